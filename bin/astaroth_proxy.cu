@@ -0,0 +1,418 @@
+/* Host proxy of an Astaroth-style integration step, to measure whether a change to the exchange improves
+   application throughput and how much of the exchange is hidden behind compute.
+
+   The domain is cut by RankPartition into one periodic subdomain per rank. Each subdomain holds --fields fields with
+   a radius-3 halo in all 26 directions. A step is the three stages of a low-storage RK3 integrator
+   (Williamson 1980, as used by Astaroth). Each stage
+     packs all fields' halos into one message per direction and posts MPI_Isend / MPI_Irecv
+     computes the interior, which needs no halo
+     waits for the messages and unpacks them
+     computes the exterior shell
+   The right-hand side of each field is a 6th-order Laplacian plus a 6th-order x-derivative of the next field.
+
+   --compute real evaluates it in loops the compiler vectorizes along x.
+   --compute busy spins for the time real compute would take, from --point-ns or from timing real compute once, so
+   the compute cost can be set independent of the host.
+   --progress calls MPI_Testall after each plane of compute, for MPIs that only progress messages inside MPI calls.
+
+   Overlap efficiency is 1 - (wait in the step) / (wait with no compute): the fraction of the time spent waiting on
+   messages that is hidden behind the interior. Packing and unpacking are reported separately, since a single thread
+   can't hide them. No GPU is used.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+#include <mpi.h>
+
+#include "argparse/argparse.hpp"
+#include "statistics.hpp"
+#include "stencil/direction_set.hpp"
+#include "stencil/logging.hpp"
+#include "stencil/mpi.hpp"
+#include "stencil/partition.hpp"
+#include "stencil/rect3.hpp"
+
+constexpr int64_t RADIUS = 3;
+constexpr int RK_STAGES = 3;
+const float RK_ALPHA[RK_STAGES] = {0.f, -5.f / 9, -153.f / 128};
+const float RK_BETA[RK_STAGES] = {1.f / 3, 15.f / 16, 8.f / 15};
+
+// 6th-order central difference coefficients for offsets 0..3
+const float D2[RADIUS + 1] = {-49.f / 18, 3.f / 2, -3.f / 20, 1.f / 90};
+const float D1[RADIUS + 1] = {0.f, 3.f / 4, -3.f / 20, 1.f / 60};
+
+typedef Directions<RadiusShape::Full> Dirs;
+
+/*! One rank's subdomain: every field with its halo, the RK3 scratch, and a message buffer for each direction.
+    Coordinates are in the allocation, so the compute region is [RADIUS, RADIUS + sz)
+*/
+struct Subdomain {
+  Dim3 sz;
+  Dim3 raw;
+  std::vector<std::vector<float>> curr, next, w; // [field][point]
+
+  int nbrs[Dirs::count]; // rank of the subdomain in each direction
+  std::vector<std::vector<float>> sendBufs, recvBufs;
+  std::vector<MPI_Request> reqs;
+
+  int64_t at(int64_t x, int64_t y, int64_t z) const noexcept { return (z * raw.y + y) * raw.x + x; }
+  int64_t fields() const noexcept { return int64_t(curr.size()); }
+};
+
+/* along one axis, the interior facing d (inside) or the halo in direction d
+ */
+void slab(int64_t d, int64_t sz, bool inside, int64_t &lo, int64_t &hi) {
+  if (0 == d) {
+    lo = RADIUS;
+    hi = RADIUS + sz;
+  } else if (d < 0) {
+    lo = inside ? RADIUS : 0;
+    hi = lo + RADIUS;
+  } else {
+    lo = inside ? sz : RADIUS + sz;
+    hi = lo + RADIUS;
+  }
+}
+
+Rect3 facing(const Subdomain &s, const Dim3 &dir, bool inside) {
+  Rect3 ret;
+  slab(dir.x, s.sz.x, inside, ret.lo.x, ret.hi.x);
+  slab(dir.y, s.sz.y, inside, ret.lo.y, ret.hi.y);
+  slab(dir.z, s.sz.z, inside, ret.lo.z, ret.hi.z);
+  return ret;
+}
+
+Subdomain make_subdomain(RankPartition &part, int64_t nFields) {
+  const int rank = mpi::world_rank();
+  const Dim3 idx = part.dimensionize(rank);
+  const Dim3 origin = part.subdomain_origin(idx);
+
+  Subdomain s;
+  s.sz = part.subdomain_size(idx);
+  s.raw = s.sz + Dim3(2 * RADIUS, 2 * RADIUS, 2 * RADIUS);
+  s.curr.assign(nFields, std::vector<float>(s.raw.flatten(), 0));
+  s.next = s.curr;
+  s.w = s.curr;
+  for (int64_t f = 0; f < nFields; ++f) {
+    for (int64_t z = RADIUS; z < RADIUS + s.sz.z; ++z) {
+      for (int64_t y = RADIUS; y < RADIUS + s.sz.y; ++y) {
+        for (int64_t x = RADIUS; x < RADIUS + s.sz.x; ++x) {
+          const double p = origin.x + x + origin.y + y + origin.z + z + f;
+          s.curr[f][s.at(x, y, z)] = float(std::sin(2 * 3.14159 / 10 * p));
+        }
+      }
+    }
+  }
+
+  for (size_t di = 0; di < Dirs::count; ++di) {
+    const Dim3 dir = Dirs::at(di);
+    s.nbrs[di] = int(part.linearize((idx + dir).wrap(part.dim())));
+    const int64_t n = facing(s, dir, true).extent().flatten() * nFields;
+    s.sendBufs.push_back(std::vector<float>(n));
+    s.recvBufs.push_back(std::vector<float>(n));
+  }
+  s.reqs.resize(2 * Dirs::count);
+  return s;
+}
+
+/* copy region `reg` of every field to or from `buf`
+ */
+void copy_region(Subdomain &s, const Rect3 &reg, float *buf, bool pack) {
+  const int64_t rowLen = reg.hi.x - reg.lo.x;
+  for (int64_t f = 0; f < s.fields(); ++f) {
+    float *u = s.curr[f].data();
+    for (int64_t z = reg.lo.z; z < reg.hi.z; ++z) {
+      for (int64_t y = reg.lo.y; y < reg.hi.y; ++y) {
+        float *row = u + s.at(reg.lo.x, y, z);
+        if (pack) {
+          std::copy(row, row + rowLen, buf);
+        } else {
+          std::copy(buf, buf + rowLen, row);
+        }
+        buf += rowLen;
+      }
+    }
+  }
+}
+
+/* A message carries the sender's interior facing dir with tag dir, so the halo in direction dir comes from the
+   neighbor there with the tag of -dir.
+*/
+void pack_and_post(Subdomain &s) {
+  for (size_t di = 0; di < Dirs::count; ++di) {
+    const size_t opp = Dirs::count - 1 - di; // directions are symmetric about the middle
+    MPI_Irecv(s.recvBufs[di].data(), int(s.recvBufs[di].size()), MPI_FLOAT, s.nbrs[di], int(opp), MPI_COMM_WORLD,
+              &s.reqs[di]);
+  }
+  for (size_t di = 0; di < Dirs::count; ++di) {
+    copy_region(s, facing(s, Dirs::at(di), true), s.sendBufs[di].data(), true);
+    MPI_Isend(s.sendBufs[di].data(), int(s.sendBufs[di].size()), MPI_FLOAT, s.nbrs[di], int(di), MPI_COMM_WORLD,
+              &s.reqs[Dirs::count + di]);
+  }
+}
+
+void unpack(Subdomain &s) {
+  for (size_t di = 0; di < Dirs::count; ++di) {
+    copy_region(s, facing(s, Dirs::at(di), false), s.recvBufs[di].data(), false);
+  }
+}
+
+void progress(Subdomain &s) {
+  int flag;
+  MPI_Testall(int(s.reqs.size()), s.reqs.data(), &flag, MPI_STATUSES_IGNORE);
+}
+
+/* one RK3 stage over `reg`, reading curr and writing next and w
+ */
+void compute_real(Subdomain &s, const Rect3 &reg, int stage, float dt, bool prog) {
+  const int64_t sy = s.raw.x;
+  const int64_t sz = s.raw.x * s.raw.y;
+  const float alpha = RK_ALPHA[stage];
+  const float beta = RK_BETA[stage];
+  for (int64_t z = reg.lo.z; z < reg.hi.z; ++z) {
+    for (int64_t f = 0; f < s.fields(); ++f) {
+      const int64_t g = (f + 1) % s.fields();
+      for (int64_t y = reg.lo.y; y < reg.hi.y; ++y) {
+        const int64_t o = s.at(0, y, z);
+        const float *__restrict__ u = s.curr[f].data() + o;
+        const float *__restrict__ v = s.curr[g].data() + o;
+        float *__restrict__ w = s.w[f].data() + o;
+        float *__restrict__ nxt = s.next[f].data() + o;
+        for (int64_t x = reg.lo.x; x < reg.hi.x; ++x) {
+          float lap = 3 * D2[0] * u[x];
+          float ddx = 0;
+          for (int64_t r = 1; r <= RADIUS; ++r) {
+            lap += D2[r] * (u[x - r] + u[x + r] + u[x - r * sy] + u[x + r * sy] + u[x - r * sz] + u[x + r * sz]);
+            ddx += D1[r] * (v[x + r] - v[x - r]);
+          }
+          const float rhs = 0.1f * lap + 0.5f * ddx;
+          w[x] = alpha * w[x] + dt * rhs;
+          nxt[x] = u[x] + beta * w[x];
+        }
+      }
+    }
+    if (prog) {
+      progress(s);
+    }
+  }
+}
+
+/* spin for as long as compute_real would take on `reg`
+ */
+void compute_busy(Subdomain &s, const Rect3 &reg, double secsPerPoint, bool prog) {
+  const double planeSecs = secsPerPoint * (reg.hi.x - reg.lo.x) * (reg.hi.y - reg.lo.y);
+  for (int64_t z = reg.lo.z; z < reg.hi.z; ++z) {
+    const double end = MPI_Wtime() + planeSecs;
+    while (MPI_Wtime() < end) {
+    }
+    if (prog) {
+      progress(s);
+    }
+  }
+}
+
+/* the points whose stencil reads no halo, empty if the subdomain is too thin
+ */
+Rect3 interior(const Subdomain &s) {
+  Rect3 ret(Dim3(2 * RADIUS, 2 * RADIUS, 2 * RADIUS), s.sz);
+  ret.hi.x = std::max(ret.hi.x, ret.lo.x);
+  ret.hi.y = std::max(ret.hi.y, ret.lo.y);
+  ret.hi.z = std::max(ret.hi.z, ret.lo.z);
+  return ret;
+}
+
+/* the compute region outside of interior(), as up to six non-overlapping slabs
+ */
+std::vector<Rect3> exterior(const Subdomain &s) {
+  const Rect3 in = interior(s);
+  Rect3 rest(Dim3(RADIUS, RADIUS, RADIUS), s.sz + Dim3(RADIUS, RADIUS, RADIUS));
+  std::vector<Rect3> ret;
+  for (int axis = 2; axis >= 0; --axis) {
+    Rect3 lo = rest, hi = rest;
+    lo.hi[axis] = in.lo[axis];
+    hi.lo[axis] = std::max(in.hi[axis], in.lo[axis]);
+    rest.lo[axis] = lo.hi[axis];
+    rest.hi[axis] = hi.lo[axis];
+    for (const Rect3 &r : {lo, hi}) {
+      if (r.extent().flatten() > 0) {
+        ret.push_back(r);
+      }
+    }
+  }
+  return ret;
+}
+
+/* per-rank seconds spent in each part of a stage, summed over stages
+ */
+struct Times {
+  double pack = 0;
+  double wait = 0;
+  double unpack = 0;
+  double compute = 0;
+};
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  const int rank = mpi::world_rank();
+  const int size = mpi::world_size();
+
+  int nIters = 10;
+  int64_t nFields = 8;
+  Dim3 ext(128, 128, 128);
+  std::string mode = "real";
+  double pointNs = 0;
+  bool prog = false;
+
+  argparse::Parser p("host proxy of an Astaroth-style RK3 step, reporting throughput and overlap efficiency");
+  p.add_option(nIters, "--iters")->help("number of steps to measure");
+  p.add_option(ext.x, "--x")->help("x extent of compute domain");
+  p.add_option(ext.y, "--y")->help("y extent of compute domain");
+  p.add_option(ext.z, "--z")->help("z extent of compute domain");
+  p.add_option(nFields, "--fields")->help("number of fields");
+  p.add_option(mode, "--compute")->help("real or busy");
+  p.add_option(pointNs, "--point-ns")->help("busy compute ns per point per stage, 0 to time real compute");
+  p.add_flag(prog, "--progress")->help("test for message completion during compute");
+  if (!p.parse(argc, argv)) {
+    if (0 == rank) {
+      std::cout << p.help();
+    }
+    exit(EXIT_FAILURE);
+  }
+  if (p.need_help()) {
+    if (0 == rank) {
+      std::cout << p.help();
+    }
+    exit(EXIT_SUCCESS);
+  }
+  if ("real" != mode && "busy" != mode) {
+    LOG_FATAL("--compute must be real or busy, not " << mode);
+  }
+  if (nFields < 1) {
+    LOG_FATAL("need at least one field");
+  }
+
+  RankPartition part(ext, size);
+  Subdomain s = make_subdomain(part, nFields);
+  if (s.sz.x < RADIUS || s.sz.y < RADIUS || s.sz.z < RADIUS) {
+    LOG_FATAL("subdomain " << s.sz << " is thinner than the radius " << RADIUS);
+  }
+  const Rect3 in = interior(s);
+  const std::vector<Rect3> ex = exterior(s);
+  const float dt = 1e-3f;
+
+  double secsPerPoint = pointNs * 1e-9;
+  if ("busy" == mode && 0 == pointNs) {
+    const Rect3 all(Dim3(RADIUS, RADIUS, RADIUS), s.sz + Dim3(RADIUS, RADIUS, RADIUS));
+    double best = 0;
+    for (int i = 0; i < 3; ++i) {
+      const double start = MPI_Wtime();
+      compute_real(s, all, 0, dt, false);
+      const double elapsed = MPI_Wtime() - start;
+      best = 0 == i ? elapsed : std::min(best, elapsed);
+    }
+    secsPerPoint = best / s.sz.flatten();
+    MPI_Allreduce(MPI_IN_PLACE, &secsPerPoint, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    if (0 == rank) {
+      LOG_INFO("busy compute at " << secsPerPoint * 1e9 << " ns per point");
+    }
+  }
+  auto compute = [&](const Rect3 &reg, int stage) {
+    if ("real" == mode) {
+      compute_real(s, reg, stage, dt, prog);
+    } else {
+      compute_busy(s, reg, secsPerPoint, prog);
+    }
+  };
+
+  // the exchange alone, for the time it takes when nothing hides it
+  Times alone;
+  for (int i = -1; i < nIters; ++i) { // i = -1 is a warmup
+    MPI_Barrier(MPI_COMM_WORLD);
+    for (int stage = 0; stage < RK_STAGES; ++stage) {
+      pack_and_post(s);
+      const double start = MPI_Wtime();
+      MPI_Waitall(int(s.reqs.size()), s.reqs.data(), MPI_STATUSES_IGNORE);
+      if (i >= 0) {
+        alone.wait += MPI_Wtime() - start;
+      }
+    }
+  }
+
+  // full steps
+  Times step;
+  Statistics stats;
+  for (int i = -1; i < nIters; ++i) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    Times t;
+    const double stepStart = MPI_Wtime();
+    for (int stage = 0; stage < RK_STAGES; ++stage) {
+      double start = MPI_Wtime();
+      pack_and_post(s);
+      double stop = MPI_Wtime();
+      t.pack += stop - start;
+
+      start = stop;
+      compute(in, stage);
+      stop = MPI_Wtime();
+      t.compute += stop - start;
+
+      start = stop;
+      MPI_Waitall(int(s.reqs.size()), s.reqs.data(), MPI_STATUSES_IGNORE);
+      stop = MPI_Wtime();
+      t.wait += stop - start;
+
+      start = stop;
+      unpack(s);
+      stop = MPI_Wtime();
+      t.unpack += stop - start;
+
+      start = stop;
+      for (const Rect3 &r : ex) {
+        compute(r, stage);
+      }
+      t.compute += MPI_Wtime() - start;
+
+      std::swap(s.curr, s.next);
+    }
+    const double elapsed = MPI_Wtime() - stepStart;
+    if (i >= 0) {
+      step.pack += t.pack;
+      step.wait += t.wait;
+      step.unpack += t.unpack;
+      step.compute += t.compute;
+      double maxElapsed;
+      MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+      if (0 == rank) {
+        stats.insert(maxElapsed);
+      }
+    }
+  }
+
+  const double eff = alone.wait > 0 ? std::max(0.0, std::min(1.0, 1 - step.wait / alone.wait)) : 1;
+  double effMin, effAvg;
+  MPI_Reduce(&eff, &effMin, 1, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+  MPI_Reduce(&eff, &effAvg, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  // slowest rank's seconds per step
+  double perStep[4] = {alone.wait / nIters, step.wait / nIters, (step.pack + step.unpack) / nIters,
+                       step.compute / nIters};
+  MPI_Allreduce(MPI_IN_PLACE, perStep, 4, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+  if (0 == rank) {
+    effAvg /= size;
+    std::cout << "ranks,extent,fields,compute,progress,count,step trimean (S),points/s,compute (S),exchange wait "
+                 "alone (S),exchange wait (S),pack+unpack (S),overlap efficiency avg,overlap efficiency min\n";
+    std::cout << size << "," << ext.x << "-" << ext.y << "-" << ext.z << "," << nFields << "," << mode << ","
+              << prog << ",";
+    std::cout << std::scientific;
+    std::cout << stats.count() << "," << stats.trimean() << "," << ext.flatten() / stats.trimean() << ","
+              << perStep[3] << "," << perStep[0] << "," << perStep[1] << "," << perStep[2] << ",";
+    std::cout << std::defaultfloat;
+    std::cout << effAvg << "," << effMin << "\n";
+  }
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,322 @@
+/* Time the rank-to-rank pattern of a DistributedDomain halo exchange on the host, as point-to-point MPI_Isend /
+   MPI_Irecv, MPI_Alltoallv, MPI_Neighbor_alltoallv, and one-sided MPI_Put, to choose a strategy for an MPI stack.
+
+   The pattern is the one realize() would produce with --per-rank subdomains on each rank: the domain is cut by
+   RankPartition, consecutive subdomains go to the same rank, and each rank sends each other rank the halos of all
+   its subdomains that face that rank's subdomains. The domain is scaled by 1, 2, 4... up to --max-scale along each
+   axis to sweep message sizes. Run with different mpirun -n to sweep rank counts. No GPU is used.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <mpi.h>
+
+#include "argparse/argparse.hpp"
+#include "statistics.hpp"
+#include "stencil/direction_set.hpp"
+#include "stencil/local_domain.cuh"
+#include "stencil/logging.hpp"
+#include "stencil/mpi.hpp"
+#include "stencil/partition.hpp"
+#include "stencil/radius.hpp"
+
+/* bytes each rank sends to each other rank in one exchange
+ */
+struct Pattern {
+  std::map<int, int64_t> sendBytes; // [dst rank] = bytes
+  std::map<int, int64_t> recvBytes; // [src rank] = bytes
+};
+
+Pattern make_pattern(const Dim3 &ext, const Radius &radius, const int64_t perRank, const int64_t bytesPerPoint) {
+  const int rank = mpi::world_rank();
+  const int size = mpi::world_size();
+  RankPartition part(ext, size * perRank);
+  const Dim3 dim = part.dim();
+
+  typedef Directions<RadiusShape::Full> Dirs;
+  Pattern ret;
+  for (int64_t i = 0; i < size * perRank; ++i) {
+    const Dim3 srcIdx = part.dimensionize(i);
+    const int srcRank = int(i / perRank);
+    for (size_t di = 0; di < Dirs::count; ++di) {
+      const Dim3 dir = Dirs::at(di);
+      if (0 == radius.dir(dir)) {
+        continue;
+      }
+      const Dim3 dstIdx = (srcIdx + dir).wrap(dim);
+      const int dstRank = int(part.linearize(dstIdx) / perRank);
+      if (srcRank == dstRank || (rank != srcRank && rank != dstRank)) {
+        continue;
+      }
+      // the source's interior facing dir, as packed by the source
+      const Dim3 haloExt = LocalDomain::halo_extent(dir, part.subdomain_size(srcIdx), radius);
+      const int64_t bytes = haloExt.flatten() * bytesPerPoint;
+      if (rank == srcRank) {
+        ret.sendBytes[dstRank] += bytes;
+      } else {
+        ret.recvBytes[srcRank] += bytes;
+      }
+    }
+  }
+  return ret;
+}
+
+/*! The buffers and per-peer counts of a Pattern, in the layouts each strategy wants
+ */
+class Exchange {
+public:
+  std::vector<int> dsts, srcs;
+  std::vector<int> sendCounts, sendDispls; // per dst, in bytes
+  std::vector<int> recvCounts, recvDispls; // per src, in bytes
+  std::vector<char> sendBuf, recvBuf;
+
+  std::vector<int> fullSendCounts, fullSendDispls, fullRecvCounts, fullRecvDispls; // per world rank
+
+  explicit Exchange(const Pattern &p) {
+    const int size = mpi::world_size();
+    fullSendCounts.resize(size, 0);
+    fullSendDispls.resize(size, 0);
+    fullRecvCounts.resize(size, 0);
+    fullRecvDispls.resize(size, 0);
+    int off = 0;
+    for (auto &kv : p.sendBytes) {
+      dsts.push_back(kv.first);
+      sendDispls.push_back(off);
+      sendCounts.push_back(int(kv.second));
+      fullSendDispls[kv.first] = off;
+      fullSendCounts[kv.first] = int(kv.second);
+      off += int(kv.second);
+    }
+    sendBuf.resize(off);
+    off = 0;
+    for (auto &kv : p.recvBytes) {
+      srcs.push_back(kv.first);
+      recvDispls.push_back(off);
+      recvCounts.push_back(int(kv.second));
+      fullRecvDispls[kv.first] = off;
+      fullRecvCounts[kv.first] = int(kv.second);
+      off += int(kv.second);
+    }
+    recvBuf.resize(off);
+
+    // each byte sent to a rank is the low byte of the sender's rank, so the recv can be checked
+    std::memset(sendBuf.data(), mpi::world_rank() & 0xFF, sendBuf.size());
+  }
+
+  void clear() { std::memset(recvBuf.data(), 0, recvBuf.size()); }
+
+  bool check() const {
+    for (size_t i = 0; i < srcs.size(); ++i) {
+      for (int b = 0; b < recvCounts[i]; ++b) {
+        if (char(srcs[i] & 0xFF) != recvBuf[recvDispls[i] + b]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+};
+
+void p2p(Exchange &ex) {
+  std::vector<MPI_Request> reqs(ex.srcs.size() + ex.dsts.size());
+  for (size_t i = 0; i < ex.srcs.size(); ++i) {
+    MPI_Irecv(ex.recvBuf.data() + ex.recvDispls[i], ex.recvCounts[i], MPI_BYTE, ex.srcs[i], 0, MPI_COMM_WORLD,
+              &reqs[i]);
+  }
+  for (size_t i = 0; i < ex.dsts.size(); ++i) {
+    MPI_Isend(ex.sendBuf.data() + ex.sendDispls[i], ex.sendCounts[i], MPI_BYTE, ex.dsts[i], 0, MPI_COMM_WORLD,
+              &reqs[ex.srcs.size() + i]);
+  }
+  MPI_Waitall(int(reqs.size()), reqs.data(), MPI_STATUSES_IGNORE);
+}
+
+void alltoallv(Exchange &ex) {
+  MPI_Alltoallv(ex.sendBuf.data(), ex.fullSendCounts.data(), ex.fullSendDispls.data(), MPI_BYTE, ex.recvBuf.data(),
+                ex.fullRecvCounts.data(), ex.fullRecvDispls.data(), MPI_BYTE, MPI_COMM_WORLD);
+}
+
+/* graph created once outside of the timed region, as realize() would
+ */
+void neighbor_alltoallv(Exchange &ex, MPI_Comm graph) {
+  MPI_Neighbor_alltoallv(ex.sendBuf.data(), ex.sendCounts.data(), ex.sendDispls.data(), MPI_BYTE, ex.recvBuf.data(),
+                         ex.recvCounts.data(), ex.recvDispls.data(), MPI_BYTE, graph);
+}
+
+/* each rank puts into its destinations' windows at offsets exchanged once outside of the timed region.
+   General active target synchronization, so each rank only synchronizes with its neighbors
+*/
+void put(Exchange &ex, MPI_Win win, MPI_Group srcGroup, MPI_Group dstGroup, const std::vector<int> &targetDispls) {
+  MPI_Win_post(srcGroup, 0, win);
+  MPI_Win_start(dstGroup, 0, win);
+  for (size_t i = 0; i < ex.dsts.size(); ++i) {
+    MPI_Put(ex.sendBuf.data() + ex.sendDispls[i], ex.sendCounts[i], MPI_BYTE, ex.dsts[i], targetDispls[i],
+            ex.sendCounts[i], MPI_BYTE, win);
+  }
+  MPI_Win_complete(win);
+  MPI_Win_wait(win);
+}
+
+template <typename F> Statistics time_strategy(const std::string &name, Exchange &ex, const int nIters, F f) {
+  const int rank = mpi::world_rank();
+  Statistics stats;
+
+  // one untimed exchange to warm up and check
+  ex.clear();
+  MPI_Barrier(MPI_COMM_WORLD);
+  f();
+  int ok = ex.check();
+  MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+  if (!ok && 0 == rank) {
+    LOG_ERROR(name << " delivered the wrong bytes");
+  }
+
+  for (int i = 0; i < nIters; ++i) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    f();
+    double elapsed = MPI_Wtime() - start;
+    double maxElapsed;
+    MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (0 == rank) {
+      stats.insert(maxElapsed);
+    }
+  }
+  return stats;
+}
+
+void report_header() {
+  std::cout << "strategy,ranks,extent,bytes,count,trimean (S),trimean (B/s),stddev,min,avg,max\n";
+}
+
+void report(const std::string &strategy, const std::string &cfg, uint64_t bytes, Statistics &stats) {
+  std::cout << strategy << "," << mpi::world_size() << "," << cfg << "," << bytes << ",";
+  std::cout << std::scientific;
+  std::cout << stats.count() << "," << stats.trimean() << "," << bytes / stats.trimean() << "," << stats.stddev()
+            << "," << stats.min() << "," << stats.avg() << "," << stats.max() << "\n";
+  std::cout << std::defaultfloat;
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  const int rank = mpi::world_rank();
+
+  int nIters = 30;
+  int nQuants = 1;
+  int64_t elemSize = 4;
+  Dim3 ext(64, 64, 64);
+  int64_t radius = 2;
+  int64_t perRank = 1;
+  int64_t maxScale = 8;
+
+  argparse::Parser p("time a DistributedDomain halo exchange pattern with host MPI strategies");
+  p.add_option(nIters, "--iters")->help("number of iterations to measure");
+  p.add_option(ext.x, "--x")->help("x extent of compute domain at scale 1");
+  p.add_option(ext.y, "--y")->help("y extent of compute domain at scale 1");
+  p.add_option(ext.z, "--z")->help("z extent of compute domain at scale 1");
+  p.add_option(nQuants, "--q")->help("number of quantities");
+  p.add_option(elemSize, "--elem-size")->help("bytes per quantity element");
+  p.add_option(radius, "--radius")->help("stencil radius in every direction");
+  p.add_option(perRank, "--per-rank")->help("subdomains on each rank");
+  p.add_option(maxScale, "--max-scale")->help("largest factor to scale the extent by");
+  if (!p.parse(argc, argv)) {
+    if (0 == rank) {
+      std::cout << p.help();
+    }
+    exit(EXIT_FAILURE);
+  }
+  if (p.need_help()) {
+    if (0 == rank) {
+      std::cout << p.help();
+    }
+    exit(EXIT_SUCCESS);
+  }
+
+  if (1 == mpi::world_size()) {
+    LOG_WARN("one rank has no other ranks to exchange with");
+    MPI_Finalize();
+    return 0;
+  }
+
+  if (0 == rank) {
+    report_header();
+  }
+
+  for (int64_t scale = 1; scale <= maxScale; scale *= 2) {
+    const Dim3 sext = ext * scale;
+    const Pattern pattern = make_pattern(sext, Radius::constant(radius), perRank, nQuants * elemSize);
+
+    int64_t bytes = 0;
+    for (auto &kv : pattern.sendBytes) {
+      bytes += kv.second;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &bytes, 1, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (bytes > std::numeric_limits<int>::max()) {
+      if (0 == rank) {
+        LOG_WARN("stopping at scale " << scale << ": " << bytes << "B does not fit MPI int counts");
+      }
+      break;
+    }
+
+    std::stringstream cfg;
+    cfg << sext.x << "-" << sext.y << "-" << sext.z;
+
+    Exchange ex(pattern);
+
+    Statistics stats = time_strategy("p2p", ex, nIters, [&]() { p2p(ex); });
+    if (0 == rank) {
+      report("p2p", cfg.str(), bytes, stats);
+    }
+
+    stats = time_strategy("alltoallv", ex, nIters, [&]() { alltoallv(ex); });
+    if (0 == rank) {
+      report("alltoallv", cfg.str(), bytes, stats);
+    }
+
+    MPI_Comm graph;
+    MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD, int(ex.srcs.size()), ex.srcs.data(), MPI_UNWEIGHTED,
+                                   int(ex.dsts.size()), ex.dsts.data(), MPI_UNWEIGHTED, MPI_INFO_NULL, 0 /*reorder*/,
+                                   &graph);
+    stats = time_strategy("neighbor_alltoallv", ex, nIters, [&]() { neighbor_alltoallv(ex, graph); });
+    if (0 == rank) {
+      report("neighbor_alltoallv", cfg.str(), bytes, stats);
+    }
+    MPI_Comm_free(&graph);
+
+    // where in each destination's window our bytes go
+    std::vector<int> targetDispls(ex.dsts.size());
+    {
+      std::vector<MPI_Request> reqs(ex.srcs.size() + ex.dsts.size());
+      for (size_t i = 0; i < ex.dsts.size(); ++i) {
+        MPI_Irecv(&targetDispls[i], 1, MPI_INT, ex.dsts[i], 1, MPI_COMM_WORLD, &reqs[i]);
+      }
+      for (size_t i = 0; i < ex.srcs.size(); ++i) {
+        MPI_Isend(&ex.recvDispls[i], 1, MPI_INT, ex.srcs[i], 1, MPI_COMM_WORLD, &reqs[ex.dsts.size() + i]);
+      }
+      MPI_Waitall(int(reqs.size()), reqs.data(), MPI_STATUSES_IGNORE);
+    }
+    MPI_Group world, srcGroup, dstGroup;
+    MPI_Comm_group(MPI_COMM_WORLD, &world);
+    MPI_Group_incl(world, int(ex.srcs.size()), ex.srcs.data(), &srcGroup);
+    MPI_Group_incl(world, int(ex.dsts.size()), ex.dsts.data(), &dstGroup);
+    MPI_Win win;
+    char empty; // some MPIs reject a null window base, even of size 0
+    MPI_Win_create(ex.recvBuf.empty() ? &empty : ex.recvBuf.data(), MPI_Aint(ex.recvBuf.size()), 1, MPI_INFO_NULL,
+                   MPI_COMM_WORLD, &win);
+    stats = time_strategy("put", ex, nIters, [&]() { put(ex, win, srcGroup, dstGroup, targetDispls); });
+    if (0 == rank) {
+      report("put", cfg.str(), bytes, stats);
+    }
+    MPI_Win_free(&win);
+    MPI_Group_free(&srcGroup);
+    MPI_Group_free(&dstGroup);
+    MPI_Group_free(&world);
+  }
+
+  MPI_Finalize();
+  return 0;
+}
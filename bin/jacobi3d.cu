@@ -34,8 +34,8 @@ __device__ int64_t dist(const Dim3 a, const Dim3 b) {
 
 /* Apply a 3d jacobi stencil to `reg`
 
-   Since the library only supports periodic boundary conditions right now,
-   fix part of the middle of the compute region at 1 and part at 0
+   The domain keeps the default periodic boundary conditions,
+   so fix part of the middle of the compute region at 1 and part at 0
  */
 __global__ void stencil_kernel(Accessor<float> dst, const Accessor<float> src,
                                const Rect3 myReg, //<! the region i should modify
@@ -106,6 +106,7 @@ int main(int argc, char **argv) {
 
   int iters;
   int checkpointPeriod = -1;
+  int staleness = -1;
 
   argparse::Parser parser("a cwpearson/argparse-powered CLI app");
   // clang-format off
@@ -122,6 +123,7 @@ int main(int argc, char **argv) {
   parser.add_flag(paraview, "--paraview")->help("dump paraview files");
   parser.add_option(iters, "--iters", "-n")->help("number of iterations");
   parser.add_option(checkpointPeriod, "--period", "-q")->help("iterations between checkpoints");
+  parser.add_option(staleness, "--staleness", "-s")->help("asynchronous: use halos up to this many iterations old");
   parser.add_positional(x)->required();
   parser.add_positional(y)->required();
   parser.add_positional(z)->required();
@@ -137,6 +139,12 @@ if (parser.need_help()) {
     return 0;
 }
 
+  // exchange_stale() does not support colocated transports
+  if (staleness >= 0 && useColo) {
+    std::cerr << "--staleness can't be used with --colo\n";
+    exit(EXIT_FAILURE);
+  }
+
   // default checkpoint 10 times
   if (checkpointPeriod <= 0) {
     checkpointPeriod = iters / 10;
@@ -190,6 +198,9 @@ if (parser.need_help()) {
   }
   if (MethodFlags::None == methods) {
     methods = MethodFlags::All;
+    if (staleness >= 0) {
+      methods = MethodFlags(int(methods) & ~int(MethodFlags::CudaMpiColocated));
+    }
   }
 
   PlacementStrategy strategy = PlacementStrategy::NodeAware;
@@ -262,6 +273,11 @@ if (parser.need_help()) {
     const std::vector<Rect3> interiors = dd.get_interior();
     const std::vector<std::vector<Rect3>> exteriors = dd.get_exterior();
 
+    if (staleness >= 0) {
+      // exchange_stale() starts from these halos
+      dd.exchange();
+    }
+
     for (int iter = 0; iter < iters; ++iter) {
 
       double elapsed = MPI_Wtime();
@@ -288,7 +304,11 @@ if (parser.need_help()) {
       // exchange halos: update ghost elements with current values from neighbors
       // if (0 == rank)
       //   std::cerr << rank << ": exchange\n";
-      dd.exchange();
+      if (staleness >= 0) {
+        dd.exchange_stale(iter + 1, staleness);
+      } else {
+        dd.exchange();
+      }
 
       if (overlap) {
         // operate on exterior now that ghost values are right
@@ -337,7 +357,10 @@ if (parser.need_help()) {
       dd.swap();
 
       elapsed = MPI_Wtime() - elapsed;
-      MPI_Allreduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      // a collective every iteration would put the asynchronous ranks back in lockstep
+      if (staleness < 0) {
+        MPI_Allreduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      }
       iterTime.insert(elapsed);
 
       if (paraview && (iter % checkpointPeriod == 0)) {
@@ -345,6 +368,10 @@ if (parser.need_help()) {
       }
     }
 
+    if (staleness >= 0) {
+      dd.finish_stale(iters + 1);
+    }
+
     if (paraview) {
       dd.write_paraview(prefix + "jacobi3d_final");
     }
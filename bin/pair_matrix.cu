@@ -0,0 +1,199 @@
+/* Measure one-way transfer time between every pair of ranks across message sizes, and write a PairMatrix file.
+
+   Pairs are scheduled as a round-robin tournament: in each of the n-1 rounds (n rounded up to even) every rank has
+   one partner. With --concurrent, all pairs of a round are measured at once, which is fast and loads the network
+   like an exchange does. Otherwise pairs are measured one at a time. --sample k measures only k of the rounds, the
+   same on every rank, so each rank has k partners. Unmeasured pairs are PAIR_NOT_MEASURED.
+
+   With --bidirectional, both ranks of a pair send at once; otherwise they ping-pong.
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include <mpi.h>
+
+#include "argparse/argparse.hpp"
+#include "stencil/logging.hpp"
+#include "stencil/mpi.hpp"
+#include "stencil/pair_matrix.hpp"
+
+/* rank's partner in `round` of a tournament of n (even) players, where some may not exist
+ */
+int partner(const int rank, const int round, const int n) {
+  assert(0 == n % 2);
+  if (n - 1 == rank) {
+    for (int i = 0; i < n - 1; ++i) {
+      if ((round - i + (n - 1)) % (n - 1) == i) {
+        return i;
+      }
+    }
+  }
+  const int j = (round - rank + (n - 1)) % (n - 1);
+  return j == rank ? n - 1 : j;
+}
+
+/* one-way time for `bytes` between this rank and `peer`
+ */
+double measure(char *sendBuf, char *recvBuf, const int bytes, const int peer, const int nIters,
+               const bool bidirectional) {
+  const int rank = mpi::world_rank();
+  const bool first = rank < peer;
+  MPI_Request reqs[2];
+  double elapsed = 0;
+  for (int i = -1; i < nIters; ++i) { // i = -1 is a warmup
+    const double start = MPI_Wtime();
+    if (bidirectional) {
+      MPI_Irecv(recvBuf, bytes, MPI_BYTE, peer, 0, MPI_COMM_WORLD, &reqs[0]);
+      MPI_Isend(sendBuf, bytes, MPI_BYTE, peer, 0, MPI_COMM_WORLD, &reqs[1]);
+      MPI_Waitall(2, reqs, MPI_STATUSES_IGNORE);
+    } else if (first) {
+      MPI_Send(sendBuf, bytes, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+      MPI_Recv(recvBuf, bytes, MPI_BYTE, peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    } else {
+      MPI_Recv(recvBuf, bytes, MPI_BYTE, peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      MPI_Send(sendBuf, bytes, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+    }
+    if (i >= 0) {
+      elapsed += MPI_Wtime() - start;
+    }
+  }
+  return bidirectional ? elapsed / nIters : elapsed / nIters / 2;
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  const int rank = mpi::world_rank();
+  const int size = mpi::world_size();
+
+  int minN = 0;
+  int maxN = 22;
+  int stepN = 2;
+  int nIters = 10;
+  int sample = 0;
+  bool bidirectional = false;
+  bool concurrent = false;
+  std::string outpath = "pair_matrix.txt";
+
+  argparse::Parser p("measure transfer time between every pair of ranks");
+  p.add_option(minN, "--min")->help("log2 of the smallest message");
+  p.add_option(maxN, "--max")->help("log2 of the largest message");
+  p.add_option(stepN, "--step")->help("log2 step between message sizes");
+  p.add_option(nIters, "--iters")->help("transfers per measurement");
+  p.add_option(sample, "--sample")->help("measure only this many partners per rank, 0 for all");
+  p.add_flag(bidirectional, "--bidirectional")->help("both ranks of a pair send at once");
+  p.add_flag(concurrent, "--concurrent")->help("measure all pairs of a round at once");
+  p.add_option(outpath, "--out", "-o")->help("pair matrix file to write");
+  if (!p.parse(argc, argv)) {
+    if (0 == rank) {
+      std::cout << p.help();
+    }
+    exit(EXIT_FAILURE);
+  }
+  if (p.need_help()) {
+    if (0 == rank) {
+      std::cout << p.help();
+    }
+    exit(EXIT_SUCCESS);
+  }
+  if (minN < 0 || maxN > 30 || minN > maxN || stepN < 1) {
+    LOG_FATAL("need 0 <= --min <= --max <= 30 and --step >= 1");
+  }
+
+  std::vector<int64_t> sizes;
+  for (int n = minN; n <= maxN; n += stepN) {
+    sizes.push_back(int64_t(1) << n);
+  }
+
+  // rounds of the tournament, in the same shuffled order on every rank
+  const int players = size + size % 2;
+  std::vector<int> rounds(players - 1);
+  for (int r = 0; r < players - 1; ++r) {
+    rounds[r] = r;
+  }
+  std::mt19937 rng(0);
+  std::shuffle(rounds.begin(), rounds.end(), rng);
+  if (sample > 0 && size_t(sample) < rounds.size()) {
+    rounds.resize(sample);
+  }
+
+  std::vector<char> sendBuf(sizes.back()), recvBuf(sizes.back());
+
+  // row[si * size + dst] = time from this rank to dst
+  std::vector<double> row(sizes.size() * size, PAIR_NOT_MEASURED);
+
+  for (size_t ri = 0; ri < rounds.size(); ++ri) {
+    const int round = rounds[ri];
+    const int peer = partner(rank, round, players);
+    if (0 == rank) {
+      LOG_INFO("round " << ri + 1 << "/" << rounds.size());
+    }
+
+    if (concurrent) {
+      MPI_Barrier(MPI_COMM_WORLD);
+      if (peer < size) {
+        for (size_t si = 0; si < sizes.size(); ++si) {
+          row[si * size + peer] = measure(sendBuf.data(), recvBuf.data(), int(sizes[si]), peer, nIters, bidirectional);
+        }
+      }
+    } else {
+      // one pair at a time, in order of the pair's lower rank
+      for (int lo = 0; lo < size; ++lo) {
+        const int hi = partner(lo, round, players);
+        if (hi < lo || hi >= size) {
+          continue;
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (rank == lo || rank == hi) {
+          for (size_t si = 0; si < sizes.size(); ++si) {
+            row[si * size + peer] =
+                measure(sendBuf.data(), recvBuf.data(), int(sizes[si]), peer, nIters, bidirectional);
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<double> rows;
+  std::vector<char> names;
+  if (0 == rank) {
+    rows.resize(row.size() * size);
+    names.resize(size * MPI_MAX_PROCESSOR_NAME);
+  }
+  MPI_Gather(row.data(), int(row.size()), MPI_DOUBLE, rows.data(), int(row.size()), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  char name[MPI_MAX_PROCESSOR_NAME] = {0};
+  int nameLen;
+  MPI_Get_processor_name(name, &nameLen);
+  MPI_Gather(name, MPI_MAX_PROCESSOR_NAME, MPI_BYTE, names.data(), MPI_MAX_PROCESSOR_NAME, MPI_BYTE, 0,
+             MPI_COMM_WORLD);
+
+  if (0 == rank) {
+    PairMatrix pm;
+    pm.bidirectional = bidirectional;
+    pm.concurrent = concurrent;
+    pm.sizes = sizes;
+    for (int r = 0; r < size; ++r) {
+      pm.hosts.push_back(std::string(&names[r * MPI_MAX_PROCESSOR_NAME]));
+    }
+    pm.times.assign(sizes.size(), Mat2D<double>(size, size, PAIR_NOT_MEASURED));
+    for (int src = 0; src < size; ++src) {
+      for (size_t si = 0; si < sizes.size(); ++si) {
+        for (int dst = 0; dst < size; ++dst) {
+          pm.times[si].at(src, dst) = rows[src * row.size() + si * size + dst];
+        }
+      }
+    }
+    std::ofstream os(outpath);
+    if (!os) {
+      LOG_FATAL("couldn't open " << outpath);
+    }
+    pm.write(os);
+    LOG_INFO("wrote " << outpath);
+  }
+
+  MPI_Finalize();
+  return 0;
+}
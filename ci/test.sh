@@ -1,4 +1,5 @@
-set -x
+set -ex
 
 cd build
-make test
\ No newline at end of file
+# the perf tests need a quiet machine with a recorded baseline, so they are run by hand with ctest -L perf
+ctest --output-on-failure -LE perf
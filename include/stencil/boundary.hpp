@@ -1,27 +1,192 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
+#include <cstdlib>
 
-#include "stencil/direction_map.hpp"
+#include "stencil/dim3.hpp"
 
-class Boundary {
+/* what fills the halo beyond a face of the global domain
+ */
+enum class BoundaryKind {
+  Periodic,    // the halo comes from the opposite side of the domain (the default)
+  Dirichlet,   // the halo is a fixed value
+  Neumann,     // the halo mirrors the interior across the face: zero gradient, reflective
+  Extrapolate, // the halo continues the line through the two interior points nearest the face
+  External,    // the halo is filled outside of the exchange, for example from the parent of a RefinedPatch
+};
 
-private:
+struct BoundaryCondition {
+  BoundaryKind kind;
+  double value; // the halo value for Dirichlet
+
+  BoundaryCondition() : kind(BoundaryKind::Periodic), value(0) {}
+  BoundaryCondition(BoundaryKind k, double v = 0) : kind(k), value(v) {}
+
+  static BoundaryCondition periodic() { return BoundaryCondition(BoundaryKind::Periodic); }
+  static BoundaryCondition dirichlet(double v) { return BoundaryCondition(BoundaryKind::Dirichlet, v); }
+  static BoundaryCondition neumann() { return BoundaryCondition(BoundaryKind::Neumann); }
+  static BoundaryCondition extrapolate() { return BoundaryCondition(BoundaryKind::Extrapolate); }
+  static BoundaryCondition external() { return BoundaryCondition(BoundaryKind::External); }
+
+  bool operator==(const BoundaryCondition &rhs) const noexcept { return kind == rhs.kind && value == rhs.value; }
+  bool operator!=(const BoundaryCondition &rhs) const noexcept { return !(*this == rhs); }
+};
+
+/* how one axis of a halo region is filled by a BoundarySender
+ */
+enum class AxisOp : int8_t {
+  None,        // not a boundary along this axis: the source is in another subdomain's halo message
+  Wrap,        // periodic onto this same subdomain: copy from the opposite side of the interior
+  Dirichlet,   // the axis' Dirichlet value
+  Neumann,     // mirror across the face
+  Extrapolate, // linear extrapolation from the two points nearest the face
+};
+
+/* A halo region of a subdomain that no message fills, and how to fill it along each axis.
+   Where more than one axis is on a boundary, a Dirichlet axis wins, and otherwise the source point is found by
+   applying every axis' op
+*/
+struct BoundaryOp {
+  Dim3 dir;        // the side of the halo region
+  AxisOp op[3];    // for x, y, z. None where dir is 0
+  double value[3]; // Dirichlet value for each axis
+
+  /* true if every source point is in this subdomain's interior, so the op need not wait for any message
+   */
+  bool reads_interior() const noexcept {
+    for (int i = 0; i < 3; ++i) {
+      if (0 != dir[i] && AxisOp::None == op[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /* true if halo values accumulated into this region can be added back where they came from
+   */
+  bool accumulates() const noexcept {
+    for (int i = 0; i < 3; ++i) {
+      if (AxisOp::Dirichlet == op[i] || AxisOp::Extrapolate == op[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
 
-  DirectionMap<bool> dirs_;
+/* The condition on each of the six faces of the global domain. Every face is periodic by default.
+   An axis must be periodic on both faces or on neither
+*/
+class Boundary {
+private:
+  BoundaryCondition faces_[3][2]; // [axis][0 for the - face, 1 for the + face]
 
 public:
+  Boundary() {}
+
+  /* set the condition on `face`, which has exactly one non-zero component, for example Dim3(-1, 0, 0)
+   */
+  void set(const Dim3 &face, const BoundaryCondition &bc) {
+    assert(1 == std::abs(face.x) + std::abs(face.y) + std::abs(face.z));
+    for (int i = 0; i < 3; ++i) {
+      if (0 != face[i]) {
+        faces_[i][face[i] > 0] = bc;
+      }
+    }
+  }
+
+  const BoundaryCondition &face(const int axis, const int side) const {
+    assert(axis >= 0 && axis < 3);
+    assert(-1 == side || 1 == side);
+    return faces_[axis][side > 0];
+  }
 
-  /* periodic boundary by default */
-  Boundary() : dirs_(true) {}
+  bool periodic(const int axis) const {
+    return BoundaryKind::Periodic == face(axis, -1).kind && BoundaryKind::Periodic == face(axis, 1).kind;
+  }
+
+  /* true if each axis is periodic on both faces or on neither
+   */
+  bool valid() const {
+    for (int i = 0; i < 3; ++i) {
+      if ((BoundaryKind::Periodic == face(i, -1).kind) != (BoundaryKind::Periodic == face(i, 1).kind)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /* true if a step from subdomain `idx` by `dir`, in a partition of `dim` subdomains, leaves through a face that is
+     not periodic
+  */
+  bool crosses(const Dim3 &idx, const Dim3 &dir, const Dim3 &dim) const {
+    for (int i = 0; i < 3; ++i) {
+      const int64_t j = idx[i] + dir[i];
+      if ((j < 0 || j >= dim[i]) && !periodic(i)) {
+        return true;
+      }
+    }
+    return false;
+  }
 
-  void set_dir(int x, int y, int z, bool b) noexcept {
-    dirs_.at_dir(x, y, z) = b;
-    dirs_.at_dir(-1 * x, -1 * y, -1 * z) = b;
+  /* How to fill halo side `dir` of subdomain `idx` if no message fills it: when it is beyond a face that is not
+     periodic, or when it wraps onto the subdomain itself. Returns false if a message fills it, or if it is beyond an
+     External face
+  */
+  bool op(BoundaryOp *ret, const Dim3 &idx, const Dim3 &dir, const Dim3 &dim) const {
+    const bool self = Dim3(idx + dir).wrap(dim) == idx;
+    if (!self && !crosses(idx, dir, dim)) {
+      return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+      const int64_t j = idx[i] + dir[i];
+      if ((j < 0 || j >= dim[i]) && BoundaryKind::External == face(i, dir[i]).kind) {
+        return false;
+      }
+    }
+    ret->dir = dir;
+    for (int i = 0; i < 3; ++i) {
+      ret->op[i] = AxisOp::None;
+      ret->value[i] = 0;
+      const int64_t j = idx[i] + dir[i];
+      if (0 == dir[i] || (j >= 0 && j < dim[i])) {
+        continue; // another subdomain along this axis
+      }
+      const BoundaryCondition &bc = face(i, dir[i]);
+      switch (bc.kind) {
+      case BoundaryKind::Periodic:
+        if (1 == dim[i]) {
+          ret->op[i] = AxisOp::Wrap;
+        }
+        break;
+      case BoundaryKind::Dirichlet:
+        ret->op[i] = AxisOp::Dirichlet;
+        ret->value[i] = bc.value;
+        break;
+      case BoundaryKind::Neumann:
+        ret->op[i] = AxisOp::Neumann;
+        break;
+      case BoundaryKind::Extrapolate:
+        ret->op[i] = AxisOp::Extrapolate;
+        break;
+      case BoundaryKind::External:
+        assert(0 && "unreachable");
+        break;
+      }
+    }
+    return true;
   }
 
-  bool wraps(int x, int y, int z) const {
-    assert(x != 0 && y != 0 && z != 0);
-    return dirs_.at_dir(x, y, z);
+  bool operator==(const Boundary &rhs) const noexcept {
+    for (int i = 0; i < 3; ++i) {
+      for (int s = 0; s < 2; ++s) {
+        if (faces_[i][s] != rhs.faces_[i][s]) {
+          return false;
+        }
+      }
+    }
+    return true;
   }
-};
\ No newline at end of file
+  bool operator!=(const Boundary &rhs) const noexcept { return !(*this == rhs); }
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "data_type.hpp"
 #include "dim3.hpp"
 #include "pack_kernel.cuh"
 
@@ -133,14 +134,96 @@ translate(void *__restrict__ dst, const Dim3 dstPos, const Dim3 dstSize,
   translate_grid(dst, dstPos, dstSize, src, srcPos, srcSize, extent, elemSize);
 }
 
+/* translate each of n quantities. Quantity i's sizes and extent grow by staggers[i] as in staggered_extent(), where
+   haloDir is the side of the destination halo being filled
+*/
 static __global__ void
 multi_translate(void *__restrict__ *__restrict__ dsts, const Dim3 dstPos,
                 const Dim3 dstSize, void *__restrict__ *__restrict__ const srcs,
                 const Dim3 srcPos, const Dim3 srcSize,
                 const Dim3 extent, // the extent of the region to be copied
-                size_t *const __restrict__ elemSizes, const size_t n) {
+                size_t *const __restrict__ elemSizes, const Dim3 *__restrict__ staggers, const Dim3 haloDir,
+                const size_t n) {
   for (size_t i = 0; i < n; ++i) {
-    translate_grid(dsts[i], dstPos, dstSize, srcs[i], srcPos, srcSize, extent,
+    const Dim3 qExt = staggered_extent(extent, haloDir, staggers[i]);
+    translate_grid(dsts[i], dstPos, dstSize + staggers[i], srcs[i], srcPos, srcSize + staggers[i], qExt,
                    elemSizes[i]);
   }
 }
+
+/*! atomically add one element of type `type` from src to dst
+ */
+inline __device__ void atomic_accumulate(void *dst, const void *src, const DataType type) {
+  switch (type) {
+  case DataType::Float:
+    atomicAdd(static_cast<float *>(dst), *static_cast<const float *>(src));
+    break;
+  case DataType::Double: {
+#if __CUDA_ARCH__ >= 600
+    atomicAdd(static_cast<double *>(dst), *static_cast<const double *>(src));
+#else
+    // no double atomicAdd before sm_60: compare-and-swap the bits until no other thread got in between
+    unsigned long long *addr = static_cast<unsigned long long *>(dst);
+    const double val = *static_cast<const double *>(src);
+    unsigned long long old = *addr, assumed;
+    do {
+      assumed = old;
+      old = atomicCAS(addr, assumed, __double_as_longlong(val + __longlong_as_double(assumed)));
+    } while (assumed != old);
+#endif
+    break;
+  }
+  case DataType::Int32:
+    atomicAdd(static_cast<int *>(dst), *static_cast<const int *>(src));
+    break;
+  case DataType::Int64:
+    // two's complement addition is the same for signed and unsigned
+    atomicAdd(static_cast<unsigned long long *>(dst), *static_cast<const unsigned long long *>(src));
+    break;
+  case DataType::None:
+    assert(0 && "can't accumulate a quantity with no DataType");
+  }
+}
+
+/* add the 3D region src[srcPos...srcPos+extent] into the 3D region
+   dst[dstPos...dstPos+extent].
+   Additions are atomic because regions accumulated from different neighbors
+   may overlap in dst (e.g. a face and an edge)
+*/
+inline __device__ void accumulate_grid(void *__restrict__ dst, const Dim3 dstPos, const Dim3 dstSize,
+                                       const void *__restrict__ src, const Dim3 srcPos, const Dim3 srcSize,
+                                       const Dim3 extent, // the extent of the region to be accumulated
+                                       const size_t elemSize, const DataType type) {
+
+  char *cDst = reinterpret_cast<char *>(dst);
+  const char *cSrc = reinterpret_cast<const char *>(src);
+
+  const size_t tz = blockDim.z * blockIdx.z + threadIdx.z;
+  const size_t ty = blockDim.y * blockIdx.y + threadIdx.y;
+  const size_t tx = blockDim.x * blockIdx.x + threadIdx.x;
+
+  for (size_t z = tz; z < extent.z; z += blockDim.z * gridDim.z) {
+    for (size_t y = ty; y < extent.y; y += blockDim.y * gridDim.y) {
+      for (size_t x = tx; x < extent.x; x += blockDim.x * gridDim.x) {
+        size_t lo = (z + dstPos.z) * dstSize.y * dstSize.x + (y + dstPos.y) * dstSize.x + (x + dstPos.x);
+        size_t li = (z + srcPos.z) * srcSize.y * srcSize.x + (y + srcPos.y) * srcSize.x + (x + srcPos.x);
+        atomic_accumulate(&cDst[lo * elemSize], &cSrc[li * elemSize], type);
+      }
+    }
+  }
+}
+
+/*! same as multi_translate, but adds src into dst instead of overwriting
+ */
+static __global__ void multi_accumulate(void *__restrict__ *__restrict__ dsts, const Dim3 dstPos, const Dim3 dstSize,
+                                        void *__restrict__ *__restrict__ const srcs, const Dim3 srcPos,
+                                        const Dim3 srcSize,
+                                        const Dim3 extent, // the extent of the region to be accumulated
+                                        size_t *const __restrict__ elemSizes, const DataType *__restrict__ types,
+                                        const Dim3 *__restrict__ staggers, const Dim3 haloDir, const size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    const Dim3 qExt = staggered_extent(extent, haloDir, staggers[i]);
+    accumulate_grid(dsts[i], dstPos, dstSize + staggers[i], srcs[i], srcPos, srcSize + staggers[i], qExt,
+                    elemSizes[i], types[i]);
+  }
+}
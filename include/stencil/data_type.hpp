@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+/* The arithmetic type of a quantity.
+   Copies only need the element size, but accumulating exchanges need to know how to add elements
+*/
+enum class DataType {
+  None, // not an arithmetic type, cannot be accumulated
+  Float,
+  Double,
+  Int32,
+  Int64,
+};
+
+/* signed integers are matched by width, so int, long, long long, and whichever of them int32_t and int64_t are all
+   have a DataType without duplicate specializations
+ */
+template <typename T> inline DataType data_type_of() {
+  if (std::is_integral<T>::value && std::is_signed<T>::value) {
+    if (sizeof(T) == sizeof(int32_t)) {
+      return DataType::Int32;
+    } else if (sizeof(T) == sizeof(int64_t)) {
+      return DataType::Int64;
+    }
+  }
+  return DataType::None;
+}
+template <> inline DataType data_type_of<float>() { return DataType::Float; }
+template <> inline DataType data_type_of<double>() { return DataType::Double; }
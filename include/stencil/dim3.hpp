@@ -58,7 +58,9 @@ public:
     assert(0 && "only 3 dimensions!");
     return x;
   }
-  CUDA_CALLABLE_MEMBER const int64_t &operator[](const size_t idx) const { return operator[](idx); }
+  CUDA_CALLABLE_MEMBER const int64_t &operator[](const size_t idx) const {
+    return const_cast<Dim3 &>(*this).operator[](idx);
+  }
 
   /*! \brief elementwise max
    */
@@ -200,7 +202,7 @@ public:
 
   CUDA_CALLABLE_MEMBER bool operator==(const Dim3 &rhs) const { return x == rhs.x && y == rhs.y && z == rhs.z; }
 
-  CUDA_CALLABLE_MEMBER bool operator!=(const Dim3 &rhs) const { return x != rhs.x || y != rhs.y || z == rhs.z; }
+  CUDA_CALLABLE_MEMBER bool operator!=(const Dim3 &rhs) const { return x != rhs.x || y != rhs.y || z != rhs.z; }
 
 #ifdef __CUDACC__
   /* convertible to CUDA dim3 */
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cassert>
+#include <vector>
+
+#include "stencil/dim3.hpp"
+#include "stencil/radius.hpp"
+
+/* Compile-time direction sets for each RadiusShape.
+
+   Directions<S>::count is the number of directions a stencil of shape S may exchange in,
+   and Directions<S>::at(i) is the i-th direction.
+   Directions are in the same order as a z-y-x nested loop over [-1,1]^3, skipping [0,0,0]
+*/
+template <RadiusShape S> struct Directions;
+
+template <> struct Directions<RadiusShape::Full> {
+  static constexpr size_t count = 26;
+  static Dim3 at(size_t i) noexcept {
+    assert(i < count);
+    const int idx = i < 13 ? int(i) : int(i) + 1; // skip [0,0,0]
+    return Dim3(idx % 3 - 1, idx / 3 % 3 - 1, idx / 9 - 1);
+  }
+};
+
+template <> struct Directions<RadiusShape::Face> {
+  static constexpr size_t count = 6;
+  static Dim3 at(size_t i) noexcept {
+    assert(i < count);
+    static const int d[count][3] = {{0, 0, -1}, {0, -1, 0}, {-1, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    return Dim3(d[i][0], d[i][1], d[i][2]);
+  }
+};
+
+template <> struct Directions<RadiusShape::Full2D> {
+  static constexpr size_t count = 8;
+  static Dim3 at(size_t i) noexcept {
+    assert(i < count);
+    const int idx = i < 4 ? int(i) : int(i) + 1; // skip [0,0,0]
+    return Dim3(idx % 3 - 1, idx / 3 - 1, 0);
+  }
+};
+
+template <> struct Directions<RadiusShape::Face2D> {
+  static constexpr size_t count = 4;
+  static Dim3 at(size_t i) noexcept {
+    assert(i < count);
+    static const int d[count][2] = {{0, -1}, {-1, 0}, {1, 0}, {0, 1}};
+    return Dim3(d[i][0], d[i][1], 0);
+  }
+};
+
+template <RadiusShape S> inline std::vector<Dim3> make_directions() {
+  std::vector<Dim3> ret;
+  ret.reserve(Directions<S>::count);
+  for (size_t i = 0; i < Directions<S>::count; ++i) {
+    ret.push_back(Directions<S>::at(i));
+  }
+  return ret;
+}
+
+/* all directions a stencil of shape `shape` may need to exchange in
+ */
+inline std::vector<Dim3> make_directions(const RadiusShape shape) {
+  switch (shape) {
+  case RadiusShape::Face:
+    return make_directions<RadiusShape::Face>();
+  case RadiusShape::Full2D:
+    return make_directions<RadiusShape::Full2D>();
+  case RadiusShape::Face2D:
+    return make_directions<RadiusShape::Face2D>();
+  case RadiusShape::Full:
+    return make_directions<RadiusShape::Full>();
+  }
+  __builtin_unreachable();
+}
+
+/* the directions of `shape` that have no component along an axis where the domain `size` is 1, for example the 8
+   in-plane directions of a constant radius on a 2D domain
+ */
+inline std::vector<Dim3> make_directions(const RadiusShape shape, const Dim3 &size) {
+  std::vector<Dim3> ret;
+  for (const Dim3 &dir : make_directions(shape)) {
+    if ((0 == dir.x || size.x > 1) && (0 == dir.y || size.y > 1) && (0 == dir.z || size.z > 1)) {
+      ret.push_back(dir);
+    }
+  }
+  return ret;
+}
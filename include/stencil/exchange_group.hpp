@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include <mpi.h>
+
+#include "stencil/local_domain.cuh"
+#include "stencil/stencil.hpp"
+#include "stencil/transports.cuh"
+
+/*! Exchange the halos of several DistributedDomains together.
+
+    The domains must cover the same region with the same radius, GPUs, methods, and ranks, so they are placed the
+    same way. Each pair of subdomains then exchanges one message holding the quantities of every domain, instead of
+    one message per domain, and the exchanges of all domains overlap.
+
+    ExchangeGroup group;
+    group.add(fluid);
+    group.add(chemistry);
+    group.realize(); // instead of realize() on each domain
+    group.exchange(); // instead of exchange() on each domain
+
+    Each domain's own exchange() still works on its own quantities.
+*/
+class ExchangeGroup {
+private:
+  std::vector<DistributedDomain *> dds_;
+
+  // views[di] has the quantities of subdomain di of every domain, in the order the domains were added
+  std::vector<LocalDomain> views_;
+  MPI_Comm comm_;
+  Transports tx_;
+
+public:
+  ExchangeGroup() : comm_(MPI_COMM_NULL) {}
+  ExchangeGroup(const ExchangeGroup &) = delete;
+  ExchangeGroup &operator=(const ExchangeGroup &) = delete;
+  ~ExchangeGroup() {
+    if (MPI_COMM_NULL != comm_) {
+      MPI_Comm_free(&comm_);
+    }
+  }
+
+  /* add a configured domain that has not been realized. The domain must outlive the group
+   */
+  void add(DistributedDomain &dd) { dds_.push_back(&dd); }
+
+  /* realize every domain and create the merged transports. Collective over the domains' ranks
+   */
+  void realize();
+
+  /* a halo exchange of the "current" quantities of every domain
+   */
+  void exchange();
+};
@@ -6,9 +6,11 @@
 
 #include "stencil/accessor.hpp"
 #include "stencil/cuda_runtime.hpp"
+#include "stencil/data_type.hpp"
 #include "stencil/dim3.hpp"
 #include "stencil/logging.hpp"
 #include "stencil/pack_kernel.cuh"
+#include "stencil/particles.cuh"
 #include "stencil/radius.hpp"
 #include "stencil/rect3.hpp"
 
@@ -24,12 +26,6 @@ public:
   DataHandle(size_t i, const std::string &name = "") : id_(i), name_(name) {}
 };
 
-enum class DataType {
-  None,
-  Float,
-  Double,
-};
-
 class LocalDomain {
   friend class DistributedDomain;
 
@@ -51,17 +47,62 @@ private:
   std::vector<void *> nextDataPtrs_;
   std::vector<int64_t> dataElemSize_;
   std::vector<std::string> dataName_;
+  std::vector<DataType> dataType_;
+  std::vector<Dim3> dataStagger_; // 1 along each axis the quantity is face-centered on
   /* device versions of the pointers (the pointers already point to device data)
    used in the packers
    */
   void **devCurrDataPtrs_;
   size_t *devDataElemSize_;
+  DataType *devDataType_;
+  Dim3 *devDataStagger_;
+
+  // particles whose positions are in the compute region
+  Particles particles_;
 
   int dev_; // CUDA device
 
+  // for a view, the domain each of its quantities belongs to, and that quantity's index there
+  std::vector<const LocalDomain *> parents_;
+  std::vector<size_t> parentIdx_;
+
+  bool is_view() const noexcept { return !parents_.empty(); }
+
+  void add_view_of(const LocalDomain &parent, const size_t qi) {
+    assert(qi < parent.dataElemSize_.size());
+    assert(parent.sz_ == sz_ && parent.origin_ == origin_ && parent.dev_ == dev_);
+    parents_.push_back(&parent);
+    parentIdx_.push_back(qi);
+    add_data(parent.dataElemSize_[qi], parent.dataName_[qi], parent.dataType_[qi], parent.dataStagger_[qi]);
+  }
+
 public:
   LocalDomain(Dim3 sz, Dim3 origin, int dev)
-      : sz_(sz), origin_(origin), dev_(dev), devCurrDataPtrs_(nullptr), devDataElemSize_(nullptr) {}
+      : sz_(sz), origin_(origin), dev_(dev), devCurrDataPtrs_(nullptr), devDataElemSize_(nullptr),
+        devDataType_(nullptr), devDataStagger_(nullptr) {}
+
+  /* A view of quantities `qis` of `parent`, sharing its allocations, so transports can exchange just those
+     quantities. realize() the view after parent is realized, and sync_view() after parent swaps
+  */
+  LocalDomain(const LocalDomain &parent, const std::vector<size_t> &qis)
+      : sz_(parent.sz_), origin_(parent.origin_), radius_(parent.radius_), dev_(parent.dev_),
+        devCurrDataPtrs_(nullptr), devDataElemSize_(nullptr), devDataType_(nullptr), devDataStagger_(nullptr) {
+    for (size_t qi : qis) {
+      add_view_of(parent, qi);
+    }
+  }
+
+  /* A view of every quantity of each of `parents`, in order. The parents must cover the same region on the same GPU
+   */
+  explicit LocalDomain(const std::vector<const LocalDomain *> &parents)
+      : sz_(parents.at(0)->sz_), origin_(parents[0]->origin_), radius_(parents[0]->radius_), dev_(parents[0]->dev_),
+        devCurrDataPtrs_(nullptr), devDataElemSize_(nullptr), devDataType_(nullptr), devDataStagger_(nullptr) {
+    for (const LocalDomain *parent : parents) {
+      for (int64_t qi = 0; qi < parent->num_data(); ++qi) {
+        add_view_of(*parent, qi);
+      }
+    }
+  }
 
   ~LocalDomain() {
     CUDA_RUNTIME(cudaGetLastError());
@@ -72,21 +113,26 @@ public:
     // std::cerr << "dtor rank=" << rank << " ~LocalDomain(): device=" << dev_
     // << "\n";
     CUDA_RUNTIME(cudaSetDevice(dev_));
+    // a view's quantities belong to its parent
     for (auto p : currDataPtrs_) {
       // std::cerr << "rank=" << rank << " ~LocalDomain(): cudaFree " <<
       // uintptr_t(p) << "\n";
-      if (p)
+      if (p && !is_view())
         CUDA_RUNTIME(cudaFree(p));
     }
     if (devCurrDataPtrs_)
       CUDA_RUNTIME(cudaFree(devCurrDataPtrs_));
 
     for (auto p : nextDataPtrs_) {
-      if (p)
+      if (p && !is_view())
         CUDA_RUNTIME(cudaFree(p));
     }
     if (devDataElemSize_)
       CUDA_RUNTIME(cudaFree(devDataElemSize_));
+    if (devDataType_)
+      CUDA_RUNTIME(cudaFree(devDataType_));
+    if (devDataStagger_)
+      CUDA_RUNTIME(cudaFree(devDataStagger_));
     CUDA_RUNTIME(cudaGetLastError());
   }
 
@@ -105,19 +151,25 @@ public:
   const Dim3 &origin() const noexcept { return origin_; }
 
   /*! Add an untyped data field with an element size of n.
+  `type` is only needed if the field will be used in an accumulating exchange.
+  `stagger` is 1 along each axis the field is face-centered on, where it has one more point than the domain
 
   \returns The index of the added data
   */
-  int64_t add_data(size_t n, const std::string &name = "") {
+  int64_t add_data(size_t n, const std::string &name = "", const DataType type = DataType::None,
+                   const Dim3 &stagger = Dim3(0, 0, 0)) {
+    assert(stagger.all_gt(-1) && stagger.all_lt(2));
     dataName_.push_back(name);
     dataElemSize_.push_back(n);
+    dataType_.push_back(type);
+    dataStagger_.push_back(stagger);
     currDataPtrs_.push_back(nullptr);
     nextDataPtrs_.push_back(nullptr);
     return int64_t(dataElemSize_.size()) - 1;
   }
 
-  template <typename T> DataHandle<T> add_data(const std::string &name = "") {
-    return DataHandle<T>(add_data(sizeof(T)), name);
+  template <typename T> DataHandle<T> add_data(const std::string &name = "", const Dim3 &stagger = Dim3(0, 0, 0)) {
+    return DataHandle<T>(add_data(sizeof(T), name, data_type_of<T>(), stagger), name);
   }
 
   /*! \brief set the radius. Should only be called by DistributedDomain
@@ -131,6 +183,9 @@ public:
 
   const Radius &radius() const noexcept { return radius_; }
 
+  Particles &particles() noexcept { return particles_; }
+  const Particles &particles() const noexcept { return particles_; }
+
   /*! \brief retrieve a pointer to current domain values (to read in stencil)
    */
   template <typename T> T *get_curr(const DataHandle<T> handle) const {
@@ -158,6 +213,20 @@ public:
 
   size_t *dev_elem_sizes() const { return devDataElemSize_; }
 
+  DataType data_type(const size_t idx) const {
+    assert(idx < dataType_.size());
+    return dataType_[idx];
+  }
+
+  DataType *dev_data_types() const { return devDataType_; }
+
+  const Dim3 &stagger(const size_t idx) const {
+    assert(idx < dataStagger_.size());
+    return dataStagger_[idx];
+  }
+
+  Dim3 *dev_staggers() const { return devDataStagger_; }
+
   void *curr_data(size_t idx) const {
     assert(idx < currDataPtrs_.size());
     return currDataPtrs_[idx];
@@ -181,10 +250,7 @@ public:
     org.z -= radius_.z(-1);
 
     // the total allocation size, for indexing in the accessor
-    Dim3 pitch = sz_;
-    pitch.x += radius_.x(-1) + radius_.x(1);
-    pitch.y += radius_.y(-1) + radius_.y(1);
-    pitch.z += radius_.z(-1) + radius_.z(1);
+    const Dim3 pitch = raw_size(dh.id_);
 
     return Accessor<T>(raw, org, pitch);
   }
@@ -200,10 +266,7 @@ public:
     org.z -= radius_.z(-1);
 
     // the total allocation size, for indexing in the accessor
-    Dim3 pitch = sz_;
-    pitch.x += radius_.x(-1) + radius_.x(1);
-    pitch.y += radius_.y(-1) + radius_.y(1);
-    pitch.z += radius_.z(-1) + radius_.z(1);
+    const Dim3 pitch = raw_size(dh.id_);
 
     return Accessor<T>(raw, org, pitch);
   }
@@ -297,9 +360,14 @@ public:
   // return the extent of the halo in direction `dir`
   Dim3 halo_extent(const Dim3 &dir) const noexcept { return halo_extent(dir, sz_, radius_); }
 
+  // return the extent of quantity `idx` in the halo in direction `dir`
+  Dim3 halo_extent(const Dim3 &dir, const int64_t idx) const noexcept {
+    return staggered_extent(halo_extent(dir), dir, dataStagger_[idx]);
+  }
+
   // return the number of bytes of the halo in direction `dir`
   int64_t halo_bytes(const Dim3 &dir, const int64_t idx) const noexcept {
-    return dataElemSize_[idx] * halo_extent(dir).flatten();
+    return dataElemSize_[idx] * halo_extent(dir, idx).flatten();
   }
 
   // return the 3d size of the compute domain, in terms of elements
@@ -311,6 +379,12 @@ public:
                 sz_.z + radius_.z(-1) + radius_.z(1));
   }
 
+  // return the 3d size of quantity `idx`'s allocation, which is one larger along each staggered axis
+  Dim3 raw_size(const size_t idx) const noexcept {
+    assert(idx < dataStagger_.size());
+    return raw_size() + dataStagger_[idx];
+  }
+
   // the GPU this domain is on
   int gpu() const { return dev_; }
 
@@ -318,6 +392,10 @@ public:
    */
   void swap() noexcept;
 
+  /* for a view, take up the parents' current and next pointers if a parent has swapped
+   */
+  void sync_view();
+
   /* return the bytes making up
   */
   std::vector<unsigned char> region_to_host(const Dim3 &pos, const Dim3 &ext,
@@ -338,11 +416,7 @@ public:
    */
   std::vector<unsigned char> quantity_to_host(const size_t qi // quantity index
                                               ) const {
-    Dim3 allocSz = sz_;
-    allocSz.x += radius_.x(-1) + radius_.x(1);
-    allocSz.y += radius_.y(-1) + radius_.y(1);
-    allocSz.z += radius_.z(-1) + radius_.z(1);
-    return region_to_host(Dim3(0, 0, 0), allocSz, qi);
+    return region_to_host(Dim3(0, 0, 0), raw_size(qi), qi);
   }
 
   void realize();
@@ -1,7 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "stencil/mpi.hpp"
 
@@ -9,45 +19,208 @@
 #define STENCIL_OUTPUT_LEVEL 3
 #endif
 
+/* Log messages are formatted by the calling thread and appended to a per-process buffer, which a background thread
+   writes to stderr. Messages below STENCIL_OUTPUT_LEVEL are compiled out. ERROR and WARN are written by every rank;
+   INFO, DEBUG, and SPEW only by the ranks chosen by the STENCIL_LOG_RANKS environment variable:
+     "node" (the default): rank 0 and the first rank on each node, from the launcher's local rank variable
+     "all": every rank
+     n: every rank divisible by n
+   A logging::Mute drops INFO, DEBUG, and SPEW on its rank while it exists. FATAL flushes the buffer and writes
+   directly before exiting.
+*/
+namespace logging {
+
+/* rank from the launcher's environment, -1 if there is none
+ */
+inline int env_local_rank() {
+  for (const char *name : {"OMPI_COMM_WORLD_LOCAL_RANK", "MV2_COMM_WORLD_LOCAL_RANK", "MPI_LOCALRANKID",
+                           "PMI_LOCAL_RANK", "SLURM_LOCALID"}) {
+    if (const char *v = std::getenv(name)) {
+      return std::atoi(v);
+    }
+  }
+  return -1;
+}
+
+/* true if this rank writes INFO and below. Decided on first use
+ */
+inline bool sampled() {
+  static const bool ret = []() {
+    const int rank = mpi::world_rank();
+    const char *mode = std::getenv("STENCIL_LOG_RANKS");
+    if (!mode || 0 == std::strcmp(mode, "node")) {
+      return 0 == rank || 0 == env_local_rank();
+    } else if (0 == std::strcmp(mode, "all")) {
+      return true;
+    } else {
+      const int n = std::atoi(mode);
+      return n > 0 ? 0 == rank % n : 0 == rank;
+    }
+  }();
+  return ret;
+}
+
+/* while true, INFO, DEBUG, and SPEW are dropped
+ */
+inline std::atomic<bool> &muted() {
+  static std::atomic<bool> ret(false);
+  return ret;
+}
+
+/* mutes INFO, DEBUG, and SPEW for its lifetime, for example while timing code that logs
+ */
+class Mute {
+  bool prev_;
+
+public:
+  Mute() : prev_(muted().exchange(true)) {}
+  ~Mute() { muted() = prev_; }
+  Mute(const Mute &) = delete;
+  Mute &operator=(const Mute &) = delete;
+};
+
+/*! Buffers formatted messages and writes them to stderr from a background thread, so a caller never waits on
+    stderr. Written when the buffer passes FLUSH_BYTES, every FLUSH_PERIOD, by flush(), and at exit.
+*/
+class Writer {
+public:
+  static constexpr size_t FLUSH_BYTES = 1 << 16;
+
+private:
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::string buf_;
+  bool stop_;
+
+  std::mutex writeMtx_; // so flushes write in order
+  std::thread thread_;
+
+  // writeMtx_ is always taken before mtx_, so a flush() and the writer thread can't wait on each other
+  void write_out() {
+    std::lock_guard<std::mutex> wl(writeMtx_);
+    std::string out;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      out.swap(buf_);
+    }
+    if (!out.empty()) {
+      std::fwrite(out.data(), 1, out.size(), stderr);
+      std::fflush(stderr);
+    }
+  }
+
+  void run() {
+    bool stop = false;
+    while (!stop) {
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait_for(lock, std::chrono::milliseconds(100), [this]() { return stop_ || buf_.size() >= FLUSH_BYTES; });
+        stop = stop_;
+      }
+      write_out();
+    }
+  }
+
+public:
+  Writer() : stop_(false), thread_(&Writer::run, this) {}
+  ~Writer() {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  void write(const std::string &msg) {
+    bool full;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      buf_ += msg;
+      full = buf_.size() >= FLUSH_BYTES;
+    }
+    if (full) {
+      cv_.notify_one();
+    }
+  }
+
+  /* write everything buffered so far before returning
+   */
+  void flush() { write_out(); }
+
+  static Writer &get() {
+    static Writer w;
+    return w;
+  }
+};
+
+inline void write(const std::string &msg) { Writer::get().write(msg); }
+inline void flush() { Writer::get().flush(); }
+
+/* stream the elements of `v` separated by spaces, for example LOG_DEBUG("ranks:" << logging::seq(ranks))
+ */
+template <typename T> struct Seq { const std::vector<T> &v; };
+template <typename T> Seq<T> seq(const std::vector<T> &v) { return Seq<T>{v}; }
+template <typename T> std::ostream &operator<<(std::ostream &os, const Seq<T> &s) {
+  for (const T &e : s.v) {
+    os << " " << e;
+  }
+  return os;
+}
+
+} // namespace logging
+
+#define LOG_IMPL(level, x)                                                                                             \
+  do {                                                                                                                 \
+    std::ostringstream ss_;                                                                                            \
+    ss_ << level "[" << __FILE__ << ":" << __LINE__ << "]{" << mpi::world_rank() << "} " << x << "\n";                 \
+    logging::write(ss_.str());                                                                                         \
+  } while (0)
+
+#define LOG_SAMPLED_IMPL(level, x)                                                                                     \
+  do {                                                                                                                 \
+    if (logging::sampled() && !logging::muted()) {                                                                     \
+      LOG_IMPL(level, x);                                                                                              \
+    }                                                                                                                  \
+  } while (0)
+
 #if STENCIL_OUTPUT_LEVEL >= 5
-#define LOG_SPEW(x)                                                                                                    \
-  std::cerr << "SPEW[" << __FILE__ << ":" << __LINE__ << "]{" << mpi::world_rank() << "} " << x << "\n";
+#define LOG_SPEW(x) LOG_SAMPLED_IMPL("SPEW", x)
 #else
 #define LOG_SPEW(x)
 #endif
 
 #if STENCIL_OUTPUT_LEVEL >= 4
-#define LOG_DEBUG(x)                                                                                                   \
-  std::cerr << "DEBUG[" << __FILE__ << ":" << __LINE__ << "]{" << mpi::world_rank() << "} " << x << "\n";
+#define LOG_DEBUG(x) LOG_SAMPLED_IMPL("DEBUG", x)
 #else
 #define LOG_DEBUG(x)
 #endif
 
 #if STENCIL_OUTPUT_LEVEL >= 3
-#define LOG_INFO(x)                                                                                                    \
-  std::cerr << "INFO[" << __FILE__ << ":" << __LINE__ << "]{" << mpi::world_rank() << "} " << x << "\n";
+#define LOG_INFO(x) LOG_SAMPLED_IMPL("INFO", x)
 #else
 #define LOG_INFO(x)
 #endif
 
 #if STENCIL_OUTPUT_LEVEL >= 2
-#define LOG_WARN(x)                                                                                                    \
-  std::cerr << "WARN[" << __FILE__ << ":" << __LINE__ << "]{" << mpi::world_rank() << "} " << x << "\n";
+#define LOG_WARN(x) LOG_IMPL("WARN", x)
 #else
 #define LOG_WARN(x)
 #endif
 
 #if STENCIL_OUTPUT_LEVEL >= 1
-#define LOG_ERROR(x)                                                                                                   \
-  std::cerr << "ERROR[" << __FILE__ << ":" << __LINE__ << "]{" << mpi::world_rank() << "} " << x << "\n";
+#define LOG_ERROR(x) LOG_IMPL("ERROR", x)
 #else
 #define LOG_ERROR(x)
 #endif
 
 #if STENCIL_OUTPUT_LEVEL >= 0
 #define LOG_FATAL(x)                                                                                                   \
-  std::cerr << "FATAL[" << __FILE__ << ":" << __LINE__ << "]{" << mpi::world_rank() << "} " << x << "\n";              \
-  exit(1);
+  do {                                                                                                                 \
+    logging::flush();                                                                                                  \
+    std::cerr << "FATAL[" << __FILE__ << ":" << __LINE__ << "]{" << mpi::world_rank() << "} " << x << "\n";            \
+    exit(1);                                                                                                           \
+  } while (0)
 #else
-#define LOG_FATAL(x) exit(1);
-#endif
\ No newline at end of file
+#define LOG_FATAL(x) exit(1)
+#endif
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+/*! Bytes used on a rank, by category, as returned by DistributedDomain::memory_report().
+
+    Each entry has this rank's current bytes, this rank's peak, and the min and max of the peak across ranks, filled
+    in by reduce(). Categories keep the order they were first added in. The peak is sampled, not tracked at each
+    allocation: it is the most seen in any report merged with merge_peaks(), so allocations freed between samples are
+    missed.
+*/
+class MemoryReport {
+public:
+  struct Entry {
+    std::string name;
+    int64_t bytes; // current, on this rank
+    int64_t peak;  // most sampled on this rank
+    int64_t min;   // least peak of any rank
+    int64_t max;   // greatest peak of any rank
+  };
+
+  // true if nothing has been allocated yet, and the bytes are what realize() is expected to allocate
+  bool predicted;
+
+  MemoryReport() : predicted(false), peakTotal_(0), totalMin_(0), totalMax_(0) {}
+
+  const std::vector<Entry> &entries() const noexcept { return entries_; }
+
+  /* add `bytes` to category `name`, creating it if needed
+   */
+  void add(const std::string &name, int64_t bytes) {
+    Entry *e = find(name);
+    if (!e) {
+      entries_.push_back(Entry{name, 0, 0, 0, 0});
+      e = &entries_.back();
+    }
+    e->bytes += bytes;
+    e->peak = std::max(e->peak, e->bytes);
+    peakTotal_ = std::max(peakTotal_, total());
+  }
+
+  /* current bytes of category `name`, 0 if there is none
+   */
+  int64_t bytes(const std::string &name) const {
+    for (const Entry &e : entries_) {
+      if (e.name == name) {
+        return e.bytes;
+      }
+    }
+    return 0;
+  }
+
+  int64_t total() const noexcept {
+    int64_t ret = 0;
+    for (const Entry &e : entries_) {
+      ret += e.bytes;
+    }
+    return ret;
+  }
+
+  /* raise each peak to at least the peak in `prev`, an earlier report of the same domain
+   */
+  void merge_peaks(const MemoryReport &prev) {
+    peakTotal_ = std::max(peakTotal_, prev.peakTotal_);
+    for (const Entry &p : prev.entries_) {
+      if (Entry *e = find(p.name)) {
+        e->peak = std::max(e->peak, p.peak);
+      } else {
+        entries_.push_back(Entry{p.name, 0, p.peak, 0, 0});
+      }
+    }
+  }
+
+  /* fill in the min and max of each peak across `comm`. Collective; every rank must have the same categories in the
+     same order
+  */
+  void reduce(MPI_Comm comm) {
+    std::vector<int64_t> mins(entries_.size() + 1), maxs(entries_.size() + 1);
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      mins[i] = entries_[i].peak;
+    }
+    mins.back() = peakTotal_;
+    maxs = mins;
+    MPI_Allreduce(MPI_IN_PLACE, mins.data(), int(mins.size()), MPI_INT64_T, MPI_MIN, comm);
+    MPI_Allreduce(MPI_IN_PLACE, maxs.data(), int(maxs.size()), MPI_INT64_T, MPI_MAX, comm);
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      entries_[i].min = mins[i];
+      entries_[i].max = maxs[i];
+    }
+    totalMin_ = mins.back();
+    totalMax_ = maxs.back();
+  }
+
+  /* one row per category and a total row: name, bytes, peak, min, max
+   */
+  friend std::ostream &operator<<(std::ostream &os, const MemoryReport &r) {
+    const std::ios::fmtflags flags = os.flags();
+    os << (r.predicted ? "predicted " : "") << "memory (B)\n";
+    os << std::left << std::setw(24) << "category" << std::right << std::setw(16) << "bytes" << std::setw(16)
+       << "peak" << std::setw(16) << "min peak" << std::setw(16) << "max peak"
+       << "\n";
+    for (const Entry &e : r.entries_) {
+      os << std::left << std::setw(24) << e.name << std::right << std::setw(16) << e.bytes << std::setw(16) << e.peak
+         << std::setw(16) << e.min << std::setw(16) << e.max << "\n";
+    }
+    os << std::left << std::setw(24) << "total" << std::right << std::setw(16) << r.total() << std::setw(16)
+       << r.peakTotal_ << std::setw(16) << r.totalMin_ << std::setw(16) << r.totalMax_ << "\n";
+    os.flags(flags);
+    return os;
+  }
+
+private:
+  std::vector<Entry> entries_;
+  int64_t peakTotal_; // the most total() has been, which may be less than the sum of the peaks
+  int64_t totalMin_;
+  int64_t totalMax_;
+
+  Entry *find(const std::string &name) {
+    for (Entry &e : entries_) {
+      if (e.name == name) {
+        return &e;
+      }
+    }
+    return nullptr;
+  }
+};
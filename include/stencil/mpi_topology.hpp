@@ -4,6 +4,8 @@
 
 #include <set>
 
+#include "stencil/logging.hpp"
+
 class MpiTopology {
 private:
   MPI_Comm comm_;
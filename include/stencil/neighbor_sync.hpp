@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+/*! Step counters for threads that each own one subdomain.
+
+    ready(i) is the last step whose interior subdomain i has published.
+    done(i) is the last step for which subdomain i has finished reading its neighbors' interiors.
+
+    Counters are published with release stores and waited on with acquire loads, so a thread only ever waits
+    on the subdomains it exchanges with, never on the whole rank.
+*/
+class NeighborSync {
+private:
+  // pad each counter to its own cache line so neighbors spinning on different subdomains do not false-share
+  struct Counter {
+    std::atomic<uint64_t> val;
+    char pad_[64 - sizeof(std::atomic<uint64_t>)];
+    Counter() : val(0) {}
+  };
+
+  std::vector<Counter> ready_;
+  std::vector<Counter> done_;
+
+  static void spin_until(const std::atomic<uint64_t> &a, const uint64_t step) noexcept {
+    // neighbors are usually close behind, so spin briefly before giving up the core
+    for (int i = 0; a.load(std::memory_order_acquire) < step; ++i) {
+      if (i >= 1000) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+public:
+  NeighborSync() {}
+  explicit NeighborSync(size_t n) : ready_(n), done_(n) {}
+
+  size_t size() const noexcept { return ready_.size(); }
+
+  /* subdomain i's interior for `step` may be read by its neighbors
+   */
+  void publish_ready(size_t i, uint64_t step) noexcept {
+    assert(i < ready_.size());
+    ready_[i].val.store(step, std::memory_order_release);
+  }
+
+  /* subdomain i is done reading its neighbors' interiors for `step`
+   */
+  void publish_done(size_t i, uint64_t step) noexcept {
+    assert(i < done_.size());
+    done_[i].val.store(step, std::memory_order_release);
+  }
+
+  uint64_t ready(size_t i) const noexcept { return ready_[i].val.load(std::memory_order_acquire); }
+  uint64_t done(size_t i) const noexcept { return done_[i].val.load(std::memory_order_acquire); }
+
+  /* block until subdomain i has published `step` or later
+   */
+  void wait_ready(size_t i, uint64_t step) const noexcept {
+    assert(i < ready_.size());
+    spin_until(ready_[i].val, step);
+  }
+
+  /* block until subdomain i is done reading for `step` or later
+   */
+  void wait_done(size_t i, uint64_t step) const noexcept {
+    assert(i < done_.size());
+    spin_until(done_[i].val, step);
+  }
+};
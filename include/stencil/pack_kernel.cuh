@@ -2,6 +2,15 @@
 
 #include "stencil/dim3.hpp"
 
+/* the extent of a quantity staggered by `stagger` in the region of extent `ext` on side `dir` of a domain.
+   A quantity staggered along an axis has one more point along it: the face shared with the + neighbor, which that
+   neighbor owns. It is the first point of the + halo, so only regions on the + side of that axis grow
+*/
+inline __host__ __device__ Dim3 staggered_extent(const Dim3 &ext, const Dim3 &dir, const Dim3 &stagger) {
+  return Dim3(ext.x + (1 == dir.x ? stagger.x : 0), ext.y + (1 == dir.y ? stagger.y : 0),
+              ext.z + (1 == dir.z ? stagger.z : 0));
+}
+
 inline __device__ void grid_pack(void *__restrict__ dst, const void *__restrict__ src, const Dim3 srcSize,
                                  const Dim3 srcPos, const Dim3 srcExtent, const size_t elemSize) {
 
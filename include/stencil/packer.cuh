@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "align.cuh"
+#include "copy.cuh"
 #include "local_domain.cuh"
 #include "pack_kernel.cuh"
 #include "stencil/logging.hpp"
@@ -47,24 +48,53 @@ public:
   virtual ~Unpacker() {}
 };
 
-/*! pack all quantities in a single domain into dst
+/*! pack all quantities in a single domain into dst.
+    Each quantity's extent and allocation grow along its staggered axes
  */
-static __global__ void dev_packer_pack_domain(void *dst,            // buffer to pack into
-                                              void **srcs,          // raw pointer to each quanitity
-                                              size_t *elemSizes,    // element size for each quantity
-                                              const size_t nQuants, // number of quantities
-                                              const Dim3 rawSz,     // domain size (elements)
-                                              const Dim3 pos,       // halo position
-                                              const Dim3 ext        // halo extent
+static __global__ void dev_packer_pack_domain(void *dst,             // buffer to pack into
+                                              void **srcs,           // raw pointer to each quanitity
+                                              size_t *elemSizes,     // element size for each quantity
+                                              const Dim3 *staggers,  // staggering of each quantity
+                                              const size_t nQuants,  // number of quantities
+                                              const Dim3 rawSz,      // domain size (elements)
+                                              const Dim3 pos,        // halo position
+                                              const Dim3 ext,        // halo extent
+                                              const Dim3 haloDir     // side of the halo the data is for
 ) {
   size_t offset = 0;
   for (size_t qi = 0; qi < nQuants; ++qi) {
     const size_t elemSz = elemSizes[qi];
+    const Dim3 qExt = staggered_extent(ext, haloDir, staggers[qi]);
     offset = next_align_of(offset, elemSz);
     void *src = srcs[qi];
     void *dstp = &((char *)dst)[offset];
-    grid_pack(dstp, src, rawSz, pos, ext, elemSz);
-    offset += elemSz * ext.flatten();
+    grid_pack(dstp, src, rawSz + staggers[qi], pos, qExt, elemSz);
+    offset += elemSz * qExt.flatten();
+  }
+}
+
+/*! add each quantity in src into the region of a single domain.
+    src is laid out as produced by dev_packer_pack_domain
+ */
+static __global__ void dev_packer_accumulate_domain(void **dsts,           // raw pointer to each quantity
+                                                    const void *src,       // buffer to accumulate from
+                                                    size_t *elemSizes,     // element size for each quantity
+                                                    const DataType *types, // data type of each quantity
+                                                    const Dim3 *staggers,  // staggering of each quantity
+                                                    const size_t nQuants,  // number of quantities
+                                                    const Dim3 rawSz,      // domain size (elements)
+                                                    const Dim3 pos,        // region position
+                                                    const Dim3 ext,        // region extent
+                                                    const Dim3 haloDir     // side of the halo the data is from
+) {
+  size_t offset = 0;
+  for (size_t qi = 0; qi < nQuants; ++qi) {
+    const size_t elemSz = elemSizes[qi];
+    const Dim3 qExt = staggered_extent(ext, haloDir, staggers[qi]);
+    offset = next_align_of(offset, elemSz);
+    const void *srcp = &((const char *)src)[offset];
+    accumulate_grid(dsts[qi], pos, rawSz + staggers[qi], srcp, Dim3(0, 0, 0), qExt, qExt, elemSz, types[qi]);
+    offset += elemSz * qExt.flatten();
   }
 }
 
@@ -103,9 +133,9 @@ private:
 
       LOG_SPEW("DevicePacker::pack(): grid= " << dimGrid.x << "," << dimGrid.y << "," << dimGrid.z
                                               << " block=" << dimBlock.x << "," << dimBlock.y << "," << dimBlock.z);
-      dev_packer_pack_domain<<<dimGrid, dimBlock, 0, stream_>>>(&devBuf_[offset], domain_->dev_curr_datas(),
-                                                                domain_->dev_elem_sizes(), domain_->num_data(),
-                                                                domain_->raw_size(), pos, ext);
+      dev_packer_pack_domain<<<dimGrid, dimBlock, 0, stream_>>>(
+          &devBuf_[offset], domain_->dev_curr_datas(), domain_->dev_elem_sizes(), domain_->dev_staggers(),
+          domain_->num_data(), domain_->raw_size(), pos, ext, msg.dir_ * -1);
 #if STENCIL_USE_CUDA_GRAPH == 0
       // 900: not allowed while stream is capturing
       CUDA_RUNTIME(cudaGetLastError());
@@ -186,9 +216,37 @@ public:
 #endif
   }
 
+  /* add the buffer into the interior regions it would be packed from.
+     The reverse of pack(), for accumulating exchanges
+  */
+  void accumulate() {
+    assert(size_);
+    CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
+
+    int64_t offset = 0;
+    for (const auto &msg : dirs_) {
+      const Dim3 pos = domain_->halo_pos(msg.dir_, false /*interior*/);
+      const Dim3 ext = domain_->halo_extent(msg.dir_ * -1);
+
+      const dim3 dimBlock = Dim3::make_block_dim(ext, 512);
+      const dim3 dimGrid = (ext + Dim3(dimBlock) - 1) / Dim3(dimBlock);
+      dev_packer_accumulate_domain<<<dimGrid, dimBlock, 0, stream_>>>(
+          domain_->dev_curr_datas(), &devBuf_[offset], domain_->dev_elem_sizes(), domain_->dev_data_types(),
+          domain_->dev_staggers(), domain_->num_data(), domain_->raw_size(), pos, ext, msg.dir_ * -1);
+      CUDA_RUNTIME(cudaGetLastError());
+      for (int64_t qi = 0; qi < domain_->num_data(); ++qi) {
+        offset = next_align_of(offset, domain_->elem_size(qi));
+        offset += domain_->halo_bytes(msg.dir_ * -1, qi);
+      }
+    }
+  }
+
   virtual int64_t size() { return size_; }
 
   virtual void *data() { return devBuf_; }
+
+  // device bytes allocated by prepare()
+  int64_t allocated_bytes() const noexcept { return devBuf_ ? size_ : 0; }
 };
 
 inline __device__ void dev_unpacker_grid_unpack(void *__restrict__ dst, const Dim3 dstSize, const Dim3 dstPos,
@@ -230,22 +288,25 @@ inline __device__ void dev_unpacker_grid_unpack(void *__restrict__ dst, const Di
   }
 }
 
-static __global__ void dev_unpacker_unpack_domain(void **dsts,          // buffer to pack into
-                                                  void *src,            // raw pointer to each quanitity
-                                                  size_t *elemSizes,    // element size for each quantity
-                                                  const size_t nQuants, // number of quantities
-                                                  const Dim3 rawSz,     // domain size (elements)
-                                                  const Dim3 pos,       // halo position
-                                                  const Dim3 ext        // halo extent
+static __global__ void dev_unpacker_unpack_domain(void **dsts,           // buffer to pack into
+                                                  void *src,             // raw pointer to each quanitity
+                                                  size_t *elemSizes,     // element size for each quantity
+                                                  const Dim3 *staggers,  // staggering of each quantity
+                                                  const size_t nQuants,  // number of quantities
+                                                  const Dim3 rawSz,      // domain size (elements)
+                                                  const Dim3 pos,        // halo position
+                                                  const Dim3 ext,        // halo extent
+                                                  const Dim3 haloDir     // side of the halo
 ) {
   size_t offset = 0;
   for (unsigned int qi = 0; qi < nQuants; ++qi) {
     void *dst = dsts[qi];
     const size_t elemSz = elemSizes[qi];
+    const Dim3 qExt = staggered_extent(ext, haloDir, staggers[qi]);
     offset = next_align_of(offset, elemSz);
     void *srcp = &((char *)src)[offset];
-    dev_unpacker_grid_unpack(dst, rawSz, pos, ext, srcp, elemSz);
-    offset += elemSz * ext.flatten();
+    dev_unpacker_grid_unpack(dst, rawSz + staggers[qi], pos, qExt, srcp, elemSz);
+    offset += elemSz * qExt.flatten();
   }
 }
 
@@ -276,9 +337,9 @@ private:
 
       const dim3 dimBlock = Dim3::make_block_dim(ext, 512);
       const dim3 dimGrid = (ext + Dim3(dimBlock) - 1) / (Dim3(dimBlock));
-      dev_unpacker_unpack_domain<<<dimGrid, dimBlock, 0, stream_>>>(domain_->dev_curr_datas(), &devBuf_[offset],
-                                                                    domain_->dev_elem_sizes(), domain_->num_data(),
-                                                                    domain_->raw_size(), pos, ext);
+      dev_unpacker_unpack_domain<<<dimGrid, dimBlock, 0, stream_>>>(
+          domain_->dev_curr_datas(), &devBuf_[offset], domain_->dev_elem_sizes(), domain_->dev_staggers(),
+          domain_->num_data(), domain_->raw_size(), pos, ext, dir);
 #if STENCIL_USE_CUDA_GRAPH == 0
       // 900: operation not permitted while stream is capturing
       CUDA_RUNTIME(cudaGetLastError());
@@ -358,9 +419,38 @@ public:
 #endif
   }
 
+  /* pack the halo regions that unpack() would write into the buffer.
+     The reverse of unpack(), for accumulating exchanges
+  */
+  void pack_halo() {
+    assert(size_);
+    CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
+
+    int64_t offset = 0;
+    for (const auto &msg : dirs_) {
+      const Dim3 dir = msg.dir_ * -1;
+      const Dim3 ext = domain_->halo_extent(dir);
+      const Dim3 pos = domain_->halo_pos(dir, true /*exterior*/);
+
+      const dim3 dimBlock = Dim3::make_block_dim(ext, 512);
+      const dim3 dimGrid = (ext + Dim3(dimBlock) - 1) / (Dim3(dimBlock));
+      dev_packer_pack_domain<<<dimGrid, dimBlock, 0, stream_>>>(
+          &devBuf_[offset], domain_->dev_curr_datas(), domain_->dev_elem_sizes(), domain_->dev_staggers(),
+          domain_->num_data(), domain_->raw_size(), pos, ext, dir);
+      CUDA_RUNTIME(cudaGetLastError());
+      for (int64_t qi = 0; qi < domain_->num_data(); ++qi) {
+        offset = next_align_of(offset, domain_->elem_size(qi));
+        offset += domain_->halo_bytes(dir, qi);
+      }
+    }
+  }
+
   virtual int64_t size() override { return size_; }
 
   virtual void *data() override { return devBuf_; }
+
+  // device bytes allocated by prepare()
+  int64_t allocated_bytes() const noexcept { return devBuf_ ? size_ : 0; }
 };
 
 #undef STENCIL_USE_CUDA_GRAPH
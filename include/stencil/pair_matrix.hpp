@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <iomanip>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "stencil/mat2d.hpp"
+
+/* a PairMatrix time for a pair that was not measured
+ */
+constexpr double PAIR_NOT_MEASURED = -1;
+
+/*! Measured one-way transfer times between every pair of ranks, for a range of message sizes.
+
+    Written by bin/pair-matrix, and read by anything that models communication cost between ranks.
+    times[si].at(src, dst) is the time in seconds for sizes[si] bytes from src to dst, or PAIR_NOT_MEASURED.
+
+    The text format is
+      pair_matrix 1
+      ranks <n>
+      hosts <n host names>
+      mode <pingpong|bidirectional> <isolated|concurrent>
+      sizes <number of sizes> <each size>
+      size <bytes>
+      <n rows of n times>
+      ... one "size" block per size
+*/
+struct PairMatrix {
+  std::vector<std::string> hosts; // one per rank
+  bool bidirectional;             // both ranks of a pair sent at once
+  bool concurrent;                // other pairs were measured at the same time
+  std::vector<int64_t> sizes;
+  std::vector<Mat2D<double>> times; // one per size
+
+  PairMatrix() : bidirectional(false), concurrent(false) {}
+
+  int64_t ranks() const noexcept { return int64_t(hosts.size()); }
+
+  bool measured(int64_t src, int64_t dst) const {
+    return !times.empty() && PAIR_NOT_MEASURED != times[0].at(src, dst);
+  }
+
+  /* time for the smallest size, PAIR_NOT_MEASURED on the diagonal and where not measured
+   */
+  Mat2D<double> latency() const {
+    Mat2D<double> ret(ranks(), ranks(), PAIR_NOT_MEASURED);
+    if (!times.empty()) {
+      ret = times.front();
+    }
+    return ret;
+  }
+
+  /* bytes per second for the largest size, 0 where not measured
+   */
+  Mat2D<double> bandwidth() const {
+    Mat2D<double> ret(ranks(), ranks(), 0);
+    if (!times.empty()) {
+      for (int64_t i = 0; i < ranks(); ++i) {
+        for (int64_t j = 0; j < ranks(); ++j) {
+          const double t = times.back().at(i, j);
+          if (t > 0) {
+            ret.at(i, j) = sizes.back() / t;
+          }
+        }
+      }
+    }
+    return ret;
+  }
+
+  void write(std::ostream &os) const {
+    os << "pair_matrix 1\n";
+    os << "ranks " << ranks() << "\n";
+    os << "hosts";
+    for (const std::string &h : hosts) {
+      os << " " << h;
+    }
+    os << "\n";
+    os << "mode " << (bidirectional ? "bidirectional" : "pingpong") << " "
+       << (concurrent ? "concurrent" : "isolated") << "\n";
+    os << "sizes " << sizes.size();
+    for (int64_t s : sizes) {
+      os << " " << s;
+    }
+    os << "\n";
+    os << std::setprecision(6) << std::scientific;
+    for (size_t si = 0; si < sizes.size(); ++si) {
+      os << "size " << sizes[si] << "\n";
+      for (int64_t i = 0; i < ranks(); ++i) {
+        for (int64_t j = 0; j < ranks(); ++j) {
+          os << (j ? " " : "") << times[si].at(i, j);
+        }
+        os << "\n";
+      }
+    }
+    os << std::defaultfloat;
+  }
+
+  /* false if `is` is not a pair matrix
+   */
+  bool read(std::istream &is) {
+    std::string key, mode, load;
+    int version;
+    int64_t n;
+    size_t numSizes;
+    if (!(is >> key >> version) || "pair_matrix" != key || 1 != version) {
+      return false;
+    }
+    if (!(is >> key >> n) || "ranks" != key || n < 0) {
+      return false;
+    }
+    if (!(is >> key) || "hosts" != key) {
+      return false;
+    }
+    hosts.resize(n);
+    for (std::string &h : hosts) {
+      is >> h;
+    }
+    if (!(is >> key >> mode >> load) || "mode" != key) {
+      return false;
+    }
+    bidirectional = "bidirectional" == mode;
+    concurrent = "concurrent" == load;
+    if (!(is >> key >> numSizes) || "sizes" != key) {
+      return false;
+    }
+    sizes.resize(numSizes);
+    for (int64_t &s : sizes) {
+      is >> s;
+    }
+    times.assign(numSizes, Mat2D<double>(n, n, PAIR_NOT_MEASURED));
+    for (size_t si = 0; si < numSizes; ++si) {
+      int64_t s;
+      if (!(is >> key >> s) || "size" != key || s != sizes[si]) {
+        return false;
+      }
+      for (int64_t i = 0; i < n; ++i) {
+        for (int64_t j = 0; j < n; ++j) {
+          is >> times[si].at(i, j);
+        }
+      }
+    }
+    return bool(is);
+  }
+};
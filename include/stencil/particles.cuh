@@ -0,0 +1,473 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nvToolsExt.h>
+
+#include "stencil/align.cuh"
+#include "stencil/cuda_runtime.hpp"
+#include "stencil/dim3.hpp"
+#include "stencil/logging.hpp"
+#include "stencil/tx_common.hpp"
+
+class DistributedDomain;
+
+template <typename T> class ParticleHandle {
+  friend class DistributedDomain;
+  friend class Particles;
+  size_t id_;
+  std::string name_;
+
+public:
+  ParticleHandle(size_t i, const std::string &name = "") : id_(i), name_(name) {}
+};
+
+/* particle positions are in global grid coordinates:
+   a particle at p is in the subdomain whose compute region contains floor(p)
+*/
+typedef double ParticlePos;
+
+/* 27 bins, one for each neighbor direction and one ([0,0,0]) for particles that stay
+ */
+constexpr int PARTICLE_BINS = 27;
+constexpr int PARTICLE_STAY = 13;
+
+inline __host__ __device__ int particle_bin(const Dim3 &dir) {
+  return (dir.z + 1) * 9 + (dir.y + 1) * 3 + (dir.x + 1);
+}
+
+/*! tag for particle migration messages. They have their own MsgKind, so a migrate() can't match a halo message that
+  exchange_async() still has in flight. The payload is
+  bit 0: 0 for the size handshake and 1 for the payload
+  bits 1-5: the direction bin
+  bits 6-15: the source subdomain
+*/
+inline int particle_tag(const int srcGPU, const Dim3 &dir, const bool payload) {
+  assert(srcGPU >= 0 && srcGPU < MAX_RANK_SUBDOMAINS);
+  return make_tag<MsgKind::Particle>((payload ? 1 : 0) | (particle_bin(dir) << 1) | (srcGPU << 6));
+}
+
+/*! find the bin of each particle relative to the compute region [lo, hi)
+    and count the particles in each bin.
+    Particles more than one subdomain away are binned to the neighbor in their direction
+*/
+static __global__ void particle_bin_kernel(uint8_t *bins,              // [out] bin of each particle
+                                           unsigned long long *counts, // [out] count for each bin
+                                           const ParticlePos *x,       // particle x positions
+                                           const ParticlePos *y,       // particle y positions
+                                           const ParticlePos *z,       // particle z positions
+                                           const size_t n,             // number of particles
+                                           const Dim3 lo,              // compute region lower corner
+                                           const Dim3 hi               // compute region upper corner
+) {
+  __shared__ unsigned int sCounts[PARTICLE_BINS];
+  for (int i = threadIdx.x; i < PARTICLE_BINS; i += blockDim.x) {
+    sCounts[i] = 0;
+  }
+  __syncthreads();
+
+  for (size_t i = blockDim.x * blockIdx.x + threadIdx.x; i < n; i += gridDim.x * blockDim.x) {
+    Dim3 dir;
+    dir.x = x[i] < lo.x ? -1 : (x[i] >= hi.x ? 1 : 0);
+    dir.y = y[i] < lo.y ? -1 : (y[i] >= hi.y ? 1 : 0);
+    dir.z = z[i] < lo.z ? -1 : (z[i] >= hi.z ? 1 : 0);
+    const int bin = particle_bin(dir);
+    bins[i] = bin;
+    atomicAdd(&sCounts[bin], 1);
+  }
+  __syncthreads();
+
+  for (int i = threadIdx.x; i < PARTICLE_BINS; i += blockDim.x) {
+    if (sCounts[i]) {
+      atomicAdd(&counts[i], (unsigned long long)sCounts[i]);
+    }
+  }
+}
+
+/*! move each particle to the next slot of its bin.
+    The array for bin b, attribute a starts at dsts[b * nAttrs + a].
+    Positions (attributes 0-2) of particles that leave are wrapped into [0, globalSize)
+*/
+static __global__ void particle_scatter_kernel(void **dsts,                 // bin arrays for each attribute
+                                               unsigned long long *cursors, // next slot in each bin
+                                               void **srcs,                 // array for each attribute
+                                               const size_t *elemSizes,     // element size of each attribute
+                                               const size_t nAttrs,         // number of attributes
+                                               const uint8_t *bins,         // bin of each particle
+                                               const size_t n,              // number of particles
+                                               const Dim3 globalSize        // size of the global domain
+) {
+  for (size_t i = blockDim.x * blockIdx.x + threadIdx.x; i < n; i += gridDim.x * blockDim.x) {
+    const int bin = bins[i];
+    const unsigned long long slot = atomicAdd(&cursors[bin], 1ull);
+    for (size_t a = 0; a < nAttrs; ++a) {
+      const size_t elemSz = elemSizes[a];
+      char *dst = static_cast<char *>(dsts[bin * nAttrs + a]) + slot * elemSz;
+      const char *src = static_cast<const char *>(srcs[a]) + i * elemSz;
+      if (a < 3 && PARTICLE_STAY != bin) {
+        const int64_t lim = 0 == a ? globalSize.x : (1 == a ? globalSize.y : globalSize.z);
+        ParticlePos p = *reinterpret_cast<const ParticlePos *>(src);
+        if (p < 0) {
+          p += lim;
+        } else if (p >= lim) {
+          p -= lim;
+        }
+        *reinterpret_cast<ParticlePos *>(dst) = p;
+      } else if (4 == elemSz) {
+        *reinterpret_cast<uint32_t *>(dst) = *reinterpret_cast<const uint32_t *>(src);
+      } else if (8 == elemSz) {
+        *reinterpret_cast<uint64_t *>(dst) = *reinterpret_cast<const uint64_t *>(src);
+      } else {
+        memcpy(dst, src, elemSz);
+      }
+    }
+  }
+}
+
+/*! A structure-of-arrays of particles on one GPU.
+    Attributes 0-2 are the x, y, and z positions. User attributes follow.
+
+    Particles are moved between subdomains by DistributedDomain::migrate(), which
+    1) bins particles by the direction they left the compute region (bin())
+    2) moves staying particles into the next arrays, and leaving particles into a
+       contiguous block for each bin in the send buffer (scatter())
+    3) appends arriving blocks to the next arrays (append())
+    4) swaps the current and next arrays (finish())
+    All buffers only grow, so steady-state migration does not allocate.
+*/
+class Particles {
+  friend class DistributedDomain;
+
+private:
+  int dev_;
+
+  std::vector<size_t> elemSize_;
+  std::vector<std::string> name_;
+
+  size_t size_;     // number of particles in curr_
+  size_t nextSize_; // number of particles in next_ during a migration
+  size_t capacity_; // number of particles allocated in curr_ and next_
+  std::vector<void *> curr_;
+  std::vector<void *> next_;
+
+  // migration scratch
+  uint8_t *bins_;              // capacity_ bins
+  unsigned long long *counts_; // PARTICLE_BINS counts followed by PARTICLE_BINS cursors
+  size_t *devElemSize_;
+  void **devSrcs_; // nAttrs
+  void **devDsts_; // PARTICLE_BINS * nAttrs
+
+  // a block for each leaving bin
+  char *sendBuf_;
+  char *hostSendBuf_;
+  size_t sendBufSize_;
+  std::array<size_t, PARTICLE_BINS> sendOffset_;
+
+  // a block for each arriving bin from another rank
+  char *hostRecvBuf_;
+  size_t hostRecvBufSize_;
+
+  cudaStream_t stream_; // created in realize()
+
+  void grow(size_t n) {
+    if (n <= capacity_) {
+      return;
+    }
+    n = std::max(n, 2 * capacity_);
+    LOG_SPEW("Particles::grow(): " << capacity_ << " -> " << n);
+    CUDA_RUNTIME(cudaSetDevice(dev_));
+    for (size_t a = 0; a < num_attrs(); ++a) {
+      char *c = nullptr;
+      char *x = nullptr;
+      CUDA_RUNTIME(cudaMalloc(&c, n * elemSize_[a]));
+      CUDA_RUNTIME(cudaMalloc(&x, n * elemSize_[a]));
+      if (curr_[a]) {
+        CUDA_RUNTIME(cudaMemcpy(c, curr_[a], size_ * elemSize_[a], cudaMemcpyDeviceToDevice));
+        CUDA_RUNTIME(cudaFree(curr_[a]));
+      }
+      if (next_[a]) {
+        CUDA_RUNTIME(cudaMemcpy(x, next_[a], nextSize_ * elemSize_[a], cudaMemcpyDeviceToDevice));
+        CUDA_RUNTIME(cudaFree(next_[a]));
+      }
+      curr_[a] = c;
+      next_[a] = x;
+    }
+    if (bins_) {
+      CUDA_RUNTIME(cudaFree(bins_));
+    }
+    CUDA_RUNTIME(cudaMalloc(&bins_, n * sizeof(*bins_)));
+    capacity_ = n;
+  }
+
+public:
+  Particles()
+      : dev_(-1), size_(0), nextSize_(0), capacity_(0), bins_(nullptr), counts_(nullptr), devElemSize_(nullptr),
+        devSrcs_(nullptr), devDsts_(nullptr), sendBuf_(nullptr), hostSendBuf_(nullptr), sendBufSize_(0),
+        hostRecvBuf_(nullptr), hostRecvBufSize_(0), stream_(0) {
+    add_attr(sizeof(ParticlePos), "x");
+    add_attr(sizeof(ParticlePos), "y");
+    add_attr(sizeof(ParticlePos), "z");
+  }
+
+  ~Particles() {
+    if (dev_ < 0) {
+      return;
+    }
+    CUDA_RUNTIME(cudaSetDevice(dev_));
+    for (void *p : curr_) {
+      if (p)
+        CUDA_RUNTIME(cudaFree(p));
+    }
+    for (void *p : next_) {
+      if (p)
+        CUDA_RUNTIME(cudaFree(p));
+    }
+    if (bins_)
+      CUDA_RUNTIME(cudaFree(bins_));
+    if (counts_)
+      CUDA_RUNTIME(cudaFree(counts_));
+    if (devElemSize_)
+      CUDA_RUNTIME(cudaFree(devElemSize_));
+    if (devSrcs_)
+      CUDA_RUNTIME(cudaFree(devSrcs_));
+    if (devDsts_)
+      CUDA_RUNTIME(cudaFree(devDsts_));
+    if (sendBuf_)
+      CUDA_RUNTIME(cudaFree(sendBuf_));
+    if (hostSendBuf_)
+      CUDA_RUNTIME(cudaFreeHost(hostSendBuf_));
+    if (hostRecvBuf_)
+      CUDA_RUNTIME(cudaFreeHost(hostRecvBuf_));
+    if (stream_)
+      CUDA_RUNTIME(cudaStreamDestroy(stream_));
+  }
+
+  /*! Add an attribute with an element size of n. Call before realize()
+
+  \returns The index of the added attribute
+  */
+  size_t add_attr(size_t n, const std::string &name = "") {
+    assert(dev_ < 0 && "add attributes before realize()");
+    elemSize_.push_back(n);
+    name_.push_back(name);
+    curr_.push_back(nullptr);
+    next_.push_back(nullptr);
+    return elemSize_.size() - 1;
+  }
+
+  template <typename T> ParticleHandle<T> add_attr(const std::string &name = "") {
+    return ParticleHandle<T>(add_attr(sizeof(T), name), name);
+  }
+
+  /* allocate migration scratch on device `dev`
+   */
+  void realize(int dev) {
+    dev_ = dev;
+    CUDA_RUNTIME(cudaSetDevice(dev_));
+    CUDA_RUNTIME(cudaStreamCreateWithFlags(&stream_, cudaStreamNonBlocking));
+    CUDA_RUNTIME(cudaMalloc(&counts_, 2 * PARTICLE_BINS * sizeof(*counts_)));
+    CUDA_RUNTIME(cudaMalloc(&devElemSize_, num_attrs() * sizeof(*devElemSize_)));
+    CUDA_RUNTIME(cudaMalloc(&devSrcs_, num_attrs() * sizeof(*devSrcs_)));
+    CUDA_RUNTIME(cudaMalloc(&devDsts_, PARTICLE_BINS * num_attrs() * sizeof(*devDsts_)));
+    CUDA_RUNTIME(
+        cudaMemcpy(devElemSize_, elemSize_.data(), num_attrs() * sizeof(*devElemSize_), cudaMemcpyHostToDevice));
+  }
+
+  size_t num_attrs() const noexcept { return elemSize_.size(); }
+  size_t size() const noexcept { return size_; }
+
+  /* device bytes of the particles and migration scratch, and pinned host bytes of the migration staging
+   */
+  size_t device_bytes() const noexcept {
+    size_t perParticle = sizeof(*bins_);
+    for (size_t e : elemSize_) {
+      perParticle += 2 * e; // curr and next
+    }
+    return capacity_ * perParticle + sendBufSize_;
+  }
+  size_t pinned_bytes() const noexcept { return sendBufSize_ + hostRecvBufSize_; }
+  size_t capacity() const noexcept { return capacity_; }
+
+  /* make room for at least n particles without changing size()
+   */
+  void reserve(size_t n) { grow(n); }
+
+  /* change the number of particles. New particles are uninitialized
+   */
+  void resize(size_t n) {
+    grow(n);
+    size_ = n;
+  }
+
+  template <typename T> T *get(const ParticleHandle<T> &handle) const {
+    assert(handle.id_ < num_attrs());
+    assert(sizeof(T) == elemSize_[handle.id_]);
+    return static_cast<T *>(curr_[handle.id_]);
+  }
+
+  ParticlePos *x() const { return static_cast<ParticlePos *>(curr_[0]); }
+  ParticlePos *y() const { return static_cast<ParticlePos *>(curr_[1]); }
+  ParticlePos *z() const { return static_cast<ParticlePos *>(curr_[2]); }
+
+  /* copy attribute `a` of all particles to the host
+   */
+  std::vector<unsigned char> attr_to_host(size_t a) const {
+    assert(a < num_attrs());
+    std::vector<unsigned char> ret(size_ * elemSize_[a]);
+    if (size_) {
+      CUDA_RUNTIME(cudaSetDevice(dev_));
+      CUDA_RUNTIME(cudaMemcpy(ret.data(), curr_[a], ret.size(), cudaMemcpyDeviceToHost));
+    }
+    return ret;
+  }
+
+  /* bytes needed for `n` packed particles, with each attribute's array aligned to its element size
+   */
+  size_t packed_bytes(size_t n) const noexcept { return packed_offset(n, num_attrs()); }
+
+  /* offset of attribute `a` in `n` packed particles
+   */
+  size_t packed_offset(size_t n, size_t a) const noexcept {
+    size_t ret = 0;
+    for (size_t i = 0; i < a; ++i) {
+      ret = next_align_of(ret, elemSize_[i]);
+      ret += n * elemSize_[i];
+    }
+    return next_align_of(ret, a < num_attrs() ? elemSize_[a] : 8);
+  }
+
+  /*! count the particles in each bin relative to the compute region [lo, hi)
+   */
+  void bin(const Dim3 &lo, const Dim3 &hi, std::array<uint64_t, PARTICLE_BINS> &counts) {
+    nvtxRangePush("Particles::bin");
+    CUDA_RUNTIME(cudaSetDevice(dev_));
+    CUDA_RUNTIME(cudaMemsetAsync(counts_, 0, PARTICLE_BINS * sizeof(*counts_), stream_));
+    if (size_) {
+      const int dimBlock = 256;
+      const int dimGrid = std::min((size_ + dimBlock - 1) / dimBlock, size_t(1024));
+      particle_bin_kernel<<<dimGrid, dimBlock, 0, stream_>>>(bins_, counts_, x(), y(), z(), size_, lo, hi);
+      CUDA_RUNTIME(cudaGetLastError());
+    }
+    static_assert(sizeof(counts[0]) == sizeof(*counts_), "");
+    CUDA_RUNTIME(cudaMemcpyAsync(counts.data(), counts_, PARTICLE_BINS * sizeof(*counts_), cudaMemcpyDeviceToHost,
+                                 stream_));
+    CUDA_RUNTIME(cudaStreamSynchronize(stream_));
+    nvtxRangePop(); // Particles::bin
+  }
+
+  /*! move staying particles to the front of the next arrays, and leaving particles to the send buffer.
+      `counts` comes from bin().
+      if `stage` the send buffer is also copied to the host
+  */
+  void scatter(const std::array<uint64_t, PARTICLE_BINS> &counts, const Dim3 &globalSize, bool stage) {
+    nvtxRangePush("Particles::scatter");
+    CUDA_RUNTIME(cudaSetDevice(dev_));
+
+    // lay out a block for each leaving bin in the send buffer
+    size_t sendBytes = 0;
+    for (int b = 0; b < PARTICLE_BINS; ++b) {
+      sendBytes = next_align_of(sendBytes, 8);
+      sendOffset_[b] = sendBytes;
+      if (PARTICLE_STAY != b) {
+        sendBytes += packed_bytes(counts[b]);
+      }
+    }
+    if (sendBytes > sendBufSize_) {
+      const size_t newSize = std::max(sendBytes, 2 * sendBufSize_);
+      if (sendBuf_) {
+        CUDA_RUNTIME(cudaFree(sendBuf_));
+      }
+      if (hostSendBuf_) {
+        CUDA_RUNTIME(cudaFreeHost(hostSendBuf_));
+      }
+      CUDA_RUNTIME(cudaMalloc(&sendBuf_, newSize));
+      CUDA_RUNTIME(cudaHostAlloc(&hostSendBuf_, newSize, cudaHostAllocDefault));
+      sendBufSize_ = newSize;
+    }
+
+    // destination of each attribute in each bin
+    std::vector<void *> dsts(PARTICLE_BINS * num_attrs());
+    for (int b = 0; b < PARTICLE_BINS; ++b) {
+      for (size_t a = 0; a < num_attrs(); ++a) {
+        if (PARTICLE_STAY == b) {
+          dsts[b * num_attrs() + a] = next_[a];
+        } else {
+          dsts[b * num_attrs() + a] = send_block(b) + packed_offset(counts[b], a);
+        }
+      }
+    }
+    CUDA_RUNTIME(cudaMemcpyAsync(devDsts_, dsts.data(), dsts.size() * sizeof(dsts[0]), cudaMemcpyHostToDevice,
+                                 stream_));
+    CUDA_RUNTIME(cudaMemcpyAsync(devSrcs_, curr_.data(), curr_.size() * sizeof(curr_[0]), cudaMemcpyHostToDevice,
+                                 stream_));
+    CUDA_RUNTIME(cudaMemsetAsync(&counts_[PARTICLE_BINS], 0, PARTICLE_BINS * sizeof(*counts_), stream_));
+
+    if (size_) {
+      const int dimBlock = 256;
+      const int dimGrid = std::min((size_ + dimBlock - 1) / dimBlock, size_t(1024));
+      particle_scatter_kernel<<<dimGrid, dimBlock, 0, stream_>>>(devDsts_, &counts_[PARTICLE_BINS], devSrcs_,
+                                                                 devElemSize_, num_attrs(), bins_, size_, globalSize);
+      CUDA_RUNTIME(cudaGetLastError());
+    }
+    nextSize_ = counts[PARTICLE_STAY];
+
+    if (stage && sendBytes) {
+      CUDA_RUNTIME(cudaMemcpyAsync(hostSendBuf_, sendBuf_, sendBytes, cudaMemcpyDeviceToHost, stream_));
+    }
+    CUDA_RUNTIME(cudaStreamSynchronize(stream_));
+    nvtxRangePop(); // Particles::scatter
+  }
+
+  /* the device block of leaving particles for bin `b` after scatter()
+   */
+  char *send_block(int b) const { return sendBuf_ + sendOffset_[b]; }
+  /* the host copy of send_block(b), if scatter() staged the send buffer
+   */
+  char *host_send_block(int b) const { return hostSendBuf_ + sendOffset_[b]; }
+
+  /* make sure there is a host buffer of at least n bytes to recv blocks into
+   */
+  char *host_recv_buf(size_t n) {
+    if (n > hostRecvBufSize_) {
+      n = std::max(n, 2 * hostRecvBufSize_);
+      if (hostRecvBuf_) {
+        CUDA_RUNTIME(cudaFreeHost(hostRecvBuf_));
+      }
+      CUDA_RUNTIME(cudaHostAlloc(&hostRecvBuf_, n, cudaHostAllocDefault));
+      hostRecvBufSize_ = n;
+    }
+    return hostRecvBuf_;
+  }
+
+  /* make room for n particles in the next arrays
+   */
+  void reserve_next(size_t n) { grow(n); }
+
+  /*! append `n` packed particles at `src` to the next arrays.
+      `src` may be on the host, this device, or a peer device
+  */
+  void append(const char *src, size_t n) {
+    assert(nextSize_ + n <= capacity_);
+    CUDA_RUNTIME(cudaSetDevice(dev_));
+    for (size_t a = 0; a < num_attrs(); ++a) {
+      char *dst = static_cast<char *>(next_[a]) + nextSize_ * elemSize_[a];
+      CUDA_RUNTIME(
+          cudaMemcpyAsync(dst, src + packed_offset(n, a), n * elemSize_[a], cudaMemcpyDefault, stream_));
+    }
+    nextSize_ += n;
+  }
+
+  /* finish a migration: the next arrays become current
+   */
+  void finish() {
+    CUDA_RUNTIME(cudaSetDevice(dev_));
+    CUDA_RUNTIME(cudaStreamSynchronize(stream_));
+    std::swap(curr_, next_);
+    size_ = nextSize_;
+    nextSize_ = 0;
+  }
+};
@@ -11,12 +11,12 @@
 
 #include "dim3.hpp"
 #include "gpu_topology.hpp"
-#include "local_domain.cuh"
 #include "mat2d.hpp"
 #include "mpi_topology.hpp"
 #include "stencil/logging.hpp"
 #include "stencil/qap.hpp"
 #include "stencil/radius.hpp"
+#include "stencil/rect3.hpp"
 
 namespace collective {}
 
@@ -78,6 +78,13 @@ public:
   }
   RankPartition() : RankPartition(Dim3(0, 0, 0), 0) {}
 
+  /* split `size` into exactly `dim` subdomains
+   */
+  RankPartition(const Dim3 &size, const Dim3 &dim)
+      : dim_(dim), size_(div_ceil(size.x, dim.x), div_ceil(size.y, dim.y), div_ceil(size.z, dim.z)) {
+    rem_ = size % dim_;
+  }
+
   virtual Dim3 dim() const { return dim_; }
 
   virtual Dim3 subdomain_size(const Dim3 &idx) const {
@@ -143,6 +150,86 @@ public:
   }
 };
 
+/*! the number of subdomains to split `points` points of `bytesPerPoint` each into, so that each subdomain fits in
+    `cacheBytes`. The result is a power of two, so RankPartition splits evenly, and at most `maxSubdomains`.
+*/
+inline int64_t subdomains_for_cache(const int64_t points, const size_t bytesPerPoint, const size_t cacheBytes,
+                                    const int64_t maxSubdomains) {
+  assert(maxSubdomains >= 1);
+  if (0 == cacheBytes) {
+    return 1;
+  }
+  const uint64_t bytes = uint64_t(points) * bytesPerPoint;
+  int64_t n = 1;
+  while (2 * n <= maxSubdomains && (bytes + n - 1) / n > cacheBytes) {
+    n *= 2;
+  }
+  return n;
+}
+
+/*! the fraction of a subdomain's allocated points that are its compute region, with halos of `radius` on every side.
+    A thin slab is mostly halo: 512x512x4 with radius 3 is 0.39
+*/
+inline double halo_efficiency(const Dim3 &sz, const Radius &radius) {
+  const Dim3 raw(sz.x + radius.x(-1) + radius.x(1), sz.y + radius.y(-1) + radius.y(1),
+                 sz.z + radius.z(-1) + radius.z(1));
+  return raw.flatten() ? double(sz.flatten()) / raw.flatten() : 0;
+}
+
+/*! the split of `size` into exactly `n` subdomains whose largest subdomain has the fewest halo points.
+    Along a split axis, no subdomain may be thinner than the radius on that axis, since its halo would then reach past
+    its neighbor. (0,0,0) if there is no such split
+*/
+inline Dim3 halo_split(const Dim3 &size, const int64_t n, const Radius &radius) {
+  // the thinnest subdomain along an axis with `parts` parts is floor(extent / parts)
+  auto thick = [](const int64_t extent, const int64_t parts, const size_t lo, const size_t hi) {
+    return extent / parts >= std::max<int64_t>(1, parts > 1 ? std::max(lo, hi) : 0);
+  };
+  Dim3 best(0, 0, 0);
+  int64_t bestHalo = 0;
+  for (int64_t x = 1; x <= n; ++x) {
+    if (n % x) {
+      continue;
+    }
+    for (int64_t y = 1; y <= n / x; ++y) {
+      if ((n / x) % y) {
+        continue;
+      }
+      const Dim3 dim(x, y, n / x / y);
+      if (!thick(size.x, dim.x, radius.x(-1), radius.x(1)) || !thick(size.y, dim.y, radius.y(-1), radius.y(1)) ||
+          !thick(size.z, dim.z, radius.z(-1), radius.z(1))) {
+        continue;
+      }
+      const Dim3 sz = RankPartition(size, dim).subdomain_size(Dim3(0, 0, 0));
+      const Dim3 raw(sz.x + radius.x(-1) + radius.x(1), sz.y + radius.y(-1) + radius.y(1),
+                     sz.z + radius.z(-1) + radius.z(1));
+      const int64_t halo = raw.flatten() - sz.flatten();
+      if (0 == best.flatten() || halo < bestHalo) {
+        best = dim;
+        bestHalo = halo;
+      }
+    }
+  }
+  return best;
+}
+
+/*! the halo_split() of `size` into the most subdomains, at most `n`, whose thinnest subdomain has a halo_efficiency()
+    of at least `minEfficiency`. (1,1,1) if no count of 2 or more qualifies
+*/
+inline Dim3 efficient_split(const Dim3 &size, const int64_t n, const Radius &radius, const double minEfficiency) {
+  for (int64_t m = n; m > 1; --m) {
+    const Dim3 dim = halo_split(size, m, radius);
+    if (0 == dim.flatten()) {
+      continue;
+    }
+    const Dim3 thinnest = RankPartition(size, dim).subdomain_size(dim - Dim3(1, 1, 1));
+    if (halo_efficiency(thinnest, radius) >= minEfficiency) {
+      return dim;
+    }
+  }
+  return Dim3(1, 1, 1);
+}
+
 /* A 2-level partition of a 3D space amongst nodes in the system, and then GPUs in the node
  */
 class NodePartition {
@@ -309,6 +396,26 @@ public:
   Dim3 idx(int64_t i) const noexcept { return dimensionize(i, dim()); }
 };
 
+/*! Split the active blocks among `n` workers. Returns the worker of each block, or -1 for an inactive block.
+    Each worker gets a contiguous run of active blocks in linear order, and runs differ in length by at most one
+*/
+inline std::vector<int64_t> assign_active(const std::vector<bool> &active, const int64_t n) {
+  assert(n > 0);
+  const int64_t numActive = std::count(active.begin(), active.end(), true);
+  std::vector<int64_t> ret(active.size(), -1);
+  int64_t ai = 0; // index among active blocks
+  for (size_t i = 0; i < active.size(); ++i) {
+    if (active[i]) {
+      // the first numActive % n workers get one extra block
+      const int64_t q = numActive / n;
+      const int64_t r = numActive % n;
+      ret[i] = ai < r * (q + 1) ? ai / (q + 1) : r + (ai - r * (q + 1)) / q;
+      ++ai;
+    }
+  }
+  return ret;
+}
+
 enum class PlacementStrategy { NodeAware, Trivial };
 
 class Placement {
@@ -334,8 +441,32 @@ public:
 
   // upper bound for idx
   virtual Dim3 dim() = 0;
+
+  // the number of subdomains placed on a rank
+  virtual int64_t num_subdomains(const int rank) = 0;
+
+  // false if no subdomain is placed at idx
+  virtual bool active(const Dim3 & /*idx*/) { return true; }
 };
 
+/*! the least halo_efficiency() of any active subdomain of `placement`
+ */
+inline double placement_efficiency(Placement &placement, const Radius &radius) {
+  const Dim3 dim = placement.dim();
+  double ret = 1;
+  for (int64_t z = 0; z < dim.z; ++z) {
+    for (int64_t y = 0; y < dim.y; ++y) {
+      for (int64_t x = 0; x < dim.x; ++x) {
+        const Dim3 idx(x, y, z);
+        if (placement.active(idx)) {
+          ret = std::min(ret, halo_efficiency(placement.subdomain_size(idx), radius));
+        }
+      }
+    }
+  }
+  return ret;
+}
+
 class Trivial : public Placement {
 private:
   RankPartition partition_;
@@ -382,29 +513,27 @@ public:
 
   Dim3 dim() override { return partition_.dim(); }
 
+  int64_t num_subdomains(const int rank) override { return size_t(rank) < idx_.size() ? idx_[rank].size() : 0; }
+
   Trivial(const Dim3 &size, // total domain size
           MpiTopology &mpiTopo,
           const std::vector<int> &rankCudaIds // which CUDA devices the calling
                                               // rank wants to contribute
   ) {
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(mpiTopo.comm());
     // have everyone request one work item per GPU
     const int workItems = rankCudaIds.size();
     std::vector<int> workItemCounts(mpiTopo.size());
-    MPI_Allgather(&workItems, 1, MPI_INT, workItemCounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    MPI_Allgather(&workItems, 1, MPI_INT, workItemCounts.data(), 1, MPI_INT, mpiTopo.comm());
 
     if (mpiTopo.rank() == 0) {
-      std::cerr << "Trivial: workItemCounts:";
-      for (auto &e : workItemCounts) {
-        std::cerr << " " << e;
-      }
-      std::cerr << "\n";
+      LOG_DEBUG("Trivial: workItemCounts:" << logging::seq(workItemCounts));
     }
 
     const int numSubdomains = std::accumulate(workItemCounts.begin(), workItemCounts.end(), 0);
 
     if (mpiTopo.rank() == 0) {
-      std::cerr << "Trivial: numSubdomains=" << numSubdomains << "\n";
+      LOG_DEBUG("Trivial: numSubdomains=" << numSubdomains);
     }
 
     partition_ = RankPartition(size, numSubdomains);
@@ -422,17 +551,8 @@ public:
     assert(rankAssignments.size() == numSubdomains);
     assert(rankIds.size() == numSubdomains);
     if (mpiTopo.rank() == 0) {
-      std::cerr << "Trivial: rankAssignments:";
-      for (auto &e : rankAssignments) {
-        std::cerr << " " << e;
-      }
-      std::cerr << "\n";
-
-      std::cerr << "Trivial: rankIds:";
-      for (auto &e : rankIds) {
-        std::cerr << " " << e;
-      }
-      std::cerr << "\n";
+      LOG_SPEW("Trivial: rankAssignments:" << logging::seq(rankAssignments));
+      LOG_SPEW("Trivial: rankIds:" << logging::seq(rankIds));
     }
 
     // figure out the cuda IDs contributed from each rank
@@ -446,14 +566,10 @@ public:
     // determine which CUDA id each subdomain will be assigned to
     std::vector<int> cudaAssignments(numSubdomains);
     MPI_Allgatherv(rankCudaIds.data(), rankCudaIds.size(), MPI_INT, cudaAssignments.data(), workItemCounts.data(),
-                   offs.data(), MPI_INT, MPI_COMM_WORLD);
+                   offs.data(), MPI_INT, mpiTopo.comm());
 
     if (0 == mpiTopo.rank()) {
-      std::cerr << "Trivial: cudaAssignments:";
-      for (auto &e : cudaAssignments) {
-        std::cerr << " " << e;
-      }
-      std::cerr << "\n";
+      LOG_SPEW("Trivial: cudaAssignments:" << logging::seq(cudaAssignments));
     }
 
     // fill data
@@ -465,10 +581,9 @@ public:
       const int id = rankIds[i];
       const int cuda = cudaAssignments[i];
       const Dim3 idx = partition_.dimensionize(i);
-      const Dim3 sdSize = partition_.subdomain_size(idx);
-
       if (0 == mpiTopo.rank()) {
-        std::cerr << idx << "is sd" << id << " on r" << rank << " cuda" << cuda << ")" << sdSize << "\n";
+        LOG_SPEW(idx << " is sd" << id << " on r" << rank << " cuda" << cuda << " "
+                     << partition_.subdomain_size(idx));
       }
 
       assert(rank >= 0);
@@ -488,7 +603,7 @@ public:
       cuda_[idx] = cuda;
     }
 
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(mpiTopo.comm());
   }
 };
 
@@ -583,7 +698,9 @@ private:
   double comm_cost(Dim3 dir, const Dim3 sz, const Radius radius) {
     assert(dir.all_lt(2));
     assert(dir.all_gt(-2));
-    double count = double(LocalDomain::halo_extent(dir, sz, radius).flatten());
+    const Dim3 ext(0 == dir.x ? sz.x : int64_t(radius.x(dir.x)), 0 == dir.y ? sz.y : int64_t(radius.y(dir.y)),
+                   0 == dir.z ? sz.z : int64_t(radius.z(dir.z)));
+    double count = double(ext.flatten());
     return count;
   }
 
@@ -628,13 +745,15 @@ public:
 
   Dim3 dim() override { return partition_.dim(); }
 
+  int64_t num_subdomains(const int rank) override { return size_t(rank) < idx_.size() ? idx_[rank].size() : 0; }
+
   NodeAware(const Dim3 &size, // total domain size
             MpiTopology &mpiTopo, Radius radius,
             const std::vector<int> &rankCudaIds // which CUDA devices the calling
                                                 // rank wants to contribute
   ) {
     LOG_DEBUG("NodeAware: entered ctor");
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(mpiTopo.comm());
     LOG_DEBUG("NodeAware: after barrier");
 
     // TODO: actually check that everyone has the same number of GPUs
@@ -646,7 +765,7 @@ public:
 
     partition_ = NodePartition(size, radius, numNodes, gpusPerNode);
 
-    if (0 == mpi::world_rank()) {
+    if (0 == mpiTopo.rank()) {
       LOG_INFO("NodeAware: " << partition_.sys_dim() << "x" << partition_.node_dim());
     }
 
@@ -664,7 +783,7 @@ public:
       allNames.resize(MPI_MAX_PROCESSOR_NAME * mpiTopo.size());
     }
     MPI_Gather(name, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, allNames.data(), MPI_MAX_PROCESSOR_NAME, MPI_CHAR, 0,
-               MPI_COMM_WORLD);
+               mpiTopo.comm());
     if (0 == mpiTopo.rank()) {
       LOG_DEBUG("NodeAware: gathered names to root");
     }
@@ -678,7 +797,7 @@ public:
       }
     }
     if (0 == mpiTopo.rank()) {
-      std::cerr << "DEBUG: NodeAware: built names for each rank\n";
+      LOG_DEBUG("NodeAware: built names for each rank");
     }
 
     // number each name
@@ -693,7 +812,7 @@ public:
       }
     }
     if (0 == mpiTopo.rank()) {
-      std::cerr << "DEBUG: NodeAware: numbered each name\n";
+      LOG_DEBUG("NodeAware: numbered each name");
     }
 
     // store the node number for each rank
@@ -708,7 +827,7 @@ public:
       }
     }
     if (0 == mpiTopo.rank()) {
-      std::cerr << "DEBUG: NodeAware: build ranks in each node\n";
+      LOG_DEBUG("NodeAware: build ranks in each node");
     }
 
     // gather up all CUDA ids that all ranks are contributing
@@ -717,10 +836,7 @@ public:
                   mpiTopo.comm());
 
     if (0 == mpiTopo.rank()) {
-      std::cerr << "globalCudaIds:";
-      for (auto &e : globalCudaIds)
-        std::cerr << " " << e;
-      std::cerr << "\n";
+      LOG_SPEW("globalCudaIds:" << logging::seq(globalCudaIds));
     }
 
     // OUTPUTS
@@ -741,11 +857,8 @@ public:
 
         const Dim3 sysIdx = partition_.sys_idx(node);
         auto &ranks = nodeRanks[node]; // ranks in this node
-        std::cerr << "placement on node " << node << " " << sysIdx << "\n";
-        std::cerr << "ranks:";
-        for (auto &e : ranks)
-          std::cerr << " " << e;
-        std::cerr << "\n";
+        LOG_DEBUG("placement on node " << node << " " << sysIdx);
+        LOG_SPEW("ranks:" << logging::seq(ranks));
         assert(ranks.size() == ranksPerNode);
 
         // make a bandwidth matrix for the components in this node
@@ -787,7 +900,7 @@ public:
               dir.y = 1;
             if (dir.z != 0 && dir.z == 1 - globalDim.z)
               dir.z = 1;
-            std::cerr << dir << "=" << srcIdx << "->" << dstIdx << "\n";
+            LOG_SPEW(dir << "=" << srcIdx << "->" << dstIdx);
             if (Dim3(0, 0, 0) == dir || dir.any_gt(1) || dir.any_lt(-1)) {
               continue;
             } else {
@@ -800,17 +913,18 @@ public:
 
         // which component each subdomain should be on
         Mat2D<double> distance = make_reciprocal(bandwidth);
-        std::vector<size_t> components = qap::solve(comm, distance);
+        // the exact solver is factorial in the number of subdomains, so fall back to local search for many subdomains
+        std::vector<size_t> components;
+        if (gpusPerNode <= 8) {
+          components = qap::solve(comm, distance);
+        } else {
+          components = qap::solve_catch(comm, distance);
+        }
 
-        std::cerr << "components:";
-        for (auto &e : components)
-          std::cerr << " " << e;
-        std::cerr << "\n";
+        LOG_SPEW("components:" << logging::seq(components));
 
         for (int64_t id = 0; id < gpusPerNode; ++id) {
           const Dim3 nodeIdx = partition_.node_idx(id);
-          const Dim3 sdSize = partition_.subdomain_size(sysIdx * nodeDim + nodeIdx);
-
           // each component is owned by a rank and has a local ID
           size_t component = components[id];
           const int ri = component / gpusPerRank;
@@ -818,8 +932,8 @@ public:
           const int gpuId = component % gpusPerRank;
           const int cuda = globalCudaIds[rank * gpusPerRank + gpuId];
 
-          std::cerr << "nodeIdx=" << nodeIdx << " size=" << sdSize << " rank=" << rank << " gpuId=" << gpuId
-                    << " cuda=" << cuda << "\n";
+          LOG_SPEW("nodeIdx=" << nodeIdx << " size=" << partition_.subdomain_size(sysIdx * nodeDim + nodeIdx)
+                               << " rank=" << rank << " gpuId=" << gpuId << " cuda=" << cuda);
 
           rankAssignment[node * gpusPerNode + id] = rank;
           idForDomain[node * gpusPerNode + id] = gpuId;
@@ -830,9 +944,9 @@ public:
     } // 0 == rank
 
     // broadcast the data to all ranks
-    MPI_Bcast(rankAssignment.data(), rankAssignment.size(), MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(idForDomain.data(), idForDomain.size(), MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(cudaAssignment.data(), cudaAssignment.size(), MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(rankAssignment.data(), rankAssignment.size(), MPI_INT, 0, mpiTopo.comm());
+    MPI_Bcast(idForDomain.data(), idForDomain.size(), MPI_INT, 0, mpiTopo.comm());
+    MPI_Bcast(cudaAssignment.data(), cudaAssignment.size(), MPI_INT, 0, mpiTopo.comm());
 
     for (size_t i = 0; i < rankAssignment.size(); ++i) {
       // convert i into a domain idx
@@ -847,8 +961,8 @@ public:
       cuda_[idx] = cuda;
 
       if (0 == mpiTopo.rank()) {
-        std::cerr << "idx=" << idx << " size=" << partition_.subdomain_size(idx) << " rank=" << rank
-                  << " subdomain=" << subdomain << " cuda=" << cuda << "\n";
+        LOG_SPEW("idx=" << idx << " size=" << partition_.subdomain_size(idx) << " rank=" << rank
+                         << " subdomain=" << subdomain << " cuda=" << cuda);
       }
 
       // convert rank and subdomain to idx
@@ -862,3 +976,189 @@ public:
     }
   }
 };
+
+/*! Place only the active blocks of a `blocks` grid over the domain, one subdomain per block.
+
+    Active blocks are split as evenly as possible among every GPU that every rank contributes, as contiguous runs in
+    linear order, so each rank's share of memory and communication follows the active volume rather than the
+    bounding box. A rank may end up with no subdomains. Every rank must pass the same `mask`.
+*/
+class Masked : public Placement {
+private:
+  RankPartition partition_;
+
+  // active_[partition_.linearize(idx)]
+  std::vector<bool> active_;
+
+  std::map<Dim3, int> rank_;
+  std::map<Dim3, int> subdomainId_;
+  std::map<Dim3, int> cuda_;
+
+  // idx_[rank][id] = idx
+  std::vector<std::vector<Dim3>> idx_;
+
+public:
+  Dim3 get_idx(int rank, int domId) override {
+    assert(size_t(rank) < idx_.size());
+    assert(size_t(domId) < idx_[rank].size());
+    return idx_[rank][domId];
+  }
+
+  int get_rank(const Dim3 &idx) override {
+    assert(active(idx));
+    return rank_[idx];
+  }
+
+  int get_subdomain_id(const Dim3 &idx) override {
+    assert(active(idx));
+    return subdomainId_[idx];
+  }
+
+  int get_cuda(const Dim3 &idx) override {
+    assert(active(idx));
+    return cuda_[idx];
+  }
+
+  Dim3 subdomain_size(const Dim3 &idx) override { return partition_.subdomain_size(idx); }
+
+  Dim3 subdomain_origin(const Dim3 &idx) override { return partition_.subdomain_origin(idx); }
+
+  Dim3 dim() override { return partition_.dim(); }
+
+  int64_t num_subdomains(const int rank) override { return size_t(rank) < idx_.size() ? idx_[rank].size() : 0; }
+
+  bool active(const Dim3 &idx) override { return active_[partition_.linearize(idx)]; }
+
+  Masked(const Dim3 &size,              // total domain size
+         const Dim3 &blocks,            // the number of blocks along each axis
+         const std::vector<bool> &mask, // mask[i] is true if block i, in linear order, is active
+         MpiTopology &mpiTopo,
+         const std::vector<int> &rankCudaIds // which CUDA devices the calling rank wants to contribute
+         )
+      : partition_(size, blocks), active_(mask) {
+    assert(mask.size() == blocks.flatten());
+
+    // every GPU contributed by every rank, in rank order
+    const int workItems = rankCudaIds.size();
+    std::vector<int> workItemCounts(mpiTopo.size());
+    MPI_Allgather(&workItems, 1, MPI_INT, workItemCounts.data(), 1, MPI_INT, mpiTopo.comm());
+    std::vector<int> offs;
+    int numGpus = 0;
+    for (int e : workItemCounts) {
+      offs.push_back(numGpus);
+      numGpus += e;
+    }
+    std::vector<int> gpuCudaIds(numGpus);
+    MPI_Allgatherv(rankCudaIds.data(), workItems, MPI_INT, gpuCudaIds.data(), workItemCounts.data(), offs.data(),
+                   MPI_INT, mpiTopo.comm());
+    std::vector<int> gpuRank;
+    for (size_t rank = 0; rank < workItemCounts.size(); ++rank) {
+      gpuRank.insert(gpuRank.end(), workItemCounts[rank], int(rank));
+    }
+
+    const std::vector<int64_t> gpuOf = assign_active(active_, numGpus);
+    idx_.resize(mpiTopo.size());
+    for (size_t i = 0; i < gpuOf.size(); ++i) {
+      if (gpuOf[i] < 0) {
+        continue;
+      }
+      const Dim3 idx = partition_.dimensionize(i);
+      const int rank = gpuRank[gpuOf[i]];
+      rank_[idx] = rank;
+      subdomainId_[idx] = int(idx_[rank].size());
+      cuda_[idx] = gpuCudaIds[gpuOf[i]];
+      idx_[rank].push_back(idx);
+    }
+
+    if (0 == mpiTopo.rank()) {
+      LOG_INFO("Masked: " << rank_.size() << " of " << blocks.flatten() << " blocks of " << blocks << " are active");
+    }
+  }
+};
+
+/*! Place the subdomains of a patch that refines `region` of a parent domain by `ratio`.
+
+    The patch is cut wherever the parent is, so each patch subdomain refines part of exactly one parent subdomain,
+    and is placed on the same rank and GPU as that parent subdomain. Coordinates are of the fine patch, with the
+    patch's origin at `region.lo`.
+*/
+class Refined : public Placement {
+private:
+  Dim3 dim_;
+  Dim3 parentFirst_;                // the parent index of patch subdomain (0,0,0)
+  std::vector<int64_t> cuts_[3];    // the fine coordinates where subdomains start along each axis, then the end
+  std::map<Dim3, int> rank_;        // convert idx to rank
+  std::map<Dim3, int> subdomainId_; // convert idx to subdomain id
+  std::map<Dim3, int> cuda_;        // get cuda device for idx
+  std::vector<std::vector<Dim3>> idx_;
+
+public:
+  Dim3 get_idx(int rank, int domId) override {
+    assert(size_t(rank) < idx_.size());
+    assert(size_t(domId) < idx_[rank].size());
+    return idx_[rank][domId];
+  }
+
+  int get_rank(const Dim3 &idx) override { return rank_[idx]; }
+
+  int get_subdomain_id(const Dim3 &idx) override { return subdomainId_[idx]; }
+
+  int get_cuda(const Dim3 &idx) override { return cuda_[idx]; }
+
+  Dim3 subdomain_size(const Dim3 &idx) override {
+    return Dim3(cuts_[0][idx.x + 1] - cuts_[0][idx.x], cuts_[1][idx.y + 1] - cuts_[1][idx.y],
+                cuts_[2][idx.z + 1] - cuts_[2][idx.z]);
+  }
+
+  Dim3 subdomain_origin(const Dim3 &idx) override { return Dim3(cuts_[0][idx.x], cuts_[1][idx.y], cuts_[2][idx.z]); }
+
+  Dim3 dim() override { return dim_; }
+
+  int64_t num_subdomains(const int rank) override { return size_t(rank) < idx_.size() ? idx_[rank].size() : 0; }
+
+  /* the index in the parent of the subdomain that patch subdomain `idx` refines
+   */
+  Dim3 parent_idx(const Dim3 &idx) const noexcept { return parentFirst_ + idx; }
+
+  Refined(Placement &parent, const Rect3 &region, const int64_t ratio, const int numRanks)
+      : dim_(0, 0, 0), parentFirst_(-1, -1, -1) {
+    const Dim3 parentDim = parent.dim();
+    for (int a = 0; a < 3; ++a) {
+      for (int64_t p = 0; p < parentDim[a]; ++p) {
+        Dim3 pIdx(0, 0, 0);
+        pIdx[a] = p;
+        const int64_t lo = std::max(parent.subdomain_origin(pIdx)[a], region.lo[a]);
+        const int64_t hi = std::min(parent.subdomain_origin(pIdx)[a] + parent.subdomain_size(pIdx)[a], region.hi[a]);
+        if (lo < hi) {
+          if (parentFirst_[a] < 0) {
+            parentFirst_[a] = p;
+          }
+          cuts_[a].push_back((lo - region.lo[a]) * ratio);
+          dim_[a] = p - parentFirst_[a] + 1;
+        }
+      }
+      if (parentFirst_[a] < 0) {
+        LOG_FATAL("Refined: region " << region << " is outside of the parent");
+      }
+      cuts_[a].push_back((region.hi[a] - region.lo[a]) * ratio);
+    }
+
+    idx_.resize(numRanks);
+    for (int64_t z = 0; z < dim_.z; ++z) {
+      for (int64_t y = 0; y < dim_.y; ++y) {
+        for (int64_t x = 0; x < dim_.x; ++x) {
+          const Dim3 idx(x, y, z);
+          const Dim3 pIdx = parent_idx(idx);
+          if (!parent.active(pIdx)) {
+            LOG_FATAL("Refined: region " << region << " covers an inactive block of the parent");
+          }
+          const int rank = parent.get_rank(pIdx);
+          rank_[idx] = rank;
+          subdomainId_[idx] = int(idx_[rank].size());
+          cuda_[idx] = parent.get_cuda(pIdx);
+          idx_[rank].push_back(idx);
+        }
+      }
+    }
+  }
+};
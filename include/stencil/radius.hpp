@@ -11,6 +11,16 @@
 // #define SPEW(x) std::cerr << "SPEW[" << __FILE__ << ":" << __LINE__ << "] " <<  x << "\n";
 #define SPEW(x)
 
+/* Which directions a Radius can be non-zero in.
+   Used to pick a fixed direction set for planning instead of all 26 directions
+ */
+enum class RadiusShape {
+  Full,   // faces, edges, and corners
+  Face,   // only faces (star stencil)
+  Full2D, // faces, edges, and corners in the xy plane
+  Face2D, // only faces in the xy plane
+};
+
 class Radius {
 private:
   DirectionMap<size_t> rads_;
@@ -78,6 +88,33 @@ public:
     dir(-1, -1, -1) = r;
   }
 
+  /* the smallest RadiusShape that covers all non-zero directions
+   */
+  RadiusShape shape() const noexcept {
+    bool usesZ = false;
+    bool usesNonFace = false;
+    for (int z = -1; z <= 1; ++z) {
+      for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+          if (0 == dir(x, y, z) || (0 == x && 0 == y && 0 == z)) {
+            continue;
+          }
+          if (0 != z) {
+            usesZ = true;
+          }
+          if (std::abs(x) + std::abs(y) + std::abs(z) > 1) {
+            usesNonFace = true;
+          }
+        }
+      }
+    }
+    if (usesZ) {
+      return usesNonFace ? RadiusShape::Full : RadiusShape::Face;
+    } else {
+      return usesNonFace ? RadiusShape::Full2D : RadiusShape::Face2D;
+    }
+  }
+
   static Radius constant(const size_t r) {
     Radius result;
     for (int zi = 0; zi < 3; ++zi) {
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+
+#include "stencil/dim3.hpp"
+#include "stencil/partition.hpp"
+#include "stencil/rcstream.hpp"
+#include "stencil/rect3.hpp"
+#include "stencil/stencil.hpp"
+
+/*! A statically placed patch that refines `region` of a realized DistributedDomain by RefinedPatch::RATIO.
+
+    The patch is a DistributedDomain of its own, with the parent's quantities, radius, and methods, so its internal
+    halos are exchanged like any other domain's. It is cut wherever the parent is, and each of its subdomains lives
+    on the GPU of the parent subdomain it refines, so moving data between the parent and the patch never leaves a GPU.
+
+    DistributedDomain dd(...);
+    ... // configure and realize dd
+    RefinedPatch patch(dd, Rect3(lo, hi));
+    patch.realize();
+    dd.exchange();
+    patch.exchange();  // exchange the patch, then fill its outer halos from dd
+    ... // step dd and patch.fine()
+    patch.coarsen();   // average the patch back into dd
+
+    Handles returned by the parent's add_data() also work on the patch. Coordinates in the patch are fine points
+    from region.lo. Where the region spans a periodic axis of the parent, the patch is periodic along it; its other
+    faces are filled from the parent. Quantities must have a DataType and may not be staggered.
+*/
+class RefinedPatch {
+public:
+  // fine points along each axis per parent point
+  static constexpr int64_t RATIO = 2;
+
+private:
+  DistributedDomain &parent_;
+  Rect3 region_;
+  DistributedDomain fine_;
+  Refined *placement_; // also fine_.placement_
+
+  // parentDomain_[di] = the parent subdomain that fine subdomain di refines
+  std::vector<size_t> parentDomain_;
+
+  // prolongDirs_[di] = the halo sides of fine subdomain di that are past a face filled from the parent
+  std::vector<std::vector<Dim3>> prolongDirs_;
+
+  // one per fine subdomain
+  std::vector<RcStream> streams_;
+
+public:
+  /* `parent` must be realized, and `region` must be inside it
+   */
+  RefinedPatch(DistributedDomain &parent, const Rect3 &region);
+  RefinedPatch(const RefinedPatch &) = delete;
+  RefinedPatch &operator=(const RefinedPatch &) = delete;
+
+  DistributedDomain &fine() noexcept { return fine_; }
+  const Rect3 &region() const noexcept { return region_; }
+
+  /* realize the patch. Collective over the parent's ranks
+   */
+  void realize();
+
+  /* fill the halos on the patch's outer faces by trilinear interpolation of the parent's current quantities.
+     The parent's halos must be current, for example by dd.exchange() first
+  */
+  void prolong();
+
+  /* exchange the patch's internal halos, then prolong()
+   */
+  void exchange() {
+    fine_.exchange();
+    prolong();
+  }
+
+  /* overwrite the parent's current quantities under the patch with the average of the fine points they cover.
+     The parent's halos are not updated
+  */
+  void coarsen();
+};
@@ -4,6 +4,7 @@
 #include <cassert>
 #include <cstdlib>
 #include <fstream>
+#include <functional>
 #include <set>
 #include <vector>
 
@@ -14,17 +15,25 @@
 
 #include "cuda_runtime.hpp"
 
+#include "stencil/boundary.hpp"
 #include "stencil/dim3.hpp"
 #include "stencil/direction_map.hpp"
+#include "stencil/direction_set.hpp"
 #include "stencil/gpu_topology.hpp"
 #include "stencil/local_domain.cuh"
 #include "stencil/logging.hpp"
+#include "stencil/memory_report.hpp"
 #include "stencil/mpi_topology.hpp"
+#include "stencil/neighbor_sync.hpp"
 #include "stencil/nvml.hpp"
 #include "stencil/partition.hpp"
 #include "stencil/radius.hpp"
+#include "stencil/rect3.hpp"
+#include "stencil/transports.cuh"
 #include "stencil/tx.hpp"
 #include "stencil/tx_cuda.cuh"
+#include "stencil/tx_engine.cuh"
+#include "stencil/tx_stale.cuh"
 
 enum class MethodFlags {
   None = 0,
@@ -58,16 +67,92 @@ inline bool operator&&(MethodFlags a, MethodFlags b) { return (a & b) != MethodF
 
 inline bool any(MethodFlags a) noexcept { return a != MethodFlags::None; }
 
+/* the state of DistributedDomain::exchange_async() for one subset of quantities
+ */
+struct AsyncExchange {
+  std::vector<LocalDomain> views; // the subset's quantities of each LocalDomain
+  MPI_Comm comm;                  // a private duplicate, so these messages only match each other
+  Transports tx;
+  bool inFlight;
+
+  AsyncExchange() : comm(MPI_COMM_NULL), inFlight(false) {}
+  ~AsyncExchange() {
+    if (MPI_COMM_NULL != comm) {
+      MPI_Comm_free(&comm);
+    }
+  }
+};
+
+/* An exchange started by DistributedDomain::exchange_async()
+ */
+class ExchangeHandle {
+  friend class DistributedDomain;
+  AsyncExchange *ax_;
+  explicit ExchangeHandle(AsyncExchange *ax) : ax_(ax) {}
+
+public:
+  ExchangeHandle() : ax_(nullptr) {}
+
+  /* advance the exchange without blocking, for example between kernel launches.
+     true if the exchange is done, after which wait() returns immediately
+  */
+  bool test() {
+    assert(ax_);
+    if (ax_->inFlight && ax_->tx.test()) {
+      wait();
+    }
+    return !ax_->inFlight;
+  }
+
+  /* block until the halos of the exchanged quantities are filled
+   */
+  void wait() {
+    assert(ax_);
+    if (ax_->inFlight) {
+      nvtxRangePush("ExchangeHandle::wait");
+      ax_->tx.finish();
+      ax_->inFlight = false;
+      nvtxRangePop(); // ExchangeHandle::wait
+    }
+  }
+};
+
+class ExchangeGroup;
+
 class DistributedDomain {
+  friend class ExchangeGroup;
+  friend class RefinedPatch;
+
 private:
   Dim3 size_;
 
+  // a private duplicate of the communicator this domain was created on
+  MPI_Comm comm_;
+
   int rank_;
   int worldSize_;
 
   // the GPUs this distributed domain will use
   std::vector<int> gpus_;
 
+  // the number of subdomains on each GPU, or 0 to size subdomains to subdomainCacheBytes_ in realize()
+  int64_t subdomainsPerGpu_;
+  // cache capacity to size subdomains to. 0 means the smallest L2 of gpus_
+  size_t subdomainCacheBytes_;
+
+  // the block grid of set_active(), and whether each block, in linear order, is active. Empty if every point is
+  std::vector<bool> mask_;
+  Dim3 maskBlocks_;
+
+  // the least halo_efficiency() a subdomain may have before realize() uses fewer or differently-shaped subdomains.
+  // 0 accepts any
+  double minEfficiency_;
+  // placement_efficiency() of the placement chosen in realize()
+  double partitionEfficiency_;
+
+  // chunk size of host-staged remote messages. 0 means unchunked
+  size_t remoteChunkBytes_;
+
   // MPI-related topology information
   MpiTopology mpiTopology_;
 
@@ -76,6 +161,12 @@ private:
   // the stencil radius in each direction
   Radius radius_;
 
+  // the condition on each face of the global domain
+  Boundary boundary_;
+
+  // the directions that can have messages, determined by the shape of radius_ in realize()
+  std::vector<Dim3> dirs_;
+
   // typically one per GPU
   // the actual data associated with this rank
   std::vector<LocalDomain> domains_;
@@ -88,20 +179,49 @@ private:
   // the names of each quantity
   std::vector<std::string> dataName_;
 
+  // the arithmetic type of each quantity
+  std::vector<DataType> dataType_;
+
+  // 1 along each axis a quantity is face-centered on
+  std::vector<Dim3> dataStagger_;
+
+  // the size in bytes and name of each user particle attribute
+  std::vector<size_t> particleElemSize_;
+  std::vector<std::string> particleName_;
+
+  // number of independent ensemble members stored for each quantity
+  size_t ensembleSize_;
+
   MethodFlags flags_;
   PlacementStrategy strategy_;
 
-  // PeerCopySenders for same-rank exchanges
-  std::vector<std::map<size_t, PeerCopySender>> peerCopySenders_;
+  // the messages of an exchange and how each is sent
+  ExchangePlan plan_;
+
+  // the transports for exchange() of all quantities
+  Transports tx_;
+
+  // max bytes in flight to one rank, 0 for no limit
+  size_t linkCap_;
 
-  std::vector<std::map<Dim3, StatefulSender *>> remoteSenders_; // remoteSender_[domain][dstIdx] = sender
-  std::vector<std::map<Dim3, StatefulRecver *>> remoteRecvers_; // remoteRecver_[domain][srcIdx] = recver
+  // the transports for exchange_async() of each quantity subset, created on first use
+  std::map<std::vector<size_t>, AsyncExchange *> asyncExchanges_;
 
-  // kernel sender for same-domain sends
-  PeerAccessSender peerAccessSender_;
+  // state for neighbor_exchange()
+  NeighborSync neighborSync_;
+  std::vector<uint64_t> neighborStep_;            // the last step of each domain
+  std::vector<std::vector<size_t>> neighborSrcs_; // same-rank domains each domain fills its halo from
+  std::vector<std::vector<size_t>> neighborDsts_; // same-rank domains that fill their halo from each domain
+  std::vector<RcStream> neighborStreams_;         // one per domain, for same-GPU halo kernels
 
-  std::vector<std::map<Dim3, ColocatedHaloSender>> coloSenders_; // vec[domain][dstIdx] = sender
-  std::vector<std::map<Dim3, ColocatedHaloRecver>> coloRecvers_;
+  // state for exchange_stale(), created on first use
+  MPI_Comm staleComm_;
+  std::vector<StaleSender *> staleSenders_;
+  std::vector<StaleRecver *> staleRecvers_;
+  uint64_t staleStep_; // the last step passed to exchange_stale()
+
+  // the peaks of every memory_report() category, sampled at the end of realize() and on each memory_report()
+  MemoryReport memPeak_;
 
 #ifdef STENCIL_SETUP_STATS
   // count of how many bytes are sent through various methods in each exchange
@@ -130,8 +250,15 @@ public:
   double timeCreate_;
 #endif
 
-  DistributedDomain(size_t x, size_t y, size_t z)
-      : size_(x, y, z), placement_(nullptr), flags_(MethodFlags::All), strategy_(PlacementStrategy::NodeAware) {
+  /* Create a domain whose ranks are the members of `comm`.
+     All ranks in `comm` must call this collectively.
+     The domain communicates on a duplicate of `comm`, so multiple domains may exchange concurrently
+  */
+  DistributedDomain(size_t x, size_t y, size_t z, MPI_Comm comm = MPI_COMM_WORLD)
+      : size_(x, y, z), comm_(MPI_COMM_NULL), subdomainsPerGpu_(1), subdomainCacheBytes_(0),
+        maskBlocks_(0, 0, 0), minEfficiency_(0), partitionEfficiency_(0),
+        remoteChunkBytes_(REMOTE_CHUNK_BYTES), placement_(nullptr), ensembleSize_(1), flags_(MethodFlags::All),
+        strategy_(PlacementStrategy::NodeAware), linkCap_(0), staleComm_(MPI_COMM_NULL), staleStep_(0) {
 
 #ifdef STENCIL_SETUP_STATS
     timeMpiTopo_ = 0;
@@ -148,28 +275,29 @@ public:
     timeSwap_ = 0;
 #endif
 
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
-    MPI_Comm_size(MPI_COMM_WORLD, &worldSize_);
+    MPI_Comm_dup(comm, &comm_);
+    MPI_Comm_rank(comm_, &rank_);
+    MPI_Comm_size(comm_, &worldSize_);
 
 #ifdef STENCIL_SETUP_STATS
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(comm_);
     double start = MPI_Wtime();
 #endif
-    mpiTopology_ = std::move(MpiTopology(MPI_COMM_WORLD));
+    mpiTopology_ = std::move(MpiTopology(comm_));
 #ifdef STENCIL_SETUP_STATS
     double elapsed = MPI_Wtime() - start;
     double maxElapsed = -1;
-    MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm_);
     if (0 == rank_) {
       timeMpiTopo_ += maxElapsed;
     }
 #endif
 
-    std::cerr << "[" << rank_ << "] colocated with " << mpiTopology_.colocated_size() << " ranks\n";
+    LOG_DEBUG("colocated with " << mpiTopology_.colocated_size() << " ranks");
 
     int deviceCount;
     CUDA_RUNTIME(cudaGetDeviceCount(&deviceCount));
-    std::cerr << "[" << rank_ << "] cudaGetDeviceCount= " << deviceCount << "\n";
+    LOG_DEBUG("cudaGetDeviceCount= " << deviceCount);
 
     /*
   cudaComputeModeDefault = 0
@@ -185,7 +313,7 @@ public:
     cudaDeviceProp prop;
     for (int i = 0; i < deviceCount; ++i) {
       CUDA_RUNTIME(cudaGetDeviceProperties(&prop, i));
-      std::cerr << "[" << rank_ << "] cudaDeviceProp.computeMode=" << prop.computeMode << "\n";
+      LOG_DEBUG("cudaDeviceProp.computeMode=" << prop.computeMode);
     }
 
     // Determine GPUs this DistributedDomain is reposible for
@@ -206,7 +334,7 @@ public:
 // create a list of cuda device IDs in use by the ranks on this node
 // TODO: assumes all ranks use the same number of GPUs
 #ifdef STENCIL_SETUP_STATS
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(comm_);
     start = MPI_Wtime();
 #endif
     std::vector<int> nodeCudaIds(gpus_.size() * mpiTopology_.colocated_size());
@@ -214,7 +342,7 @@ public:
                   mpiTopology_.colocated_comm());
 #ifdef STENCIL_SETUP_STATS
     elapsed = MPI_Wtime() - start;
-    MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm_);
     if (0 == rank_) {
       timeNodeGpus_ += maxElapsed;
     }
@@ -233,7 +361,7 @@ public:
     }
 
 #ifdef STENCIL_SETUP_STATS
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(comm_);
     start = MPI_Wtime();
 #endif
     // Try to enable peer access between all GPUs
@@ -246,7 +374,7 @@ public:
     nvtxRangePop();
 #ifdef STENCIL_SETUP_STATS
     elapsed = MPI_Wtime() - start;
-    MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm_);
     if (0 == rank_) {
       timePeerEn_ += maxElapsed;
     }
@@ -255,19 +383,22 @@ public:
   }
 
   ~DistributedDomain() {
-    for (auto &m : remoteSenders_) {
-      for (auto &kv : m) {
-        delete kv.second;
-      }
+    for (auto &kv : asyncExchanges_) {
+      delete kv.second;
     }
-    for (auto &m : remoteRecvers_) {
-      for (auto &kv : m) {
-        delete kv.second;
-      }
+    if (MPI_COMM_NULL != staleComm_) {
+      LOG_WARN("exchange_stale() was never finished with finish_stale()");
+      destroy_stale();
+    }
+    if (MPI_COMM_NULL != comm_) {
+      MPI_Comm_free(&comm_);
     }
   }
 
   const Dim3 &size() const noexcept { return size_; }
+  /* the communicator this domain uses. Ranks are reported relative to this communicator
+   */
+  MPI_Comm comm() const noexcept { return comm_; }
   std::vector<LocalDomain> &domains() noexcept { return domains_; }
   const std::vector<LocalDomain> &domains() const noexcept { return domains_; }
 
@@ -277,10 +408,68 @@ public:
 
   void set_radius(const Radius &r) noexcept { radius_ = r; }
 
-  template <typename T> DataHandle<T> add_data(const std::string &name = "") {
-    dataElemSize_.push_back(sizeof(T));
-    dataName_.push_back(name);
-    return DataHandle<T>(dataElemSize_.size() - 1, name);
+  /* Set the condition on `face` of the global domain, for example Dim3(-1, 0, 0) for the -x face. Call before
+     realize(). Faces are periodic by default, and an axis must be periodic on both faces or on neither.
+
+     exchange() fills the halo past a face in the same pass as the halos from neighbors, with no message. So does a
+     periodic axis with one subdomain, which is copied within the subdomain. Dirichlet and Extrapolate need a
+     quantity with a DataType, and Extrapolate needs at least two points along the axis in each subdomain
+  */
+  void set_boundary(const Dim3 &face, const BoundaryCondition &bc) { boundary_.set(face, bc); }
+
+  const Boundary &boundary() const noexcept { return boundary_; }
+
+  /* Store `n` independent members of every quantity. Call before add_data()
+
+     Every member shares the placement and the communication plan, and all members of all quantities travel in the
+     same halo message, so the per-message cost of an exchange is shared by the whole ensemble.
+  */
+  void set_ensemble(size_t n) {
+    assert(n > 0);
+    assert(dataElemSize_.empty() && "set_ensemble() must be called before add_data()");
+    ensembleSize_ = n;
+  }
+
+  size_t ensemble_size() const noexcept { return ensembleSize_; }
+
+  /* add a quantity. With an ensemble, one copy of the quantity is added for each member
+
+     `stagger` is 1 along each axis the quantity is face-centered on, for example Dim3(1, 0, 0) for the x component
+     of a face-centered velocity. Such a quantity has one more point along that axis in each subdomain: the face
+     shared with the + neighbor, which the neighbor owns and exchange() fills as the first point of the + halo.
+     No padding is exchanged for quantities that are not staggered. The + radius along a staggered axis must be
+     non-zero
+  */
+  template <typename T> DataHandle<T> add_data(const std::string &name = "", const Dim3 &stagger = Dim3(0, 0, 0)) {
+    const size_t first = dataElemSize_.size();
+    for (size_t m = 0; m < ensembleSize_; ++m) {
+      dataElemSize_.push_back(sizeof(T));
+      dataType_.push_back(data_type_of<T>());
+      dataStagger_.push_back(stagger);
+      if (ensembleSize_ > 1) {
+        dataName_.push_back(name + "_" + std::to_string(m));
+      } else {
+        dataName_.push_back(name);
+      }
+    }
+    return DataHandle<T>(first, name);
+  }
+
+  /* the handle for ensemble member `m` of a quantity returned by add_data()
+   */
+  template <typename T> DataHandle<T> get_member(const DataHandle<T> &handle, size_t m) const {
+    assert(m < ensembleSize_);
+    return DataHandle<T>(handle.id_ + m, handle.name_);
+  }
+
+  /* add an attribute to every particle. Call before realize()
+     Every particle also has x, y, and z positions, see Particles
+  */
+  template <typename T> ParticleHandle<T> add_particle_attr(const std::string &name = "") {
+    particleElemSize_.push_back(sizeof(T));
+    particleName_.push_back(name);
+    // positions are the first three attributes
+    return ParticleHandle<T>(3 + particleElemSize_.size() - 1, name);
   }
 
   /* Choose comm methods from MethodFlags. Call before realize()
@@ -305,6 +494,73 @@ public:
    */
   void set_gpus(const std::vector<int> &cudaIds) { gpus_ = cudaIds; }
 
+  /* Place `n` subdomains on each GPU instead of one. Call before realize()
+     Many small subdomains give kernels better cache reuse and give exchange() more independent messages to overlap.
+     A rank may have at most MAX_RANK_SUBDOMAINS subdomains
+  */
+  void set_subdomains_per_gpu(int64_t n) noexcept {
+    assert(n > 0);
+    subdomainsPerGpu_ = n;
+  }
+
+  /* Split the domain into a `blocks` grid and only allocate, place, and exchange the blocks for which
+     `active(region)` is true, where `region` is the block's part of the domain. Call before realize(), with the same
+     arguments on every rank.
+
+     Each active block is a subdomain, and active blocks are spread evenly over every GPU, so memory and
+     communication follow the active volume instead of the bounding box. This replaces set_subdomains_per_gpu() and
+     set_placement(). No messages are planned to inactive blocks: halos that face one are left as they are
+  */
+  void set_active(const Dim3 &blocks, const std::function<bool(const Rect3 &)> &active) {
+    const RankPartition part(size_, blocks);
+    maskBlocks_ = blocks;
+    mask_.assign(blocks.flatten(), false);
+    for (int64_t i = 0; i < blocks.flatten(); ++i) {
+      const Dim3 idx(i % blocks.x, (i / blocks.x) % blocks.y, i / (blocks.x * blocks.y));
+      const Dim3 origin = part.subdomain_origin(idx);
+      mask_[i] = active(Rect3(origin, origin + part.subdomain_size(idx)));
+    }
+  }
+
+  /* Keep every subdomain's compute region at least `efficiency` of its allocated points (see halo_efficiency()).
+     If the placement realize() would choose has a thinner subdomain, the domain is instead split into the most
+     subdomains, no more than requested, that meet `efficiency`, choosing the split axes to minimize halo. Subdomain
+     slots beyond that are left idle, so some GPUs or ranks may have no subdomain. 0 (the default) accepts any split.
+     Not used with set_active(). Must be the same on every rank. Call before realize()
+  */
+  void set_min_efficiency(double efficiency) noexcept {
+    assert(efficiency >= 0 && efficiency < 1);
+    minEfficiency_ = efficiency;
+  }
+
+  /* the compute fraction of the allocated points of the least efficient subdomain (see halo_efficiency()).
+     ( after realize() )
+  */
+  double partition_efficiency() const noexcept { return partitionEfficiency_; }
+
+  /* In realize(), choose the number of subdomains per GPU so each subdomain's quantities fit in `cacheBytes`.
+     0 means the L2 size of the GPU with the smallest L2. Call before realize()
+  */
+  void fit_subdomains_to_cache(size_t cacheBytes = 0) noexcept {
+    subdomainsPerGpu_ = 0;
+    subdomainCacheBytes_ = cacheBytes;
+  }
+
+  /* Split host-staged (MethodFlags::CudaMpi) remote messages into chunks of `bytes`, so the device-to-host copy,
+     the network, and the host-to-device copy of a large halo overlap. 0 sends each message whole.
+     Must be the same on every rank. Call before realize()
+  */
+  void set_remote_chunk_bytes(size_t bytes) noexcept { remoteChunkBytes_ = bytes; }
+
+  /* Allow at most `bytes` of remote sends in flight from this rank to any one other rank.
+     Sends beyond the cap wait for earlier sends to that rank to finish, so many ranks do not all flood one receiver.
+     0 (the default) means no limit. Call before exchange()
+  */
+  void set_link_cap(size_t bytes) noexcept {
+    linkCap_ = bytes;
+    tx_.engine_.set_link_cap(int64_t(bytes));
+  }
+
   /* return the coordinate in the domain that subdomain i's interior starts at
    */
   const Dim3 &get_origin(int64_t i) const { return domains_[i].origin(); }
@@ -318,6 +574,19 @@ public:
   */
   uint64_t exchange_bytes_for_method(const MethodFlags &method) const;
 
+  /* Return the bytes this rank uses, by category: the current buffer of each quantity (with its halo), the next
+     buffers, exchange packers and unpackers, pinned host staging, particles, and the placement and plan bookkeeping.
+     Each category also has this rank's peak, and the least and greatest peak of any rank. Peaks are sampled at the end
+     of realize() and at each memory_report(), so transient allocations in realize(), and particle buffers that grew
+     and were freed between calls, are not in them. Collective.
+
+     Before realize() nothing is allocated, and the report is a prediction (MemoryReport::predicted) of what realize()
+     will allocate. It is an upper bound: every subdomain is sized like the largest, including the fewer, larger ones
+     set_min_efficiency() may fall back to, and every halo is sent with the most memory-hungry enabled method.
+     fit_subdomains_to_cache() is predicted as one subdomain per GPU
+  */
+  MemoryReport memory_report();
+
   /* Initialize resources for a previously-configured domain.
   (before exchange())
   */
@@ -340,11 +609,89 @@ public:
    */
   std::vector<std::vector<Rect3>> get_exterior() const;
 
+private:
+  void create_transports(Transports &tx, std::vector<LocalDomain> &domains, MPI_Comm comm);
+  void create_stale();
+  void destroy_stale();
+  MemoryReport local_memory();
+  MemoryReport predict_memory();
+
+public:
+
   /*!
   Do a halo exchange of the "current" quantities and return
   */
   void exchange();
 
+  /*!
+  Start a halo exchange of the "current" values of `quantities` only, and return a handle to finish it.
+  Compute on other quantities, or on the interior, until handle.wait().
+
+  Each distinct subset has its own buffers, requests, and communicator, so exchanges of different subsets may be in
+  flight at the same time, and with exchange(). The first call for a subset is collective and creates its transports;
+  later calls reuse them. A subset may have only one exchange in flight, and subsets in flight at the same time
+  should not share quantities.
+  */
+  ExchangeHandle exchange_async(const std::vector<size_t> &quantities);
+
+  /* the quantity indices of every ensemble member of `handle`, for exchange_async()
+   */
+  template <typename T> std::vector<size_t> quantities(const DataHandle<T> &handle) const {
+    std::vector<size_t> ret;
+    for (size_t m = 0; m < ensembleSize_; ++m) {
+      ret.push_back(handle.id_ + m);
+    }
+    return ret;
+  }
+
+  /*!
+  The reverse of exchange(): add the "current" halo regions of each domain back into the interior
+  regions of the neighbors they would be filled from. Halo values are not modified.
+  Used for scatter-style updates (e.g. particle deposition) that write into the halo.
+  Every quantity must be float, double, int32_t, or int64_t
+  */
+  void exchange_accumulate();
+
+  /*!
+  Move particles that have left the compute region of their LocalDomain to the neighbor they moved into.
+  Particles that leave the global domain are wrapped around.
+  Particles should move less than one subdomain between calls
+  */
+  void migrate();
+
+  /*!
+  Swap domain `di` and fill its halos from its neighbors, synchronizing only with those neighbors.
+  For one thread per domain when every neighbor is on this rank: no barrier and no call to exchange() by other
+  threads is needed, so a domain may run up to one step ahead of its neighbors.
+
+  Call from the thread that owns domain `di` once its kernels for the step have finished.
+  Fill the halos once with exchange() before the first step.
+  */
+  void neighbor_exchange(size_t di);
+
+  /*!
+  Bounded-staleness exchange for asynchronous iterations that tolerate old halos, like asynchronous Jacobi.
+  Send this rank's halos for `step`, then fill each halo with the newest one received. Blocks only while a neighbor on
+  another rank has not reached `step - staleness`, so ranks may drift up to `staleness` steps apart. Return the
+  oldest step among the remote halos now in the domains: `step` if there are none, 0 if a halo is still the one
+  from before the first step.
+
+  Messages carry the step they were packed at. Halos from domains on this rank are always current. Colocated
+  transports are not supported: call set_methods() without MethodFlags::CudaMpiColocated.
+
+  `step` starts at 1 and increases with each call. Fill the halos once with exchange() before the first step.
+  The domains may be swapped between calls: a halo that becomes current gets the newest step received, and a next
+  buffer whose halo was never filled waits for a message.
+  The first call is collective and creates the transports.
+  */
+  uint64_t exchange_stale(uint64_t step, uint64_t staleness);
+
+  /*!
+  The last exchange_stale(), with every halo current at `step`. Every rank passes the same `step`.
+  Releases the bounded-staleness transports; exchange_stale() may start again from step 1 afterwards.
+  */
+  void finish_stale(uint64_t step);
+
   /* Dump distributed domain to a series of paraview files
 
      The files are named prefixN.txt, where N is a unique number for each
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "stencil/boundary.hpp"
+#include "stencil/dim3.hpp"
+#include "stencil/memory_report.hpp"
+#include "stencil/tx_boundary.cuh"
+#include "stencil/tx_common.hpp"
+#include "stencil/tx_cuda.cuh"
+#include "stencil/tx_engine.cuh"
+
+/* The messages a DistributedDomain's subdomains send and recv in an exchange, and the method chosen for each.
+   Decided once in realize(). Every set of Transports for the domain carries the same messages
+*/
+struct ExchangePlan {
+  // outbox for same-GPU exchanges
+  std::vector<Message> peerAccessOutbox;
+
+  // outboxes for same-rank exchanges
+  // peerCopyOutboxes[di][dj] = peer copy from di to dj
+  std::vector<std::vector<std::vector<Message>>> peerCopyOutboxes;
+
+  // outbox for co-located domains in different ranks
+  // coloOutboxes[di][dstIdx] = messages
+  std::vector<std::map<Dim3, std::vector<Message>>> coloOutboxes;
+  std::vector<std::map<Dim3, std::vector<Message>>> coloInboxes;
+
+  // remoteInboxes[domain][srcIdx] = messages
+  std::vector<std::map<Dim3, std::vector<Message>>> remoteInboxes;
+  // remoteOutboxes[domain][dstIdx] = messages
+  std::vector<std::map<Dim3, std::vector<Message>>> remoteOutboxes;
+
+  // boundaryOps[di] = halo regions of domain di filled by a boundary condition or a periodic wrap onto itself
+  std::vector<std::vector<BoundaryOp>> boundaryOps;
+};
+
+/*! The senders and recvers for every message of an ExchangePlan, over one set of LocalDomains.
+
+    DistributedDomain has one for all quantities, and one for each quantity subset passed to exchange_async().
+    Each has its own communicator, so different Transports may be in flight at the same time.
+
+    tx.start();   // start every send and recv
+    tx.test();    // optionally, advance without blocking
+    tx.finish();  // block until every halo is filled
+*/
+class Transports {
+public:
+  // PeerCopySenders for same-rank exchanges
+  std::vector<std::map<size_t, PeerCopySender>> peerCopySenders_;
+
+  std::vector<std::map<Dim3, StatefulSender *>> remoteSenders_; // remoteSender_[domain][dstIdx] = sender
+  std::vector<std::map<Dim3, StatefulRecver *>> remoteRecvers_; // remoteRecver_[domain][srcIdx] = recver
+  std::vector<StatefulSender *> remoteSendOrder_;                 // remoteSenders_, in the order start() starts them
+
+  // kernel sender for same-domain sends
+  PeerAccessSender peerAccessSender_;
+
+  // kernel sender for halos no message fills
+  BoundarySender boundarySender_;
+
+  std::vector<std::map<Dim3, ColocatedHaloSender>> coloSenders_; // vec[domain][dstIdx] = sender
+  std::vector<std::map<Dim3, ColocatedHaloRecver>> coloRecvers_;
+
+  // flat view of the remote and colocated senders/recvers above, for polling
+  TxEngine engine_;
+
+  Transports() {}
+  Transports(const Transports &) = delete;
+  Transports &operator=(const Transports &) = delete;
+
+  ~Transports() {
+    for (auto &m : remoteSenders_) {
+      for (auto &kv : m) {
+        delete kv.second;
+      }
+    }
+    for (auto &m : remoteRecvers_) {
+      for (auto &kv : m) {
+        delete kv.second;
+      }
+    }
+  }
+
+  /* start every send and recv of a halo exchange
+   */
+  void start();
+
+  /* advance the exchange without blocking. true if finish() will not wait on the network
+   */
+  bool test() { return engine_.test(); }
+
+  /* block until the exchange started by start() is done
+   */
+  void finish();
+
+  /* a reverse halo exchange that adds each halo into the interior it would be filled from
+   */
+  void accumulate();
+  /* add the device buffers of every sender and recver to the "packer" and "unpacker" categories of `report`, and
+     their pinned staging to "pinned"
+  */
+  void add_memory(MemoryReport &report) const {
+    for (auto &m : peerCopySenders_) {
+      for (auto &kv : m) {
+        report.add("packer", kv.second.packer_bytes());
+        report.add("unpacker", kv.second.unpacker_bytes());
+      }
+    }
+    for (auto &m : remoteSenders_) {
+      for (auto &kv : m) {
+        report.add("packer", kv.second->device_bytes());
+        report.add("pinned", kv.second->pinned_bytes());
+      }
+    }
+    for (auto &m : remoteRecvers_) {
+      for (auto &kv : m) {
+        report.add("unpacker", kv.second->device_bytes());
+        report.add("pinned", kv.second->pinned_bytes());
+      }
+    }
+    for (auto &m : coloSenders_) {
+      for (auto &kv : m) {
+        report.add("packer", kv.second.device_bytes());
+      }
+    }
+    for (auto &m : coloRecvers_) {
+      for (auto &kv : m) {
+        report.add("unpacker", kv.second.device_bytes());
+      }
+    }
+  }
+};
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <nvToolsExt.h>
+
+#include "stencil/boundary.hpp"
+#include "stencil/copy.cuh"
+#include "stencil/cuda_runtime.hpp"
+#include "stencil/data_type.hpp"
+#include "stencil/local_domain.cuh"
+#include "stencil/logging.hpp"
+#include "stencil/pack_kernel.cuh"
+#include "stencil/rcstream.hpp"
+
+inline __device__ double boundary_load(const void *p, const DataType type) {
+  switch (type) {
+  case DataType::Float:
+    return *static_cast<const float *>(p);
+  case DataType::Double:
+    return *static_cast<const double *>(p);
+  case DataType::Int32:
+    return *static_cast<const int32_t *>(p);
+  case DataType::Int64:
+    return double(*static_cast<const int64_t *>(p));
+  case DataType::None:
+    assert(0 && "can't compute a boundary value for a quantity with no DataType");
+  }
+  return 0;
+}
+
+inline __device__ void boundary_store(void *p, const DataType type, const double v) {
+  switch (type) {
+  case DataType::Float:
+    *static_cast<float *>(p) = float(v);
+    break;
+  case DataType::Double:
+    *static_cast<double *>(p) = v;
+    break;
+  case DataType::Int32:
+    *static_cast<int32_t *>(p) = int32_t(v);
+    break;
+  case DataType::Int64:
+    *static_cast<int64_t *>(p) = int64_t(v);
+    break;
+  case DataType::None:
+    assert(0 && "can't compute a boundary value for a quantity with no DataType");
+  }
+}
+
+/* Map halo point `a` to the point its value comes from under `op`, for a domain whose interior is lo...lo+sz.
+   Returns true and sets `*dirichlet` if the point is a fixed value instead.
+   Extrapolate axes map to the interior point nearest the face, and set dist[axis] to how far past it `a` is
+*/
+inline __device__ bool boundary_source(Dim3 *src, int64_t dist[3], double *dirichlet, const Dim3 &a,
+                                       const BoundaryOp &op, const Dim3 &lo, const Dim3 &sz) {
+  *src = a;
+  for (int i = 0; i < 3; ++i) {
+    dist[i] = 0;
+    const int64_t edge = op.dir[i] > 0 ? lo[i] + sz[i] - 1 : lo[i];
+    switch (op.op[i]) {
+    case AxisOp::None:
+      break;
+    case AxisOp::Wrap:
+      (*src)[i] = a[i] - op.dir[i] * sz[i];
+      break;
+    case AxisOp::Dirichlet:
+      *dirichlet = op.value[i];
+      return true;
+    case AxisOp::Neumann:
+      (*src)[i] = 2 * edge + (op.dir[i] > 0 ? 1 : -1) - a[i];
+      break;
+    case AxisOp::Extrapolate:
+      (*src)[i] = edge;
+      dist[i] = op.dir[i] * (a[i] - edge);
+      break;
+    }
+  }
+  return false;
+}
+
+/* fill the region pos...pos+ext on side op.dir of each of n quantities according to `op`.
+   Quantity i's sizes and extent grow by staggers[i] as in staggered_extent()
+*/
+static __global__ void boundary_kernel(void *__restrict__ *__restrict__ datas, const Dim3 pos, const Dim3 ext,
+                                       const Dim3 rawSz, const Dim3 lo, const Dim3 sz, const BoundaryOp op,
+                                       const size_t *__restrict__ elemSizes, const DataType *__restrict__ types,
+                                       const Dim3 *__restrict__ staggers, const size_t n) {
+
+  const size_t tz = blockDim.z * blockIdx.z + threadIdx.z;
+  const size_t ty = blockDim.y * blockIdx.y + threadIdx.y;
+  const size_t tx = blockDim.x * blockIdx.x + threadIdx.x;
+
+  for (size_t qi = 0; qi < n; ++qi) {
+    const Dim3 qExt = staggered_extent(ext, op.dir, staggers[qi]);
+    const Dim3 qSz = rawSz + staggers[qi];
+    const size_t elemSize = elemSizes[qi];
+    char *data = static_cast<char *>(datas[qi]);
+    for (int64_t z = tz; z < qExt.z; z += blockDim.z * gridDim.z) {
+      for (int64_t y = ty; y < qExt.y; y += blockDim.y * gridDim.y) {
+        for (int64_t x = tx; x < qExt.x; x += blockDim.x * gridDim.x) {
+          const Dim3 a = pos + Dim3(x, y, z);
+          Dim3 s;
+          int64_t dist[3];
+          double v;
+          char *dst = &data[(a.z * qSz.y * qSz.x + a.y * qSz.x + a.x) * elemSize];
+          if (boundary_source(&s, dist, &v, a, op, lo, sz)) {
+            boundary_store(dst, types[qi], v);
+            continue;
+          }
+          const char *src = &data[(s.z * qSz.y * qSz.x + s.y * qSz.x + s.x) * elemSize];
+          if (0 == dist[0] && 0 == dist[1] && 0 == dist[2]) {
+            memcpy(dst, src, elemSize);
+            continue;
+          }
+          // extrapolate along each axis from the point nearest the face and the one before it
+          const double v0 = boundary_load(src, types[qi]);
+          v = v0;
+          for (int i = 0; i < 3; ++i) {
+            if (dist[i]) {
+              Dim3 s1 = s;
+              s1[i] -= op.dir[i];
+              v += dist[i] * (v0 - boundary_load(&data[(s1.z * qSz.y * qSz.x + s1.y * qSz.x + s1.x) * elemSize],
+                                                 types[qi]));
+            }
+          }
+          boundary_store(dst, types[qi], v);
+        }
+      }
+    }
+  }
+}
+
+/* add the region pos...pos+ext on side op.dir of each of n quantities into the points it was filled from by
+   boundary_kernel(). Only for ops where BoundaryOp::accumulates()
+*/
+static __global__ void boundary_accumulate_kernel(void *__restrict__ *__restrict__ datas, const Dim3 pos,
+                                                  const Dim3 ext, const Dim3 rawSz, const Dim3 lo, const Dim3 sz,
+                                                  const BoundaryOp op, const size_t *__restrict__ elemSizes,
+                                                  const DataType *__restrict__ types,
+                                                  const Dim3 *__restrict__ staggers, const size_t n) {
+
+  const size_t tz = blockDim.z * blockIdx.z + threadIdx.z;
+  const size_t ty = blockDim.y * blockIdx.y + threadIdx.y;
+  const size_t tx = blockDim.x * blockIdx.x + threadIdx.x;
+
+  for (size_t qi = 0; qi < n; ++qi) {
+    const Dim3 qExt = staggered_extent(ext, op.dir, staggers[qi]);
+    const Dim3 qSz = rawSz + staggers[qi];
+    const size_t elemSize = elemSizes[qi];
+    char *data = static_cast<char *>(datas[qi]);
+    for (int64_t z = tz; z < qExt.z; z += blockDim.z * gridDim.z) {
+      for (int64_t y = ty; y < qExt.y; y += blockDim.y * gridDim.y) {
+        for (int64_t x = tx; x < qExt.x; x += blockDim.x * gridDim.x) {
+          const Dim3 a = pos + Dim3(x, y, z);
+          Dim3 s;
+          int64_t dist[3];
+          double v;
+          boundary_source(&s, dist, &v, a, op, lo, sz);
+          atomic_accumulate(&data[(s.z * qSz.y * qSz.x + s.y * qSz.x + s.x) * elemSize],
+                            &data[(a.z * qSz.y * qSz.x + a.y * qSz.x + a.x) * elemSize], types[qi]);
+        }
+      }
+    }
+  }
+}
+
+/*! Fill the halo regions of local domains that no message fills: those beyond a face with a boundary condition, and
+    those that wrap periodically onto the domain itself.
+
+    Ops whose sources are all in the interior are launched by send_interior() alongside the other sends of an
+    exchange. Ops that read a halo filled by a message (an edge or corner past a wall, next to a neighbor) are
+    launched by send_halo() once those messages have been unpacked.
+*/
+class BoundarySender {
+private:
+  // ops_[di] = the ops for domain di
+  std::vector<std::vector<BoundaryOp>> ops_;
+
+  // one stream per device
+  std::map<int, RcStream> streams_;
+
+  std::vector<const LocalDomain *> domains_;
+
+  void launch(const LocalDomain *domain, const BoundaryOp &op, cudaStream_t stream, const bool accumulate) {
+    const Dim3 pos = domain->halo_pos(op.dir, true /*exterior*/);
+    const Dim3 lo = domain->halo_pos(Dim3(0, 0, 0), false /*interior*/);
+    const Dim3 ext = domain->halo_extent(op.dir);
+    const dim3 dimBlock = Dim3::make_block_dim(ext, 512 /*threads per block*/);
+    const dim3 dimGrid = (ext + Dim3(dimBlock) - 1) / (Dim3(dimBlock));
+    CUDA_RUNTIME(cudaSetDevice(domain->gpu()));
+    if (accumulate) {
+      boundary_accumulate_kernel<<<dimGrid, dimBlock, 0, stream>>>(
+          domain->dev_curr_datas(), pos, ext, domain->raw_size(), lo, domain->size(), op, domain->dev_elem_sizes(),
+          domain->dev_data_types(), domain->dev_staggers(), domain->num_data());
+    } else {
+      boundary_kernel<<<dimGrid, dimBlock, 0, stream>>>(domain->dev_curr_datas(), pos, ext, domain->raw_size(), lo,
+                                                        domain->size(), op, domain->dev_elem_sizes(),
+                                                        domain->dev_data_types(), domain->dev_staggers(),
+                                                        domain->num_data());
+    }
+    CUDA_RUNTIME(cudaGetLastError());
+  }
+
+public:
+  BoundarySender() {}
+
+  void prepare(const std::vector<std::vector<BoundaryOp>> &ops, const std::vector<LocalDomain> &domains) {
+    assert(ops.size() == domains.size());
+    ops_ = ops;
+    for (auto &e : domains) {
+      domains_.push_back(&e);
+    }
+    for (size_t di = 0; di < ops_.size(); ++di) {
+      if (!ops_[di].empty()) {
+        const int dev = domains_[di]->gpu();
+        streams_.emplace(dev, RcStream(dev, RcStream::Priority::HIGH));
+      }
+    }
+  }
+
+  bool empty() const noexcept { return streams_.empty(); }
+
+  /* launch the ops that only read the interior
+   */
+  void send_interior() {
+    nvtxRangePush("BoundarySender::send_interior");
+    for (size_t di = 0; di < ops_.size(); ++di) {
+      for (const BoundaryOp &op : ops_[di]) {
+        if (op.reads_interior()) {
+          launch(domains_[di], op, streams_[domains_[di]->gpu()], false);
+        }
+      }
+    }
+    nvtxRangePop(); // BoundarySender::send_interior
+  }
+
+  /* launch the ops that read halos filled by messages. Only once those halos are filled
+   */
+  void send_halo() {
+    nvtxRangePush("BoundarySender::send_halo");
+    for (size_t di = 0; di < ops_.size(); ++di) {
+      for (const BoundaryOp &op : ops_[di]) {
+        if (!op.reads_interior()) {
+          launch(domains_[di], op, streams_[domains_[di]->gpu()], false);
+        }
+      }
+    }
+    nvtxRangePop(); // BoundarySender::send_halo
+  }
+
+  /* launch every op of domain `di` in `stream`, interior ops first. Only once di's halos from messages are filled
+   */
+  void send(size_t di, cudaStream_t stream) {
+    nvtxRangePush("BoundarySender::send(di)");
+    for (const BoundaryOp &op : ops_[di]) {
+      if (op.reads_interior()) {
+        launch(domains_[di], op, stream, false);
+      }
+    }
+    for (const BoundaryOp &op : ops_[di]) {
+      if (!op.reads_interior()) {
+        launch(domains_[di], op, stream, false);
+      }
+    }
+    nvtxRangePop(); // BoundarySender::send(di)
+  }
+
+  /* add the halo regions filled by copies (periodic self-wrap and Neumann) back into the points they were copied
+     from. Regions with a Dirichlet or extrapolated axis have no source to add into and are left alone
+  */
+  void send_accumulate() {
+    nvtxRangePush("BoundarySender::send_accumulate");
+    for (size_t di = 0; di < ops_.size(); ++di) {
+      for (const BoundaryOp &op : ops_[di]) {
+        if (op.accumulates()) {
+          launch(domains_[di], op, streams_[domains_[di]->gpu()], true);
+        }
+      }
+    }
+    nvtxRangePop(); // BoundarySender::send_accumulate
+  }
+
+  void wait() {
+    for (auto &kv : streams_) {
+      CUDA_RUNTIME(cudaSetDevice(kv.second.device()));
+      CUDA_RUNTIME(cudaStreamSynchronize(kv.second));
+    }
+  }
+};
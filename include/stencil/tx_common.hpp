@@ -2,7 +2,10 @@
 
 #include "stencil/dim3.hpp"
 
+#include <cassert>
 #include <climits>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 
 class Message {
@@ -21,45 +24,50 @@ public:
 };
 
 enum class MsgKind {
-  ColocatedEvt = 0,
+  ColocatedEvt = 0, // ColocatedSetup record kinds, exchanged by exchange_setup() rather than tagged
   ColocatedMem = 1,
-  ColocatedDev = 2,
+  ColocatedDev = 2, // unused
   ColocatedNotify = 3,
-  Other = 4,
+  Remote = 4,           // RemoteSender / CudaAwareMpiSender halo
+  RemoteAccumulate = 5, // halo sent back in an accumulating exchange
+  Other = 6,
+  Particle = 7, // particle migration, see particle_tag()
 };
 
+/* bits used for a subdomain id in a tag: the most subdomains a rank may have is 1 << SUBDOMAIN_BITS
+ */
+constexpr int SUBDOMAIN_BITS = 10;
+constexpr int MAX_RANK_SUBDOMAINS = 1 << SUBDOMAIN_BITS;
+
+/* the largest tag make_tag<MsgKind> will produce
+ */
+constexpr int MAX_MSG_KIND_TAG = (1 << (3 + 2 * SUBDOMAIN_BITS)) - 1;
+
+/* a tag payload naming the subdomain pair of a message.
+   Between a pair of ranks, each ordered pair of subdomains has at most one message of each kind
+*/
+inline int subdomain_pair(const int srcGPU, const int dstGPU) {
+  assert(srcGPU >= 0 && srcGPU < MAX_RANK_SUBDOMAINS);
+  assert(dstGPU >= 0 && dstGPU < MAX_RANK_SUBDOMAINS);
+  return (srcGPU << SUBDOMAIN_BITS) | dstGPU;
+}
+
 /*!
   Construct an MPI tag.
   We have observed systems where the max tag value is 1 << 23, so we only use
   23 bits here.
+
+  bits 0-2 encode message kind
+  bits 3-22 are the payload, usually subdomain_pair()
 */
-template <MsgKind kind>
-inline int make_tag(const int payload, const Dim3 dir = Dim3(0, 0, 0)) {
-  int ret = 0;
+template <MsgKind kind> inline int make_tag(const int payload) {
+  static_assert(static_cast<int>(kind) >= 0b000 && static_cast<int>(kind) <= 0b111, "kind needs more than 3 bits");
+  assert(payload >= 0 && payload < (1 << (2 * SUBDOMAIN_BITS)));
 
   // bit 31 is 0
-
-  // bits 0-1 encode message kind
-  int kindInt = static_cast<int>(kind);
-  assert(kindInt <= 0b11);
-  assert(kindInt >= 0b00);
-  ret |= kindInt;
-
-  // bits 2-7 encode direction vector
-  assert(dir.x >= -1 && dir.x <= 1);
-  assert(dir.y >= -1 && dir.y <= 1);
-  assert(dir.z >= -1 && dir.z <= 1);
-  int dirBits = 0;
-  dirBits |= dir.x == 0 ? 0b00 : (dir.x == 1 ? 0b01 : 0b10);
-  dirBits |= (dir.y == 0 ? 0b00 : (dir.y == 1 ? 0b01 : 0b10)) << 2;
-  dirBits |= (dir.z == 0 ? 0b00 : (dir.z == 1 ? 0b01 : 0b10)) << 4;
-  ret |= (dirBits << 2);
-
-  // bits 8-23 are the payload
-  assert(payload < (1 << 16));
-  ret |= (payload & 0xFFFF) << 8;
-
+  const int ret = static_cast<int>(kind) | (payload << 3);
   assert(ret >= 0);
+  assert(ret <= MAX_MSG_KIND_TAG);
   return ret;
 }
 
@@ -109,6 +117,33 @@ inline int make_tag(int gpu, int idx, Dim3 dir) {
   return t;
 }
 
+/* default chunk size of a host-staged remote message.
+   Large enough that per-chunk MPI overhead is small, small enough that a large face has several chunks to pipeline
+*/
+constexpr size_t REMOTE_CHUNK_BYTES = size_t(1) << 20;
+
+/* the number of chunks of at most `chunkBytes` in a `bytes`-size message. 0 chunkBytes means one chunk
+ */
+inline size_t num_chunks(const size_t bytes, const size_t chunkBytes) {
+  if (0 == bytes) {
+    return 0;
+  } else if (0 == chunkBytes) {
+    return 1;
+  }
+  return (bytes + chunkBytes - 1) / chunkBytes;
+}
+
+/* the size of chunk i of a `bytes`-size message
+ */
+inline size_t chunk_size(const size_t i, const size_t bytes, const size_t chunkBytes) {
+  assert(i < num_chunks(bytes, chunkBytes));
+  if (0 == chunkBytes) {
+    return bytes;
+  }
+  const size_t off = i * chunkBytes;
+  return bytes - off < chunkBytes ? bytes - off : chunkBytes;
+}
+
 /*! a sender that has multiple phases
     sender->send();
     while(sender->active()) {
@@ -143,6 +178,25 @@ public:
   */
   virtual void wait() = 0;
 
+  /*! start an accumulating (reverse) exchange: recv the halo regions the
+      recver would have unpacked into and add them to the domain.
+      Continue with active() / next_ready() / next() / wait() as with send()
+  */
+  virtual void recv_accumulate() = 0;
+
+  /*! bytes sent by send(), after prepare()
+   */
+  virtual int64_t bytes() = 0;
+
+  /*! the rank send() sends to
+   */
+  virtual int dst_rank() const noexcept = 0;
+
+  /*! device bytes of the packed buffer and host bytes of pinned staging allocated by prepare()
+   */
+  virtual int64_t device_bytes() const noexcept { return 0; }
+  virtual int64_t pinned_bytes() const noexcept { return 0; }
+
   virtual ~StatefulSender() {}
 };
 
@@ -173,5 +227,16 @@ public:
   */
   virtual void wait() = 0;
 
+  /*! start an accumulating (reverse) exchange: send the halo regions recv()
+      would have unpacked into back to the sender.
+      Continue with active() / next_ready() / next() / wait() as with recv()
+  */
+  virtual void send_halo() = 0;
+
+  /*! device bytes of the packed buffer and host bytes of pinned staging allocated by prepare()
+   */
+  virtual int64_t device_bytes() const noexcept { return 0; }
+  virtual int64_t pinned_bytes() const noexcept { return 0; }
+
   virtual ~StatefulRecver() {}
 };
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <functional>
 #include <future>
 #include <iomanip>
 #include <map>
 #include <sstream>
+#include <vector>
 
 #include <mpi.h>
 
@@ -65,11 +67,61 @@ public:
     }
   }
 
+  /* translate one message with a kernel in `stream`, which is on the source device
+   */
+  void launch(const Message &msg, cudaStream_t stream) {
+    const LocalDomain *srcDomain = domains_[msg.srcGPU_];
+    const LocalDomain *dstDomain = domains_[msg.dstGPU_];
+    const Dim3 dstSz = dstDomain->raw_size();
+    const Dim3 srcSz = srcDomain->raw_size();
+    const Dim3 srcPos = srcDomain->halo_pos(msg.dir_, false /*interior*/);
+    const Dim3 dstPos = dstDomain->halo_pos(msg.dir_ * -1, true /*exterior*/);
+    // send +x means recv into -x halo
+    const Dim3 extent = srcDomain->halo_extent(msg.dir_ * -1);
+    const dim3 dimBlock = Dim3::make_block_dim(extent, 512 /*threads per block*/);
+    const dim3 dimGrid = (extent + Dim3(dimBlock) - 1) / (Dim3(dimBlock));
+    CUDA_RUNTIME(cudaSetDevice(srcDomain->gpu()));
+    assert(srcDomain->num_data() == dstDomain->num_data());
+    LOG_SPEW("grid=" << dimGrid << " block=" << dimBlock);
+    multi_translate<<<dimGrid, dimBlock, 0, stream>>>(
+        dstDomain->dev_curr_datas(), dstPos, dstSz, srcDomain->dev_curr_datas(), srcPos, srcSz, extent,
+        srcDomain->dev_elem_sizes(), srcDomain->dev_staggers(), msg.dir_ * -1, srcDomain->num_data());
+    CUDA_RUNTIME(cudaGetLastError());
+  }
+
   void send() {
 
     nvtxRangePush("PeerSender::send");
 
     // translate data with kernel
+    for (auto &msg : outbox_) {
+      RcStream &stream = streams_[domains_[msg.srcGPU_]->gpu()];
+      assert(stream.device() == domains_[msg.srcGPU_]->gpu());
+      launch(msg, stream);
+    }
+
+    nvtxRangePop(); // PeerSender::send
+  }
+
+  /* send only the messages from domain `srcGPU` to domain `dstGPU`, in `stream`.
+     Lets the thread that owns dstGPU pull its halos without touching other domains' messages.
+  */
+  void send(size_t srcGPU, size_t dstGPU, cudaStream_t stream) {
+    nvtxRangePush("PeerSender::send(src, dst)");
+    for (auto &msg : outbox_) {
+      if (size_t(msg.srcGPU_) == srcGPU && size_t(msg.dstGPU_) == dstGPU) {
+        launch(msg, stream);
+      }
+    }
+    nvtxRangePop(); // PeerSender::send(src, dst)
+  }
+
+  /* add the halo regions filled by send() back into the interiors they were copied from
+   */
+  void send_accumulate() {
+
+    nvtxRangePush("PeerSender::send_accumulate");
+
     for (auto &msg : outbox_) {
       const LocalDomain *srcDomain = domains_[msg.srcGPU_];
       const LocalDomain *dstDomain = domains_[msg.dstGPU_];
@@ -77,21 +129,22 @@ public:
       const Dim3 srcSz = srcDomain->raw_size();
       const Dim3 srcPos = srcDomain->halo_pos(msg.dir_, false /*interior*/);
       const Dim3 dstPos = dstDomain->halo_pos(msg.dir_ * -1, true /*exterior*/);
-      const Dim3 extent = srcDomain->halo_extent(msg.dir_);
+      const Dim3 extent = srcDomain->halo_extent(msg.dir_ * -1);
       RcStream &stream = streams_[srcDomain->gpu()];
       const dim3 dimBlock = Dim3::make_block_dim(extent, 512 /*threads per block*/);
       const dim3 dimGrid = (extent + Dim3(dimBlock) - 1) / (Dim3(dimBlock));
       assert(stream.device() == srcDomain->gpu());
       CUDA_RUNTIME(cudaSetDevice(stream.device()));
       assert(srcDomain->num_data() == dstDomain->num_data());
-      LOG_SPEW("grid=" << dimGrid << " block=" << dimBlock);
-      multi_translate<<<dimGrid, dimBlock, 0, stream>>>(dstDomain->dev_curr_datas(), dstPos, dstSz,
-                                                        srcDomain->dev_curr_datas(), srcPos, srcSz, extent,
-                                                        srcDomain->dev_elem_sizes(), srcDomain->num_data());
+      multi_accumulate<<<dimGrid, dimBlock, 0, stream>>>(srcDomain->dev_curr_datas(), srcPos, srcSz,
+                                                         dstDomain->dev_curr_datas(), dstPos, dstSz, extent,
+                                                         srcDomain->dev_elem_sizes(), srcDomain->dev_data_types(),
+                                                         srcDomain->dev_staggers(), msg.dir_ * -1,
+                                                         srcDomain->num_data());
       CUDA_RUNTIME(cudaGetLastError());
     }
 
-    nvtxRangePop(); // PeerSender::send
+    nvtxRangePop(); // PeerSender::send_accumulate
   }
 
   void wait() {
@@ -118,6 +171,8 @@ private:
 
   // event to sync src and dst streams
   cudaEvent_t event_;
+  // event to sync dst and src streams in send_accumulate()
+  cudaEvent_t revEvent_;
 
   // packed buffers
   DevicePacker packer_;
@@ -133,11 +188,16 @@ public:
     packer_.prepare(srcDomain_, outbox);
     unpacker_.prepare(dstDomain_, outbox);
 
-    // create event
+    // create events
     CUDA_RUNTIME(cudaSetDevice(srcDomain_->gpu()));
     CUDA_RUNTIME(cudaEventCreate(&event_));
+    CUDA_RUNTIME(cudaSetDevice(dstDomain_->gpu()));
+    CUDA_RUNTIME(cudaEventCreate(&revEvent_));
   }
 
+  int64_t packer_bytes() const noexcept { return packer_.allocated_bytes(); }
+  int64_t unpacker_bytes() const noexcept { return unpacker_.allocated_bytes(); }
+
   void send() {
     nvtxRangePush("PeerCopySender::send");
     assert(packer_.data());
@@ -161,6 +221,29 @@ public:
     nvtxRangePop(); // PeerCopySender::send
   }
 
+  /* pack the dst halos, copy them back to the src device, and add them into the src domain
+   */
+  void send_accumulate() {
+    nvtxRangePush("PeerCopySender::send_accumulate");
+    assert(packer_.size() == unpacker_.size());
+
+    // pack halos in destination stream
+    unpacker_.pack_halo();
+
+    // copy from dst device to src device
+    const int dstDev = dstDomain_->gpu();
+    const int srcDev = srcDomain_->gpu();
+    CUDA_RUNTIME(cudaMemcpyPeerAsync(packer_.data(), srcDev, unpacker_.data(), dstDev, unpacker_.size(), dstStream_));
+
+    // sync dst and src streams
+    CUDA_RUNTIME(cudaEventRecord(revEvent_, dstStream_));
+    CUDA_RUNTIME(cudaSetDevice(srcDev));
+    CUDA_RUNTIME(cudaStreamWaitEvent(srcStream_, revEvent_, 0 /*flags*/));
+
+    packer_.accumulate();
+    nvtxRangePop(); // PeerCopySender::send_accumulate
+  }
+
   void wait() {
     CUDA_RUNTIME(cudaSetDevice(srcStream_.device()));
     CUDA_RUNTIME(cudaStreamSynchronize(srcStream_));
@@ -169,6 +252,67 @@ public:
   }
 };
 
+/* The setup metadata one side of a colocated pair gives the other.
+   Every pair's records are exchanged at once by exchange_setup(), instead of a handshake per pair
+*/
+struct ColocatedSetup {
+  MsgKind kind; // ColocatedEvt from a ColocatedDeviceSender, ColocatedMem from a ColocatedDeviceRecver
+  int pair;     // subdomain_pair(srcGPU, dstGPU)
+  int dev;      // the recver's CUDA id, for ColocatedMem
+  cudaIpcEventHandle_t evtHandle;
+  cudaIpcMemHandle_t memHandle;
+};
+
+/* the record of `kind` for `pair` in `records`
+ */
+inline const ColocatedSetup &find_setup(const std::vector<ColocatedSetup> &records, const MsgKind kind,
+                                        const int pair) {
+  for (const ColocatedSetup &r : records) {
+    if (kind == r.kind && pair == r.pair) {
+      return r;
+    }
+  }
+  LOG_FATAL("no colocated setup record of kind " << int(kind) << " for subdomain pair " << pair);
+}
+
+/* Send out[r] to rank r and recv in[r] from rank r, for every neighbor rank r, in one MPI_Neighbor_alltoallv.
+   in[r] must already be sized to the number of records r sends. Collective over `comm`
+*/
+inline void exchange_setup(std::map<int, std::vector<ColocatedSetup>> &in,
+                           const std::map<int, std::vector<ColocatedSetup>> &out, MPI_Comm comm) {
+  nvtxRangePush("exchange_setup");
+  std::vector<int> sources, recvCounts, recvDispls;
+  std::vector<int> dests, sendCounts, sendDispls;
+  std::vector<ColocatedSetup> recvBuf, sendBuf;
+  for (auto &kv : in) {
+    sources.push_back(kv.first);
+    recvDispls.push_back(int(recvBuf.size() * sizeof(ColocatedSetup)));
+    recvCounts.push_back(int(kv.second.size() * sizeof(ColocatedSetup)));
+    recvBuf.resize(recvBuf.size() + kv.second.size());
+  }
+  for (auto &kv : out) {
+    dests.push_back(kv.first);
+    sendDispls.push_back(int(sendBuf.size() * sizeof(ColocatedSetup)));
+    sendCounts.push_back(int(kv.second.size() * sizeof(ColocatedSetup)));
+    sendBuf.insert(sendBuf.end(), kv.second.begin(), kv.second.end());
+  }
+
+  // a graph of only the ranks this one has records for
+  MPI_Comm graph;
+  MPI_Dist_graph_create_adjacent(comm, int(sources.size()), sources.data(), MPI_UNWEIGHTED, int(dests.size()),
+                                 dests.data(), MPI_UNWEIGHTED, MPI_INFO_NULL, 0 /*reorder*/, &graph);
+  MPI_Neighbor_alltoallv(sendBuf.data(), sendCounts.data(), sendDispls.data(), MPI_BYTE, recvBuf.data(),
+                         recvCounts.data(), recvDispls.data(), MPI_BYTE, graph);
+  MPI_Comm_free(&graph);
+
+  size_t off = 0;
+  for (auto &kv : in) {
+    std::copy(recvBuf.begin() + off, recvBuf.begin() + off + kv.second.size(), kv.second.begin());
+    off += kv.second.size();
+  }
+  nvtxRangePop(); // exchange_setup
+}
+
 /*! Send data between CUDA devices in colocated ranks
     Issue copy, then record event, then send a message notifying recver that event was recorded
  */
@@ -189,31 +333,22 @@ private:
   cudaIpcMemHandle_t memHandle_;
   cudaIpcEventHandle_t evtHandle_;
 
-  MPI_Request evtReq_;
-  MPI_Request memReq_;
-  MPI_Request idReq_;
   MPI_Request notifyReq_; // notify the ColocatedHaloRecver that we have recorded the event
+  MPI_Request revReq_;    // notified by the recver that it has recorded the event in an accumulating exchange
+
+  MPI_Comm comm_;
 
-  int tagUb_; // largest tag value, if positive
-  char junk_; // one byte of junk to notify the recver
+  char junk_;    // one byte of junk to notify the recver
+  char revJunk_; // one byte of junk to be notified by the recver
 
 public:
-  ColocatedDeviceSender() : dstBuf_(nullptr), event_(0) {}
+  ColocatedDeviceSender() : dstBuf_(nullptr), event_(0), comm_(MPI_COMM_NULL) {}
   ColocatedDeviceSender(int srcRank, int srcGPU, // domain ID
                         int dstRank, int dstGPU, // domain ID
-                        int srcDev)              // cuda ID
+                        int srcDev,              // cuda ID
+                        MPI_Comm comm)
       : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), srcDev_(srcDev), dstBuf_(nullptr),
-        bufSize_(0), event_(0) {
-
-    int tag_ub = -1;
-    int flag;
-    int *tag_ub_ptr;
-    MPI_Comm_get_attr(MPI_COMM_WORLD, MPI_TAG_UB, &tag_ub_ptr, &flag);
-    assert(flag);
-    if (flag)
-      tag_ub = *tag_ub_ptr;
-    tagUb_ = tag_ub;
-  }
+        bufSize_(0), event_(0), comm_(comm) {}
 
   ~ColocatedDeviceSender() {
     if (dstBuf_) {
@@ -226,8 +361,13 @@ public:
     }
   }
 
-  int payload() const noexcept { return ((srcGPU_ & 0xFF) << 8) | (dstGPU_ & 0xFF); }
+  int payload() const noexcept { return subdomain_pair(srcGPU_, dstGPU_); }
+
+  int dst_rank() const noexcept { return dstRank_; }
 
+  /* create the event the recver will wait on. Then send setup() to the recver, and pass its setup() to
+     finish_prepare()
+  */
   void start_prepare(size_t numBytes) {
 
     // create an event and associated handle
@@ -235,36 +375,29 @@ public:
     CUDA_RUNTIME(cudaEventCreate(&event_, cudaEventInterprocess | cudaEventDisableTiming));
     CUDA_RUNTIME(cudaIpcGetEventHandle(&evtHandle_, event_));
 
-    // send the event handle
-    MPI_Isend(&evtHandle_, sizeof(evtHandle_), MPI_BYTE, dstRank_, make_tag<MsgKind::ColocatedEvt>(payload()),
-              MPI_COMM_WORLD, &evtReq_);
-
-    // Recieve the IPC mem handle
-    const int memHandleTag = make_tag<MsgKind::ColocatedMem>(payload());
-    assert(memHandleTag < tagUb_);
-    MPI_Irecv(&memHandle_, sizeof(memHandle_), MPI_BYTE, dstRank_, memHandleTag, MPI_COMM_WORLD, &memReq_);
-    // Retrieve the destination device id
-    const int devTag = make_tag<MsgKind::ColocatedDev>(payload());
-    assert(devTag < tagUb_);
-    MPI_Irecv(&dstDev_, 1, MPI_INT, dstRank_, devTag, MPI_COMM_WORLD, &idReq_);
-
     // compute the required buffer size
     bufSize_ = numBytes;
   }
 
-  void finish_prepare() {
-    // block until we have recved the device ID
-    MPI_Wait(&idReq_, MPI_STATUS_IGNORE);
+  ColocatedSetup setup() const noexcept {
+    ColocatedSetup ret{};
+    ret.kind = MsgKind::ColocatedEvt;
+    ret.pair = payload();
+    ret.evtHandle = evtHandle_;
+    return ret;
+  }
 
-    // wait for recv mem handle
-    MPI_Wait(&memReq_, MPI_STATUS_IGNORE);
+  /* open the recver's buffer from its setup()
+   */
+  void finish_prepare(const ColocatedSetup &recver) {
+    assert(MsgKind::ColocatedMem == recver.kind);
+    assert(payload() == recver.pair);
+    dstDev_ = recver.dev;
+    memHandle_ = recver.memHandle;
 
     // convert to a pointer
     CUDA_RUNTIME(cudaSetDevice(srcDev_));
     CUDA_RUNTIME(cudaIpcOpenMemHandle(&dstBuf_, memHandle_, cudaIpcMemLazyEnablePeerAccess));
-
-    // block until we have sent event handle
-    MPI_Wait(&evtReq_, MPI_STATUS_IGNORE);
   }
 
   void send(const void *devPtr, RcStream &stream) {
@@ -278,7 +411,7 @@ public:
     CUDA_RUNTIME(cudaMemcpyPeerAsync(dstBuf_, dstDev_, devPtr, srcDev_, bufSize_, stream));
     // record the event
     CUDA_RUNTIME(cudaEventRecord(event_, stream));
-    MPI_Isend(&junk_, 1, MPI_BYTE, dstRank_, make_tag<MsgKind::ColocatedNotify>(payload()), MPI_COMM_WORLD,
+    MPI_Isend(&junk_, 1, MPI_BYTE, dstRank_, make_tag<MsgKind::ColocatedNotify>(payload()), comm_,
               &notifyReq_);
   }
 
@@ -286,6 +419,35 @@ public:
     CUDA_RUNTIME(cudaSetDevice(srcDev_));
     CUDA_RUNTIME(cudaEventSynchronize(event_));
   }
+
+  /* In an accumulating exchange, the recver fills its buffer, records the event, and notifies us.
+     The notification has the same tag as the forward one, but travels the other way between the ranks.
+     Forward notifications have all been recved by the time a reverse one can be sent.
+  */
+  void start_recv_reverse() {
+    MPI_Irecv(&revJunk_, 1, MPI_BYTE, dstRank_, make_tag<MsgKind::ColocatedNotify>(payload()), comm_, &revReq_);
+  }
+
+  bool recv_reverse_ready() {
+    int flag;
+    MPI_Test(&revReq_, &flag, MPI_STATUS_IGNORE);
+    return flag;
+  }
+
+  /* the request recv_reverse_ready() tests
+   */
+  MPI_Request *reverse_request() noexcept { return &revReq_; }
+
+  /* copy the recver's buffer to devPtr in stream, once the recver's event is done
+   */
+  void recv_reverse(void *devPtr, RcStream &stream) {
+    assert(srcDev_ == stream.device());
+    assert(dstBuf_);
+    assert(devPtr);
+    CUDA_RUNTIME(cudaSetDevice(srcDev_));
+    CUDA_RUNTIME(cudaStreamWaitEvent(stream, event_, 0 /*flags*/));
+    CUDA_RUNTIME(cudaMemcpyPeerAsync(devPtr, srcDev_, dstBuf_, dstDev_, bufSize_, stream));
+  }
 };
 
 class ColocatedDeviceRecver {
@@ -300,59 +462,57 @@ private:
 
   cudaIpcMemHandle_t memHandle_;
   cudaIpcEventHandle_t evtHandle_;
-  MPI_Request memReq_;
-  MPI_Request idReq_;
-  MPI_Request evtReq_;
+  MPI_Request revReq_; // notify the sender that we have recorded the event in an accumulating exchange
+
+  MPI_Comm comm_;
+
+  char junk_; // one byte of junk to notify the sender
 
 public:
-  ColocatedDeviceRecver() : event_(0) {}
+  ColocatedDeviceRecver() : event_(0), revReq_(MPI_REQUEST_NULL), comm_(MPI_COMM_NULL) {}
   ColocatedDeviceRecver(int srcRank, int srcGPU, int dstRank,
                         int dstGPU, // domain ID
-                        int dstDev  // cuda ID
-                        )
-      : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), dstDev_(dstDev), event_(0) {}
+                        int dstDev, // cuda ID
+                        MPI_Comm comm)
+      : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), dstDev_(dstDev), event_(0),
+        revReq_(MPI_REQUEST_NULL), comm_(comm) {}
   ~ColocatedDeviceRecver() {
     if (event_) {
       CUDA_RUNTIME(cudaEventDestroy(event_));
     }
   }
 
-  /*! prepare to recieve devPtr
+  int src_rank() const noexcept { return srcRank_; }
+
+  /*! prepare to recieve devPtr. Then send setup() to the sender, and pass its setup() to finish_prepare()
    */
   void start_prepare(void *devPtr) {
-    // fprintf(stderr, "ColoDevRecv::start_prepare: send mem on %d(%d) to
-    // r%dg%d\n", dstDev_, dstGPU_, srcRank_, srcGPU_);
     assert(devPtr);
 
-    int payload = ((srcGPU_ & 0xFF) << 8) | (dstGPU_ & 0xFF);
-
-    // recv the event handle
-    MPI_Irecv(&evtHandle_, sizeof(evtHandle_), MPI_BYTE, srcRank_, make_tag<MsgKind::ColocatedEvt>(payload),
-              MPI_COMM_WORLD, &evtReq_);
-
     // get an a memory handle
     CUDA_RUNTIME(cudaSetDevice(dstDev_));
     CUDA_RUNTIME(cudaIpcGetMemHandle(&memHandle_, devPtr));
-
-    // Send the mem handle to the ColocatedSender
-    MPI_Isend(&memHandle_, sizeof(memHandle_), MPI_BYTE, srcRank_, make_tag<MsgKind::ColocatedMem>(payload),
-              MPI_COMM_WORLD, &memReq_);
-    // Send the CUDA device id to the ColocatedSender
-    MPI_Isend(&dstDev_, 1, MPI_INT, srcRank_, make_tag<MsgKind::ColocatedDev>(payload), MPI_COMM_WORLD, &idReq_);
   }
 
-  void finish_prepare() {
+  ColocatedSetup setup() const noexcept {
+    ColocatedSetup ret{};
+    ret.kind = MsgKind::ColocatedMem;
+    ret.pair = subdomain_pair(srcGPU_, dstGPU_);
+    ret.dev = dstDev_;
+    ret.memHandle = memHandle_;
+    return ret;
+  }
 
-    // wait to recv the event
-    MPI_Wait(&evtReq_, MPI_STATUS_IGNORE);
+  /* open the sender's event from its setup()
+   */
+  void finish_prepare(const ColocatedSetup &sender) {
+    assert(MsgKind::ColocatedEvt == sender.kind);
+    assert(subdomain_pair(srcGPU_, dstGPU_) == sender.pair);
+    evtHandle_ = sender.evtHandle;
 
     // convert event handle to event
     CUDA_RUNTIME(cudaSetDevice(dstDev_));
     CUDA_RUNTIME(cudaIpcOpenEventHandle(&event_, evtHandle_));
-
-    // wait to send the mem handle and the CUDA device ID
-    MPI_Wait(&memReq_, MPI_STATUS_IGNORE);
-    MPI_Wait(&idReq_, MPI_STATUS_IGNORE);
   }
 
   /*! have stream wait for data to arrive
@@ -370,6 +530,24 @@ public:
     // wait for ColocatedDeviceSender cudaMemcpyPeerAsync to be done
     CUDA_RUNTIME(cudaStreamWaitEvent(stream, event_, 0 /*flags*/));
   }
+
+  /*! notify the sender that our buffer will be ready once the work in stream is done.
+      Used in an accumulating exchange, where the sender copies out of our buffer.
+      The notice is outstanding until wait_reverse()
+   */
+  void send_reverse(RcStream &stream) {
+    assert(event_);
+    assert(MPI_REQUEST_NULL == revReq_);
+    assert(stream.device() == dstDev_);
+    CUDA_RUNTIME(cudaSetDevice(dstDev_));
+    CUDA_RUNTIME(cudaEventRecord(event_, stream));
+    const int payload = subdomain_pair(srcGPU_, dstGPU_);
+    MPI_Isend(&junk_, 1, MPI_BYTE, srcRank_, make_tag<MsgKind::ColocatedNotify>(payload), comm_, &revReq_);
+  }
+
+  /* complete the notice from send_reverse(), if any
+   */
+  void wait_reverse() { MPI_Wait(&revReq_, MPI_STATUS_IGNORE); }
 };
 
 /* For colocated, either the sender or reciever has to be stateful.
@@ -393,27 +571,73 @@ private:
   DevicePacker packer_;
   ColocatedDeviceSender sender_;
 
+  /* NONE: send() is stateless
+     WAIT_NOTIFY: waiting for the recver to pack its halo in an accumulating exchange
+     WAIT_ACCUMULATE: waiting on copy and accumulate
+  */
+  enum class State { NONE, WAIT_NOTIFY, WAIT_ACCUMULATE };
+  State state_;
+
 public:
-  ColocatedHaloSender(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain)
+  ColocatedHaloSender(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain, MPI_Comm comm)
       : domain_(&domain), stream_(domain.gpu(), RcStream::Priority::HIGH), packer_(stream_),
-        sender_(srcRank, srcGPU, dstRank, dstGPU, domain.gpu()) {}
+        sender_(srcRank, srcGPU, dstRank, dstGPU, domain.gpu(), comm), state_(State::NONE) {}
 
   void start_prepare(const std::vector<Message> &outbox) {
     packer_.prepare(domain_, outbox);
     if (0 == packer_.size()) {
-      std::cerr << "WARN: 0-size ColocatedHaloSender was created\n";
+      LOG_WARN("0-size ColocatedHaloSender was created");
     }
     sender_.start_prepare(packer_.size());
   }
 
-  void finish_prepare() { sender_.finish_prepare(); }
+  int dst_rank() const noexcept { return sender_.dst_rank(); }
+  int64_t device_bytes() const noexcept { return packer_.allocated_bytes(); }
+  ColocatedSetup setup() const noexcept { return sender_.setup(); }
+  void finish_prepare(const ColocatedSetup &recver) { sender_.finish_prepare(recver); }
 
   void send() noexcept {
     packer_.pack();
     sender_.send(packer_.data(), stream_);
   }
 
-  void wait() noexcept { sender_.wait(); }
+  void wait() noexcept {
+    if (State::WAIT_ACCUMULATE == state_) {
+      CUDA_RUNTIME(cudaSetDevice(stream_.device()));
+      CUDA_RUNTIME(cudaStreamSynchronize(stream_));
+      state_ = State::NONE;
+    } else {
+      sender_.wait();
+    }
+  }
+
+  /* start an accumulating exchange.
+     Continue with active() / next_ready() / next() / wait()
+  */
+  void recv_accumulate() {
+    assert(State::NONE == state_);
+    state_ = State::WAIT_NOTIFY;
+    sender_.start_recv_reverse();
+  }
+
+  bool active() { return State::WAIT_NOTIFY == state_; }
+
+  bool next_ready() {
+    assert(State::WAIT_NOTIFY == state_);
+    return sender_.recv_reverse_ready();
+  }
+
+  /* the request the active state is waiting on
+   */
+  MPI_Request *active_request() noexcept { return sender_.reverse_request(); }
+
+  void next() {
+    if (State::WAIT_NOTIFY == state_) {
+      state_ = State::WAIT_ACCUMULATE;
+      sender_.recv_reverse(packer_.data(), stream_);
+      packer_.accumulate();
+    }
+  }
 };
 
 /* The receiver is stateful because it can't start to wait on the
@@ -432,6 +656,7 @@ private:
   RcStream stream_;
 
   MPI_Request notifyReq_;
+  MPI_Comm comm_;
 
   ColocatedDeviceRecver recver_;
   DeviceUnpacker unpacker_;
@@ -439,35 +664,39 @@ private:
   /* NONE: ready to recv
      WAIT_NOTIFY: waiting on Irecv from ColocatedHaloSender
      WAIT_COPY: waiting on copy
-
+     WAIT_HALO: waiting on halo pack in an accumulating exchange
   */
-  enum class State { NONE, WAIT_NOTIFY, WAIT_COPY };
+  enum class State { NONE, WAIT_NOTIFY, WAIT_COPY, WAIT_HALO };
   State state_;
 
   char junk_; // to recv data into
 
 public:
-  ColocatedHaloRecver(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain)
+  ColocatedHaloRecver(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain, MPI_Comm comm)
       : srcRank_(srcRank), srcGPU_(srcGPU), dstGPU_(dstGPU), domain_(&domain),
-        stream_(domain.gpu(), RcStream::Priority::HIGH), recver_(srcRank, srcGPU, dstRank, dstGPU, domain.gpu()),
-        unpacker_(stream_), state_(State::NONE) {}
+        stream_(domain.gpu(), RcStream::Priority::HIGH), comm_(comm),
+        recver_(srcRank, srcGPU, dstRank, dstGPU, domain.gpu(), comm), unpacker_(stream_), state_(State::NONE) {}
 
   void start_prepare(const std::vector<Message> &inbox) {
     unpacker_.prepare(domain_, inbox);
     if (0 == unpacker_.size()) {
-      std::cerr << "WARN: a 0-size ColocatedHaloRecver was created\n";
+      LOG_WARN("a 0-size ColocatedHaloRecver was created");
     }
     recver_.start_prepare(unpacker_.data());
   }
 
-  void finish_prepare() { recver_.finish_prepare(); }
+  int src_rank() const noexcept { return srcRank_; }
+  int64_t device_bytes() const noexcept { return unpacker_.allocated_bytes(); }
+  ColocatedSetup setup() const noexcept { return recver_.setup(); }
+  void finish_prepare(const ColocatedSetup &sender) { recver_.finish_prepare(sender); }
 
   void recv() {
     assert(State::NONE == state_);
     state_ = State::WAIT_NOTIFY;
+    recver_.wait_reverse(); // the sender copies into our buffer again, so the last reverse notice must be done
 
-    const int payload = ((srcGPU_ & 0xFF) << 8) | (dstGPU_ & 0xFF);
-    MPI_Irecv(&junk_, 1, MPI_BYTE, srcRank_, make_tag<MsgKind::ColocatedNotify>(payload), MPI_COMM_WORLD, &notifyReq_);
+    const int payload = subdomain_pair(srcGPU_, dstGPU_);
+    MPI_Irecv(&junk_, 1, MPI_BYTE, srcRank_, make_tag<MsgKind::ColocatedNotify>(payload), comm_, &notifyReq_);
 
     assert(stream_.device() == domain_->gpu());
   }
@@ -489,6 +718,10 @@ public:
     }
   }
 
+  /* the request the active state is waiting on
+   */
+  MPI_Request *active_request() noexcept { return &notifyReq_; }
+
   void next() {
     if (State::WAIT_NOTIFY == state_) {
       // have device recver wait on its stream, and then unpack the data.
@@ -500,17 +733,34 @@ public:
   }
 
   void wait() noexcept {
+    if (State::WAIT_HALO == state_) {
+      recver_.wait_reverse();
+    }
     // wait on unpacker
     assert(stream_.device() == domain_->gpu());
     CUDA_RUNTIME(cudaSetDevice(stream_.device()));
     CUDA_RUNTIME(cudaStreamSynchronize(stream_));
     state_ = State::NONE;
   }
+
+  /* pack our halo and let the ColocatedHaloSender copy it back, for an accumulating exchange.
+     Nothing to poll, call wait() to finish
+  */
+  void send_halo() {
+    assert(State::NONE == state_);
+    state_ = State::WAIT_HALO;
+    recver_.wait_reverse(); // the buffer is about to be refilled, so the last reverse notice must be done
+    unpacker_.pack_halo();
+    recver_.send_reverse(stream_);
+  }
 };
 
 /*! Send from one domain to a remote domain
+
+    The message is copied to the host and sent in chunks of chunk_bytes(), so the MPI_Isend of one chunk overlaps the
+    copy of the next. The RemoteRecver must use the same chunk size.
  */
-class RemoteSender : public StatefulSender {
+class RemoteSender final : public StatefulSender {
 private:
   int srcRank_;
   int srcGPU_;
@@ -518,24 +768,44 @@ private:
   int dstGPU_;
 
   LocalDomain *domain_;
+  MPI_Comm comm_;
 
   char *hostBuf_;
 
   RcStream stream_;
-  MPI_Request req_;
+  MPI_Request req_; // recv_accumulate()
 
-  enum class State { None, D2H, Wait };
+  size_t chunkBytes_;
+  std::vector<cudaEvent_t> chunkEvents_; // chunkEvents_[i] is recorded after chunk i is on the host
+  std::vector<MPI_Request> chunkReqs_;
+  size_t nextChunk_; // the next chunk to MPI_Isend
+
+  /* None, D2H, Wait: send()
+     AccH2H, AccH2D: recv_accumulate()
+  */
+  enum class State { None, D2H, Wait, AccH2H, AccH2D };
   State state_;
 
   DevicePacker packer_;
 
 public:
   // RemoteSender() : hostBuf_(nullptr) {}
-  RemoteSender(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain)
-      : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain), hostBuf_(nullptr),
-        stream_(domain.gpu(), RcStream::Priority::HIGH), state_(State::None), packer_(stream_) {}
+  RemoteSender(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain, MPI_Comm comm)
+      : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain), comm_(comm),
+        hostBuf_(nullptr), stream_(domain.gpu(), RcStream::Priority::HIGH), chunkBytes_(REMOTE_CHUNK_BYTES),
+        nextChunk_(0), state_(State::None), packer_(stream_) {}
+
+  ~RemoteSender() {
+    for (cudaEvent_t e : chunkEvents_) {
+      CUDA_RUNTIME(cudaEventDestroy(e));
+    }
+    CUDA_RUNTIME(cudaFreeHost(hostBuf_));
+  }
 
-  ~RemoteSender() { CUDA_RUNTIME(cudaFreeHost(hostBuf_)); }
+  /* split messages into chunks of `bytes`. 0 sends each message whole. Call before prepare()
+   */
+  void set_chunk_bytes(size_t bytes) noexcept { chunkBytes_ = bytes; }
+  size_t chunk_bytes() const noexcept { return chunkBytes_; }
 
   /*! Prepare to send a set of messages whose direction vectors are store in
    outbox.
@@ -561,6 +831,12 @@ public:
       CUDA_RUNTIME(cudaHostAlloc(&hostBuf_, packer_.size(), cudaHostAllocDefault));
       assert(hostBuf_);
     }
+
+    chunkEvents_.resize(num_chunks(packer_.size(), chunkBytes_));
+    for (cudaEvent_t &e : chunkEvents_) {
+      CUDA_RUNTIME(cudaEventCreateWithFlags(&e, cudaEventDisableTiming));
+    }
+    chunkReqs_.resize(chunkEvents_.size(), MPI_REQUEST_NULL);
   }
 
   virtual void send() override {
@@ -568,25 +844,62 @@ public:
     send_d2h();
   }
 
+  virtual void recv_accumulate() override {
+    state_ = State::AccH2H;
+    recv_acc_h2h();
+  }
+
   virtual bool active() override {
     assert(State::None != state_);
-    return State::Wait != state_;
+    return State::Wait != state_ && State::AccH2D != state_;
   }
 
   virtual bool next_ready() override {
     assert(State::None != state_);
     if (state_ == State::D2H) {
       return d2h_done();
+    } else if (state_ == State::AccH2H) {
+      return acc_h2h_done();
     } else {
       __builtin_unreachable();
       LOG_FATAL("unreachable");
     }
   }
 
+  /* the request the current active state is waiting on, or nullptr if it is waiting on the stream
+   */
+  MPI_Request *active_request() noexcept { return (State::AccH2H == state_ && packer_.size()) ? &req_ : nullptr; }
+
+  /* the first outstanding chunk MPI_Isend after send() has finished its active states, or nullptr.
+     Chunks may complete in any order, so the send is done only when this returns nullptr or a null request
+   */
+  MPI_Request *send_request() noexcept {
+    if (State::Wait == state_) {
+      for (MPI_Request &req : chunkReqs_) {
+        if (MPI_REQUEST_NULL != req) {
+          return &req;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  virtual int64_t bytes() override { return packer_.size(); }
+  virtual int dst_rank() const noexcept override { return dstRank_; }
+  virtual int64_t device_bytes() const noexcept override { return packer_.allocated_bytes(); }
+  virtual int64_t pinned_bytes() const noexcept override { return hostBuf_ ? packer_.allocated_bytes() : 0; }
+
+  /* in D2H, each next() sends the chunks that have reached the host and stays in D2H until all are sent
+   */
   virtual void next() override {
     if (State::D2H == state_) {
-      state_ = State::Wait;
       send_h2h();
+      if (nextChunk_ == chunkReqs_.size()) {
+        state_ = State::Wait;
+      }
+    } else if (State::AccH2H == state_) {
+      state_ = State::AccH2D;
+      recv_acc_h2d();
     } else {
       __builtin_unreachable();
       LOG_FATAL("unreachable");
@@ -594,23 +907,34 @@ public:
   }
 
   virtual void wait() override {
-    assert(State::Wait == state_);
+    assert(State::Wait == state_ || State::AccH2D == state_);
     if (packer_.size()) {
-      MPI_Wait(&req_, MPI_STATUS_IGNORE);
+      if (State::Wait == state_) {
+        MPI_Waitall(int(chunkReqs_.size()), chunkReqs_.data(), MPI_STATUSES_IGNORE);
+      } else {
+        CUDA_RUNTIME(cudaStreamSynchronize(stream_));
+      }
     }
     state_ = State::None;
   }
 
   void send_d2h() {
+    nextChunk_ = 0;
     if (packer_.size()) {
       nvtxRangePush("RemoteSender::send_d2h");
       // pack data into device buffer
       assert(stream_.device() == domain_->gpu());
       packer_.pack();
 
-      // copy to host buffer
+      // copy each chunk to the host buffer
       assert(hostBuf_);
-      CUDA_RUNTIME(cudaMemcpyAsync(hostBuf_, packer_.data(), packer_.size(), cudaMemcpyDefault, stream_));
+      const char *src = static_cast<const char *>(packer_.data());
+      for (size_t i = 0; i < chunkEvents_.size(); ++i) {
+        const size_t off = i * chunkBytes_;
+        const size_t n = chunk_size(i, packer_.size(), chunkBytes_);
+        CUDA_RUNTIME(cudaMemcpyAsync(hostBuf_ + off, src + off, n, cudaMemcpyDefault, stream_));
+        CUDA_RUNTIME(cudaEventRecord(chunkEvents_[i], stream_));
+      }
 
       nvtxRangePop(); // RemoteSender::send_d2h
     }
@@ -618,10 +942,16 @@ public:
 
   bool is_d2h() const noexcept { return State::D2H == state_; }
 
+  /* true if the next next() will start this send's first MPI_Isend
+   */
+  bool starts_send() const noexcept { return State::D2H == state_ && 0 == nextChunk_; }
+
+  /* true if the next chunk to send is on the host
+   */
   bool d2h_done() {
     assert(State::D2H == state_);
-    if (packer_.size()) {
-      cudaError_t err = cudaStreamQuery(stream_);
+    if (nextChunk_ < chunkEvents_.size()) {
+      cudaError_t err = cudaEventQuery(chunkEvents_[nextChunk_]);
       if (cudaSuccess == err) {
         return true;
       } else if (cudaErrorNotReady == err) {
@@ -635,23 +965,61 @@ public:
     }
   }
 
+  /* MPI_Isend every chunk that has reached the host, in order
+   */
   void send_h2h() {
     if (packer_.size()) {
       nvtxRangePush("RemoteSender::send_h2h");
       assert(hostBuf_);
-      assert(packer_.size());
-      assert(srcGPU_ < 8);
-      assert(dstGPU_ < 8);
-      const int tag = ((srcGPU_ & 0xF) << 4) | (dstGPU_ & 0xF);
-      MPI_Isend(hostBuf_, packer_.size(), MPI_BYTE, dstRank_, tag, MPI_COMM_WORLD, &req_);
+      const int tag = make_tag<MsgKind::Remote>(subdomain_pair(srcGPU_, dstGPU_));
+      // chunks have the same tag and are matched in order
+      do {
+        const size_t off = nextChunk_ * chunkBytes_;
+        const size_t n = chunk_size(nextChunk_, packer_.size(), chunkBytes_);
+        assert(n <= size_t(std::numeric_limits<int>::max()));
+        MPI_Isend(hostBuf_ + off, int(n), MPI_BYTE, dstRank_, tag, comm_, &chunkReqs_[nextChunk_]);
+        ++nextChunk_;
+      } while (nextChunk_ < chunkEvents_.size() && d2h_done());
       nvtxRangePop(); // RemoteSender::send_h2h
     }
   }
+
+  void recv_acc_h2h() {
+    if (packer_.size()) {
+      nvtxRangePush("RemoteSender::recv_acc_h2h");
+      assert(hostBuf_);
+      const int tag = make_tag<MsgKind::RemoteAccumulate>(subdomain_pair(srcGPU_, dstGPU_));
+      MPI_Irecv(hostBuf_, packer_.size(), MPI_BYTE, dstRank_, tag, comm_, &req_);
+      nvtxRangePop(); // RemoteSender::recv_acc_h2h
+    }
+  }
+
+  bool acc_h2h_done() {
+    assert(State::AccH2H == state_);
+    if (packer_.size()) {
+      int flag;
+      MPI_Test(&req_, &flag, MPI_STATUS_IGNORE);
+      return flag;
+    } else {
+      return true;
+    }
+  }
+
+  void recv_acc_h2d() {
+    if (packer_.size()) {
+      nvtxRangePush("RemoteSender::recv_acc_h2d");
+      CUDA_RUNTIME(cudaMemcpyAsync(packer_.data(), hostBuf_, packer_.size(), cudaMemcpyDefault, stream_));
+      packer_.accumulate();
+      nvtxRangePop(); // RemoteSender::recv_acc_h2d
+    }
+  }
 };
 
 /*! Recv from a remote domain into a domain
+
+    Chunks are copied to the device as they arrive, and the message is unpacked once all chunks are copied.
  */
-class RemoteRecver : public StatefulRecver {
+class RemoteRecver final : public StatefulRecver {
 private:
   int srcRank_;
   int srcGPU_;
@@ -659,28 +1027,45 @@ private:
   int dstGPU_;
 
   LocalDomain *domain_;
+  MPI_Comm comm_;
 
   char *hostBuf_;
 
   RcStream stream_;
 
-  MPI_Request req_;
+  MPI_Request req_; // send_halo()
+
+  size_t chunkBytes_;
+  std::vector<MPI_Request> chunkReqs_;
+  size_t nextChunk_; // the next chunk to copy to the device
 
-  enum class State { None, H2H, H2D };
+  /* None, H2H, H2D: recv()
+     AccD2H, AccWait: send_halo()
+  */
+  enum class State { None, H2H, H2D, AccD2H, AccWait };
   State state_;
 
   DeviceUnpacker unpacker_;
 
 public:
   RemoteRecver() = delete;
-  RemoteRecver(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain)
-      : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain), hostBuf_(nullptr),
-        stream_(domain.gpu(), RcStream::Priority::HIGH), state_(State::None), unpacker_(stream_) {
+  RemoteRecver(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain, MPI_Comm comm)
+      : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain), comm_(comm),
+        hostBuf_(nullptr), stream_(domain.gpu(), RcStream::Priority::HIGH), chunkBytes_(REMOTE_CHUNK_BYTES),
+        nextChunk_(0), state_(State::None), unpacker_(stream_) {
     CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
   }
 
   ~RemoteRecver() { CUDA_RUNTIME(cudaFreeHost(hostBuf_)); }
 
+  virtual int64_t device_bytes() const noexcept override { return unpacker_.allocated_bytes(); }
+  virtual int64_t pinned_bytes() const noexcept override { return hostBuf_ ? unpacker_.allocated_bytes() : 0; }
+
+  /* must match the RemoteSender's chunk size. Call before prepare()
+   */
+  void set_chunk_bytes(size_t bytes) noexcept { chunkBytes_ = bytes; }
+  size_t chunk_bytes() const noexcept { return chunkBytes_; }
+
   /*! Prepare to send a set of messages whose direction vectors are store in
    * outbox
    */
@@ -695,6 +1080,7 @@ public:
       CUDA_RUNTIME(cudaHostAlloc(&hostBuf_, unpacker_.size(), cudaHostAllocDefault));
       assert(hostBuf_);
     }
+    chunkReqs_.resize(num_chunks(unpacker_.size(), chunkBytes_), MPI_REQUEST_NULL);
   }
 
   virtual void recv() override {
@@ -702,20 +1088,44 @@ public:
     recv_h2h();
   }
 
+  virtual void send_halo() override {
+    state_ = State::AccD2H;
+    send_acc_d2h();
+  }
+
   virtual bool active() override {
     assert(State::None != state_);
-    return State::H2D != state_;
+    return State::H2D != state_ && State::AccWait != state_;
   }
 
   virtual bool next_ready() override {
-    assert(State::H2H == state_);
-    return h2h_done();
+    if (State::H2H == state_) {
+      return h2h_done();
+    } else if (State::AccD2H == state_) {
+      return acc_d2h_done();
+    } else {
+      assert(0);
+      __builtin_unreachable();
+    }
   }
 
+  /* the request the current active state is waiting on, or nullptr if it is waiting on the stream
+   */
+  MPI_Request *active_request() noexcept {
+    return (State::H2H == state_ && nextChunk_ < chunkReqs_.size()) ? &chunkReqs_[nextChunk_] : nullptr;
+  }
+
+  /* in H2H, each next() copies the chunks that have arrived and stays in H2H until all are copied
+   */
   virtual void next() override {
     if (State::H2H == state_) {
-      state_ = State::H2D;
       recv_h2d();
+      if (nextChunk_ == chunkReqs_.size()) {
+        state_ = State::H2D;
+      }
+    } else if (State::AccD2H == state_) {
+      state_ = State::AccWait;
+      send_acc_h2h();
     } else {
       assert(0);
       __builtin_unreachable();
@@ -723,57 +1133,109 @@ public:
   }
 
   virtual void wait() override {
-    assert(State::H2D == state_);
+    assert(State::H2D == state_ || State::AccWait == state_);
     if (unpacker_.size()) {
-      CUDA_RUNTIME(cudaStreamSynchronize(stream_));
+      if (State::H2D == state_) {
+        CUDA_RUNTIME(cudaStreamSynchronize(stream_));
+      } else {
+        MPI_Wait(&req_, MPI_STATUS_IGNORE);
+      }
     }
   }
 
+  /* copy every chunk that has arrived to the device, in order. Unpack once all chunks are copied
+   */
   void recv_h2d() {
     if (unpacker_.size()) {
       nvtxRangePush("RemoteRecver::recv_h2d");
-      // copy to device buffer
-      CUDA_RUNTIME(cudaMemcpyAsync(unpacker_.data(), hostBuf_, unpacker_.size(), cudaMemcpyDefault, stream_));
-      unpacker_.unpack();
+      char *dst = static_cast<char *>(unpacker_.data());
+      // a chunk's request may already be freed by MPI_Test, in which case it is null and tests as done
+      while (h2h_done()) {
+        const size_t off = nextChunk_ * chunkBytes_;
+        const size_t n = chunk_size(nextChunk_, unpacker_.size(), chunkBytes_);
+        CUDA_RUNTIME(cudaMemcpyAsync(dst + off, hostBuf_ + off, n, cudaMemcpyDefault, stream_));
+        if (++nextChunk_ == chunkReqs_.size()) {
+          unpacker_.unpack();
+          break;
+        }
+      }
       nvtxRangePop(); // RemoteRecver::recv_h2d
     }
   }
 
   bool is_h2h() const { return State::H2H == state_; }
 
+  /* true if the next chunk to copy has arrived
+   */
   bool h2h_done() {
     assert(State::H2H == state_);
-    if (unpacker_.size()) {
+    if (nextChunk_ < chunkReqs_.size()) {
       int flag;
-      MPI_Test(&req_, &flag, MPI_STATUS_IGNORE);
-      if (flag) {
+      MPI_Test(&chunkReqs_[nextChunk_], &flag, MPI_STATUS_IGNORE);
+      return flag;
+    } else {
+      return true;
+    }
+  }
+
+  void recv_h2h() {
+    nextChunk_ = 0;
+    if (unpacker_.size()) {
+      nvtxRangePush("RemoteRecver::recv_h2h");
+      assert(hostBuf_);
+      const int tag = make_tag<MsgKind::Remote>(subdomain_pair(srcGPU_, dstGPU_));
+      for (size_t i = 0; i < chunkReqs_.size(); ++i) {
+        const size_t off = i * chunkBytes_;
+        const size_t n = chunk_size(i, unpacker_.size(), chunkBytes_);
+        assert(n <= size_t(std::numeric_limits<int>::max()));
+        MPI_Irecv(hostBuf_ + off, int(n), MPI_BYTE, srcRank_, tag, comm_, &chunkReqs_[i]);
+      }
+      nvtxRangePop(); // RemoteRecver::recv_h2h
+    }
+  }
+
+  void send_acc_d2h() {
+    if (unpacker_.size()) {
+      nvtxRangePush("RemoteRecver::send_acc_d2h");
+      unpacker_.pack_halo();
+      CUDA_RUNTIME(cudaMemcpyAsync(hostBuf_, unpacker_.data(), unpacker_.size(), cudaMemcpyDefault, stream_));
+      nvtxRangePop(); // RemoteRecver::send_acc_d2h
+    }
+  }
+
+  bool acc_d2h_done() {
+    assert(State::AccD2H == state_);
+    if (unpacker_.size()) {
+      cudaError_t err = cudaStreamQuery(stream_);
+      if (cudaSuccess == err) {
         return true;
-      } else {
+      } else if (cudaErrorNotReady == err) {
         return false;
+      } else {
+        CUDA_RUNTIME(err);
+        __builtin_unreachable();
       }
     } else {
       return true;
     }
   }
 
-  void recv_h2h() {
+  void send_acc_h2h() {
     if (unpacker_.size()) {
-      nvtxRangePush("RemoteRecver::recv_h2h");
+      nvtxRangePush("RemoteRecver::send_acc_h2h");
       assert(hostBuf_);
-      assert(srcGPU_ < 8);
-      assert(dstGPU_ < 8);
-      const int tag = ((srcGPU_ & 0xF) << 4) | (dstGPU_ & 0xF);
+      const int tag = make_tag<MsgKind::RemoteAccumulate>(subdomain_pair(srcGPU_, dstGPU_));
       int numBytes = unpacker_.size();
       assert(numBytes <= std::numeric_limits<int>::max());
-      MPI_Irecv(hostBuf_, int(numBytes), MPI_BYTE, srcRank_, tag, MPI_COMM_WORLD, &req_);
-      nvtxRangePop(); // RemoteRecver::recv_h2h
+      MPI_Isend(hostBuf_, int(numBytes), MPI_BYTE, srcRank_, tag, comm_, &req_);
+      nvtxRangePop(); // RemoteRecver::send_acc_h2h
     }
   }
 };
 
 /*! Send from one domain to a remote domain
  */
-class CudaAwareMpiSender : public StatefulSender {
+class CudaAwareMpiSender final : public StatefulSender {
 private:
   int srcRank_;
   int srcGPU_;
@@ -781,6 +1243,7 @@ private:
   int dstGPU_;
 
   LocalDomain *domain_;
+  MPI_Comm comm_;
 
   RcStream stream_;
   MPI_Request req_;
@@ -789,6 +1252,8 @@ private:
     None,
     Pack,
     Send,
+    AccRecv,       // recv_accumulate(): waiting on MPI_Irecv
+    AccAccumulate, // recv_accumulate(): waiting on accumulate
   };
   State state_;
 
@@ -798,9 +1263,9 @@ private:
 
 public:
   // CudaAwareMpiSender() {}
-  CudaAwareMpiSender(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain)
+  CudaAwareMpiSender(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain, MPI_Comm comm)
       : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain),
-        stream_(domain.gpu(), RcStream::Priority::HIGH), state_(State::None), packer_(stream_) {}
+        comm_(comm), stream_(domain.gpu(), RcStream::Priority::HIGH), state_(State::None), packer_(stream_) {}
 
   virtual void prepare(std::vector<Message> &outbox) override {
     packer_.prepare(domain_, outbox);
@@ -814,17 +1279,44 @@ public:
     send_pack();
   }
 
-  virtual bool active() override { return State::Send != state_; }
+  virtual void recv_accumulate() override {
+    state_ = State::AccRecv;
+    recv_acc_d2d();
+  }
+
+  virtual bool active() override { return State::Send != state_ && State::AccAccumulate != state_; }
 
   virtual bool next_ready() override {
-    assert(State::Pack == state_);
-    return pack_done();
+    if (State::Pack == state_) {
+      return pack_done();
+    } else if (State::AccRecv == state_) {
+      int flag;
+      MPI_Test(&req_, &flag, MPI_STATUS_IGNORE);
+      return flag;
+    } else {
+      LOG_FATAL("unexpected state");
+    }
   }
 
+  /* the request the current active state is waiting on, or nullptr if it is waiting on the stream
+   */
+  MPI_Request *active_request() noexcept { return State::AccRecv == state_ ? &req_ : nullptr; }
+
+  /* the outstanding MPI_Isend after send() has finished its active states, or nullptr
+   */
+  MPI_Request *send_request() noexcept { return State::Send == state_ ? &req_ : nullptr; }
+
+  virtual int64_t bytes() override { return packer_.size(); }
+  virtual int dst_rank() const noexcept override { return dstRank_; }
+  virtual int64_t device_bytes() const noexcept override { return packer_.allocated_bytes(); }
+
   virtual void next() override {
     if (State::Pack == state_) {
       state_ = State::Send;
       send_d2d();
+    } else if (State::AccRecv == state_) {
+      state_ = State::AccAccumulate;
+      packer_.accumulate();
     } else {
       assert(0);
       __builtin_unreachable();
@@ -832,9 +1324,13 @@ public:
   }
 
   virtual void wait() override {
-    assert(State::Send == state_);
+    assert(State::Send == state_ || State::AccAccumulate == state_);
     CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
-    MPI_Wait(&req_, MPI_STATUS_IGNORE);
+    if (State::Send == state_) {
+      MPI_Wait(&req_, MPI_STATUS_IGNORE);
+    } else {
+      CUDA_RUNTIME(cudaStreamSynchronize(stream_));
+    }
   }
 
   void send_pack() {
@@ -863,18 +1359,27 @@ public:
     assert(packer_.size());
     nvtxRangePush("CudaAwareMpiSender::send_d2d");
     assert(packer_.data());
-    assert(srcGPU_ < 8);
-    assert(dstGPU_ < 8);
     CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
-    const int tag = ((srcGPU_ & 0xF) << 4) | (dstGPU_ & 0xF);
+    const int tag = make_tag<MsgKind::Remote>(subdomain_pair(srcGPU_, dstGPU_));
     size_t numBytes = packer_.size();
     assert(numBytes <= std::numeric_limits<int>::max());
-    MPI_Isend(packer_.data(), int(numBytes), MPI_BYTE, dstRank_, tag, MPI_COMM_WORLD, &req_);
+    MPI_Isend(packer_.data(), int(numBytes), MPI_BYTE, dstRank_, tag, comm_, &req_);
     nvtxRangePop(); // CudaAwareMpiSender::send_d2d
   }
+
+  void recv_acc_d2d() {
+    assert(packer_.size());
+    nvtxRangePush("CudaAwareMpiSender::recv_acc_d2d");
+    CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
+    const int tag = make_tag<MsgKind::RemoteAccumulate>(subdomain_pair(srcGPU_, dstGPU_));
+    size_t numBytes = packer_.size();
+    assert(numBytes <= std::numeric_limits<int>::max());
+    MPI_Irecv(packer_.data(), int(numBytes), MPI_BYTE, dstRank_, tag, comm_, &req_);
+    nvtxRangePop(); // CudaAwareMpiSender::recv_acc_d2d
+  }
 };
 
-class CudaAwareMpiRecver : public StatefulRecver {
+class CudaAwareMpiRecver final : public StatefulRecver {
 private:
   int srcRank_;
   int srcGPU_;
@@ -882,6 +1387,7 @@ private:
   int dstGPU_;
 
   LocalDomain *domain_;
+  MPI_Comm comm_;
 
   RcStream stream_;
   MPI_Request req_;
@@ -890,6 +1396,8 @@ private:
     None,
     Recv,
     Unpack,
+    AccPack, // send_halo(): waiting on halo pack
+    AccSend, // send_halo(): waiting on MPI_Isend
   };
   State state_;
 
@@ -897,9 +1405,11 @@ private:
 
 public:
   CudaAwareMpiRecver() = delete;
-  CudaAwareMpiRecver(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain)
+  CudaAwareMpiRecver(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain, MPI_Comm comm)
       : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain),
-        stream_(domain.gpu(), RcStream::Priority::HIGH), state_(State::None), unpacker_(stream_) {}
+        comm_(comm), stream_(domain.gpu(), RcStream::Priority::HIGH), state_(State::None), unpacker_(stream_) {}
+
+  virtual int64_t device_bytes() const noexcept override { return unpacker_.allocated_bytes(); }
 
   /*! Prepare to send a set of messages whose direction vectors are store in
    * outbox
@@ -916,17 +1426,43 @@ public:
     recv_d2d();
   }
 
+  virtual void send_halo() override {
+    state_ = State::AccPack;
+    assert(unpacker_.size());
+    unpacker_.pack_halo();
+  }
+
   virtual bool active() override {
     assert(State::None != state_);
-    return State::Unpack != state_;
+    return State::Unpack != state_ && State::AccSend != state_;
+  }
+
+  virtual bool next_ready() override {
+    if (State::AccPack == state_) {
+      cudaError_t err = cudaStreamQuery(stream_);
+      if (cudaSuccess == err) {
+        return true;
+      } else if (cudaErrorNotReady == err) {
+        return false;
+      } else {
+        CUDA_RUNTIME(err);
+        LOG_FATAL("cuda error");
+      }
+    }
+    return d2d_done();
   }
 
-  virtual bool next_ready() override { return d2d_done(); }
+  /* the request the current active state is waiting on, or nullptr if it is waiting on the stream
+   */
+  MPI_Request *active_request() noexcept { return State::Recv == state_ ? &req_ : nullptr; }
 
   virtual void next() override {
     if (State::Recv == state_) {
       state_ = State::Unpack;
       recv_unpack();
+    } else if (State::AccPack == state_) {
+      state_ = State::AccSend;
+      send_acc_d2d();
     } else {
       LOG_FATAL("unreachable");
       __builtin_unreachable();
@@ -935,8 +1471,12 @@ public:
 
   virtual void wait() override {
     assert(unpacker_.size());
-    assert(State::Unpack == state_);
-    CUDA_RUNTIME(cudaStreamSynchronize(stream_));
+    assert(State::Unpack == state_ || State::AccSend == state_);
+    if (State::Unpack == state_) {
+      CUDA_RUNTIME(cudaStreamSynchronize(stream_));
+    } else {
+      MPI_Wait(&req_, MPI_STATUS_IGNORE);
+    }
   }
 
   void recv_unpack() {
@@ -964,11 +1504,17 @@ public:
     assert(unpacker_.size());
     nvtxRangePush("CudaAwareMpiRecver::recv_d2d");
     assert(unpacker_.data());
-    assert(srcGPU_ < 8);
-    assert(dstGPU_ < 8);
     CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
-    const int tag = ((srcGPU_ & 0xF) << 4) | (dstGPU_ & 0xF);
-    MPI_Irecv(unpacker_.data(), int(unpacker_.size()), MPI_BYTE, srcRank_, tag, MPI_COMM_WORLD, &req_);
+    const int tag = make_tag<MsgKind::Remote>(subdomain_pair(srcGPU_, dstGPU_));
+    MPI_Irecv(unpacker_.data(), int(unpacker_.size()), MPI_BYTE, srcRank_, tag, comm_, &req_);
     nvtxRangePop(); // CudaAwareMpiRecver::recv_d2d
   }
+
+  void send_acc_d2d() {
+    nvtxRangePush("CudaAwareMpiRecver::send_acc_d2d");
+    CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
+    const int tag = make_tag<MsgKind::RemoteAccumulate>(subdomain_pair(srcGPU_, dstGPU_));
+    MPI_Isend(unpacker_.data(), int(unpacker_.size()), MPI_BYTE, srcRank_, tag, comm_, &req_);
+    nvtxRangePop(); // CudaAwareMpiRecver::send_acc_d2d
+  }
 };
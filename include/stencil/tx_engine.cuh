@@ -0,0 +1,363 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <mpi.h>
+
+#include <nvToolsExt.h>
+
+#include "stencil/logging.hpp"
+#include "stencil/tx_cuda.cuh"
+
+/*! Drives the stateful transfers of a DistributedDomain to completion.
+
+    Transfers are kept in one flat array of (kind, object) descriptors and dispatched with a switch on the kind,
+    so there are no virtual calls in the poll loop.
+    The request each transfer is waiting on is copied into one flat array, so a single
+    MPI_Testsome (or MPI_Waitsome, if nothing is waiting on the GPU) finds every MPI completion in a pass.
+    Only transfers waiting on a stream are polled individually.
+
+    A completed request is freed by MPI_Testsome, so the engine clears the transfer's own copy before calling next().
+
+    With a link cap, a sender whose MPI_Isend would put more than the cap in flight to its destination rank is held
+    until earlier sends to that rank complete, so a rank does not flood one receiver. A send larger than the cap still
+    goes alone.
+
+    engine.add(...);          // once, after realize()
+    // start every transfer with send() / recv() / recv_accumulate() / send_halo()
+    engine.poll();           // until no transfer is active()
+    // wait() on every transfer
+
+    poll() is begin() then wait(). To overlap other work, call begin() and then test() now and then.
+*/
+class TxEngine {
+public:
+  enum class Kind : uint8_t {
+    RemoteSender,
+    RemoteRecver,
+    CudaAwareMpiSender,
+    CudaAwareMpiRecver,
+    ColocatedHaloSender,
+    ColocatedHaloRecver,
+  };
+
+private:
+  struct Transfer {
+    Kind kind;
+    void *obj;
+    int link;      // destination rank of a sender, or -1
+    int64_t bytes; // bytes a sender sends
+  };
+
+  std::vector<Transfer> transfers_;
+  std::vector<MPI_Request> reqs_; // reqs_[i] is the request transfers_[i] is waiting on, or MPI_REQUEST_NULL
+  std::vector<bool> inflight_;    // reqs_[i] is transfers_[i]'s MPI_Isend, tracked for the link cap
+  std::vector<int> gpuWait_;      // transfers waiting on a stream
+  std::vector<int> gpuPoll_;      // scratch for polling gpuWait_
+  std::vector<int> completed_;    // scratch for MPI_Testsome
+  int numMpiWait_;                // number of non-null entries in reqs_
+
+  int64_t linkCap_;                          // max bytes in flight to one rank, 0 for no limit
+  std::map<int, int64_t> linkBytes_;         // bytes in flight to each rank
+  std::map<int, std::deque<int>> deferred_;  // senders held back by the cap on each link, in arrival order
+  size_t numDeferred_;
+
+  void add(Kind kind, void *obj, int link = -1, int64_t bytes = 0) {
+    transfers_.push_back({kind, obj, link, bytes});
+    reqs_.push_back(MPI_REQUEST_NULL);
+    inflight_.push_back(false);
+    completed_.push_back(0);
+  }
+
+  bool active(const Transfer &t) {
+    switch (t.kind) {
+    case Kind::RemoteSender:
+      return static_cast<RemoteSender *>(t.obj)->active();
+    case Kind::RemoteRecver:
+      return static_cast<RemoteRecver *>(t.obj)->active();
+    case Kind::CudaAwareMpiSender:
+      return static_cast<CudaAwareMpiSender *>(t.obj)->active();
+    case Kind::CudaAwareMpiRecver:
+      return static_cast<CudaAwareMpiRecver *>(t.obj)->active();
+    case Kind::ColocatedHaloSender:
+      return static_cast<ColocatedHaloSender *>(t.obj)->active();
+    case Kind::ColocatedHaloRecver:
+      return static_cast<ColocatedHaloRecver *>(t.obj)->active();
+    }
+    __builtin_unreachable();
+  }
+
+  MPI_Request *active_request(const Transfer &t) {
+    switch (t.kind) {
+    case Kind::RemoteSender:
+      return static_cast<RemoteSender *>(t.obj)->active_request();
+    case Kind::RemoteRecver:
+      return static_cast<RemoteRecver *>(t.obj)->active_request();
+    case Kind::CudaAwareMpiSender:
+      return static_cast<CudaAwareMpiSender *>(t.obj)->active_request();
+    case Kind::CudaAwareMpiRecver:
+      return static_cast<CudaAwareMpiRecver *>(t.obj)->active_request();
+    case Kind::ColocatedHaloSender:
+      return static_cast<ColocatedHaloSender *>(t.obj)->active_request();
+    case Kind::ColocatedHaloRecver:
+      return static_cast<ColocatedHaloRecver *>(t.obj)->active_request();
+    }
+    __builtin_unreachable();
+  }
+
+  bool next_ready(const Transfer &t) {
+    switch (t.kind) {
+    case Kind::RemoteSender:
+      return static_cast<RemoteSender *>(t.obj)->next_ready();
+    case Kind::RemoteRecver:
+      return static_cast<RemoteRecver *>(t.obj)->next_ready();
+    case Kind::CudaAwareMpiSender:
+      return static_cast<CudaAwareMpiSender *>(t.obj)->next_ready();
+    case Kind::CudaAwareMpiRecver:
+      return static_cast<CudaAwareMpiRecver *>(t.obj)->next_ready();
+    case Kind::ColocatedHaloSender:
+      return static_cast<ColocatedHaloSender *>(t.obj)->next_ready();
+    case Kind::ColocatedHaloRecver:
+      return static_cast<ColocatedHaloRecver *>(t.obj)->next_ready();
+    }
+    __builtin_unreachable();
+  }
+
+  void next(const Transfer &t) {
+    switch (t.kind) {
+    case Kind::RemoteSender:
+      static_cast<RemoteSender *>(t.obj)->next();
+      return;
+    case Kind::RemoteRecver:
+      static_cast<RemoteRecver *>(t.obj)->next();
+      return;
+    case Kind::CudaAwareMpiSender:
+      static_cast<CudaAwareMpiSender *>(t.obj)->next();
+      return;
+    case Kind::CudaAwareMpiRecver:
+      static_cast<CudaAwareMpiRecver *>(t.obj)->next();
+      return;
+    case Kind::ColocatedHaloSender:
+      static_cast<ColocatedHaloSender *>(t.obj)->next();
+      return;
+    case Kind::ColocatedHaloRecver:
+      static_cast<ColocatedHaloRecver *>(t.obj)->next();
+      return;
+    }
+    __builtin_unreachable();
+  }
+
+  /* true if next() will MPI_Isend the transfer's data
+   */
+  bool next_sends(const Transfer &t) {
+    switch (t.kind) {
+    case Kind::RemoteSender:
+      return static_cast<RemoteSender *>(t.obj)->starts_send();
+    case Kind::CudaAwareMpiSender:
+      return static_cast<CudaAwareMpiSender *>(t.obj)->is_pack();
+    default:
+      return false;
+    }
+  }
+
+  /* an outstanding MPI_Isend of a sender that is no longer active, or nullptr. Once it is done and nulled, the sender
+     returns its next outstanding one, if any
+   */
+  MPI_Request *send_request(const Transfer &t) {
+    switch (t.kind) {
+    case Kind::RemoteSender:
+      return static_cast<RemoteSender *>(t.obj)->send_request();
+    case Kind::CudaAwareMpiSender:
+      return static_cast<CudaAwareMpiSender *>(t.obj)->send_request();
+    default:
+      return nullptr;
+    }
+  }
+
+  /* reserve room on transfer i's link if its send fits under the cap
+   */
+  bool admit(int i) {
+    const Transfer &t = transfers_[i];
+    if (0 == linkCap_ || !next_sends(t)) {
+      return true;
+    }
+    int64_t &inFlight = linkBytes_[t.link];
+    if (0 == inFlight || inFlight + t.bytes <= linkCap_) {
+      inFlight += t.bytes;
+      return true;
+    }
+    return false;
+  }
+
+  /* move transfer i to its next state, or hold it until its link has room
+   */
+  void advance(int i) {
+    const Transfer &t = transfers_[i];
+    if (admit(i)) {
+      next(t);
+      track(i);
+    } else {
+      deferred_[t.link].push_back(i);
+      ++numDeferred_;
+    }
+  }
+
+  /* an MPI_Isend on `link` finished: release its bytes and start held senders that now fit
+   */
+  void release(int link, int64_t bytes) {
+    linkBytes_[link] -= bytes;
+    std::deque<int> &held = deferred_[link];
+    while (!held.empty() && admit(held.front())) {
+      const int i = held.front();
+      held.pop_front();
+      --numDeferred_;
+      next(transfers_[i]);
+      track(i);
+    }
+  }
+
+  /* record what transfer i is waiting on after it was started or moved to its next state
+   */
+  void track(int i) {
+    const Transfer &t = transfers_[i];
+    if (!active(t)) {
+      MPI_Request *req = linkCap_ ? send_request(t) : nullptr;
+      if (req && MPI_REQUEST_NULL != *req) {
+        // keep the send in the completion set so its bytes can be released
+        reqs_[i] = *req;
+        inflight_[i] = true;
+        ++numMpiWait_;
+      } else {
+        reqs_[i] = MPI_REQUEST_NULL;
+      }
+      return;
+    }
+    MPI_Request *req = active_request(t);
+    if (req) {
+      reqs_[i] = *req;
+      ++numMpiWait_;
+    } else {
+      reqs_[i] = MPI_REQUEST_NULL;
+      gpuWait_.push_back(i);
+    }
+  }
+
+public:
+  TxEngine() : numMpiWait_(0), linkCap_(0), numDeferred_(0) {}
+
+  /* add senders after prepare(), so their size is known
+   */
+  void add(RemoteSender *s) { add(Kind::RemoteSender, s, s->dst_rank(), s->bytes()); }
+  void add(RemoteRecver *r) { add(Kind::RemoteRecver, r); }
+  void add(CudaAwareMpiSender *s) { add(Kind::CudaAwareMpiSender, s, s->dst_rank(), s->bytes()); }
+  void add(CudaAwareMpiRecver *r) { add(Kind::CudaAwareMpiRecver, r); }
+  void add(ColocatedHaloSender *s) { add(Kind::ColocatedHaloSender, s); }
+  void add(ColocatedHaloRecver *r) { add(Kind::ColocatedHaloRecver, r); }
+
+  size_t size() const noexcept { return transfers_.size(); }
+
+  /* limit the bytes of MPI_Isend in flight to any one rank. 0 means no limit
+   */
+  void set_link_cap(int64_t bytes) noexcept { linkCap_ = bytes; }
+
+  /*! record what every started transfer is waiting on. Call after starting transfers, before test() or wait().
+      Transfers that were not started must not be active()
+  */
+  void begin() {
+    numMpiWait_ = 0;
+    gpuWait_.clear();
+    linkBytes_.clear();
+    for (size_t i = 0; i < transfers_.size(); ++i) {
+      track(i);
+    }
+  }
+
+  /* true if no transfer is active()
+   */
+  bool done() const noexcept { return 0 == numMpiWait_ && gpuWait_.empty(); }
+
+  /* advance every transfer that is ready, without blocking. true if no transfer is active()
+   */
+  bool test() {
+    if (!done()) {
+      pass(false);
+    }
+    return done();
+  }
+
+  /* advance transfers until none are active()
+   */
+  void wait() {
+    while (!done()) {
+      pass(true);
+    }
+  }
+
+  /*! move every started transfer through its states until none are active().
+      Transfers that were not started must not be active()
+  */
+  void poll() {
+    nvtxRangePush("TxEngine::poll");
+    begin();
+    wait();
+    nvtxRangePop(); // TxEngine::poll
+  }
+
+private:
+  /* one pass over the waiting transfers. If `block`, wait for an MPI completion when nothing is waiting on the GPU
+   */
+  void pass(const bool block) {
+    // a held sender always has an in-flight send on its link to wait for
+    assert(0 == numDeferred_ || numMpiWait_ > 0);
+
+    // advance transfers whose stream work is done
+    gpuPoll_.swap(gpuWait_);
+    gpuWait_.clear();
+    for (int i : gpuPoll_) {
+      const Transfer &t = transfers_[i];
+      if (next_ready(t)) {
+        advance(i);
+      } else {
+        gpuWait_.push_back(i);
+      }
+    }
+
+    if (0 == numMpiWait_) {
+      return;
+    }
+
+    // advance transfers whose requests are done. Block if there is nothing else to do
+    int outcount;
+    if (block && gpuWait_.empty()) {
+      MPI_Waitsome(int(reqs_.size()), reqs_.data(), &outcount, completed_.data(), MPI_STATUSES_IGNORE);
+    } else {
+      MPI_Testsome(int(reqs_.size()), reqs_.data(), &outcount, completed_.data(), MPI_STATUSES_IGNORE);
+    }
+    if (MPI_UNDEFINED == outcount) {
+      LOG_FATAL("TxEngine waiting on " << numMpiWait_ << " requests, but all are null");
+    }
+    numMpiWait_ -= outcount;
+    for (int k = 0; k < outcount; ++k) {
+      const int i = completed_[k];
+      const Transfer &t = transfers_[i];
+      if (inflight_[i]) {
+        *send_request(t) = MPI_REQUEST_NULL; // MPI has freed it
+        // a chunked send holds its bytes until its last outstanding chunk is done
+        MPI_Request *req = send_request(t);
+        if (req && MPI_REQUEST_NULL != *req) {
+          reqs_[i] = *req;
+          ++numMpiWait_;
+        } else {
+          inflight_[i] = false;
+          release(t.link, t.bytes);
+        }
+      } else {
+        *active_request(t) = MPI_REQUEST_NULL; // MPI has freed it
+        advance(i);
+      }
+    }
+  }
+};
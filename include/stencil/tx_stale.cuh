@@ -0,0 +1,288 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <vector>
+
+#include <mpi.h>
+
+#include <nvToolsExt.h>
+
+#include "stencil/cuda_runtime.hpp"
+#include "stencil/local_domain.cuh"
+#include "stencil/logging.hpp"
+#include "stencil/packer.cuh"
+#include "stencil/rcstream.hpp"
+#include "stencil/tx_common.hpp"
+
+/* bytes at the front of every bounded-staleness message: the step the halo was packed at, as a uint64_t
+ */
+constexpr size_t STALE_HEADER_BYTES = sizeof(uint64_t);
+
+/*! Send a remote domain's halo, tagged with the step it was packed at, for DistributedDomain::exchange_stale().
+
+    There is at most one message in flight. If the last one has not been received when send() is called, the new
+    step is held and packed later by progress(), so a sender never waits on a slow receiver: the receiver just gets
+    the newest step once it catches up.
+*/
+class StaleSender {
+private:
+  int srcRank_;
+  int srcGPU_;
+  int dstRank_;
+  int dstGPU_;
+
+  LocalDomain *domain_;
+  MPI_Comm comm_;
+
+  char *hostBuf_; // STALE_HEADER_BYTES of step, then the packed halo
+
+  RcStream stream_;
+  MPI_Request req_;
+
+  /* D2H: packing `packedStep_` onto the host
+     Sent: MPI_Isend of `sentStep_` in flight
+  */
+  enum class State { None, D2H, Sent };
+  State state_;
+
+  uint64_t pending_;    // newest step passed to send()
+  uint64_t packedStep_; // step in hostBuf_
+  uint64_t sentStep_;   // newest step passed to MPI_Isend
+
+  DevicePacker packer_;
+
+public:
+  StaleSender(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain, MPI_Comm comm)
+      : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain), comm_(comm),
+        hostBuf_(nullptr), stream_(domain.gpu(), RcStream::Priority::HIGH), req_(MPI_REQUEST_NULL),
+        state_(State::None), pending_(0), packedStep_(0), sentStep_(0), packer_(stream_) {}
+
+  ~StaleSender() { CUDA_RUNTIME(cudaFreeHost(hostBuf_)); }
+
+  StaleSender(const StaleSender &) = delete;
+  StaleSender &operator=(const StaleSender &) = delete;
+
+  int64_t device_bytes() const noexcept { return packer_.allocated_bytes(); }
+  int64_t pinned_bytes() const noexcept { return hostBuf_ ? STALE_HEADER_BYTES + packer_.allocated_bytes() : 0; }
+
+  void prepare(std::vector<Message> &outbox) {
+    packer_.prepare(domain_, outbox);
+    LOG_INFO(packer_.size() << "B StaleSender was prepared: "
+                            << "r" << srcRank_ << "d" << srcGPU_ << "->"
+                            << "r" << dstRank_ << "d" << dstGPU_);
+    CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
+    CUDA_RUNTIME(cudaHostAlloc(&hostBuf_, STALE_HEADER_BYTES + packer_.size(), cudaHostAllocDefault));
+    assert(hostBuf_);
+  }
+
+  /* send the domain's current halo for `step`, now or from a later progress() while the domain is still at `step`
+   */
+  void send(uint64_t step) {
+    assert(step > pending_);
+    pending_ = step;
+    progress();
+  }
+
+  /* move the newest step along without blocking
+   */
+  void progress() {
+    if (State::Sent == state_) {
+      int flag;
+      MPI_Test(&req_, &flag, MPI_STATUS_IGNORE);
+      if (flag) {
+        state_ = State::None;
+      }
+    }
+    if (State::None == state_ && pending_ > sentStep_) {
+      nvtxRangePush("StaleSender::d2h");
+      packedStep_ = pending_;
+      if (packer_.size()) {
+        packer_.pack();
+        CUDA_RUNTIME(cudaMemcpyAsync(hostBuf_ + STALE_HEADER_BYTES, packer_.data(), packer_.size(),
+                                     cudaMemcpyDefault, stream_));
+      }
+      state_ = State::D2H;
+      nvtxRangePop(); // StaleSender::d2h
+    }
+    if (State::D2H == state_) {
+      cudaError_t err = cudaStreamQuery(stream_);
+      if (cudaSuccess == err) {
+        post();
+      } else if (cudaErrorNotReady != err) {
+        CUDA_RUNTIME(err);
+      }
+    }
+  }
+
+  /* block until the domain's halo is no longer being read, so the caller may modify it
+   */
+  void release() {
+    if (State::D2H == state_) {
+      CUDA_RUNTIME(cudaStreamSynchronize(stream_));
+      post();
+    }
+  }
+
+  /* true if the newest step passed to send() has been sent and the send has completed locally, so hostBuf_ may be
+     reused. It may not have been received yet
+   */
+  bool done() const noexcept { return State::None == state_ && pending_ == sentStep_; }
+
+  uint64_t sent_step() const noexcept { return sentStep_; }
+
+private:
+  void post() {
+    assert(State::D2H == state_);
+    std::memcpy(hostBuf_, &packedStep_, STALE_HEADER_BYTES);
+    const size_t n = STALE_HEADER_BYTES + packer_.size();
+    assert(n <= size_t(std::numeric_limits<int>::max()));
+    const int tag = make_tag<MsgKind::Remote>(subdomain_pair(srcGPU_, dstGPU_));
+    MPI_Isend(hostBuf_, int(n), MPI_BYTE, dstRank_, tag, comm_, &req_);
+    sentStep_ = packedStep_;
+    state_ = State::Sent;
+  }
+};
+
+/*! Recv a remote domain's halo for DistributedDomain::exchange_stale(), keeping only the newest step.
+
+    A recv is always posted, into whichever of the two host buffers does not hold the newest message, so the sender
+    never waits for this rank to call in. apply() unpacks the newest message into the current buffers if their halo is
+    older. The domain's current and next buffers swap, so the step in the halo is tracked for each.
+*/
+class StaleRecver {
+private:
+  int srcRank_;
+  int srcGPU_;
+  int dstRank_;
+  int dstGPU_;
+
+  LocalDomain *domain_;
+  MPI_Comm comm_;
+
+  char *hostBufs_[2]; // STALE_HEADER_BYTES of step, then the packed halo
+  int posted_;        // the buffer the outstanding MPI_Irecv writes
+
+  RcStream stream_;
+  MPI_Request req_;
+
+  uint64_t latest_; // the newest step received
+  // the step in the halo of each set of current buffers, keyed by the first buffer. Absent if never filled
+  std::map<const void *, uint64_t> applied_;
+
+  DeviceUnpacker unpacker_;
+
+  void post() {
+    const size_t n = STALE_HEADER_BYTES + unpacker_.size();
+    assert(n <= size_t(std::numeric_limits<int>::max()));
+    const int tag = make_tag<MsgKind::Remote>(subdomain_pair(srcGPU_, dstGPU_));
+    MPI_Irecv(hostBufs_[posted_], int(n), MPI_BYTE, srcRank_, tag, comm_, &req_);
+  }
+
+  const void *curr_key() const { return domain_->num_data() ? domain_->curr_data(0) : nullptr; }
+
+public:
+  StaleRecver(int srcRank, int srcGPU, int dstRank, int dstGPU, LocalDomain &domain, MPI_Comm comm)
+      : srcRank_(srcRank), srcGPU_(srcGPU), dstRank_(dstRank), dstGPU_(dstGPU), domain_(&domain), comm_(comm),
+        hostBufs_{nullptr, nullptr}, posted_(0), stream_(domain.gpu(), RcStream::Priority::HIGH),
+        req_(MPI_REQUEST_NULL), latest_(0), unpacker_(stream_) {}
+
+  ~StaleRecver() {
+    CUDA_RUNTIME(cudaFreeHost(hostBufs_[0]));
+    CUDA_RUNTIME(cudaFreeHost(hostBufs_[1]));
+  }
+
+  StaleRecver(const StaleRecver &) = delete;
+  StaleRecver &operator=(const StaleRecver &) = delete;
+
+  int64_t device_bytes() const noexcept { return unpacker_.allocated_bytes(); }
+  int64_t pinned_bytes() const noexcept {
+    return hostBufs_[0] ? 2 * (STALE_HEADER_BYTES + unpacker_.allocated_bytes()) : 0;
+  }
+
+  /* prepare buffers for `inbox` and post the first recv. The current halo is the one exchange() filled before step 1
+   */
+  void prepare(std::vector<Message> &inbox) {
+    unpacker_.prepare(domain_, inbox);
+    LOG_INFO(unpacker_.size() << "B StaleRecver was prepared: "
+                              << "r" << srcRank_ << "d" << srcGPU_ << "->"
+                              << "r" << dstRank_ << "d" << dstGPU_);
+    CUDA_RUNTIME(cudaSetDevice(domain_->gpu()));
+    for (char *&buf : hostBufs_) {
+      CUDA_RUNTIME(cudaHostAlloc(&buf, STALE_HEADER_BYTES + unpacker_.size(), cudaHostAllocDefault));
+      assert(buf);
+    }
+    applied_[curr_key()] = 0;
+    post();
+  }
+
+  /* take every message that has arrived without blocking, and repost the recv
+   */
+  void progress() {
+    int flag = 1;
+    while (flag) {
+      MPI_Test(&req_, &flag, MPI_STATUS_IGNORE);
+      if (flag) {
+        uint64_t step;
+        std::memcpy(&step, hostBufs_[posted_], STALE_HEADER_BYTES);
+        assert(step > latest_ && "messages between a pair of ranks arrive in order");
+        latest_ = step;
+        posted_ = 1 - posted_; // the older buffer is free: it was synchronized by the last sync()
+        post();
+      }
+    }
+  }
+
+  /* the newest step received, 0 if none
+   */
+  uint64_t latest() const noexcept { return latest_; }
+
+  /* the step whose halo is in the current buffers, 0 if it is the one from before step 1 or was never filled
+   */
+  uint64_t applied() const {
+    auto it = applied_.find(curr_key());
+    return applied_.end() == it ? 0 : it->second;
+  }
+
+  /* set `step` to the step the current halo will have after apply(). False if it would have none: nothing has been
+     received, and the current buffers are not the ones exchange() filled
+  */
+  bool available(uint64_t &step) const {
+    auto it = applied_.find(curr_key());
+    if (latest_ > 0 || applied_.end() != it) {
+      step = std::max(latest_, applied_.end() == it ? 0 : it->second);
+      return true;
+    }
+    return false;
+  }
+
+  /* unpack the newest message into the halo of the current buffers, if it is newer than their halo.
+     No progress() until sync(), which would repost into the buffer being copied from
+  */
+  void apply() {
+    auto it = applied_.find(curr_key());
+    if (latest_ > 0 && (applied_.end() == it || latest_ > it->second)) {
+      nvtxRangePush("StaleRecver::apply");
+      if (unpacker_.size()) {
+        const char *buf = hostBufs_[1 - posted_];
+        CUDA_RUNTIME(cudaMemcpyAsync(unpacker_.data(), buf + STALE_HEADER_BYTES, unpacker_.size(),
+                                     cudaMemcpyDefault, stream_));
+        unpacker_.unpack();
+      }
+      applied_[curr_key()] = latest_;
+      nvtxRangePop(); // StaleRecver::apply
+    }
+  }
+
+  void sync() { CUDA_RUNTIME(cudaStreamSynchronize(stream_)); }
+
+  /* cancel the outstanding recv. Only once the source has sent its last message and it has been received
+   */
+  void cancel() {
+    MPI_Cancel(&req_);
+    MPI_Wait(&req_, MPI_STATUS_IGNORE);
+  }
+};
@@ -0,0 +1,72 @@
+#include "stencil/exchange_group.hpp"
+
+#include <nvToolsExt.h>
+
+#include "stencil/logging.hpp"
+
+void ExchangeGroup::realize() {
+  nvtxRangePush("ExchangeGroup::realize()");
+
+  if (dds_.empty()) {
+    LOG_FATAL("ExchangeGroup::realize(): no domains");
+  }
+  DistributedDomain &first = *dds_[0];
+
+  for (DistributedDomain *dd : dds_) {
+    dd->realize();
+  }
+
+  // every domain must be placed like the first, or the plan of the first does not fit the others
+  for (DistributedDomain *dd : dds_) {
+    int result;
+    MPI_Comm_compare(first.comm_, dd->comm_, &result);
+    if (MPI_CONGRUENT != result && MPI_IDENT != result) {
+      LOG_FATAL("ExchangeGroup::realize(): domains are on different ranks");
+    }
+    if (!(dd->size_ == first.size_) || !(dd->radius_ == first.radius_) || dd->flags_ != first.flags_ ||
+        dd->boundary_ != first.boundary_) {
+      LOG_FATAL("ExchangeGroup::realize(): domains differ in size, radius, methods, or boundary");
+    }
+    if (dd->domains_.size() != first.domains_.size()) {
+      LOG_FATAL("ExchangeGroup::realize(): domains have different numbers of subdomains");
+    }
+    for (size_t di = 0; di < first.domains_.size(); ++di) {
+      const LocalDomain &a = first.domains_[di];
+      const LocalDomain &b = dd->domains_[di];
+      if (!(a.origin() == b.origin()) || !(a.size() == b.size()) || a.gpu() != b.gpu()) {
+        LOG_FATAL("ExchangeGroup::realize(): subdomain " << di << " was placed differently in different domains");
+      }
+    }
+  }
+
+  // one view per subdomain over the quantities of all domains
+  views_.reserve(first.domains_.size()); // transports point into views_
+  for (size_t di = 0; di < first.domains_.size(); ++di) {
+    std::vector<const LocalDomain *> parents;
+    for (DistributedDomain *dd : dds_) {
+      parents.push_back(&dd->domains_[di]);
+    }
+    views_.push_back(LocalDomain(parents));
+  }
+  for (LocalDomain &v : views_) {
+    v.realize();
+  }
+
+  MPI_Comm_dup(first.comm_, &comm_);
+  first.create_transports(tx_, views_, comm_);
+
+  nvtxRangePop(); // ExchangeGroup::realize()
+}
+
+void ExchangeGroup::exchange() {
+  nvtxRangePush("ExchangeGroup::exchange()");
+
+  // pick up any swap() since the last exchange
+  for (LocalDomain &v : views_) {
+    v.sync_view();
+  }
+  tx_.start();
+  tx_.finish();
+
+  nvtxRangePop(); // ExchangeGroup::exchange()
+}
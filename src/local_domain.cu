@@ -53,6 +53,23 @@ void LocalDomain::swap() noexcept {
   nvtxRangePop();
 }
 
+void LocalDomain::sync_view() {
+  assert(is_view());
+  bool changed = false;
+  for (size_t i = 0; i < parentIdx_.size(); ++i) {
+    const LocalDomain *parent = parents_[i];
+    const size_t pi = parentIdx_[i];
+    changed |= currDataPtrs_[i] != parent->currDataPtrs_[pi];
+    currDataPtrs_[i] = parent->currDataPtrs_[pi];
+    nextDataPtrs_[i] = parent->nextDataPtrs_[pi];
+  }
+  if (changed) {
+    CUDA_RUNTIME(cudaSetDevice(dev_));
+    CUDA_RUNTIME(cudaMemcpy(devCurrDataPtrs_, currDataPtrs_.data(), currDataPtrs_.size() * sizeof(currDataPtrs_[0]),
+                            cudaMemcpyHostToDevice));
+  }
+}
+
 Dim3 LocalDomain::halo_pos(const Dim3 &dir, const bool halo) const noexcept {
   assert(dir.all_gt(-2));
   assert(dir.all_lt(2));
@@ -106,7 +123,7 @@ std::vector<unsigned char> LocalDomain::region_to_host(const Dim3 &pos, const Di
   CUDA_RUNTIME(cudaMalloc(&devBuf, bytes));
   const dim3 dimBlock = Dim3::make_block_dim(ext, 512);
   const dim3 dimGrid = (ext + Dim3(dimBlock) - 1) / (Dim3(dimBlock));
-  pack_kernel<<<dimGrid, dimBlock>>>(devBuf, curr_data(qi), raw_size(), pos, ext, elem_size(qi));
+  pack_kernel<<<dimGrid, dimBlock>>>(devBuf, curr_data(qi), raw_size(qi), pos, ext, elem_size(qi));
   CUDA_RUNTIME(cudaDeviceSynchronize());
 
   // copy quantity to host
@@ -134,36 +151,51 @@ void LocalDomain::realize() {
   // int rank;
   // MPI_Comm_rank(MPI_COMM_WORLD, &rank);
   // std::cerr << "r" << rank << " dev=" << dev_ << "\n";
-  for (int64_t i = 0; i < num_data(); ++i) {
-    assert(i < dataElemSize_.size());
-    int64_t elemSz = dataElemSize_[i];
-    LOG_SPEW("elemSz=" << elemSz);
-    LOG_SPEW("radius +x=" << radius_.x(1));
-    LOG_SPEW("radius -x=" << radius_.x(-1));
-    LOG_SPEW("radius +y=" << radius_.y(1));
-    LOG_SPEW("radius -y=" << radius_.y(-1));
-    LOG_SPEW("radius +z=" << radius_.z(1));
-    LOG_SPEW("radius -z=" << radius_.z(-1));
-
-    int64_t elemBytes = ((sz_.x + radius_.x(-1) + radius_.x(1)) * (sz_.y + radius_.y(-1) + radius_.y(1)) *
-                         (sz_.z + radius_.z(-1) + radius_.z(1))) *
-                        elemSz;
-    LOG_SPEW("allocate " << elemBytes << " bytes");
-    char *c = nullptr;
-    char *n = nullptr;
-    CUDA_RUNTIME(cudaMalloc(&c, elemBytes));
-    CUDA_RUNTIME(cudaMalloc(&n, elemBytes));
-    assert(uintptr_t(c) % elemSz == 0 && "allocation should be aligned");
-    assert(uintptr_t(n) % elemSz == 0 && "allocation should be aligned");
-    currDataPtrs_[i] = c;
-    nextDataPtrs_[i] = n;
+  if (is_view()) {
+    // a view shares its parents' allocations
+    for (int64_t i = 0; i < num_data(); ++i) {
+      currDataPtrs_[i] = parents_[i]->currDataPtrs_[parentIdx_[i]];
+      nextDataPtrs_[i] = parents_[i]->nextDataPtrs_[parentIdx_[i]];
+    }
+  } else {
+    for (int64_t i = 0; i < num_data(); ++i) {
+      assert(i < dataElemSize_.size());
+      int64_t elemSz = dataElemSize_[i];
+      LOG_SPEW("elemSz=" << elemSz);
+      LOG_SPEW("radius +x=" << radius_.x(1));
+      LOG_SPEW("radius -x=" << radius_.x(-1));
+      LOG_SPEW("radius +y=" << radius_.y(1));
+      LOG_SPEW("radius -y=" << radius_.y(-1));
+      LOG_SPEW("radius +z=" << radius_.z(1));
+      LOG_SPEW("radius -z=" << radius_.z(-1));
+
+      int64_t elemBytes = raw_size(i).flatten() * elemSz;
+      LOG_SPEW("allocate " << elemBytes << " bytes");
+      char *c = nullptr;
+      char *n = nullptr;
+      CUDA_RUNTIME(cudaMalloc(&c, elemBytes));
+      CUDA_RUNTIME(cudaMalloc(&n, elemBytes));
+      assert(uintptr_t(c) % elemSz == 0 && "allocation should be aligned");
+      assert(uintptr_t(n) % elemSz == 0 && "allocation should be aligned");
+      currDataPtrs_[i] = c;
+      nextDataPtrs_[i] = n;
+    }
   }
 
   CUDA_RUNTIME(cudaMalloc(&devCurrDataPtrs_, currDataPtrs_.size() * sizeof(currDataPtrs_[0])));
   CUDA_RUNTIME(cudaMalloc(&devDataElemSize_, dataElemSize_.size() * sizeof(dataElemSize_[0])));
+  CUDA_RUNTIME(cudaMalloc(&devDataType_, dataType_.size() * sizeof(dataType_[0])));
+  CUDA_RUNTIME(cudaMalloc(&devDataStagger_, dataStagger_.size() * sizeof(dataStagger_[0])));
   CUDA_RUNTIME(cudaMemcpy(devCurrDataPtrs_, currDataPtrs_.data(), currDataPtrs_.size() * sizeof(currDataPtrs_[0]),
                           cudaMemcpyHostToDevice));
   CUDA_RUNTIME(cudaMemcpy(devDataElemSize_, dataElemSize_.data(), dataElemSize_.size() * sizeof(dataElemSize_[0]),
                           cudaMemcpyHostToDevice));
+  CUDA_RUNTIME(cudaMemcpy(devDataType_, dataType_.data(), dataType_.size() * sizeof(dataType_[0]),
+                          cudaMemcpyHostToDevice));
+  CUDA_RUNTIME(cudaMemcpy(devDataStagger_, dataStagger_.data(), dataStagger_.size() * sizeof(dataStagger_[0]),
+                          cudaMemcpyHostToDevice));
+  if (!is_view()) {
+    particles_.realize(dev_);
+  }
   CUDA_RUNTIME(cudaGetLastError());
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "stencil/rcstream.hpp"
 
+#include "stencil/logging.hpp"
+
 #include <cassert>
 
 void RcStream::maybe_release() {
@@ -26,7 +28,7 @@ RcStream::RcStream(int dev, Priority requestedPriority) : count_(new size_t), de
   int maxPrio;
   CUDA_RUNTIME(cudaDeviceGetStreamPriorityRange(&minPrio, &maxPrio));
   if (minPrio == maxPrio) {
-    std::cerr << "WARN: stream priority not supported\n";
+    LOG_WARN("stream priority not supported");
   }
 
   int priority;
@@ -39,8 +41,7 @@ RcStream::RcStream(int dev, Priority requestedPriority) : count_(new size_t), de
     break;
   default:
     priority = 0;
-    std::cerr << "unexpected priority\n";
-    exit(EXIT_FAILURE);
+    LOG_FATAL("unexpected priority");
   }
   CUDA_RUNTIME(cudaStreamCreateWithPriority(&stream_, cudaStreamNonBlocking, priority));
 }
\ No newline at end of file
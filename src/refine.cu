@@ -0,0 +1,224 @@
+#include "stencil/refine.hpp"
+
+#include <nvToolsExt.h>
+
+#include "stencil/direction_set.hpp"
+#include "stencil/logging.hpp"
+#include "stencil/tx_boundary.cuh"
+
+/* fill the region finePos...finePos+ext of each fine quantity by trilinear interpolation of the coarse quantity.
+   fineOrigin and coarseOrigin are the coordinates of raw point (0,0,0) of each, in fine patch and coarse parent
+   coordinates. Points are cell-centered, so fine point f is at coarse point regionLo + (f + 0.5) / ratio - 0.5
+*/
+static __global__ void prolong_kernel(void *__restrict__ *__restrict__ fines, const Dim3 fineRaw, const Dim3 finePos,
+                                      const Dim3 ext, const Dim3 fineOrigin, void *__restrict__ *__restrict__ coarses,
+                                      const Dim3 coarseRaw, const Dim3 coarseOrigin, const Dim3 regionLo,
+                                      const int64_t ratio, const size_t *__restrict__ elemSizes,
+                                      const DataType *__restrict__ types, const size_t n) {
+
+  const size_t tz = blockDim.z * blockIdx.z + threadIdx.z;
+  const size_t ty = blockDim.y * blockIdx.y + threadIdx.y;
+  const size_t tx = blockDim.x * blockIdx.x + threadIdx.x;
+
+  for (int64_t z = tz; z < ext.z; z += blockDim.z * gridDim.z) {
+    for (int64_t y = ty; y < ext.y; y += blockDim.y * gridDim.y) {
+      for (int64_t x = tx; x < ext.x; x += blockDim.x * gridDim.x) {
+        const Dim3 o = finePos + Dim3(x, y, z); // fine raw index
+        const Dim3 f = fineOrigin + o;          // fine patch coordinate
+
+        // the coarse raw points on either side of f, and the weight of the upper one
+        Dim3 lo, hi;
+        double w[3];
+        for (int a = 0; a < 3; ++a) {
+          const double c = regionLo[a] + (f[a] + 0.5) / ratio - 0.5 - coarseOrigin[a];
+          const int64_t c0 = int64_t(floor(c));
+          w[a] = c - c0;
+          lo[a] = min(max(c0, int64_t(0)), coarseRaw[a] - 1);
+          hi[a] = min(max(c0 + 1, int64_t(0)), coarseRaw[a] - 1);
+        }
+
+        for (size_t qi = 0; qi < n; ++qi) {
+          const size_t elemSize = elemSizes[qi];
+          const char *coarse = static_cast<const char *>(coarses[qi]);
+          double v = 0;
+          for (int k = 0; k < 8; ++k) {
+            const Dim3 p((k & 1) ? hi.x : lo.x, (k & 2) ? hi.y : lo.y, (k & 4) ? hi.z : lo.z);
+            const double wk = ((k & 1) ? w[0] : 1 - w[0]) * ((k & 2) ? w[1] : 1 - w[1]) * ((k & 4) ? w[2] : 1 - w[2]);
+            v += wk * boundary_load(&coarse[(p.z * coarseRaw.y * coarseRaw.x + p.y * coarseRaw.x + p.x) * elemSize],
+                                    types[qi]);
+          }
+          char *fine = static_cast<char *>(fines[qi]);
+          boundary_store(&fine[(o.z * fineRaw.y * fineRaw.x + o.y * fineRaw.x + o.x) * elemSize], types[qi], v);
+        }
+      }
+    }
+  }
+}
+
+/* overwrite ext coarse points from coarsePos with the average of the ratio^3 fine points from finePos they cover.
+   Both positions are raw indices
+*/
+static __global__ void coarsen_kernel(void *__restrict__ *__restrict__ coarses, const Dim3 coarseRaw,
+                                      const Dim3 coarsePos, const Dim3 ext, void *__restrict__ *__restrict__ fines,
+                                      const Dim3 fineRaw, const Dim3 finePos, const int64_t ratio,
+                                      const size_t *__restrict__ elemSizes, const DataType *__restrict__ types,
+                                      const size_t n) {
+
+  const size_t tz = blockDim.z * blockIdx.z + threadIdx.z;
+  const size_t ty = blockDim.y * blockIdx.y + threadIdx.y;
+  const size_t tx = blockDim.x * blockIdx.x + threadIdx.x;
+
+  for (int64_t z = tz; z < ext.z; z += blockDim.z * gridDim.z) {
+    for (int64_t y = ty; y < ext.y; y += blockDim.y * gridDim.y) {
+      for (int64_t x = tx; x < ext.x; x += blockDim.x * gridDim.x) {
+        const Dim3 c = coarsePos + Dim3(x, y, z);
+        const Dim3 f0 = finePos + Dim3(x, y, z) * ratio;
+        for (size_t qi = 0; qi < n; ++qi) {
+          const size_t elemSize = elemSizes[qi];
+          const char *fine = static_cast<const char *>(fines[qi]);
+          double v = 0;
+          for (int64_t k = 0; k < ratio; ++k) {
+            for (int64_t j = 0; j < ratio; ++j) {
+              for (int64_t i = 0; i < ratio; ++i) {
+                const Dim3 f = f0 + Dim3(i, j, k);
+                v += boundary_load(&fine[(f.z * fineRaw.y * fineRaw.x + f.y * fineRaw.x + f.x) * elemSize], types[qi]);
+              }
+            }
+          }
+          char *coarse = static_cast<char *>(coarses[qi]);
+          boundary_store(&coarse[(c.z * coarseRaw.y * coarseRaw.x + c.y * coarseRaw.x + c.x) * elemSize], types[qi],
+                         v / (ratio * ratio * ratio));
+        }
+      }
+    }
+  }
+}
+
+RefinedPatch::RefinedPatch(DistributedDomain &parent, const Rect3 &region)
+    : parent_(parent), region_(region), fine_(RATIO * region.extent().x, RATIO * region.extent().y,
+                                              RATIO * region.extent().z, parent.comm()),
+      placement_(nullptr) {
+
+  if (!parent_.placement_) {
+    LOG_FATAL("RefinedPatch: the parent must be realized");
+  }
+  for (int a = 0; a < 3; ++a) {
+    if (region_.lo[a] < 0 || region_.hi[a] > parent_.size_[a] || region_.lo[a] >= region_.hi[a]) {
+      LOG_FATAL("RefinedPatch: region " << region_ << " is not inside the parent " << parent_.size_);
+    }
+  }
+  for (size_t qi = 0; qi < parent_.dataType_.size(); ++qi) {
+    if (DataType::None == parent_.dataType_[qi] || parent_.dataStagger_[qi].any()) {
+      LOG_FATAL("RefinedPatch: quantity " << parent_.dataName_[qi] << " has no DataType or is staggered");
+    }
+  }
+
+  // the same quantities, so the parent's handles work on the patch
+  fine_.dataElemSize_ = parent_.dataElemSize_;
+  fine_.dataName_ = parent_.dataName_;
+  fine_.dataType_ = parent_.dataType_;
+  fine_.dataStagger_ = parent_.dataStagger_;
+  fine_.ensembleSize_ = parent_.ensembleSize_;
+  fine_.radius_ = parent_.radius_;
+  fine_.flags_ = parent_.flags_;
+  fine_.gpus_ = parent_.gpus_;
+
+  // periodic only where the patch wraps around a periodic parent, otherwise the parent fills the halo
+  for (int a = 0; a < 3; ++a) {
+    const bool whole = 0 == region_.lo[a] && parent_.size_[a] == region_.hi[a];
+    if (!whole || !parent_.boundary_.periodic(a)) {
+      Dim3 face(0, 0, 0);
+      face[a] = 1;
+      fine_.set_boundary(face, BoundaryCondition::external());
+      fine_.set_boundary(face * -1, BoundaryCondition::external());
+    }
+  }
+
+  placement_ = new Refined(*parent_.placement_, region_, RATIO, parent_.worldSize_);
+  fine_.placement_ = placement_;
+}
+
+void RefinedPatch::realize() {
+  nvtxRangePush("RefinedPatch::realize()");
+  fine_.realize();
+
+  const Dim3 dim = placement_->dim();
+  const Boundary &boundary = fine_.boundary();
+  typedef Directions<RadiusShape::Full> Dirs;
+  for (size_t di = 0; di < fine_.domains_.size(); ++di) {
+    const Dim3 idx = placement_->get_idx(fine_.rank_, di);
+    const size_t pi = parent_.placement_->get_subdomain_id(placement_->parent_idx(idx));
+    assert(parent_.placement_->get_rank(placement_->parent_idx(idx)) == parent_.rank_);
+    assert(parent_.domains_[pi].gpu() == fine_.domains_[di].gpu());
+    parentDomain_.push_back(pi);
+    streams_.push_back(RcStream(fine_.domains_[di].gpu()));
+
+    prolongDirs_.push_back({});
+    for (size_t i = 0; i < Dirs::count; ++i) {
+      const Dim3 dir = Dirs::at(i);
+      if (0 == fine_.radius_.dir(dir)) {
+        continue;
+      }
+      for (int a = 0; a < 3; ++a) {
+        const int64_t j = idx[a] + dir[a];
+        if ((j < 0 || j >= dim[a]) && BoundaryKind::External == boundary.face(a, dir[a]).kind) {
+          prolongDirs_.back().push_back(dir);
+          break;
+        }
+      }
+    }
+  }
+  nvtxRangePop(); // RefinedPatch::realize()
+}
+
+void RefinedPatch::prolong() {
+  nvtxRangePush("RefinedPatch::prolong()");
+  for (size_t di = 0; di < fine_.domains_.size(); ++di) {
+    const LocalDomain &fd = fine_.domains_[di];
+    const LocalDomain &cd = parent_.domains_[parentDomain_[di]];
+    const Dim3 fineOrigin = fd.origin() - fd.halo_pos(Dim3(0, 0, 0), false);
+    const Dim3 coarseOrigin = cd.origin() - cd.halo_pos(Dim3(0, 0, 0), false);
+    CUDA_RUNTIME(cudaSetDevice(fd.gpu()));
+    for (const Dim3 &dir : prolongDirs_[di]) {
+      const Dim3 pos = fd.halo_pos(dir, true /*exterior*/);
+      const Dim3 ext = fd.halo_extent(dir);
+      const dim3 dimBlock = Dim3::make_block_dim(ext, 512 /*threads per block*/);
+      const dim3 dimGrid = (ext + Dim3(dimBlock) - 1) / (Dim3(dimBlock));
+      prolong_kernel<<<dimGrid, dimBlock, 0, streams_[di]>>>(
+          fd.dev_curr_datas(), fd.raw_size(), pos, ext, fineOrigin, cd.dev_curr_datas(), cd.raw_size(), coarseOrigin,
+          region_.lo, RATIO, fd.dev_elem_sizes(), fd.dev_data_types(), fd.num_data());
+      CUDA_RUNTIME(cudaGetLastError());
+    }
+  }
+  for (RcStream &stream : streams_) {
+    CUDA_RUNTIME(cudaSetDevice(stream.device()));
+    CUDA_RUNTIME(cudaStreamSynchronize(stream));
+  }
+  nvtxRangePop(); // RefinedPatch::prolong()
+}
+
+void RefinedPatch::coarsen() {
+  nvtxRangePush("RefinedPatch::coarsen()");
+  for (size_t di = 0; di < fine_.domains_.size(); ++di) {
+    const LocalDomain &fd = fine_.domains_[di];
+    const LocalDomain &cd = parent_.domains_[parentDomain_[di]];
+    // fine subdomains start and end on coarse points
+    assert(0 == fd.origin().x % RATIO && 0 == fd.origin().y % RATIO && 0 == fd.origin().z % RATIO);
+    const Dim3 ext = fd.size() / Dim3(RATIO, RATIO, RATIO);
+    const Dim3 coarsePos = region_.lo + fd.origin() / Dim3(RATIO, RATIO, RATIO) - cd.origin() +
+                           cd.halo_pos(Dim3(0, 0, 0), false);
+    const dim3 dimBlock = Dim3::make_block_dim(ext, 512 /*threads per block*/);
+    const dim3 dimGrid = (ext + Dim3(dimBlock) - 1) / (Dim3(dimBlock));
+    CUDA_RUNTIME(cudaSetDevice(fd.gpu()));
+    coarsen_kernel<<<dimGrid, dimBlock, 0, streams_[di]>>>(cd.dev_curr_datas(), cd.raw_size(), coarsePos, ext,
+                                                           fd.dev_curr_datas(), fd.raw_size(),
+                                                           fd.halo_pos(Dim3(0, 0, 0), false), RATIO,
+                                                           fd.dev_elem_sizes(), fd.dev_data_types(), fd.num_data());
+    CUDA_RUNTIME(cudaGetLastError());
+  }
+  for (RcStream &stream : streams_) {
+    CUDA_RUNTIME(cudaSetDevice(stream.device()));
+    CUDA_RUNTIME(cudaStreamSynchronize(stream));
+  }
+  nvtxRangePop(); // RefinedPatch::coarsen()
+}
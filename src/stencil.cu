@@ -1,6 +1,10 @@
 #include "stencil/logging.hpp"
 #include "stencil/stencil.hpp"
 
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <thread>
 #include <vector>
 
 uint64_t DistributedDomain::exchange_bytes_for_method(const MethodFlags &method) const {
@@ -27,51 +31,166 @@ uint64_t DistributedDomain::exchange_bytes_for_method(const MethodFlags &method)
 void DistributedDomain::realize() {
   // TODO: make sure everyone has the same Placement Strategy
 
+  // the shared face of a staggered quantity travels in the + halo along its axis
+  for (size_t qi = 0; qi < dataStagger_.size(); ++qi) {
+    const Dim3 &s = dataStagger_[qi];
+    if ((s.x && 0 == radius_.x(1)) || (s.y && 0 == radius_.y(1)) || (s.z && 0 == radius_.z(1))) {
+      LOG_FATAL("quantity " << dataName_[qi] << " is staggered along an axis whose + radius is 0");
+    }
+  }
+
+  if (!boundary_.valid()) {
+    LOG_FATAL("an axis has a boundary condition on one face and is periodic on the other");
+  }
+  for (int i = 0; i < 3; ++i) {
+    for (int side : {-1, 1}) {
+      const BoundaryKind kind = boundary_.face(i, side).kind;
+      if (BoundaryKind::Dirichlet != kind && BoundaryKind::Extrapolate != kind) {
+        continue;
+      }
+      for (size_t qi = 0; qi < dataType_.size(); ++qi) {
+        if (DataType::None == dataType_[qi]) {
+          LOG_FATAL("quantity " << dataName_[qi] << " has no DataType for a Dirichlet or Extrapolate boundary");
+        }
+      }
+    }
+  }
+
   // compute domain placement
 #ifdef STENCIL_SETUP_STATS
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Barrier(comm_);
   double start = MPI_Wtime();
 #endif
   nvtxRangePush("placement");
-  if (strategy_ == PlacementStrategy::NodeAware) {
-    assert(!placement_);
-    placement_ = new NodeAware(size_, mpiTopology_, radius_, gpus_);
-  } else {
-    assert(!placement_);
-    placement_ = new Trivial(size_, mpiTopology_, gpus_);
+
+  // a placement set before realize(), for example by RefinedPatch, is used as-is
+  if (!placement_) {
+    // decide how many subdomains go on each GPU
+    int64_t perGpu = subdomainsPerGpu_;
+    if (!mask_.empty()) {
+      perGpu = 1; // the active blocks are the subdomains, each GPU just contributes itself
+    } else if (0 == perGpu) {
+      size_t cacheBytes = subdomainCacheBytes_;
+      if (0 == cacheBytes) {
+        cacheBytes = std::numeric_limits<size_t>::max();
+        for (int gpu : gpus_) {
+          cudaDeviceProp prop;
+          CUDA_RUNTIME(cudaGetDeviceProperties(&prop, gpu));
+          cacheBytes = std::min(cacheBytes, size_t(prop.l2CacheSize));
+        }
+      }
+      size_t bytesPerPoint = 0;
+      for (size_t elemSize : dataElemSize_) {
+        bytesPerPoint += 2 * elemSize; // curr and next
+      }
+      int64_t numGpus = gpus_.size();
+      MPI_Allreduce(MPI_IN_PLACE, &numGpus, 1, MPI_INT64_T, MPI_SUM, comm_);
+      perGpu = subdomains_for_cache(size_.flatten() / numGpus, bytesPerPoint, cacheBytes,
+                                    MAX_RANK_SUBDOMAINS / int64_t(gpus_.size()));
+      // placement expects every rank to contribute the same number of subdomains
+      MPI_Allreduce(MPI_IN_PLACE, &perGpu, 1, MPI_INT64_T, MPI_MIN, comm_);
+      LOG_INFO("sized " << perGpu << " subdomains per GPU for " << cacheBytes << "B cache");
+    }
+    if (int64_t(gpus_.size()) * perGpu > MAX_RANK_SUBDOMAINS) {
+      LOG_FATAL(gpus_.size() * perGpu << " subdomains requested, but a rank may have at most " << MAX_RANK_SUBDOMAINS);
+    }
+
+    // the CUDA device of each subdomain this rank contributes
+    std::vector<int> sdCudaIds;
+    for (int gpu : gpus_) {
+      for (int64_t i = 0; i < perGpu; ++i) {
+        sdCudaIds.push_back(gpu);
+      }
+    }
+
+    if (!mask_.empty()) {
+      assert(!placement_);
+      placement_ = new Masked(size_, maskBlocks_, mask_, mpiTopology_, sdCudaIds);
+    } else if (strategy_ == PlacementStrategy::NodeAware) {
+      assert(!placement_);
+      placement_ = new NodeAware(size_, mpiTopology_, radius_, sdCudaIds);
+    } else {
+      assert(!placement_);
+      placement_ = new Trivial(size_, mpiTopology_, sdCudaIds);
+    }
+
+    // too many subdomains for the domain and radius makes them mostly halo. Use fewer, thicker ones instead
+    if (mask_.empty() && minEfficiency_ > 0) {
+      const double efficiency = placement_efficiency(*placement_, radius_);
+      if (efficiency < minEfficiency_) {
+        const int64_t numSubdomains = placement_->dim().flatten();
+        const Dim3 blocks = efficient_split(size_, numSubdomains, radius_, minEfficiency_);
+        if (0 == rank_) {
+          LOG_WARN("partition efficiency " << efficiency << " is below " << minEfficiency_ << ", using "
+                                           << blocks.flatten() << " of " << numSubdomains << " subdomains as "
+                                           << blocks);
+        }
+        delete placement_;
+        placement_ = new Masked(size_, blocks, std::vector<bool>(blocks.flatten(), true), mpiTopology_, sdCudaIds);
+      }
+    }
   }
   assert(placement_);
+
+  partitionEfficiency_ = placement_efficiency(*placement_, radius_);
+  if (0 == rank_) {
+    LOG_INFO("partition efficiency " << partitionEfficiency_
+                                     << " (compute / allocated points of the thinnest subdomain)");
+  }
+
+  // make sure the tags for the most subdomains on any rank are valid on comm_. With a mask, ranks may differ
+  {
+    int64_t maxSubdomains = 0;
+    for (int r = 0; r < mpiTopology_.size(); ++r) {
+      maxSubdomains = std::max(maxSubdomains, placement_->num_subdomains(r));
+    }
+    if (maxSubdomains > MAX_RANK_SUBDOMAINS) {
+      LOG_FATAL(maxSubdomains << " subdomains placed on a rank, but a rank may have at most " << MAX_RANK_SUBDOMAINS);
+    }
+    int *tagUb;
+    int flag;
+    MPI_Comm_get_attr(comm_, MPI_TAG_UB, &tagUb, &flag);
+    const int maxId = std::max(int(maxSubdomains) - 1, 0);
+    const int maxTag = make_tag<MsgKind::Particle>(subdomain_pair(maxId, maxId)); // the largest kind
+    if (flag && *tagUb < maxTag) {
+      LOG_FATAL(maxSubdomains << " subdomains per rank needs MPI tags up to " << maxTag << ", but MPI_TAG_UB is "
+                              << *tagUb);
+    }
+  }
   nvtxRangePop(); // "placement"
 #ifdef STENCIL_SETUP_STATS
   double maxElapsed = -1;
   double elapsed = MPI_Wtime() - start;
-  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm_);
   if (0 == rank_) {
     timePlacement_ += maxElapsed;
   }
 #endif
 
 #ifdef STENCIL_SETUP_STATS
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Barrier(comm_);
   start = MPI_Wtime();
 #endif
-  for (int64_t domId = 0; domId < int64_t(gpus_.size()); domId++) {
+  for (int64_t domId = 0; domId < placement_->num_subdomains(rank_); domId++) {
 
     const Dim3 idx = placement_->get_idx(rank_, domId);
     const Dim3 sdSize = placement_->subdomain_size(idx);
     const Dim3 sdOrigin = placement_->subdomain_origin(idx);
 
-    // placement algorithm should agree with me what my GPU is
-    assert(placement_->get_cuda(idx) == gpus_[domId]);
+    // placement algorithm should put my subdomains on my GPUs
+    assert(std::find(gpus_.begin(), gpus_.end(), placement_->get_cuda(idx)) != gpus_.end());
 
     const int cudaId = placement_->get_cuda(idx);
 
-    fprintf(stderr, "rank=%d gpu=%ld (cuda id=%d) => [%ld,%ld,%ld]\n", rank_, domId, cudaId, idx.x, idx.y, idx.z);
+    LOG_DEBUG("subdomain " << domId << " (cuda id=" << cudaId << ") => " << idx);
 
     LocalDomain sd(sdSize, sdOrigin, cudaId);
     sd.set_radius(radius_);
     for (size_t dataIdx = 0; dataIdx < dataElemSize_.size(); ++dataIdx) {
-      sd.add_data(dataElemSize_[dataIdx]);
+      sd.add_data(dataElemSize_[dataIdx], dataName_[dataIdx], dataType_[dataIdx], dataStagger_[dataIdx]);
+    }
+    for (size_t ai = 0; ai < particleElemSize_.size(); ++ai) {
+      sd.particles().add_attr(particleElemSize_[ai], particleName_[ai]);
     }
 
     domains_.push_back(sd);
@@ -82,34 +201,24 @@ void DistributedDomain::realize() {
   }
 #ifdef STENCIL_SETUP_STATS
   elapsed = MPI_Wtime() - start;
-  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm_);
   if (0 == rank_) {
     timeRealize_ += maxElapsed;
   }
 #endif
 
 #ifdef STENCIL_SETUP_STATS
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Barrier(comm_);
   start = MPI_Wtime();
 #endif
 
-  // outbox for same-GPU exchanges
-  std::vector<Message> peerAccessOutbox;
-
-  // outboxes for same-rank exchanges
-  std::vector<std::vector<std::vector<Message>>> peerCopyOutboxes;
-  // peerCopyOutboxes[di][dj] = peer copy from di to dj
-
-  // outbox for co-located domains in different ranks
-  // one outbox for each co-located domain
-  std::vector<std::map<Dim3, std::vector<Message>>> coloOutboxes;
-  std::vector<std::map<Dim3, std::vector<Message>>> coloInboxes;
-  // coloOutboxed[di][dstRank] = messages
-
-  // inbox for each remote domain my domains recv from
-  std::vector<std::map<Dim3, std::vector<Message>>> remoteInboxes; // remoteOutboxes_[domain][srcIdx] = messages
-  // outbox for each remote domain my domains send to
-  std::vector<std::map<Dim3, std::vector<Message>>> remoteOutboxes; // remoteOutboxes[domain][dstIdx] = messages
+  // the messages of every exchange, kept so transports for quantity subsets can be created later
+  std::vector<Message> &peerAccessOutbox = plan_.peerAccessOutbox;
+  std::vector<std::vector<std::vector<Message>>> &peerCopyOutboxes = plan_.peerCopyOutboxes;
+  std::vector<std::map<Dim3, std::vector<Message>>> &coloOutboxes = plan_.coloOutboxes;
+  std::vector<std::map<Dim3, std::vector<Message>>> &coloInboxes = plan_.coloInboxes;
+  std::vector<std::map<Dim3, std::vector<Message>>> &remoteInboxes = plan_.remoteInboxes;
+  std::vector<std::map<Dim3, std::vector<Message>>> &remoteOutboxes = plan_.remoteOutboxes;
 
   LOG_DEBUG("comm plan");
   /*
@@ -118,130 +227,147 @@ void DistributedDomain::realize() {
   size would be zero
   */
   nvtxRangePush("DistributedDomain::realize() plan messages");
-  peerCopyOutboxes.resize(gpus_.size());
+  peerCopyOutboxes.resize(domains_.size());
   for (auto &v : peerCopyOutboxes) {
-    v.resize(gpus_.size());
+    v.resize(domains_.size());
   }
-  coloOutboxes.resize(gpus_.size());
-  coloInboxes.resize(gpus_.size());
-  remoteOutboxes.resize(gpus_.size());
-  remoteInboxes.resize(gpus_.size());
+  coloOutboxes.resize(domains_.size());
+  coloInboxes.resize(domains_.size());
+  remoteOutboxes.resize(domains_.size());
+  remoteInboxes.resize(domains_.size());
 
   const Dim3 globalDim = placement_->dim();
 
+  // only consider directions the stencil shape can reach along the domain's axes (e.g. 4 instead of 26 for a 2D star
+  // stencil, or 8 for a constant radius on a domain one point thick in z)
+  dirs_ = make_directions(radius_.shape(), size_);
+  LOG_DEBUG("planning with " << dirs_.size() << " directions");
+
   for (size_t di = 0; di < domains_.size(); ++di) {
     const Dim3 myIdx = placement_->get_idx(rank_, di);
     const int myDev = domains_[di].gpu();
     assert(myDev == placement_->get_cuda(myIdx));
-    for (int z = -1; z <= 1; ++z) {
-      for (int y = -1; y <= 1; ++y) {
-        for (int x = -1; x <= 1; ++x) {
-          // send direction
-          const Dim3 dir(x, y, z);
-          if (Dim3(0, 0, 0) == dir) {
-            continue; // no message
-          }
-
-          // Only do sends when the stencil radius in the opposite
-          // direction is non-zero for example, if +x radius is 2, our -x
-          // neighbor needs a halo region from us, so we need to plan to send
-          // in that direction
-          if (0 == radius_.dir(dir * -1)) {
-            continue; // no sends or recvs for this dir
-          } else {
-            LOG_DEBUG(dir << " radius = " << radius_.dir(dir * -1));
-          }
+    for (const Dim3 &dir : dirs_) { // send direction
+      // Only do sends when the stencil radius in the opposite
+      // direction is non-zero for example, if +x radius is 2, our -x
+      // neighbor needs a halo region from us, so we need to plan to send
+      // in that direction
+      if (0 == radius_.dir(dir * -1)) {
+        continue; // no sends or recvs for this dir
+      } else {
+        LOG_DEBUG(dir << " radius = " << radius_.dir(dir * -1));
+      }
 
-          // TODO: this assumes we have periodic boundaries
-          // we can filter out some messages here if we do not
-          const Dim3 dstIdx = (myIdx + dir).wrap(globalDim);
-          const int dstRank = placement_->get_rank(dstIdx);
-          const int dstGPU = placement_->get_subdomain_id(dstIdx);
-          const int dstDev = placement_->get_cuda(dstIdx);
-          Message sMsg(dir, di, dstGPU);
-
-          if (any_methods(MethodFlags::CudaKernel)) {
-            if (dstRank == rank_ && myDev == dstDev) {
-              peerAccessOutbox.push_back(sMsg);
-              goto send_planned;
-            }
-          }
-          if (any_methods(MethodFlags::CudaMemcpyPeer)) {
-            LOG_DEBUG("peer " << rank_ << " " << dstRank << " peer(" << myDev << "," << dstDev << ")=" << gpu_topo::peer(myDev, dstDev));
-            if (dstRank == rank_ && gpu_topo::peer(myDev, dstDev)) {
-              peerCopyOutboxes[di][dstGPU].push_back(sMsg);
-              goto send_planned;
-            }
-          }
-          if (any_methods(MethodFlags::CudaMpiColocated)) {
-            if ((dstRank != rank_) && mpiTopology_.colocated(dstRank) && gpu_topo::peer(myDev, dstDev)) {
-              assert(di < coloOutboxes.size());
-              coloOutboxes[di].emplace(dstIdx, std::vector<Message>());
-              coloOutboxes[di][dstIdx].push_back(sMsg);
-              LOG_DEBUG("mpi-colocated for Mesage dir=" << sMsg.dir_);
-              goto send_planned;
-            }
+      // halos past a face that is not periodic, or that wrap onto this subdomain, are filled by boundary ops.
+      // Halos that face an inactive block are not filled
+      if (!boundary_.crosses(myIdx, dir, globalDim) && (myIdx + dir).wrap(globalDim) != myIdx &&
+          placement_->active((myIdx + dir).wrap(globalDim))) {
+        const Dim3 dstIdx = (myIdx + dir).wrap(globalDim);
+        const int dstRank = placement_->get_rank(dstIdx);
+        const int dstGPU = placement_->get_subdomain_id(dstIdx);
+        const int dstDev = placement_->get_cuda(dstIdx);
+        Message sMsg(dir, di, dstGPU);
+
+        if (any_methods(MethodFlags::CudaKernel)) {
+          if (dstRank == rank_ && myDev == dstDev) {
+            peerAccessOutbox.push_back(sMsg);
+            goto send_planned;
           }
-          if (any_methods(MethodFlags::CudaMpi | MethodFlags::CudaAwareMpi)) {
-            assert(di < remoteOutboxes.size());
-            remoteOutboxes[di][dstIdx].push_back(sMsg);
-            LOG_DEBUG("Plan send <remote> "
-                      << myIdx << " (r" << rank_ << "d" << di << "g" << myDev << ")"
-                      << " -> " << dstIdx << " (r" << dstRank << "d" << dstGPU << "g" << dstDev << ")"
-                      << " (dir=" << dir << ", rad" << dir * -1 << "=" << radius_.dir(dir * -1) << ")");
+        }
+        if (any_methods(MethodFlags::CudaMemcpyPeer)) {
+          LOG_DEBUG("peer " << rank_ << " " << dstRank << " peer(" << myDev << "," << dstDev << ")=" << gpu_topo::peer(myDev, dstDev));
+          if (dstRank == rank_ && gpu_topo::peer(myDev, dstDev)) {
+            peerCopyOutboxes[di][dstGPU].push_back(sMsg);
             goto send_planned;
           }
-          LOG_FATAL("No method available to send required message " << sMsg.dir_ << "\n");
-        send_planned: // successfully found a way to send
-
-          // TODO: this assumes we have periodic boundaries
-          // we can filter out some messages here if we do not
-          const Dim3 srcIdx = (myIdx - dir).wrap(globalDim);
-          const int srcRank = placement_->get_rank(srcIdx);
-          const int srcGPU = placement_->get_subdomain_id(srcIdx);
-          const int srcDev = placement_->get_cuda(srcIdx);
-          Message rMsg(dir, srcGPU, di);
-
-          if (any_methods(MethodFlags::CudaKernel)) {
-            if (srcRank == rank_ && srcDev == myDev) {
-              // no recver needed
-              goto recv_planned;
-            }
+        }
+        if (any_methods(MethodFlags::CudaMpiColocated)) {
+          if ((dstRank != rank_) && mpiTopology_.colocated(dstRank) && gpu_topo::peer(myDev, dstDev)) {
+            assert(di < coloOutboxes.size());
+            coloOutboxes[di].emplace(dstIdx, std::vector<Message>());
+            coloOutboxes[di][dstIdx].push_back(sMsg);
+            LOG_DEBUG("mpi-colocated for Mesage dir=" << sMsg.dir_);
+            goto send_planned;
           }
-          if (any_methods(MethodFlags::CudaMemcpyPeer)) {
-            if (srcRank == rank_ && gpu_topo::peer(srcDev, myDev)) {
-              // no recver needed
-              goto recv_planned;
-            }
+        }
+        if (any_methods(MethodFlags::CudaMpi | MethodFlags::CudaAwareMpi)) {
+          assert(di < remoteOutboxes.size());
+          remoteOutboxes[di][dstIdx].push_back(sMsg);
+          LOG_DEBUG("Plan send <remote> "
+                    << myIdx << " (r" << rank_ << "d" << di << "g" << myDev << ")"
+                    << " -> " << dstIdx << " (r" << dstRank << "d" << dstGPU << "g" << dstDev << ")"
+                    << " (dir=" << dir << ", rad" << dir * -1 << "=" << radius_.dir(dir * -1) << ")");
+          goto send_planned;
+        }
+        LOG_FATAL("No method available to send required message " << sMsg.dir_ << "\n");
+      }
+    send_planned: // successfully found a way to send
+
+      if (!boundary_.crosses(myIdx, dir * -1, globalDim) && (myIdx - dir).wrap(globalDim) != myIdx &&
+          placement_->active((myIdx - dir).wrap(globalDim))) {
+        const Dim3 srcIdx = (myIdx - dir).wrap(globalDim);
+        const int srcRank = placement_->get_rank(srcIdx);
+        const int srcGPU = placement_->get_subdomain_id(srcIdx);
+        const int srcDev = placement_->get_cuda(srcIdx);
+        Message rMsg(dir, srcGPU, di);
+
+        if (any_methods(MethodFlags::CudaKernel)) {
+          if (srcRank == rank_ && srcDev == myDev) {
+            // no recver needed
+            goto recv_planned;
           }
-          if (any_methods(MethodFlags::CudaMpiColocated)) {
-            if ((srcRank != rank_) && mpiTopology_.colocated(srcRank) && gpu_topo::peer(srcDev, myDev)) {
-              assert(di < coloInboxes.size());
-              coloInboxes[di].emplace(srcIdx, std::vector<Message>());
-              coloInboxes[di][srcIdx].push_back(sMsg);
-              goto recv_planned;
-            }
+        }
+        if (any_methods(MethodFlags::CudaMemcpyPeer)) {
+          if (srcRank == rank_ && gpu_topo::peer(srcDev, myDev)) {
+            // no recver needed
+            goto recv_planned;
           }
-          if (any_methods(MethodFlags::CudaMpi | MethodFlags::CudaAwareMpi)) {
-            assert(di < remoteInboxes.size());
-            remoteInboxes[di].emplace(srcIdx, std::vector<Message>());
-            remoteInboxes[di][srcIdx].push_back(sMsg);
-            LOG_SPEW("Plan recv <remote> " << srcIdx << "->" << myIdx << " (dir=" << dir << "): r" << dir * -1 << "="
-                                           << radius_.dir(dir * -1));
+        }
+        if (any_methods(MethodFlags::CudaMpiColocated)) {
+          if ((srcRank != rank_) && mpiTopology_.colocated(srcRank) && gpu_topo::peer(srcDev, myDev)) {
+            assert(di < coloInboxes.size());
+            coloInboxes[di].emplace(srcIdx, std::vector<Message>());
+            coloInboxes[di][srcIdx].push_back(sMsg);
             goto recv_planned;
           }
-          LOG_FATAL("No method available to recv required message");
-        recv_planned: // found a way to recv
-          (void)0;
         }
+        if (any_methods(MethodFlags::CudaMpi | MethodFlags::CudaAwareMpi)) {
+          assert(di < remoteInboxes.size());
+          remoteInboxes[di].emplace(srcIdx, std::vector<Message>());
+          remoteInboxes[di][srcIdx].push_back(sMsg);
+          LOG_SPEW("Plan recv <remote> " << srcIdx << "->" << myIdx << " (dir=" << dir << "): r" << dir * -1 << "="
+                                         << radius_.dir(dir * -1));
+          goto recv_planned;
+        }
+        LOG_FATAL("No method available to recv required message");
+      }
+    recv_planned: // found a way to recv
+      (void)0;
+    }
+  }
+
+  // the halo sides no message fills
+  plan_.boundaryOps.resize(domains_.size());
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    const Dim3 myIdx = placement_->get_idx(rank_, di);
+    for (const Dim3 &dir : dirs_) { // halo side
+      BoundaryOp op;
+      if (0 != radius_.dir(dir) && boundary_.op(&op, myIdx, dir, globalDim)) {
+        for (int i = 0; i < 3; ++i) {
+          if (AxisOp::Extrapolate == op.op[i] && domains_[di].size()[i] < 2) {
+            LOG_FATAL("Extrapolate boundary needs at least 2 points along axis " << i << " in each subdomain");
+          }
+        }
+        plan_.boundaryOps[di].push_back(op);
       }
     }
+    LOG_DEBUG("domain " << di << ": " << plan_.boundaryOps[di].size() << " boundary ops");
   }
 
   nvtxRangePop(); // plan
 #ifdef STENCIL_SETUP_STATS
   elapsed = MPI_Wtime() - start;
-  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm_);
   if (0 == rank_) {
     timePlan_ += maxElapsed;
   }
@@ -355,10 +481,10 @@ void DistributedDomain::realize() {
 // give every rank the total send volume
 #ifdef STENCIL_SETUP_STATS
     nvtxRangePush("allreduce communication stats");
-    MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaMpi_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaMpiColocated_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaMemcpyPeer_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaKernel_, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaMpi_, 1, MPI_UINT64_T, MPI_SUM, comm_);
+    MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaMpiColocated_, 1, MPI_UINT64_T, MPI_SUM, comm_);
+    MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaMemcpyPeer_, 1, MPI_UINT64_T, MPI_SUM, comm_);
+    MPI_Allreduce(MPI_IN_PLACE, &numBytesCudaKernel_, 1, MPI_UINT64_T, MPI_SUM, comm_);
     nvtxRangePop();
 
     if (rank_ == 0) {
@@ -371,157 +497,224 @@ void DistributedDomain::realize() {
   }
 
 #ifdef STENCIL_SETUP_STATS
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Barrier(comm_);
   start = MPI_Wtime();
 #endif
+  create_transports(tx_, domains_, comm_);
+
+  // same-rank neighbors of each domain, for neighbor_exchange()
+  {
+    std::vector<std::set<size_t>> srcs(domains_.size()), dsts(domains_.size());
+    for (const Message &msg : peerAccessOutbox) {
+      srcs[msg.dstGPU_].insert(msg.srcGPU_);
+      dsts[msg.srcGPU_].insert(msg.dstGPU_);
+    }
+    for (size_t srcGPU = 0; srcGPU < tx_.peerCopySenders_.size(); ++srcGPU) {
+      for (auto &kv : tx_.peerCopySenders_[srcGPU]) {
+        srcs[kv.first].insert(srcGPU);
+        dsts[srcGPU].insert(kv.first);
+      }
+    }
+    neighborSync_ = NeighborSync(domains_.size());
+    neighborStep_.assign(domains_.size(), 0);
+    neighborSrcs_.clear();
+    neighborDsts_.clear();
+    neighborStreams_.clear();
+    for (size_t di = 0; di < domains_.size(); ++di) {
+      neighborSrcs_.push_back(std::vector<size_t>(srcs[di].begin(), srcs[di].end()));
+      neighborDsts_.push_back(std::vector<size_t>(dsts[di].begin(), dsts[di].end()));
+      neighborStreams_.push_back(RcStream(domains_[di].gpu(), RcStream::Priority::HIGH));
+    }
+  }
+
+#ifdef STENCIL_SETUP_STATS
+  elapsed = MPI_Wtime() - start;
+  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm_);
+  if (0 == rank_) {
+    timeCreate_ += maxElapsed;
+  }
+#endif
+
+  memPeak_ = local_memory();
+}
+
+/* create and prepare a sender or recver for every message in plan_, over `domains`, communicating on `comm`.
+   Collective over `comm`
+*/
+void DistributedDomain::create_transports(Transports &tx, std::vector<LocalDomain> &domains, MPI_Comm comm) {
+  std::vector<Message> &peerAccessOutbox = plan_.peerAccessOutbox;
+  std::vector<std::vector<std::vector<Message>>> &peerCopyOutboxes = plan_.peerCopyOutboxes;
+  std::vector<std::map<Dim3, std::vector<Message>>> &coloOutboxes = plan_.coloOutboxes;
+  std::vector<std::map<Dim3, std::vector<Message>>> &coloInboxes = plan_.coloInboxes;
+  std::vector<std::map<Dim3, std::vector<Message>>> &remoteInboxes = plan_.remoteInboxes;
+  std::vector<std::map<Dim3, std::vector<Message>>> &remoteOutboxes = plan_.remoteOutboxes;
+
+  tx.engine_.set_link_cap(int64_t(linkCap_));
+
   // create remote sender/recvers
-  std::cerr << "create remote\n";
+  LOG_DEBUG("create remote");
   nvtxRangePush("DistributedDomain::realize: create remote");
   // per-domain senders and messages
-  remoteSenders_.resize(gpus_.size());
-  remoteRecvers_.resize(gpus_.size());
+  tx.remoteSenders_.resize(domains.size());
+  tx.remoteRecvers_.resize(domains.size());
 
   // create all required remote senders/recvers
-  for (size_t di = 0; di < domains_.size(); ++di) {
+  for (size_t di = 0; di < domains.size(); ++di) {
     for (auto &kv : remoteOutboxes[di]) {
       const Dim3 dstIdx = kv.first;
       const int dstRank = placement_->get_rank(dstIdx);
       const int dstGPU = placement_->get_subdomain_id(dstIdx);
-      if (0 == remoteSenders_[di].count(dstIdx)) {
+      if (0 == tx.remoteSenders_[di].count(dstIdx)) {
         StatefulSender *sender = nullptr;
         if (any_methods(MethodFlags::CudaAwareMpi)) {
-          sender = new CudaAwareMpiSender(rank_, di, dstRank, dstGPU, domains_[di]);
+          sender = new CudaAwareMpiSender(rank_, di, dstRank, dstGPU, domains[di], comm);
         } else if (any_methods(MethodFlags::CudaMpi)) {
-          sender = new RemoteSender(rank_, di, dstRank, dstGPU, domains_[di]);
+          RemoteSender *s = new RemoteSender(rank_, di, dstRank, dstGPU, domains[di], comm);
+          s->set_chunk_bytes(remoteChunkBytes_);
+          sender = s;
         }
         assert(sender);
-        remoteSenders_[di].emplace(dstIdx, sender);
+        tx.remoteSenders_[di].emplace(dstIdx, sender);
       }
     }
     for (auto &kv : remoteInboxes[di]) {
       const Dim3 srcIdx = kv.first;
       const int srcRank = placement_->get_rank(srcIdx);
       const int srcGPU = placement_->get_subdomain_id(srcIdx);
-      if (0 == remoteRecvers_[di].count(srcIdx)) {
+      if (0 == tx.remoteRecvers_[di].count(srcIdx)) {
         StatefulRecver *recver = nullptr;
         if (any_methods(MethodFlags::CudaAwareMpi)) {
-          recver = new CudaAwareMpiRecver(srcRank, srcGPU, rank_, di, domains_[di]);
+          CudaAwareMpiRecver *r = new CudaAwareMpiRecver(srcRank, srcGPU, rank_, di, domains[di], comm);
+          tx.engine_.add(r);
+          recver = r;
         } else if (any_methods(MethodFlags::CudaMpi)) {
-          recver = new RemoteRecver(srcRank, srcGPU, rank_, di, domains_[di]);
+          RemoteRecver *r = new RemoteRecver(srcRank, srcGPU, rank_, di, domains[di], comm);
+          r->set_chunk_bytes(remoteChunkBytes_);
+          tx.engine_.add(r);
+          recver = r;
         }
         assert(recver);
-        remoteRecvers_[di].emplace(srcIdx, recver);
+        tx.remoteRecvers_[di].emplace(srcIdx, recver);
       }
     }
   }
   nvtxRangePop(); // create remote
 
-  std::cerr << "create colocated\n";
+  LOG_DEBUG("create colocated");
   // create colocated sender/recvers
   nvtxRangePush("DistributedDomain::realize: create colocated");
   // per-domain senders and messages
-  coloSenders_.resize(gpus_.size());
-  coloRecvers_.resize(gpus_.size());
+  tx.coloSenders_.resize(domains.size());
+  tx.coloRecvers_.resize(domains.size());
 
   // create all required colocated senders/recvers
-  for (size_t di = 0; di < domains_.size(); ++di) {
+  for (size_t di = 0; di < domains.size(); ++di) {
     for (auto &kv : coloOutboxes[di]) {
       const Dim3 dstIdx = kv.first;
       const int dstRank = placement_->get_rank(dstIdx);
       const int dstGPU = placement_->get_subdomain_id(dstIdx);
-      std::cerr << "rank " << rank_ << " create ColoSender to " << dstIdx << " on " << dstRank << " (" << dstGPU
-                << ")\n";
-      coloSenders_[di].emplace(dstIdx, ColocatedHaloSender(rank_, di, dstRank, dstGPU, domains_[di]));
+      LOG_SPEW("create ColoSender to " << dstIdx << " on " << dstRank << " (" << dstGPU << ")");
+      auto it = tx.coloSenders_[di].emplace(dstIdx, ColocatedHaloSender(rank_, di, dstRank, dstGPU, domains[di], comm));
+      tx.engine_.add(&it.first->second);
     }
     for (auto &kv : coloInboxes[di]) {
       const Dim3 srcIdx = kv.first;
       const int srcRank = placement_->get_rank(srcIdx);
       const int srcGPU = placement_->get_subdomain_id(srcIdx);
-      std::cerr << "rank " << rank_ << " create ColoRecver from " << srcIdx << " on " << srcRank << " (" << srcGPU
-                << ")\n";
-      coloRecvers_[di].emplace(srcIdx, ColocatedHaloRecver(srcRank, srcGPU, rank_, di, domains_[di]));
+      LOG_SPEW("create ColoRecver from " << srcIdx << " on " << srcRank << " (" << srcGPU << ")");
+      auto it = tx.coloRecvers_[di].emplace(srcIdx, ColocatedHaloRecver(srcRank, srcGPU, rank_, di, domains[di], comm));
+      tx.engine_.add(&it.first->second);
     }
   }
   nvtxRangePop(); // create colocated
 
-  std::cerr << "create peer copy\n";
+  LOG_DEBUG("create peer copy");
   // create colocated sender/recvers
   nvtxRangePush("DistributedDomain::realize: create PeerCopySender");
   // per-domain senders and messages
-  peerCopySenders_.resize(gpus_.size());
+  tx.peerCopySenders_.resize(domains.size());
 
   // create all required colocated senders/recvers
   for (size_t srcGPU = 0; srcGPU < peerCopyOutboxes.size(); ++srcGPU) {
     for (size_t dstGPU = 0; dstGPU < peerCopyOutboxes[srcGPU].size(); ++dstGPU) {
       if (!peerCopyOutboxes[srcGPU][dstGPU].empty()) {
-        peerCopySenders_[srcGPU].emplace(dstGPU, PeerCopySender(srcGPU, dstGPU, domains_[srcGPU], domains_[dstGPU]));
+        tx.peerCopySenders_[srcGPU].emplace(dstGPU, PeerCopySender(srcGPU, dstGPU, domains[srcGPU], domains[dstGPU]));
       }
     }
   }
   nvtxRangePop(); // create peer copy
 
   // prepare senders and receivers
-  std::cerr << "DistributedDomain::realize: prepare PeerAccessSender\n";
+  LOG_DEBUG("DistributedDomain::realize: prepare PeerAccessSender");
   nvtxRangePush("DistributedDomain::realize: prep peerAccessSender");
-  peerAccessSender_.prepare(peerAccessOutbox, domains_);
+  tx.peerAccessSender_.prepare(peerAccessOutbox, domains);
+  nvtxRangePop();
+  nvtxRangePush("DistributedDomain::realize: prep boundarySender");
+  tx.boundarySender_.prepare(plan_.boundaryOps, domains);
   nvtxRangePop();
-  std::cerr << "DistributedDomain::realize: prepare PeerCopySender\n";
+  LOG_DEBUG("DistributedDomain::realize: prepare PeerCopySender");
   nvtxRangePush("DistributedDomain::realize: prep peerCopySender");
-  for (size_t srcGPU = 0; srcGPU < peerCopySenders_.size(); ++srcGPU) {
-    for (auto &kv : peerCopySenders_[srcGPU]) {
+  for (size_t srcGPU = 0; srcGPU < tx.peerCopySenders_.size(); ++srcGPU) {
+    for (auto &kv : tx.peerCopySenders_[srcGPU]) {
       const int dstGPU = kv.first;
       auto &sender = kv.second;
       sender.prepare(peerCopyOutboxes[srcGPU][dstGPU]);
     }
   }
   nvtxRangePop();
-  std::cerr << "DistributedDomain::realize: start_prepare "
-               "ColocatedHaloSender/ColocatedHaloRecver\n";
+  LOG_DEBUG("DistributedDomain::realize: prepare ColocatedHaloSender/ColocatedHaloRecver");
   nvtxRangePush("DistributedDomain::realize: prep colocated");
-  assert(coloSenders_.size() == coloRecvers_.size());
-  for (size_t di = 0; di < coloSenders_.size(); ++di) {
-    for (auto &kv : coloSenders_[di]) {
+  assert(tx.coloSenders_.size() == tx.coloRecvers_.size());
+  /* every sender and recver makes its IPC handle, then the handles for every pair go out in one collective over
+     the ranks with colocated neighbors, instead of a three-message handshake per pair
+  */
+  std::map<int, std::vector<ColocatedSetup>> setupOut, setupIn; // [rank] = records
+  for (size_t di = 0; di < tx.coloSenders_.size(); ++di) {
+    for (auto &kv : tx.coloSenders_[di]) {
       const Dim3 dstIdx = kv.first;
-      const int dstRank = placement_->get_rank(dstIdx);
       auto &sender = kv.second;
-      LOG_DEBUG(" colo sender.start_prepare " << placement_->get_idx(rank_, di) << "->" << dstIdx << "(rank " << dstRank
-                                              << ")");
+      LOG_DEBUG(" colo sender.start_prepare " << placement_->get_idx(rank_, di) << "->" << dstIdx << "(rank "
+                                              << sender.dst_rank() << ")");
       sender.start_prepare(coloOutboxes[di][dstIdx]);
+      setupOut[sender.dst_rank()].push_back(sender.setup());
+      setupIn[sender.dst_rank()].emplace_back(); // the recver's record
     }
-    for (auto &kv : coloRecvers_[di]) {
+    for (auto &kv : tx.coloRecvers_[di]) {
       const Dim3 srcIdx = kv.first;
       auto &recver = kv.second;
       LOG_DEBUG(" colo recver.start_prepare " << srcIdx << "->" << placement_->get_idx(rank_, di));
       recver.start_prepare(coloInboxes[di][srcIdx]);
+      setupOut[recver.src_rank()].push_back(recver.setup());
+      setupIn[recver.src_rank()].emplace_back(); // the sender's record
     }
   }
+  if (any_methods(MethodFlags::CudaMpiColocated)) { // the same on every rank
+    exchange_setup(setupIn, setupOut, comm);
+  }
   LOG_DEBUG("DistributedDomain::realize: finish_prepare ColocatedHaloSender/ColocatedHaloRecver");
-  for (size_t di = 0; di < coloSenders_.size(); ++di) {
-    for (auto &kv : coloSenders_[di]) {
-      const Dim3 dstIdx = kv.first;
+  for (size_t di = 0; di < tx.coloSenders_.size(); ++di) {
+    for (auto &kv : tx.coloSenders_[di]) {
       auto &sender = kv.second;
-      const int srcDev = domains_[di].gpu();
-      const int dstDev = placement_->get_cuda(dstIdx);
-      LOG_DEBUG("colo sender.finish_prepare " << placement_->get_idx(rank_, di) << " -> " << dstIdx);
-      sender.finish_prepare();
+      LOG_DEBUG("colo sender.finish_prepare " << placement_->get_idx(rank_, di) << " -> " << kv.first);
+      sender.finish_prepare(find_setup(setupIn[sender.dst_rank()], MsgKind::ColocatedMem, sender.setup().pair));
     }
-    for (auto &kv : coloRecvers_[di]) {
+    for (auto &kv : tx.coloRecvers_[di]) {
       auto &recver = kv.second;
       LOG_DEBUG("colo recver.finish_prepare for colo from " << kv.first);
-      recver.finish_prepare();
+      recver.finish_prepare(find_setup(setupIn[recver.src_rank()], MsgKind::ColocatedEvt, recver.setup().pair));
     }
   }
   nvtxRangePop(); // prep colocated
   LOG_DEBUG("DistributedDomain::realize: prepare RemoteSender/RemoteRecver");
   nvtxRangePush("DistributedDomain::realize: prep remote");
-  assert(remoteSenders_.size() == remoteRecvers_.size());
-  for (size_t di = 0; di < remoteSenders_.size(); ++di) {
-    for (auto &kv : remoteSenders_[di]) {
+  assert(tx.remoteSenders_.size() == tx.remoteRecvers_.size());
+  for (size_t di = 0; di < tx.remoteSenders_.size(); ++di) {
+    for (auto &kv : tx.remoteSenders_[di]) {
       const Dim3 dstIdx = kv.first;
       auto &sender = kv.second;
       sender->prepare(remoteOutboxes[di][dstIdx]);
     }
-    for (auto &kv : remoteRecvers_[di]) {
+    for (auto &kv : tx.remoteRecvers_[di]) {
       const Dim3 srcIdx = kv.first;
       auto &recver = kv.second;
       recver->prepare(remoteInboxes[di][srcIdx]);
@@ -529,20 +722,49 @@ void DistributedDomain::realize() {
   }
   nvtxRangePop(); // prep remote
 
-#ifdef STENCIL_SETUP_STATS
-  elapsed = MPI_Wtime() - start;
-  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
-  if (0 == rank_) {
-    timeCreate_ += maxElapsed;
+  /* Order remote sends largest first, so the longest transfers overlap everything else, and among equal sizes by
+     destination rank starting after this rank. Then rotate the whole order by this rank, so neighboring ranks, which
+     have the same sizes, start with different sends instead of all injecting the same direction at once.
+     Senders are added to the engine in the same order, now that their sizes are known
+  */
+  {
+    int worldSize;
+    MPI_Comm_size(comm, &worldSize);
+    tx.remoteSendOrder_.clear();
+    for (auto &domSenders : tx.remoteSenders_) {
+      for (auto &kv : domSenders) {
+        tx.remoteSendOrder_.push_back(kv.second);
+      }
+    }
+    std::stable_sort(tx.remoteSendOrder_.begin(), tx.remoteSendOrder_.end(),
+                     [&](StatefulSender *a, StatefulSender *b) {
+                       if (a->bytes() != b->bytes()) {
+                         return a->bytes() > b->bytes();
+                       }
+                       const int da = (a->dst_rank() - rank_ + worldSize) % worldSize;
+                       const int db = (b->dst_rank() - rank_ + worldSize) % worldSize;
+                       return da < db;
+                     });
+    if (!tx.remoteSendOrder_.empty()) {
+      const size_t offset = size_t(rank_) % tx.remoteSendOrder_.size();
+      std::rotate(tx.remoteSendOrder_.begin(), tx.remoteSendOrder_.begin() + offset, tx.remoteSendOrder_.end());
+    }
+    for (StatefulSender *sender : tx.remoteSendOrder_) {
+      if (any_methods(MethodFlags::CudaAwareMpi)) {
+        tx.engine_.add(static_cast<CudaAwareMpiSender *>(sender));
+      } else {
+        tx.engine_.add(static_cast<RemoteSender *>(sender));
+      }
+    }
   }
-#endif
+
 }
 
 void DistributedDomain::swap() {
   LOG_DEBUG("swap()");
 
 #ifdef STENCIL_EXCHANGE_STATS
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Barrier(comm_);
   double start = MPI_Wtime();
 #endif
 
@@ -553,7 +775,7 @@ void DistributedDomain::swap() {
 #ifdef STENCIL_EXCHANGE_STATS
   double elapsed = MPI_Wtime() - start;
   double maxElapsed = -1;
-  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm_);
   if (0 == rank_) {
     timeSwap_ += maxElapsed;
   }
@@ -576,32 +798,24 @@ std::vector<Rect3> DistributedDomain::get_interior() const {
     const Rect3 comReg = dom.get_compute_region();
     Rect3 intReg = dom.get_compute_region();
 
-    for (int dz = -1; dz <= 1; ++dz) {
-      for (int dy = -1; dy <= 1; ++dy) {
-        for (int dx = -1; dx <= 1; ++dx) {
-          const Dim3 dir(dx, dy, dz);
-          if (Dim3(0, 0, 0) == dir) {
-            continue;
-          }
-
-          // if the radius is non-zero in a negative direction,
-          // move the lower corner of that direction inward
-          if (dir.x < 0) {
-            intReg.lo.x = std::max(comReg.lo.x + int64_t(radius_.dir(dir)), intReg.lo.x);
-          } else if (dir.x > 0) {
-            intReg.hi.x = std::min(comReg.hi.x - int64_t(radius_.dir(dir)), intReg.hi.x);
-          }
-          if (dir.y < 0) {
-            intReg.lo.y = std::max(comReg.lo.y + int64_t(radius_.dir(dir)), intReg.lo.y);
-          } else if (dir.y > 0) {
-            intReg.hi.y = std::min(comReg.hi.y - int64_t(radius_.dir(dir)), intReg.hi.y);
-          }
-          if (dir.z < 0) {
-            intReg.lo.z = std::max(comReg.lo.z + int64_t(radius_.dir(dir)), intReg.lo.z);
-          } else if (dir.z > 0) {
-            intReg.hi.z = std::min(comReg.hi.z - int64_t(radius_.dir(dir)), intReg.hi.z);
-          }
-        }
+    // the same directions realize() plans, but from radius_ so this does not depend on realize()
+    for (const Dim3 &dir : make_directions(radius_.shape(), size_)) {
+      // if the radius is non-zero in a negative direction,
+      // move the lower corner of that direction inward
+      if (dir.x < 0) {
+        intReg.lo.x = std::max(comReg.lo.x + int64_t(radius_.dir(dir)), intReg.lo.x);
+      } else if (dir.x > 0) {
+        intReg.hi.x = std::min(comReg.hi.x - int64_t(radius_.dir(dir)), intReg.hi.x);
+      }
+      if (dir.y < 0) {
+        intReg.lo.y = std::max(comReg.lo.y + int64_t(radius_.dir(dir)), intReg.lo.y);
+      } else if (dir.y > 0) {
+        intReg.hi.y = std::min(comReg.hi.y - int64_t(radius_.dir(dir)), intReg.hi.y);
+      }
+      if (dir.z < 0) {
+        intReg.lo.z = std::max(comReg.lo.z + int64_t(radius_.dir(dir)), intReg.lo.z);
+      } else if (dir.z > 0) {
+        intReg.hi.z = std::min(comReg.hi.z - int64_t(radius_.dir(dir)), intReg.hi.z);
       }
     }
     ret[di] = intReg;
@@ -672,195 +886,91 @@ void DistributedDomain::exchange() {
   nvtxRangePush("DD::exchange()");
 
 #ifdef STENCIL_EXCHANGE_STATS
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Barrier(comm_);
   double start = MPI_Wtime();
 #endif
 
-  /*! Try to start sends in order from longest to shortest
-   * we expect remote to be longest, followed by peer copy, followed by colo
-   * colo is shorter than peer copy due to the node-aware data placement:
-   * if we try to place bigger exchanges nearby, they will be faster
-   */
+  tx_.start();
+  tx_.finish();
 
-  // start remote send d2h
-  LOG_DEBUG("remote send start");
-  nvtxRangePush("DD::exchange: remote send d2h");
-  for (auto &domSenders : remoteSenders_) {
-    for (auto &kv : domSenders) {
-      StatefulSender *sender = kv.second;
-      sender->send();
-    }
+#ifdef STENCIL_EXCHANGE_STATS
+  double maxElapsed = -1;
+  double elapsed = MPI_Wtime() - start;
+  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm_);
+  if (0 == rank_) {
+    timeExchange_ += maxElapsed;
   }
-  nvtxRangePop();
+#endif
 
-  // send same-rank messages
-  LOG_DEBUG("send peer copy");
-  nvtxRangePush("DD::exchange: peer copy send");
-  for (auto &src : peerCopySenders_) {
-    for (auto &kv : src) {
-      PeerCopySender &sender = kv.second;
-      sender.send();
-    }
-  }
-  nvtxRangePop();
+  nvtxRangePop(); // "DD::excchange"
 
-  // start colocated Senders
-  LOG_DEBUG("start colo send");
-  nvtxRangePush("DD::exchange: colo send");
-  for (auto &domSenders : coloSenders_) {
-    for (auto &kv : domSenders) {
-      ColocatedHaloSender &sender = kv.second;
-      sender.send();
-    }
-  }
-  nvtxRangePop();
+  // No barrier necessary: the CPU thread has already blocked until all recvs are done, so it is safe to proceed.
+}
 
-  // send self messages
-  LOG_DEBUG("send peer access");
-  nvtxRangePush("DD::exchange: peer access send");
-  peerAccessSender_.send();
-  nvtxRangePop();
+ExchangeHandle DistributedDomain::exchange_async(const std::vector<size_t> &quantities) {
 
-  // start colocated recvers
-  LOG_DEBUG("start colo recv");
-  nvtxRangePush("DD::exchange: colo recv");
-  for (auto &domRecvers : coloRecvers_) {
-    for (auto &kv : domRecvers) {
-      ColocatedHaloRecver &recver = kv.second;
-      recver.recv();
-    }
-  }
-  nvtxRangePop();
+  nvtxRangePush("DD::exchange_async()");
 
-  // start remote recv h2h
-  LOG_DEBUG("[" << rank_ << "] remote recv start");
-  nvtxRangePush("DD::exchange: remote recv h2h");
-  for (auto &domRecvers : remoteRecvers_) {
-    for (auto &kv : domRecvers) {
-      StatefulRecver *recver = kv.second;
-      recver->recv();
-    }
+  // every rank must name the same subset, in any order
+  std::vector<size_t> qis = quantities;
+  std::sort(qis.begin(), qis.end());
+  qis.erase(std::unique(qis.begin(), qis.end()), qis.end());
+  if (qis.empty()) {
+    LOG_FATAL("exchange_async(): no quantities");
+  }
+  if (qis.back() >= dataElemSize_.size()) {
+    LOG_FATAL("exchange_async(): quantity " << qis.back() << " does not exist");
   }
-  nvtxRangePop();
 
-  // poll stateful senders and recvers to move onto next step until all are done
-  LOG_DEBUG("[" << rank_ << "] start poll");
-  nvtxRangePush("DD::exchange: poll");
-  bool pending = true;
-  while (pending) {
-    pending = false;
-  recvers:
-    // move recvers from h2h to h2d
-    for (auto &domRecvers : remoteRecvers_) {
-      for (auto &kv : domRecvers) {
-        StatefulRecver *recver = kv.second;
-        if (recver->active()) {
-          pending = true;
-          if (recver->next_ready()) {
-            // const Dim3 srcIdx = kv.first;
-            // std::cerr << "[" << rank_ << "] src=" << srcIdx << "
-            // recv_h2d\n";
-            recver->next();
-            goto senders; // try to overlap sends and recvs
-          }
-        }
-      }
-    }
-  senders:
-    // move senders from d2h to h2h
-    for (auto &domSenders : remoteSenders_) {
-      for (auto &kv : domSenders) {
-        StatefulSender *sender = kv.second;
-        if (sender->active()) {
-          pending = true;
-          if (sender->next_ready()) {
-            sender->next();
-            goto colo; // try to overlap sends and recvs
-          }
-        }
-      }
+  AsyncExchange *ax = nullptr;
+  auto it = asyncExchanges_.find(qis);
+  if (asyncExchanges_.end() == it) {
+    nvtxRangePush("DD::exchange_async: create");
+    ax = new AsyncExchange;
+    asyncExchanges_[qis] = ax;
+    MPI_Comm_dup(comm_, &ax->comm);
+    ax->views.reserve(domains_.size()); // transports point into views
+    for (const LocalDomain &d : domains_) {
+      ax->views.push_back(LocalDomain(d, qis));
     }
-  colo:
-    for (auto &domRecvers : coloRecvers_) {
-      for (auto &kv : domRecvers) {
-        ColocatedHaloRecver &recver = kv.second;
-        if (recver.active()) {
-          pending = true;
-          if (recver.next_ready()) {
-            recver.next();
-            goto recvers; // try to overlap sends and recvs
-          }
-        }
-      }
+    for (LocalDomain &v : ax->views) {
+      v.realize();
     }
+    create_transports(ax->tx, ax->views, ax->comm);
+    nvtxRangePop(); // DD::exchange_async: create
+  } else {
+    ax = it->second;
   }
-  nvtxRangePop(); // DD::exchange: poll
-
-  // wait for sends
-  LOG_SPEW("[" << rank_ << "] wait for peer access senders");
-  nvtxRangePush("peerAccessSender.wait()");
-  peerAccessSender_.wait();
-  nvtxRangePop();
 
-  nvtxRangePush("peerCopySender.wait()");
-  for (auto &src : peerCopySenders_) {
-    for (auto &kv : src) {
-      PeerCopySender &sender = kv.second;
-      sender.wait();
-    }
+  if (ax->inFlight) {
+    LOG_FATAL("exchange_async(): the last exchange of these quantities was not waited on");
   }
-  nvtxRangePop(); // peerCopySender.wait()
 
-  // wait for colocated
-  nvtxRangePush("colocated.wait()");
-  for (auto &domSenders : coloSenders_) {
-    for (auto &kv : domSenders) {
-      LOG_SPEW("domain=" << kv.first << " wait colocated sender");
-      ColocatedHaloSender &sender = kv.second;
-      sender.wait();
-    }
-  }
-  for (auto &domRecvers : coloRecvers_) {
-    for (auto &kv : domRecvers) {
-      LOG_SPEW("domain=" << kv.first << " wait colocated recver");
-      ColocatedHaloRecver &recver = kv.second;
-      recver.wait();
-    }
+  // pick up any swap() since the last exchange
+  for (LocalDomain &v : ax->views) {
+    v.sync_view();
   }
-  nvtxRangePop(); // colocated wait
-  nvtxRangePush("remote wait");
-  // wait for remote senders and recvers
-  // printf("rank=%d wait for RemoteRecver/RemoteSender\n", rank_);
-  for (auto &domRecvers : remoteRecvers_) {
-    for (auto &kv : domRecvers) {
-      LOG_SPEW("domain=" << kv.first << " wait remote recver");
-      StatefulRecver *recver = kv.second;
-      assert(recver);
-      recver->wait();
-    }
-  }
-  for (auto &domSenders : remoteSenders_) {
-    for (auto &kv : domSenders) {
-      LOG_SPEW("domain=" << kv.first << " wait remote sender");
-      StatefulSender *sender = kv.second;
-      assert(sender);
-      sender->wait();
-    }
-  }
-  nvtxRangePop(); // remote wait
 
-#ifdef STENCIL_EXCHANGE_STATS
-  double maxElapsed = -1;
-  double elapsed = MPI_Wtime() - start;
-  MPI_Reduce(&elapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
-  if (0 == rank_) {
-    timeExchange_ += maxElapsed;
+  ax->inFlight = true;
+  ax->tx.start();
+
+  nvtxRangePop(); // DD::exchange_async()
+  return ExchangeHandle(ax);
+}
+
+void DistributedDomain::exchange_accumulate() {
+
+  nvtxRangePush("DD::exchange_accumulate()");
+
+  for (size_t qi = 0; qi < dataType_.size(); ++qi) {
+    if (DataType::None == dataType_[qi]) {
+      LOG_FATAL("quantity " << dataName_[qi] << " can't be accumulated: it is not float, double, int32_t, or int64_t");
+    }
   }
-#endif
 
-  nvtxRangePop(); // "DD::excchange"
+  tx_.accumulate();
 
-  // No barrier necessary: the CPU thread has already blocked until all recvs are done, so it is safe to proceed.
+  nvtxRangePop(); // DD::exchange_accumulate()
 }
 
 void DistributedDomain::write_paraview(const std::string &prefix, bool zeroNaNs) {
@@ -870,8 +980,8 @@ void DistributedDomain::write_paraview(const std::string &prefix, bool zeroNaNs)
   nvtxRangePush("write_paraview");
 
   int rank, size;
-  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  MPI_Comm_rank(comm_, &rank);
+  MPI_Comm_size(comm_, &size);
 
   int64_t num = rank * domains_.size();
 
@@ -937,3 +1047,502 @@ void DistributedDomain::write_paraview(const std::string &prefix, bool zeroNaNs)
 
   nvtxRangePop();
 }
+
+void DistributedDomain::migrate() {
+
+  nvtxRangePush("DD::migrate()");
+
+  const Dim3 globalDim = placement_->dim();
+  // particles may move diagonally regardless of the stencil shape
+  typedef Directions<RadiusShape::Full> Dirs;
+
+  std::vector<std::array<uint64_t, PARTICLE_BINS>> sendCounts(domains_.size());
+  std::vector<std::array<uint64_t, PARTICLE_BINS>> recvCounts(domains_.size());
+  std::vector<std::array<size_t, PARTICLE_BINS>> recvOffsets(domains_.size()); // offset in host recv buffer
+  std::vector<MPI_Request> reqs;
+
+  // count the particles leaving in each direction
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    LocalDomain &d = domains_[di];
+    d.particles().bin(d.origin(), d.origin() + d.size(), sendCounts[di]);
+  }
+
+  // start size handshakes with neighbors on other ranks
+  nvtxRangePush("DD::migrate: counts");
+  std::vector<bool> stage(domains_.size(), false); // if a domain has a neighbor on another rank
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    const Dim3 myIdx = placement_->get_idx(rank_, di);
+    for (size_t i = 0; i < Dirs::count; ++i) {
+      const Dim3 dir = Dirs::at(i);
+      const int bin = particle_bin(dir);
+      const Dim3 dstIdx = (myIdx + dir).wrap(globalDim);
+      const Dim3 srcIdx = (myIdx - dir).wrap(globalDim);
+      // particles leaving toward an inactive block are dropped, and none arrive from one
+      if (placement_->active(dstIdx) && placement_->get_rank(dstIdx) != rank_) {
+        stage[di] = true;
+        reqs.push_back(MPI_REQUEST_NULL);
+        MPI_Isend(&sendCounts[di][bin], 1, MPI_UINT64_T, placement_->get_rank(dstIdx), particle_tag(di, dir, false),
+                  comm_, &reqs.back());
+      }
+      if (!placement_->active(srcIdx)) {
+        recvCounts[di][bin] = 0;
+        continue;
+      }
+      const int srcRank = placement_->get_rank(srcIdx);
+      const int srcGPU = placement_->get_subdomain_id(srcIdx);
+      if (srcRank == rank_) {
+        recvCounts[di][bin] = sendCounts[srcGPU][bin];
+      } else {
+        reqs.push_back(MPI_REQUEST_NULL);
+        MPI_Irecv(&recvCounts[di][bin], 1, MPI_UINT64_T, srcRank, particle_tag(srcGPU, dir, false), comm_,
+                  &reqs.back());
+      }
+    }
+  }
+  nvtxRangePop(); // DD::migrate: counts
+
+  // move particles into the next arrays or send blocks while the handshakes are in flight
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    domains_[di].particles().scatter(sendCounts[di], globalDim, stage[di]);
+  }
+  MPI_Waitall(int(reqs.size()), reqs.data(), MPI_STATUSES_IGNORE);
+  reqs.clear();
+
+  // send and recv particles with neighbors on other ranks
+  nvtxRangePush("DD::migrate: payload");
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    Particles &particles = domains_[di].particles();
+    const Dim3 myIdx = placement_->get_idx(rank_, di);
+
+    // one block in the host recv buffer for each remote neighbor
+    size_t recvBytes = 0;
+    for (size_t i = 0; i < Dirs::count; ++i) {
+      const Dim3 dir = Dirs::at(i);
+      const int bin = particle_bin(dir);
+      const Dim3 srcIdx = (myIdx - dir).wrap(globalDim);
+      if (placement_->active(srcIdx) && placement_->get_rank(srcIdx) != rank_) {
+        recvBytes = next_align_of(recvBytes, 8);
+        recvOffsets[di][bin] = recvBytes;
+        recvBytes += particles.packed_bytes(recvCounts[di][bin]);
+      }
+    }
+    char *recvBuf = particles.host_recv_buf(recvBytes);
+
+    for (size_t i = 0; i < Dirs::count; ++i) {
+      const Dim3 dir = Dirs::at(i);
+      const int bin = particle_bin(dir);
+      const Dim3 dstIdx = (myIdx + dir).wrap(globalDim);
+      const Dim3 srcIdx = (myIdx - dir).wrap(globalDim);
+      // nothing moves to or from an inactive block
+      const int dstRank = placement_->active(dstIdx) ? placement_->get_rank(dstIdx) : rank_;
+      const int srcRank = placement_->active(srcIdx) ? placement_->get_rank(srcIdx) : rank_;
+      if (srcRank != rank_ && recvCounts[di][bin]) {
+        const int srcGPU = placement_->get_subdomain_id(srcIdx);
+        const size_t numBytes = particles.packed_bytes(recvCounts[di][bin]);
+        assert(numBytes <= std::numeric_limits<int>::max());
+        reqs.push_back(MPI_REQUEST_NULL);
+        MPI_Irecv(recvBuf + recvOffsets[di][bin], int(numBytes), MPI_BYTE, srcRank, particle_tag(srcGPU, dir, true),
+                  comm_, &reqs.back());
+      }
+      if (dstRank != rank_ && sendCounts[di][bin]) {
+        const size_t numBytes = particles.packed_bytes(sendCounts[di][bin]);
+        assert(numBytes <= std::numeric_limits<int>::max());
+        reqs.push_back(MPI_REQUEST_NULL);
+        MPI_Isend(particles.host_send_block(bin), int(numBytes), MPI_BYTE, dstRank, particle_tag(di, dir, true), comm_,
+                  &reqs.back());
+      }
+    }
+  }
+  MPI_Waitall(int(reqs.size()), reqs.data(), MPI_STATUSES_IGNORE);
+  nvtxRangePop(); // DD::migrate: payload
+
+  // append arrivals after the particles that stayed
+  nvtxRangePush("DD::migrate: append");
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    Particles &particles = domains_[di].particles();
+    const Dim3 myIdx = placement_->get_idx(rank_, di);
+
+    uint64_t total = sendCounts[di][PARTICLE_STAY];
+    for (size_t i = 0; i < Dirs::count; ++i) {
+      total += recvCounts[di][particle_bin(Dirs::at(i))];
+    }
+    particles.reserve_next(total);
+
+    for (size_t i = 0; i < Dirs::count; ++i) {
+      const Dim3 dir = Dirs::at(i);
+      const int bin = particle_bin(dir);
+      const Dim3 srcIdx = (myIdx - dir).wrap(globalDim);
+      const uint64_t count = recvCounts[di][bin];
+      if (0 == count) {
+        continue;
+      }
+      if (placement_->get_rank(srcIdx) == rank_) {
+        // same-rank neighbors are copied directly from their send block
+        const int srcGPU = placement_->get_subdomain_id(srcIdx);
+        particles.append(domains_[srcGPU].particles().send_block(bin), count);
+      } else {
+        particles.append(particles.host_recv_buf(0) + recvOffsets[di][bin], count);
+      }
+    }
+  }
+  for (auto &d : domains_) {
+    d.particles().finish();
+  }
+  nvtxRangePop(); // DD::migrate: append
+
+  nvtxRangePop(); // DD::migrate()
+}
+
+void DistributedDomain::neighbor_exchange(const size_t di) {
+
+  nvtxRangePush("DD::neighbor_exchange()");
+  assert(di < domains_.size());
+
+  if (!tx_.remoteSenders_[di].empty() || !tx_.remoteRecvers_[di].empty() || !tx_.coloSenders_[di].empty() ||
+      !tx_.coloRecvers_[di].empty()) {
+    LOG_FATAL("neighbor_exchange(): domain " << di << " has neighbors on other ranks, use exchange()");
+  }
+
+  LocalDomain &d = domains_[di];
+  const uint64_t step = ++neighborStep_[di];
+
+  /* Neighbors read our current interior for the last step with kernels that look up our current pointers.
+     They must be done before swap() changes those pointers, which also keeps us from overwriting the interior
+     they are reading during the next step.
+  */
+  for (size_t dj : neighborDsts_[di]) {
+    neighborSync_.wait_done(dj, step - 1);
+  }
+  d.swap();
+  neighborSync_.publish_ready(di, step);
+
+  // fill our halo from each neighbor as soon as that neighbor has published this step
+  for (size_t si : neighborSrcs_[di]) {
+    neighborSync_.wait_ready(si, step);
+    auto it = tx_.peerCopySenders_[si].find(di);
+    if (it != tx_.peerCopySenders_[si].end()) {
+      it->second.send();
+    }
+    tx_.peerAccessSender_.send(si, di, neighborStreams_[di]);
+  }
+  for (size_t si : neighborSrcs_[di]) {
+    auto it = tx_.peerCopySenders_[si].find(di);
+    if (it != tx_.peerCopySenders_[si].end()) {
+      it->second.wait();
+    }
+  }
+  // our halos from neighbors are filled in or before neighborStreams_[di], so boundary ops may read them
+  tx_.boundarySender_.send(di, neighborStreams_[di]);
+  CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+  CUDA_RUNTIME(cudaStreamSynchronize(neighborStreams_[di]));
+  neighborSync_.publish_done(di, step);
+
+  nvtxRangePop(); // DD::neighbor_exchange()
+}
+
+/* create and prepare a StaleSender or StaleRecver for every remote message in plan_. Collective over comm_
+ */
+void DistributedDomain::create_stale() {
+  nvtxRangePush("DD::create_stale");
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    if (!plan_.coloOutboxes[di].empty() || !plan_.coloInboxes[di].empty()) {
+      LOG_FATAL("exchange_stale(): colocated transports are not supported, set_methods() without CudaMpiColocated");
+    }
+  }
+
+  MPI_Comm_dup(comm_, &staleComm_);
+  for (size_t di = 0; di < domains_.size(); ++di) {
+    for (auto &kv : plan_.remoteOutboxes[di]) {
+      const Dim3 dstIdx = kv.first;
+      const int dstRank = placement_->get_rank(dstIdx);
+      const int dstGPU = placement_->get_subdomain_id(dstIdx);
+      StaleSender *sender = new StaleSender(rank_, di, dstRank, dstGPU, domains_[di], staleComm_);
+      sender->prepare(kv.second);
+      staleSenders_.push_back(sender);
+    }
+    for (auto &kv : plan_.remoteInboxes[di]) {
+      const Dim3 srcIdx = kv.first;
+      const int srcRank = placement_->get_rank(srcIdx);
+      const int srcGPU = placement_->get_subdomain_id(srcIdx);
+      StaleRecver *recver = new StaleRecver(srcRank, srcGPU, rank_, di, domains_[di], staleComm_);
+      recver->prepare(kv.second);
+      staleRecvers_.push_back(recver);
+    }
+  }
+  staleStep_ = 0;
+  nvtxRangePop(); // DD::create_stale
+}
+
+void DistributedDomain::destroy_stale() {
+  for (StaleRecver *recver : staleRecvers_) {
+    recver->cancel();
+    delete recver;
+  }
+  staleRecvers_.clear();
+  for (StaleSender *sender : staleSenders_) {
+    delete sender;
+  }
+  staleSenders_.clear();
+  MPI_Comm_free(&staleComm_);
+  staleStep_ = 0;
+}
+
+uint64_t DistributedDomain::exchange_stale(const uint64_t step, const uint64_t staleness) {
+
+  nvtxRangePush("DD::exchange_stale()");
+
+  if (MPI_COMM_NULL == staleComm_) {
+    create_stale();
+  }
+  if (step <= staleStep_) {
+    LOG_FATAL("exchange_stale(): step " << step << " is not after the last step " << staleStep_);
+  }
+  staleStep_ = step;
+
+  for (StaleSender *sender : staleSenders_) {
+    sender->send(step);
+  }
+
+  // same-rank halos are always current
+  for (auto &src : tx_.peerCopySenders_) {
+    for (auto &kv : src) {
+      kv.second.send();
+    }
+  }
+  tx_.peerAccessSender_.send();
+  tx_.boundarySender_.send_interior();
+
+  /* Block only while a neighbor is more than `staleness` steps behind.
+     Keep sending while we wait: a neighbor may be waiting on the step our senders are still holding.
+  */
+  nvtxRangePush("DD::exchange_stale: wait");
+  uint64_t oldest;
+  while (true) {
+    oldest = step;
+    bool ready = true; // every current halo will have been filled
+    for (StaleRecver *recver : staleRecvers_) {
+      recver->progress();
+      uint64_t halo;
+      if (recver->available(halo)) {
+        oldest = std::min(oldest, halo);
+      } else {
+        ready = false;
+      }
+    }
+    if (ready && oldest + staleness >= step) {
+      break;
+    }
+    for (StaleSender *sender : staleSenders_) {
+      sender->progress();
+    }
+    std::this_thread::yield(); // let MPI's progress thread and the rest of the node run
+  }
+  nvtxRangePop(); // DD::exchange_stale: wait
+
+  for (StaleRecver *recver : staleRecvers_) {
+    recver->apply();
+  }
+  // the caller may modify the domains once we return
+  for (StaleSender *sender : staleSenders_) {
+    sender->release();
+  }
+  for (StaleRecver *recver : staleRecvers_) {
+    recver->sync();
+  }
+  tx_.peerAccessSender_.wait();
+  for (auto &src : tx_.peerCopySenders_) {
+    for (auto &kv : src) {
+      kv.second.wait();
+    }
+  }
+  tx_.boundarySender_.send_halo();
+  tx_.boundarySender_.wait();
+
+  nvtxRangePop(); // DD::exchange_stale()
+  return oldest;
+}
+
+void DistributedDomain::finish_stale(const uint64_t step) {
+
+  nvtxRangePush("DD::finish_stale()");
+
+  exchange_stale(step, 0);
+
+  /* every neighbor has sent `step`, its last message. Ours must complete before our senders are destroyed; each
+     neighbor keeps its recvs posted until its own exchange_stale(step, 0) has received them
+  */
+  bool done = false;
+  while (!done) {
+    done = true;
+    for (StaleSender *sender : staleSenders_) {
+      sender->progress();
+      done = done && sender->done();
+    }
+    std::this_thread::yield();
+  }
+  destroy_stale();
+
+  nvtxRangePop(); // DD::finish_stale()
+}
+
+/* bytes of a std::map node beyond its key and value: three links and a color, rounded to pointers
+ */
+static constexpr int64_t MAP_NODE_BYTES = 4 * sizeof(void *);
+
+MemoryReport DistributedDomain::local_memory() {
+  MemoryReport r;
+
+  // every rank adds the same categories in the same order, so reduce() lines them up
+  int64_t next = 0;
+  for (size_t qi = 0; qi < dataElemSize_.size(); ++qi) {
+    int64_t bytes = 0;
+    for (const LocalDomain &d : domains_) {
+      bytes += d.raw_size(qi).flatten() * int64_t(dataElemSize_[qi]);
+    }
+    r.add("quantity " + dataName_[qi], bytes);
+    next += bytes;
+  }
+  r.add("next", next);
+
+  r.add("packer", 0);
+  r.add("unpacker", 0);
+  r.add("pinned", 0);
+  tx_.add_memory(r);
+  for (auto &kv : asyncExchanges_) {
+    kv.second->tx.add_memory(r);
+  }
+  for (StaleSender *sender : staleSenders_) {
+    r.add("packer", sender->device_bytes());
+    r.add("pinned", sender->pinned_bytes());
+  }
+  for (StaleRecver *recver : staleRecvers_) {
+    r.add("unpacker", recver->device_bytes());
+    r.add("pinned", recver->pinned_bytes());
+  }
+
+  r.add("particles", 0);
+  for (const LocalDomain &d : domains_) {
+    r.add("particles", d.particles().device_bytes());
+    r.add("pinned", d.particles().pinned_bytes());
+  }
+
+  // placements keep every subdomain's rank, id, and CUDA device in maps, and each rank's subdomain indices
+  int64_t placementBytes = 0;
+  if (placement_) {
+    placementBytes = placement_->dim().flatten() *
+                     (3 * (MAP_NODE_BYTES + int64_t(sizeof(Dim3) + sizeof(int))) + int64_t(sizeof(Dim3)));
+  }
+  r.add("placement", placementBytes);
+
+  int64_t planBytes = plan_.peerAccessOutbox.size() * sizeof(Message);
+  for (const auto &v : plan_.peerCopyOutboxes) {
+    for (const auto &msgs : v) {
+      planBytes += msgs.size() * sizeof(Message);
+    }
+  }
+  for (const auto *boxes : {&plan_.coloOutboxes, &plan_.coloInboxes, &plan_.remoteOutboxes, &plan_.remoteInboxes}) {
+    for (const auto &m : *boxes) {
+      for (const auto &kv : m) {
+        planBytes += MAP_NODE_BYTES + sizeof(kv) + kv.second.size() * sizeof(Message);
+      }
+    }
+  }
+  for (const auto &ops : plan_.boundaryOps) {
+    planBytes += ops.size() * sizeof(BoundaryOp);
+  }
+  r.add("plan", planBytes);
+
+  return r;
+}
+
+MemoryReport DistributedDomain::predict_memory() {
+  MemoryReport r;
+  r.predicted = true;
+
+  int64_t numGpus = gpus_.size();
+  MPI_Allreduce(MPI_IN_PLACE, &numGpus, 1, MPI_INT64_T, MPI_SUM, comm_);
+
+  // how many subdomains there are, and how many this rank gets
+  int64_t numSubdomains;
+  int64_t localSubdomains;
+  Dim3 sz;
+  if (placement_) {
+    numSubdomains = placement_->dim().flatten();
+    localSubdomains = placement_->num_subdomains(rank_);
+    sz = Dim3(0, 0, 0);
+    for (int64_t i = 0; i < localSubdomains; ++i) {
+      const Dim3 ext = placement_->subdomain_size(placement_->get_idx(rank_, i));
+      sz = ext.flatten() > sz.flatten() ? ext : sz;
+    }
+  } else if (!mask_.empty()) {
+    const int64_t numActive = std::count(mask_.begin(), mask_.end(), true);
+    numSubdomains = maskBlocks_.flatten();
+    localSubdomains = int64_t(gpus_.size()) * ((numActive + numGpus - 1) / numGpus);
+    sz = RankPartition(size_, maskBlocks_).subdomain_size(Dim3(0, 0, 0));
+  } else {
+    const int64_t perGpu = subdomainsPerGpu_ ? subdomainsPerGpu_ : 1;
+    numSubdomains = numGpus * perGpu;
+    localSubdomains = int64_t(gpus_.size()) * perGpu;
+    // the remainder of an uneven split goes to the low indices, so the first subdomain is the largest
+    sz = RankPartition(size_, numSubdomains).subdomain_size(Dim3(0, 0, 0));
+    /* realize() may replace the placement with fewer, larger subdomains to meet set_min_efficiency(), each in its
+       own slot. Whether it does depends on the placement's split, which is not known yet, so size subdomains like
+       the larger of the two
+    */
+    if (minEfficiency_ > 0) {
+      const Dim3 blocks = efficient_split(size_, numSubdomains, radius_, minEfficiency_);
+      const Dim3 fewer = RankPartition(size_, blocks).subdomain_size(Dim3(0, 0, 0));
+      sz = fewer.flatten() > sz.flatten() ? fewer : sz;
+    }
+  }
+
+  const std::vector<Dim3> dirs = make_directions(radius_.shape(), size_);
+  const Dim3 raw(sz.x + radius_.x(-1) + radius_.x(1), sz.y + radius_.y(-1) + radius_.y(1),
+                 sz.z + radius_.z(-1) + radius_.z(1));
+
+  int64_t next = 0;
+  int64_t haloBytes = 0; // bytes of every halo of one subdomain, all quantities
+  for (size_t qi = 0; qi < dataElemSize_.size(); ++qi) {
+    const int64_t bytes = localSubdomains * (raw + dataStagger_[qi]).flatten() * int64_t(dataElemSize_[qi]);
+    r.add("quantity " + dataName_[qi], bytes);
+    next += bytes;
+    for (const Dim3 &dir : dirs) {
+      if (0 != radius_.dir(dir)) {
+        const Dim3 ext = staggered_extent(LocalDomain::halo_extent(dir, sz, radius_), dir, dataStagger_[qi]);
+        haloBytes += ext.flatten() * int64_t(dataElemSize_[qi]);
+      }
+    }
+  }
+  r.add("next", next);
+
+  // only kernels on peer pointers need no buffers. Host-staged remote messages also stage both ends in pinned memory
+  const bool buffered =
+      any_methods(MethodFlags::CudaMpi | MethodFlags::CudaAwareMpi | MethodFlags::CudaMpiColocated |
+                  MethodFlags::CudaMemcpyPeer);
+  const int64_t bufBytes = buffered ? localSubdomains * haloBytes : 0;
+  r.add("packer", bufBytes);
+  r.add("unpacker", bufBytes);
+  r.add("pinned", any_methods(MethodFlags::CudaMpi) ? 2 * localSubdomains * haloBytes : 0);
+
+  // particles are allocated as they are added
+  r.add("particles", 0);
+
+  r.add("placement", numSubdomains * (3 * (MAP_NODE_BYTES + int64_t(sizeof(Dim3) + sizeof(int))) +
+                                      int64_t(sizeof(Dim3))));
+  // a message in each direction, each way, in an outbox keyed by neighbor
+  r.add("plan", localSubdomains * int64_t(dirs.size()) * 2 *
+                    (MAP_NODE_BYTES + int64_t(sizeof(std::pair<const Dim3, std::vector<Message>>) + sizeof(Message))));
+
+  return r;
+}
+
+MemoryReport DistributedDomain::memory_report() {
+  // dirs_ is determined in realize()
+  MemoryReport r = dirs_.empty() ? predict_memory() : local_memory();
+  if (!r.predicted) {
+    r.merge_peaks(memPeak_);
+    memPeak_ = r;
+  }
+  r.reduce(comm_);
+  return r;
+}
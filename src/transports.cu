@@ -0,0 +1,244 @@
+#include "stencil/transports.cuh"
+
+#include <nvToolsExt.h>
+
+#include "stencil/logging.hpp"
+
+void Transports::start() {
+
+  /*! Try to start sends in order from longest to shortest
+   * we expect remote to be longest, followed by peer copy, followed by colo
+   * colo is shorter than peer copy due to the node-aware data placement:
+   * if we try to place bigger exchanges nearby, they will be faster
+   */
+
+  // start remote send d2h
+  LOG_DEBUG("remote send start");
+  nvtxRangePush("Transports::start: remote send d2h");
+  for (StatefulSender *sender : remoteSendOrder_) {
+    sender->send();
+  }
+  nvtxRangePop();
+
+  // send same-rank messages
+  LOG_DEBUG("send peer copy");
+  nvtxRangePush("Transports::start: peer copy send");
+  for (auto &src : peerCopySenders_) {
+    for (auto &kv : src) {
+      PeerCopySender &sender = kv.second;
+      sender.send();
+    }
+  }
+  nvtxRangePop();
+
+  // start colocated Senders
+  LOG_DEBUG("start colo send");
+  nvtxRangePush("Transports::start: colo send");
+  for (auto &domSenders : coloSenders_) {
+    for (auto &kv : domSenders) {
+      ColocatedHaloSender &sender = kv.second;
+      sender.send();
+    }
+  }
+  nvtxRangePop();
+
+  // send self messages
+  LOG_DEBUG("send peer access");
+  nvtxRangePush("Transports::start: peer access send");
+  peerAccessSender_.send();
+  nvtxRangePop();
+
+  // fill boundary halos that only read the interior
+  LOG_DEBUG("send boundary interior");
+  nvtxRangePush("Transports::start: boundary send");
+  boundarySender_.send_interior();
+  nvtxRangePop();
+
+  // start colocated recvers
+  LOG_DEBUG("start colo recv");
+  nvtxRangePush("Transports::start: colo recv");
+  for (auto &domRecvers : coloRecvers_) {
+    for (auto &kv : domRecvers) {
+      ColocatedHaloRecver &recver = kv.second;
+      recver.recv();
+    }
+  }
+  nvtxRangePop();
+
+  // start remote recv h2h
+  LOG_DEBUG("remote recv start");
+  nvtxRangePush("Transports::start: remote recv h2h");
+  for (auto &domRecvers : remoteRecvers_) {
+    for (auto &kv : domRecvers) {
+      StatefulRecver *recver = kv.second;
+      recver->recv();
+    }
+  }
+  nvtxRangePop();
+
+  // record what each stateful sender and recver is waiting on, so test() and finish() can move them along
+  engine_.begin();
+}
+
+void Transports::finish() {
+
+  // poll stateful senders and recvers to move onto next step until all are done
+  nvtxRangePush("Transports::finish: poll");
+  engine_.wait();
+  nvtxRangePop(); // Transports::finish: poll
+
+  // wait for sends
+  LOG_SPEW("wait for peer access senders");
+  nvtxRangePush("peerAccessSender.wait()");
+  peerAccessSender_.wait();
+  nvtxRangePop();
+
+  nvtxRangePush("peerCopySender.wait()");
+  for (auto &src : peerCopySenders_) {
+    for (auto &kv : src) {
+      PeerCopySender &sender = kv.second;
+      sender.wait();
+    }
+  }
+  nvtxRangePop(); // peerCopySender.wait()
+
+  // wait for colocated
+  nvtxRangePush("colocated.wait()");
+  for (auto &domSenders : coloSenders_) {
+    for (auto &kv : domSenders) {
+      LOG_SPEW("domain=" << kv.first << " wait colocated sender");
+      ColocatedHaloSender &sender = kv.second;
+      sender.wait();
+    }
+  }
+  for (auto &domRecvers : coloRecvers_) {
+    for (auto &kv : domRecvers) {
+      LOG_SPEW("domain=" << kv.first << " wait colocated recver");
+      ColocatedHaloRecver &recver = kv.second;
+      recver.wait();
+    }
+  }
+  nvtxRangePop(); // colocated wait
+  nvtxRangePush("remote wait");
+  // wait for remote senders and recvers
+  for (auto &domRecvers : remoteRecvers_) {
+    for (auto &kv : domRecvers) {
+      LOG_SPEW("domain=" << kv.first << " wait remote recver");
+      StatefulRecver *recver = kv.second;
+      assert(recver);
+      recver->wait();
+    }
+  }
+  for (auto &domSenders : remoteSenders_) {
+    for (auto &kv : domSenders) {
+      LOG_SPEW("domain=" << kv.first << " wait remote sender");
+      StatefulSender *sender = kv.second;
+      assert(sender);
+      sender->wait();
+    }
+  }
+  nvtxRangePop(); // remote wait
+
+  // every message halo is filled, so fill boundary halos that read them
+  nvtxRangePush("boundarySender.wait()");
+  boundarySender_.send_halo();
+  boundarySender_.wait();
+  nvtxRangePop(); // boundarySender.wait()
+}
+
+void Transports::accumulate() {
+
+  /* Use the transports planned for exchange(), but move data from each recver back to its sender.
+     Recvers pack the halos that they would unpack into, and senders add them into the interior they would pack from.
+  */
+
+  // boundary halos may add into halos that messages send back, so they go first
+  nvtxRangePush("Transports::accumulate: boundary");
+  boundarySender_.send_accumulate();
+  boundarySender_.wait();
+  nvtxRangePop();
+
+  // start remote halo packs
+  LOG_DEBUG("remote send halo start");
+  nvtxRangePush("Transports::accumulate: remote send halo");
+  for (auto &domRecvers : remoteRecvers_) {
+    for (auto &kv : domRecvers) {
+      StatefulRecver *recver = kv.second;
+      recver->send_halo();
+    }
+  }
+  nvtxRangePop();
+
+  // start colocated halo packs
+  nvtxRangePush("Transports::accumulate: colo send halo");
+  for (auto &domRecvers : coloRecvers_) {
+    for (auto &kv : domRecvers) {
+      ColocatedHaloRecver &recver = kv.second;
+      recver.send_halo();
+    }
+  }
+  nvtxRangePop();
+
+  // same-rank and same-GPU messages
+  nvtxRangePush("Transports::accumulate: peer copy");
+  for (auto &src : peerCopySenders_) {
+    for (auto &kv : src) {
+      PeerCopySender &sender = kv.second;
+      sender.send_accumulate();
+    }
+  }
+  nvtxRangePop();
+  nvtxRangePush("Transports::accumulate: peer access");
+  peerAccessSender_.send_accumulate();
+  nvtxRangePop();
+
+  // start waiting for halos from other ranks
+  nvtxRangePush("Transports::accumulate: recv");
+  for (auto &domSenders : coloSenders_) {
+    for (auto &kv : domSenders) {
+      ColocatedHaloSender &sender = kv.second;
+      sender.recv_accumulate();
+    }
+  }
+  for (auto &domSenders : remoteSenders_) {
+    for (auto &kv : domSenders) {
+      StatefulSender *sender = kv.second;
+      sender->recv_accumulate();
+    }
+  }
+  nvtxRangePop();
+
+  // poll until all halos are sent and all accumulates are started
+  nvtxRangePush("Transports::accumulate: poll");
+  engine_.poll();
+  nvtxRangePop(); // Transports::accumulate: poll
+
+  nvtxRangePush("Transports::accumulate: wait");
+  peerAccessSender_.wait();
+  for (auto &src : peerCopySenders_) {
+    for (auto &kv : src) {
+      kv.second.wait();
+    }
+  }
+  for (auto &domSenders : coloSenders_) {
+    for (auto &kv : domSenders) {
+      kv.second.wait();
+    }
+  }
+  for (auto &domRecvers : coloRecvers_) {
+    for (auto &kv : domRecvers) {
+      kv.second.wait();
+    }
+  }
+  for (auto &domRecvers : remoteRecvers_) {
+    for (auto &kv : domRecvers) {
+      kv.second->wait();
+    }
+  }
+  for (auto &domSenders : remoteSenders_) {
+    for (auto &kv : domSenders) {
+      kv.second->wait();
+    }
+  }
+  nvtxRangePop(); // Transports::accumulate: wait
+}
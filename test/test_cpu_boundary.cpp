@@ -0,0 +1,91 @@
+#include "catch2/catch.hpp"
+
+#include "stencil/boundary.hpp"
+
+TEST_CASE("boundary") {
+
+  SECTION("periodic by default") {
+    Boundary b;
+    REQUIRE(b.valid());
+    for (int i = 0; i < 3; ++i) {
+      REQUIRE(b.periodic(i));
+    }
+
+    BoundaryOp op;
+    const Dim3 dim(2, 2, 2);
+    INFO("neighbors are other subdomains");
+    REQUIRE(!b.op(&op, Dim3(0, 0, 0), Dim3(-1, 0, 0), dim));
+    REQUIRE(!b.op(&op, Dim3(1, 1, 1), Dim3(1, 1, 1), dim));
+  }
+
+  SECTION("only one face of an axis set") {
+    Boundary b;
+    b.set(Dim3(0, 1, 0), BoundaryCondition::neumann());
+    REQUIRE(!b.valid());
+    b.set(Dim3(0, -1, 0), BoundaryCondition::dirichlet(3));
+    REQUIRE(b.valid());
+    REQUIRE(!b.periodic(1));
+    REQUIRE(b.face(1, -1).value == 3);
+  }
+
+  SECTION("self wrap") {
+    Boundary b;
+    BoundaryOp op;
+    const Dim3 dim(1, 2, 2);
+    REQUIRE(b.op(&op, Dim3(0, 1, 0), Dim3(1, 0, 0), dim));
+    REQUIRE(op.op[0] == AxisOp::Wrap);
+    REQUIRE(op.op[1] == AxisOp::None);
+    REQUIRE(op.reads_interior());
+    REQUIRE(op.accumulates());
+
+    INFO("wrapping in x onto a different y is a message");
+    REQUIRE(!b.op(&op, Dim3(0, 1, 0), Dim3(1, 1, 0), dim));
+  }
+
+  SECTION("walls") {
+    Boundary b;
+    b.set(Dim3(-1, 0, 0), BoundaryCondition::dirichlet(1));
+    b.set(Dim3(1, 0, 0), BoundaryCondition::extrapolate());
+    BoundaryOp op;
+    const Dim3 dim(2, 2, 1);
+
+    INFO("interior faces are messages");
+    REQUIRE(!b.crosses(Dim3(0, 0, 0), Dim3(1, 0, 0), dim));
+    REQUIRE(!b.op(&op, Dim3(0, 0, 0), Dim3(1, 0, 0), dim));
+
+    REQUIRE(b.crosses(Dim3(0, 0, 0), Dim3(-1, 0, 0), dim));
+    REQUIRE(b.op(&op, Dim3(0, 0, 0), Dim3(-1, 0, 0), dim));
+    REQUIRE(op.op[0] == AxisOp::Dirichlet);
+    REQUIRE(op.value[0] == 1);
+    REQUIRE(op.reads_interior());
+    REQUIRE(!op.accumulates());
+
+    INFO("an edge past a wall reads the halo the y message fills");
+    REQUIRE(b.op(&op, Dim3(1, 0, 0), Dim3(1, -1, 0), dim));
+    REQUIRE(op.op[0] == AxisOp::Extrapolate);
+    REQUIRE(op.op[1] == AxisOp::None);
+    REQUIRE(!op.reads_interior());
+
+    INFO("z has one subdomain and is periodic");
+    REQUIRE(b.op(&op, Dim3(1, 1, 0), Dim3(1, 0, 1), dim));
+    REQUIRE(op.op[0] == AxisOp::Extrapolate);
+    REQUIRE(op.op[2] == AxisOp::Wrap);
+    REQUIRE(op.reads_interior());
+  }
+
+  SECTION("external") {
+    Boundary b;
+    b.set(Dim3(0, 0, -1), BoundaryCondition::external());
+    b.set(Dim3(0, 0, 1), BoundaryCondition::external());
+    BoundaryOp op;
+    const Dim3 dim(1, 1, 2);
+    REQUIRE(b.valid());
+    REQUIRE(b.crosses(Dim3(0, 0, 1), Dim3(0, 0, 1), dim));
+    INFO("filled by someone else");
+    REQUIRE(!b.op(&op, Dim3(0, 0, 1), Dim3(0, 0, 1), dim));
+    REQUIRE(!b.op(&op, Dim3(0, 0, 1), Dim3(1, 0, 1), dim));
+    INFO("still wraps in x");
+    REQUIRE(b.op(&op, Dim3(0, 0, 1), Dim3(1, 0, 0), dim));
+    REQUIRE(op.op[0] == AxisOp::Wrap);
+  }
+}
@@ -0,0 +1,89 @@
+#include "catch2/catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "stencil/logging.hpp"
+
+TEST_CASE("logging") {
+
+  SECTION("seq") {
+    std::stringstream ss;
+    ss << "ranks:" << logging::seq(std::vector<int>{0, 4, 8});
+    REQUIRE(ss.str() == "ranks: 0 4 8");
+    std::stringstream empty;
+    empty << logging::seq(std::vector<int>());
+    REQUIRE(empty.str().empty());
+  }
+
+  SECTION("rank 0 is sampled") {
+    if (0 == mpi::world_rank()) {
+      REQUIRE(logging::sampled());
+    }
+  }
+
+  SECTION("mute") {
+    REQUIRE(!logging::muted());
+    {
+      logging::Mute outer;
+      REQUIRE(logging::muted());
+      {
+        logging::Mute inner;
+        REQUIRE(logging::muted());
+      }
+      REQUIRE(logging::muted()); // an inner mute restores the outer one
+    }
+    REQUIRE(!logging::muted());
+  }
+
+  SECTION("writer") {
+    const char *path = "test_cpu_logging.txt";
+    const int nThreads = 4;
+    const int nLines = 2000;
+
+    // send stderr to a file while the writer exists
+    std::fflush(stderr);
+    const int saved = dup(fileno(stderr));
+    REQUIRE(std::freopen(path, "w", stderr));
+    {
+      logging::Writer w;
+      std::vector<std::thread> threads;
+      for (int t = 0; t < nThreads; ++t) {
+        threads.push_back(std::thread([&w, t]() {
+          for (int i = 0; i < nLines; ++i) {
+            w.write("thread " + std::to_string(t) + " line " + std::to_string(i) + "\n");
+          }
+        }));
+      }
+      // flushes race with the background thread, which must not deadlock
+      for (int i = 0; i < 100; ++i) {
+        w.flush();
+      }
+      for (std::thread &t : threads) {
+        t.join();
+      }
+    } // the writer writes the rest when destroyed
+    std::fflush(stderr);
+    dup2(saved, fileno(stderr));
+    close(saved);
+
+    std::ifstream is(path);
+    std::vector<int> next(nThreads, 0);
+    std::string word, line;
+    int t, i, n = 0;
+    while (is >> word >> t >> line >> i) {
+      REQUIRE(t >= 0);
+      REQUIRE(t < nThreads);
+      REQUIRE(i == next[t]); // each thread's messages are whole and in order
+      ++next[t];
+      ++n;
+    }
+    REQUIRE(n == nThreads * nLines);
+    std::remove(path);
+  }
+}
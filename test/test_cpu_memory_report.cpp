@@ -0,0 +1,50 @@
+#include "catch2/catch.hpp"
+
+#include <sstream>
+
+#include "stencil/memory_report.hpp"
+
+TEST_CASE("memory_report") {
+
+  MemoryReport r;
+  r.add("quantity a", 100);
+  r.add("packer", 10);
+  r.add("packer", 20);
+  r.add("pinned", 0);
+
+  SECTION("add") {
+    REQUIRE(r.entries().size() == 3);
+    REQUIRE(r.entries()[0].name == "quantity a");
+    REQUIRE(r.bytes("packer") == 30);
+    REQUIRE(r.bytes("pinned") == 0);
+    REQUIRE(r.bytes("missing") == 0);
+    REQUIRE(r.total() == 130);
+    REQUIRE(!r.predicted);
+  }
+
+  SECTION("merge peaks") {
+    MemoryReport later;
+    later.add("quantity a", 50);
+    later.add("packer", 40);
+    later.merge_peaks(r);
+    REQUIRE(later.entries().size() == 3);
+    REQUIRE(later.entries()[0].peak == 100);
+    REQUIRE(later.entries()[1].peak == 40);
+    REQUIRE(later.bytes("pinned") == 0);
+    REQUIRE(later.total() == 90);
+  }
+
+  SECTION("reduce") {
+    r.reduce(MPI_COMM_WORLD);
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (1 == size) {
+      REQUIRE(r.entries()[1].min == 30);
+      REQUIRE(r.entries()[1].max == 30);
+    }
+    std::stringstream ss;
+    ss << r;
+    REQUIRE(ss.str().find("total") != std::string::npos);
+    REQUIRE(ss.str().find("130") != std::string::npos);
+  }
+}
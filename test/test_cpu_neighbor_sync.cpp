@@ -0,0 +1,59 @@
+#include "catch2/catch.hpp"
+
+#include <thread>
+#include <vector>
+
+#include "stencil/neighbor_sync.hpp"
+
+TEST_CASE("neighbor_sync") {
+
+  SECTION("publish") {
+    NeighborSync sync(3);
+    REQUIRE(3 == sync.size());
+    REQUIRE(0 == sync.ready(1));
+    sync.publish_ready(1, 4);
+    sync.publish_done(2, 3);
+    REQUIRE(4 == sync.ready(1));
+    REQUIRE(3 == sync.done(2));
+    REQUIRE(0 == sync.ready(0));
+
+    // already satisfied waits return immediately
+    sync.wait_ready(1, 2);
+    sync.wait_done(2, 3);
+  }
+
+  SECTION("ring of threads") {
+    // each thread reads its left neighbor's value every step, then publishes its own
+    const size_t n = 4;
+    const uint64_t steps = 100;
+    NeighborSync sync(n);
+    std::vector<uint64_t> vals(n, 0);
+    std::vector<uint64_t> seen(n * steps, 0);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < n; ++i) {
+      threads.push_back(std::thread([&, i]() {
+        const size_t left = (i + n - 1) % n;
+        const size_t right = (i + 1) % n;
+        for (uint64_t step = 1; step <= steps; ++step) {
+          // our right neighbor must have read our last value before we overwrite it
+          sync.wait_done(right, step - 1);
+          vals[i] = step;
+          sync.publish_ready(i, step);
+          sync.wait_ready(left, step);
+          seen[i * steps + step - 1] = vals[left];
+          sync.publish_done(i, step);
+        }
+      }));
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+      for (uint64_t step = 1; step <= steps; ++step) {
+        REQUIRE(step == seen[i * steps + step - 1]);
+      }
+    }
+  }
+}
@@ -0,0 +1,50 @@
+#include "catch2/catch.hpp"
+
+#include <sstream>
+
+#include "stencil/pair_matrix.hpp"
+
+TEST_CASE("pair_matrix") {
+
+  PairMatrix pm;
+  pm.hosts = {"a", "a", "b"};
+  pm.bidirectional = true;
+  pm.sizes = {1, 1024};
+  pm.times.assign(2, Mat2D<double>(3, 3, PAIR_NOT_MEASURED));
+  pm.times[0].at(0, 1) = 1e-6;
+  pm.times[0].at(1, 0) = 1e-6;
+  pm.times[1].at(0, 1) = 1e-5;
+  pm.times[1].at(1, 0) = 1e-5;
+
+  SECTION("round trip") {
+    std::stringstream ss;
+    pm.write(ss);
+    PairMatrix rd;
+    REQUIRE(rd.read(ss));
+    REQUIRE(rd.hosts == pm.hosts);
+    REQUIRE(rd.bidirectional);
+    REQUIRE(!rd.concurrent);
+    REQUIRE(rd.sizes == pm.sizes);
+    REQUIRE(rd.times.size() == 2);
+    REQUIRE(rd.times[0].at(0, 1) == Approx(1e-6));
+    REQUIRE(rd.times[1].at(1, 0) == Approx(1e-5));
+    REQUIRE(rd.times[1].at(2, 0) == PAIR_NOT_MEASURED);
+  }
+
+  SECTION("measured") {
+    REQUIRE(pm.measured(0, 1));
+    REQUIRE(!pm.measured(0, 2));
+  }
+
+  SECTION("latency and bandwidth") {
+    REQUIRE(pm.latency().at(0, 1) == 1e-6);
+    REQUIRE(pm.bandwidth().at(0, 1) == Approx(1024 / 1e-5));
+    REQUIRE(pm.bandwidth().at(0, 2) == 0);
+  }
+
+  SECTION("not a pair matrix") {
+    std::stringstream ss("something else");
+    PairMatrix rd;
+    REQUIRE(!rd.read(ss));
+  }
+}
@@ -71,4 +71,79 @@ TEST_CASE("partition") {
     REQUIRE(Dim3(4, 5, 0) == part.subdomain_origin(Dim3(1, 1, 0)));
     REQUIRE(Dim3(7, 10, 0) == part.subdomain_origin(Dim3(2, 2, 0)));
   }
-}
\ No newline at end of file
+}
+TEST_CASE("partition with dim") {
+  RankPartition part(Dim3(10, 3, 1), Dim3(4, 1, 1));
+  REQUIRE(Dim3(4, 1, 1) == part.dim());
+  REQUIRE(Dim3(3, 3, 1) == part.subdomain_size(Dim3(1, 0, 0)));
+  REQUIRE(Dim3(2, 3, 1) == part.subdomain_size(Dim3(3, 0, 0)));
+  REQUIRE(Dim3(8, 0, 0) == part.subdomain_origin(Dim3(3, 0, 0)));
+}
+
+TEST_CASE("assign_active") {
+
+  SECTION("all active") {
+    std::vector<bool> active(6, true);
+    REQUIRE(assign_active(active, 3) == std::vector<int64_t>({0, 0, 1, 1, 2, 2}));
+  }
+
+  SECTION("inactive blocks are skipped") {
+    std::vector<bool> active = {true, false, true, true, false, true, true};
+    REQUIRE(assign_active(active, 2) == std::vector<int64_t>({0, -1, 0, 0, -1, 1, 1}));
+  }
+
+  SECTION("uneven") {
+    std::vector<bool> active(7, true);
+    REQUIRE(assign_active(active, 3) == std::vector<int64_t>({0, 0, 0, 1, 1, 2, 2}));
+  }
+
+  SECTION("more workers than blocks") {
+    std::vector<bool> active = {false, true, true};
+    REQUIRE(assign_active(active, 4) == std::vector<int64_t>({-1, 0, 1}));
+  }
+}
+
+TEST_CASE("subdomains_for_cache") {
+
+  SECTION("fits already") { REQUIRE(1 == subdomains_for_cache(1000, 8, 8000, 64)); }
+
+  SECTION("no cache") { REQUIRE(1 == subdomains_for_cache(1000, 8, 0, 64)); }
+
+  SECTION("power of two") {
+    // 8000B into 3000B -> 4 subdomains of 2000B
+    REQUIRE(4 == subdomains_for_cache(1000, 8, 3000, 64));
+  }
+
+  SECTION("limited") { REQUIRE(16 == subdomains_for_cache(1000, 8, 1, 16)); }
+}
+
+TEST_CASE("halo_split") {
+
+  const Radius r = Radius::constant(3);
+
+  SECTION("efficiency") {
+    REQUIRE(halo_efficiency(Dim3(10, 10, 10), Radius::constant(0)) == 1);
+    // 512x512x4 in 518x518x10
+    REQUIRE(halo_efficiency(Dim3(512, 512, 4), r) == Approx(0.3908).epsilon(0.001));
+  }
+
+  SECTION("cube") { REQUIRE(halo_split(Dim3(64, 64, 64), 8, r) == Dim3(2, 2, 2)); }
+
+  SECTION("no radius along x") {
+    Radius yz = Radius::constant(3);
+    yz.dir(1, 0, 0) = 0;
+    yz.dir(-1, 0, 0) = 0;
+    REQUIRE(halo_split(Dim3(64, 64, 64), 8, yz) == Dim3(8, 1, 1));
+  }
+
+  SECTION("thinner than radius") { REQUIRE(halo_split(Dim3(4, 4, 4), 8, r) == Dim3(0, 0, 0)); }
+
+  SECTION("enough subdomains") { REQUIRE(efficient_split(Dim3(512, 512, 512), 4096, r, 0.5) == Dim3(16, 16, 16)); }
+
+  SECTION("fewer subdomains") {
+    // 64 subdomains of 16^3 would be 0.385 efficient. 18, the thinnest 32x21x21, are 0.51
+    REQUIRE(efficient_split(Dim3(64, 64, 64), 64, r, 0.5).flatten() == 18);
+  }
+
+  SECTION("none qualify") { REQUIRE(efficient_split(Dim3(8, 8, 8), 8, r, 0.5) == Dim3(1, 1, 1)); }
+}
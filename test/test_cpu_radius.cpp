@@ -1,5 +1,6 @@
 #include "catch2/catch.hpp"
 
+#include "stencil/direction_set.hpp"
 #include "stencil/radius.hpp"
 
 TEST_CASE("radius") {
@@ -32,4 +33,44 @@ TEST_CASE("radius") {
     REQUIRE(r0.z(-1) == 1);
     REQUIRE(r0.z(1) == 1);
   }
+
+  SECTION("shape") {
+    REQUIRE(RadiusShape::Full == Radius::constant(1).shape());
+    REQUIRE(RadiusShape::Face == Radius::face_edge_corner(2, 0, 0).shape());
+
+    r0 = Radius::constant(0);
+    r0.dir(1, 0, 0) = 1;
+    r0.dir(0, -1, 0) = 1;
+    REQUIRE(RadiusShape::Face2D == r0.shape());
+    r0.dir(1, 1, 0) = 1;
+    REQUIRE(RadiusShape::Full2D == r0.shape());
+    r0.dir(0, 0, 1) = 1;
+    REQUIRE(RadiusShape::Full == r0.shape());
+  }
+
+  SECTION("directions") {
+    REQUIRE(26 == make_directions(RadiusShape::Full).size());
+    REQUIRE(6 == make_directions(RadiusShape::Face).size());
+    REQUIRE(8 == make_directions(RadiusShape::Full2D).size());
+    REQUIRE(4 == make_directions(RadiusShape::Face2D).size());
+
+    for (const Dim3 &dir : make_directions(RadiusShape::Full)) {
+      REQUIRE(Dim3(0, 0, 0) != dir);
+    }
+    for (const Dim3 &dir : make_directions(RadiusShape::Full2D)) {
+      REQUIRE(0 == dir.z);
+      REQUIRE((0 != dir.x || 0 != dir.y));
+    }
+  }
+
+  SECTION("directions of a thin domain") {
+    REQUIRE(26 == make_directions(RadiusShape::Full, Dim3(10, 10, 10)).size());
+    REQUIRE(8 == make_directions(RadiusShape::Full, Dim3(10, 10, 1)).size());
+    REQUIRE(4 == make_directions(RadiusShape::Face, Dim3(10, 10, 1)).size());
+    REQUIRE(2 == make_directions(RadiusShape::Full, Dim3(10, 1, 1)).size());
+    REQUIRE(make_directions(RadiusShape::Full, Dim3(1, 1, 1)).empty());
+    for (const Dim3 &dir : make_directions(RadiusShape::Full, Dim3(10, 10, 1))) {
+      REQUIRE(0 == dir.z);
+    }
+  }
 }
\ No newline at end of file
@@ -7,4 +7,53 @@ TEST_CASE("tag") {
   REQUIRE(make_tag(0, 0, Dim3(0, 0, 0)) != make_tag(0, 0, Dim3(0, 0, -1)));
   REQUIRE(make_tag(0, 0, Dim3(0, 0, 0)) == make_tag(0, 0, Dim3(0, 0, 0)));
   REQUIRE(make_tag(0, 1, Dim3(0, 0, 0)) != make_tag(0, 0, Dim3(0, 0, 0)));
-}
\ No newline at end of file
+}
+TEST_CASE("msg kind tag") {
+
+  const int last = MAX_RANK_SUBDOMAINS - 1;
+
+  SECTION("fits in 23 bits") {
+    REQUIRE(MAX_MSG_KIND_TAG < (1 << 23));
+    REQUIRE(make_tag<MsgKind::Particle>(subdomain_pair(last, last)) <= MAX_MSG_KIND_TAG);
+  }
+
+  SECTION("distinct kinds") {
+    const int payload = subdomain_pair(3, 5);
+    REQUIRE(make_tag<MsgKind::Remote>(payload) != make_tag<MsgKind::RemoteAccumulate>(payload));
+    REQUIRE(make_tag<MsgKind::Remote>(payload) != make_tag<MsgKind::ColocatedNotify>(payload));
+    REQUIRE(make_tag<MsgKind::Remote>(payload) != make_tag<MsgKind::Particle>(payload));
+  }
+
+  SECTION("distinct subdomain pairs") {
+    REQUIRE(subdomain_pair(0, 1) != subdomain_pair(1, 0));
+    REQUIRE(subdomain_pair(last, 0) != subdomain_pair(0, last));
+    REQUIRE(make_tag<MsgKind::Remote>(subdomain_pair(8, 0)) != make_tag<MsgKind::Remote>(subdomain_pair(0, 0)));
+  }
+}
+
+TEST_CASE("chunks") {
+
+  SECTION("empty") { REQUIRE(num_chunks(0, 4) == 0); }
+
+  SECTION("unchunked") {
+    REQUIRE(num_chunks(10, 0) == 1);
+    REQUIRE(chunk_size(0, 10, 0) == 10);
+  }
+
+  SECTION("uneven") {
+    REQUIRE(num_chunks(10, 4) == 3);
+    REQUIRE(chunk_size(0, 10, 4) == 4);
+    REQUIRE(chunk_size(1, 10, 4) == 4);
+    REQUIRE(chunk_size(2, 10, 4) == 2);
+  }
+
+  SECTION("even") {
+    REQUIRE(num_chunks(8, 4) == 2);
+    REQUIRE(chunk_size(1, 8, 4) == 4);
+  }
+
+  SECTION("smaller than a chunk") {
+    REQUIRE(num_chunks(3, 4) == 1);
+    REQUIRE(chunk_size(0, 3, 4) == 3);
+  }
+}
@@ -40,18 +40,26 @@ TEMPLATE_TEST_CASE("colocated", "[mpi][cuda][template]", int32_t, int64_t) {
   CUDA_RUNTIME(cudaMalloc(&buf1, n * sizeof(TestType)));
 
   INFO("ctors");
-  ColocatedDeviceSender sender(myRank, srcGPU, dstRank, dstGPU, srcDev);
-  ColocatedDeviceRecver recver(srcRank, srcGPU, myRank, dstGPU, dstDev);
+  ColocatedDeviceSender sender(myRank, srcGPU, dstRank, dstGPU, srcDev, MPI_COMM_WORLD);
+  ColocatedDeviceRecver recver(srcRank, srcGPU, myRank, dstGPU, dstDev, MPI_COMM_WORLD);
 
   INFO("sender.start_prepare");
   sender.start_prepare(n * sizeof(TestType));
   INFO("recver.start_prepare");
   recver.start_prepare(buf1);
 
+  INFO("exchange_setup");
+  std::map<int, std::vector<ColocatedSetup>> setupOut, setupIn;
+  setupOut[dstRank].push_back(sender.setup());
+  setupIn[dstRank].emplace_back();
+  setupOut[srcRank].push_back(recver.setup());
+  setupIn[srcRank].emplace_back();
+  exchange_setup(setupIn, setupOut, MPI_COMM_WORLD);
+
   INFO("sender.finish_prepare");
-  sender.finish_prepare();
+  sender.finish_prepare(find_setup(setupIn[dstRank], MsgKind::ColocatedMem, sender.setup().pair));
   INFO("recver.finish_prepare");
-  recver.finish_prepare();
+  recver.finish_prepare(find_setup(setupIn[srcRank], MsgKind::ColocatedEvt, recver.setup().pair));
 
   INFO("streams");
   RcStream sendStream(srcDev);
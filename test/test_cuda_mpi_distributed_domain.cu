@@ -1,13 +1,17 @@
 #include "catch2/catch.hpp"
 
 #include <cstring> // std::memcpy
+#include <functional>
+#include <thread>
 
 #include "stencil/copy.cuh"
 #include "stencil/cuda_runtime.hpp"
 #include "stencil/dim3.hpp"
+#include "stencil/exchange_group.hpp"
+#include "stencil/refine.hpp"
 #include "stencil/stencil.hpp"
 
-__device__ int pack_xyz(int x, int y, int z) {
+__host__ __device__ int pack_xyz(int x, int y, int z) {
   int ret = 0;
   ret |= x & 0x3FF;
   ret |= (y & 0x3FF) << 10;
@@ -247,4 +251,877 @@ TEST_CASE("swap") {
   MPI_Barrier(MPI_COMM_WORLD);
 
   dd.swap();
-}
\ No newline at end of file
+}
+
+TEST_CASE("ensemble") {
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  size_t radius = 1;
+  typedef float Q1;
+  const size_t nMembers = 3;
+  const int64_t memberOffset = 100; // fits the 10-bit x of pack_xyz for every member
+
+  INFO("ctor");
+  DistributedDomain dd(10, 10, 10);
+  dd.set_radius(radius);
+  dd.set_ensemble(nMembers);
+  auto dh1 = dd.add_data<Q1>("d0");
+  dd.set_methods(MethodFlags::CudaMpi);
+  REQUIRE(nMembers == dd.ensemble_size());
+
+  INFO("realize");
+  dd.realize();
+
+  INFO("init");
+  dim3 dimGrid(10, 10, 10);
+  dim3 dimBlock(8, 8, 8);
+  for (auto &d : dd.domains()) {
+    REQUIRE(int64_t(nMembers) == d.num_data());
+    CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+    for (size_t m = 0; m < nMembers; ++m) {
+      Q1 *member = d.get_curr(dd.get_member(dh1, m));
+      REQUIRE(member != nullptr);
+      if (m > 0) {
+        REQUIRE(member != d.get_curr(dd.get_member(dh1, m - 1)));
+      }
+      // member m holds x + memberOffset * m, so a member swapped with another in the message is caught
+      init_kernel<<<dimGrid, dimBlock>>>(member, d.origin() + Dim3(memberOffset * m, 0, 0), d.raw_size());
+    }
+    CUDA_RUNTIME(cudaDeviceSynchronize());
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  INFO("exchange");
+  dd.exchange();
+  CUDA_RUNTIME(cudaDeviceSynchronize());
+
+  INFO("check halo regions of every member against that member's own values");
+  for (auto &d : dd.domains()) {
+    const Dim3 origin = d.origin();
+    Dim3 ext = d.size();
+    ext.x += 2 * radius;
+    ext.y += 2 * radius;
+    ext.z += 2 * radius;
+
+    for (size_t qi = 0; qi < d.num_data(); ++qi) {
+      auto vec = d.quantity_to_host(qi);
+      std::vector<Q1> quantity(ext.flatten());
+      REQUIRE(vec.size() == quantity.size() * sizeof(Q1));
+      std::memcpy(quantity.data(), vec.data(), vec.size());
+
+      for (int64_t z = 0; z < ext.z; ++z) {
+        for (int64_t y = 0; y < ext.y; ++y) {
+          for (int64_t x = 0; x < ext.x; ++x) {
+            Dim3 coord = Dim3(x, y, z) - Dim3(radius, radius, radius) + origin;
+            coord = coord.wrap(Dim3(10, 10, 10));
+
+            Q1 val = quantity[z * (ext.y * ext.x) + y * (ext.x) + x];
+            REQUIRE(unpack_x(val) == coord.x + memberOffset * int64_t(qi));
+            REQUIRE(unpack_y(val) == coord.y);
+            REQUIRE(unpack_z(val) == coord.z);
+          }
+        }
+      }
+    }
+  }
+}
+
+/* check that every point in the domain, including the halo, holds its wrapped global coordinate
+ */
+template <typename T> static void require_coords(LocalDomain &d, const size_t qi, const Dim3 &globalSize) {
+  const Radius &radius = d.radius();
+  const Dim3 origin = d.origin();
+  const Dim3 ext = d.raw_size(qi);
+
+  auto vec = d.quantity_to_host(qi);
+  std::vector<T> quantity(ext.flatten());
+  REQUIRE(vec.size() == quantity.size() * sizeof(T));
+  std::memcpy(quantity.data(), vec.data(), vec.size());
+
+  for (int64_t z = 0; z < ext.z; ++z) {
+    for (int64_t y = 0; y < ext.y; ++y) {
+      for (int64_t x = 0; x < ext.x; ++x) {
+        Dim3 coord = Dim3(x, y, z) - Dim3(radius.x(-1), radius.y(-1), radius.z(-1)) + origin;
+        coord = coord.wrap(globalSize);
+
+        T val = quantity[z * (ext.y * ext.x) + y * (ext.x) + x];
+        REQUIRE(unpack_x(val) == coord.x);
+        REQUIRE(unpack_y(val) == coord.y);
+        REQUIRE(unpack_z(val) == coord.z);
+      }
+    }
+  }
+}
+
+/* set every owned point of quantity `qi` to `f` of its global coordinate, and the halo to -1
+ */
+template <typename T>
+static void fill_owned(LocalDomain &d, const size_t qi, const std::function<T(const Dim3 &)> &f) {
+  const Dim3 lo(d.radius().x(-1), d.radius().y(-1), d.radius().z(-1));
+  const Dim3 raw = d.raw_size(qi);
+  std::vector<T> host(raw.flatten(), -1);
+  for (int64_t z = lo.z; z < lo.z + d.size().z; ++z) {
+    for (int64_t y = lo.y; y < lo.y + d.size().y; ++y) {
+      for (int64_t x = lo.x; x < lo.x + d.size().x; ++x) {
+        host[z * raw.y * raw.x + y * raw.x + x] = f(d.origin() + Dim3(x, y, z) - lo);
+      }
+    }
+  }
+  CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+  CUDA_RUNTIME(cudaMemcpy(d.curr_data(qi), host.data(), host.size() * sizeof(T), cudaMemcpyHostToDevice));
+}
+
+/* quantity `qi` of `d`, including the halo
+ */
+template <typename T> static std::vector<T> host_quantity(LocalDomain &d, const size_t qi) {
+  std::vector<T> host(d.raw_size(qi).flatten());
+  CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+  CUDA_RUNTIME(cudaMemcpy(host.data(), d.curr_data(qi), host.size() * sizeof(T), cudaMemcpyDeviceToHost));
+  return host;
+}
+
+TEST_CASE("communicator") {
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  typedef float Q1;
+  const Dim3 sz(10, 10, 10);
+
+  dim3 dimGrid(10, 10, 10);
+  dim3 dimBlock(8, 8, 8);
+
+  SECTION("two domains on one communicator") {
+    DistributedDomain dd1(sz.x, sz.y, sz.z, MPI_COMM_WORLD);
+    DistributedDomain dd2(sz.x, sz.y, sz.z, MPI_COMM_WORLD);
+    REQUIRE(dd1.comm() != MPI_COMM_WORLD);
+    REQUIRE(dd2.comm() != dd1.comm());
+
+    dd1.set_radius(1);
+    dd2.set_radius(1);
+    auto dh1 = dd1.add_data<Q1>("d1");
+    auto dh2 = dd2.add_data<Q1>("d2");
+    dd1.set_methods(MethodFlags::CudaMpi);
+    dd2.set_methods(MethodFlags::CudaMpi);
+    dd1.realize();
+    dd2.realize();
+
+    for (auto &d : dd1.domains()) {
+      CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+      init_kernel<<<dimGrid, dimBlock>>>(d.get_curr(dh1), d.origin(), d.raw_size());
+      CUDA_RUNTIME(cudaDeviceSynchronize());
+    }
+    for (auto &d : dd2.domains()) {
+      CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+      init_kernel<<<dimGrid, dimBlock>>>(d.get_curr(dh2), d.origin(), d.raw_size());
+      CUDA_RUNTIME(cudaDeviceSynchronize());
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    // start both exchanges before waiting on either, so messages of both domains are in flight at once
+    ExchangeHandle h1 = dd1.exchange_async(dd1.quantities(dh1));
+    ExchangeHandle h2 = dd2.exchange_async(dd2.quantities(dh2));
+    h1.wait();
+    h2.wait();
+    CUDA_RUNTIME(cudaDeviceSynchronize());
+
+    for (auto &d : dd1.domains()) {
+      require_coords<Q1>(d, 0, sz);
+    }
+    for (auto &d : dd2.domains()) {
+      require_coords<Q1>(d, 0, sz);
+    }
+  }
+
+  SECTION("one domain per rank") {
+    MPI_Comm self;
+    MPI_Comm_split(MPI_COMM_WORLD, rank, 0, &self);
+    {
+      DistributedDomain dd(sz.x, sz.y, sz.z, self);
+      dd.set_radius(1);
+      auto dh = dd.add_data<Q1>("d0");
+      dd.set_methods(MethodFlags::CudaMpi);
+      dd.realize();
+
+      for (auto &d : dd.domains()) {
+        CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+        init_kernel<<<dimGrid, dimBlock>>>(d.get_curr(dh), d.origin(), d.raw_size());
+        CUDA_RUNTIME(cudaDeviceSynchronize());
+      }
+
+      dd.exchange();
+      CUDA_RUNTIME(cudaDeviceSynchronize());
+
+      for (auto &d : dd.domains()) {
+        require_coords<Q1>(d, 0, sz);
+      }
+    }
+    MPI_Comm_free(&self);
+  }
+}
+
+/* exchange_accumulate() of a quantity of type Q1 that is 1 everywhere
+ */
+template <typename Q1> static void require_accumulate() {
+  const size_t radius = 1;
+
+  DistributedDomain dd(10, 10, 10);
+  dd.set_radius(radius);
+  auto dh1 = dd.add_data<Q1>("d0");
+  dd.set_methods(MethodFlags::All);
+  dd.realize();
+
+  INFO("set every point, including the halo, to 1");
+  for (auto &d : dd.domains()) {
+    std::vector<Q1> ones(d.raw_size().flatten(), 1);
+    CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+    CUDA_RUNTIME(cudaMemcpy(d.get_curr(dh1), ones.data(), ones.size() * sizeof(Q1), cudaMemcpyHostToDevice));
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  dd.exchange_accumulate();
+  CUDA_RUNTIME(cudaDeviceSynchronize());
+
+  INFO("each interior point gets 1 from every halo region that covers it");
+  for (auto &d : dd.domains()) {
+    const Dim3 sz = d.size();
+    const Dim3 ext = d.raw_size();
+    auto vec = d.quantity_to_host(0);
+    std::vector<Q1> quantity(ext.flatten());
+    REQUIRE(vec.size() == quantity.size() * sizeof(Q1));
+    std::memcpy(quantity.data(), vec.data(), vec.size());
+
+    for (int64_t z = 0; z < ext.z; ++z) {
+      for (int64_t y = 0; y < ext.y; ++y) {
+        for (int64_t x = 0; x < ext.x; ++x) {
+          const Dim3 p = Dim3(x, y, z) - Dim3(radius, radius, radius); // position in compute region
+          const bool halo = !(p.all_ge(0) && p.all_lt(sz));
+
+          Q1 expected = 1;
+          if (!halo) {
+            for (int dz = -1; dz <= 1; ++dz) {
+              for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                  if (dx == 0 && dy == 0 && dz == 0) {
+                    continue;
+                  }
+                  const bool inX = (dx == 0) || (dx < 0 ? p.x < int64_t(radius) : p.x >= sz.x - int64_t(radius));
+                  const bool inY = (dy == 0) || (dy < 0 ? p.y < int64_t(radius) : p.y >= sz.y - int64_t(radius));
+                  const bool inZ = (dz == 0) || (dz < 0 ? p.z < int64_t(radius) : p.z >= sz.z - int64_t(radius));
+                  if (inX && inY && inZ) {
+                    expected += 1;
+                  }
+                }
+              }
+            }
+          }
+          REQUIRE(quantity[z * (ext.y * ext.x) + y * (ext.x) + x] == expected);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("exchange_accumulate") {
+  SECTION("float") { require_accumulate<float>(); }
+  SECTION("double") { require_accumulate<double>(); }
+  SECTION("int64_t") { require_accumulate<int64_t>(); }
+}
+
+TEST_CASE("migrate") {
+  DistributedDomain dd(10, 10, 10);
+  dd.set_radius(1);
+  auto ih = dd.add_particle_attr<int64_t>("id");
+  dd.set_methods(MethodFlags::All);
+  dd.realize();
+  const Dim3 globalSize = dd.size();
+
+  INFO("one particle in the center of each compute point, tagged with that point, then shifted by [1,1,1]");
+  for (auto &d : dd.domains()) {
+    const Dim3 sz = d.size();
+    std::vector<ParticlePos> x, y, z;
+    std::vector<int64_t> id;
+    for (int64_t pz = 0; pz < sz.z; ++pz) {
+      for (int64_t py = 0; py < sz.y; ++py) {
+        for (int64_t px = 0; px < sz.x; ++px) {
+          const Dim3 g = d.origin() + Dim3(px, py, pz);
+          x.push_back(g.x + 1.5);
+          y.push_back(g.y + 1.5);
+          z.push_back(g.z + 1.5);
+          id.push_back(g.z * (globalSize.y * globalSize.x) + g.y * globalSize.x + g.x);
+        }
+      }
+    }
+    Particles &particles = d.particles();
+    particles.resize(id.size());
+    CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+    CUDA_RUNTIME(cudaMemcpy(particles.x(), x.data(), x.size() * sizeof(x[0]), cudaMemcpyHostToDevice));
+    CUDA_RUNTIME(cudaMemcpy(particles.y(), y.data(), y.size() * sizeof(y[0]), cudaMemcpyHostToDevice));
+    CUDA_RUNTIME(cudaMemcpy(particles.z(), z.data(), z.size() * sizeof(z[0]), cudaMemcpyHostToDevice));
+    CUDA_RUNTIME(cudaMemcpy(particles.get(ih), id.data(), id.size() * sizeof(id[0]), cudaMemcpyHostToDevice));
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  dd.migrate();
+
+  INFO("every domain has one particle per point, each in its compute region and tagged with the point it came from");
+  for (auto &d : dd.domains()) {
+    const Particles &particles = d.particles();
+    REQUIRE(particles.size() == size_t(d.size().flatten()));
+
+    std::vector<ParticlePos> pos[3];
+    for (size_t a = 0; a < 3; ++a) {
+      auto vec = particles.attr_to_host(a);
+      pos[a].resize(particles.size());
+      std::memcpy(pos[a].data(), vec.data(), vec.size());
+    }
+    auto vec = particles.attr_to_host(3);
+    std::vector<int64_t> id(particles.size());
+    std::memcpy(id.data(), vec.data(), vec.size());
+
+    for (size_t i = 0; i < particles.size(); ++i) {
+      const Dim3 p(int64_t(pos[0][i]), int64_t(pos[1][i]), int64_t(pos[2][i]));
+      REQUIRE((p - d.origin()).all_ge(0));
+      REQUIRE((p - d.origin()).all_lt(d.size()));
+      const Dim3 src = (p - Dim3(1, 1, 1)).wrap(globalSize);
+      REQUIRE(id[i] == src.z * (globalSize.y * globalSize.x) + src.y * globalSize.x + src.x);
+    }
+  }
+}
+
+TEST_CASE("subdomains per gpu") {
+  typedef float Q1;
+  const Dim3 sz(20, 20, 20);
+
+  dim3 dimGrid(10, 10, 10);
+  dim3 dimBlock(8, 8, 8);
+
+  DistributedDomain dd(sz.x, sz.y, sz.z);
+  dd.set_radius(1);
+  auto dh = dd.add_data<Q1>("d0");
+  dd.set_subdomains_per_gpu(8);
+  dd.set_methods(MethodFlags::All);
+  dd.realize();
+
+  INFO("several subdomains share each GPU");
+  REQUIRE(dd.domains().size() >= 8);
+  REQUIRE(dd.domains().size() % 8 == 0);
+
+  for (auto &d : dd.domains()) {
+    CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+    init_kernel<<<dimGrid, dimBlock>>>(d.get_curr(dh), d.origin(), d.raw_size());
+    CUDA_RUNTIME(cudaDeviceSynchronize());
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  dd.exchange();
+  CUDA_RUNTIME(cudaDeviceSynchronize());
+
+  for (auto &d : dd.domains()) {
+    require_coords<Q1>(d, 0, sz);
+  }
+}
+
+TEST_CASE("memory_report") {
+  DistributedDomain dd(30, 20, 10);
+  dd.set_radius(2);
+  dd.add_data<float>("d0");
+  dd.add_data<double>("d1", Dim3(1, 0, 0));
+
+  INFO("before realize() the report is a prediction");
+  const MemoryReport predicted = dd.memory_report();
+  REQUIRE(predicted.predicted);
+  REQUIRE(predicted.bytes("quantity d0") > 0);
+
+  dd.realize();
+  const MemoryReport realized = dd.memory_report();
+  REQUIRE(!realized.predicted);
+  REQUIRE(realized.bytes("quantity d1") > 0);
+  for (const MemoryReport::Entry &e : realized.entries()) {
+    REQUIRE(e.peak >= e.bytes);
+    REQUIRE(e.max >= e.min);
+  }
+
+  INFO("the prediction is an upper bound on what realize() allocated");
+  REQUIRE(predicted.total() >= realized.total());
+}
+
+TEST_CASE("exchange_async") {
+  typedef float Q1;
+  const Dim3 sz(20, 20, 20);
+
+  dim3 dimGrid(10, 10, 10);
+  dim3 dimBlock(8, 8, 8);
+
+  DistributedDomain dd(sz.x, sz.y, sz.z);
+  dd.set_radius(1);
+  auto dh0 = dd.add_data<Q1>("d0");
+  auto dh1 = dd.add_data<Q1>("d1");
+  dd.set_methods(MethodFlags::All);
+  dd.realize();
+
+  // fill the next buffers and swap, so the subsets' views must pick up the swap
+  for (auto &d : dd.domains()) {
+    CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+    init_kernel<<<dimGrid, dimBlock>>>(d.get_next(dh0), d.origin(), d.raw_size());
+    init_kernel<<<dimGrid, dimBlock>>>(d.get_next(dh1), d.origin(), d.raw_size());
+    CUDA_RUNTIME(cudaDeviceSynchronize());
+  }
+  dd.swap();
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  SECTION("one subset") {
+    ExchangeHandle h = dd.exchange_async(dd.quantities(dh0));
+    h.wait();
+    REQUIRE(h.test());
+    for (auto &d : dd.domains()) {
+      require_coords<Q1>(d, 0, sz);
+
+      INFO("the other quantity's halo is untouched");
+      auto vec = d.quantity_to_host(1);
+      Q1 corner;
+      std::memcpy(&corner, vec.data(), sizeof(corner));
+      REQUIRE(corner == -1);
+    }
+  }
+
+  SECTION("two subsets in flight") {
+    ExchangeHandle h0 = dd.exchange_async(dd.quantities(dh0));
+    ExchangeHandle h1 = dd.exchange_async(dd.quantities(dh1));
+    h1.wait();
+    h0.wait();
+    for (auto &d : dd.domains()) {
+      require_coords<Q1>(d, 0, sz);
+      require_coords<Q1>(d, 1, sz);
+    }
+  }
+}
+
+/*! set the interior of dst to pack_xyz() of the global coordinate in the low 32 bits and `step` in the high 32 bits
+ */
+__global__ void stamp_kernel(int64_t *dst, const Dim3 origin, const Dim3 rawSz, const int64_t step) {
+  constexpr int64_t radius = 1;
+  for (int64_t z = blockIdx.z * blockDim.z + threadIdx.z + radius; z < rawSz.z - radius; z += gridDim.z * blockDim.z) {
+    for (int64_t y = blockIdx.y * blockDim.y + threadIdx.y + radius; y < rawSz.y - radius;
+         y += gridDim.y * blockDim.y) {
+      for (int64_t x = blockIdx.x * blockDim.x + threadIdx.x + radius; x < rawSz.x - radius;
+           x += gridDim.x * blockDim.x) {
+        dst[z * rawSz.y * rawSz.x + y * rawSz.x + x] =
+            (step << 32) | pack_xyz(origin.x + x - radius, origin.y + y - radius, origin.z + z - radius);
+      }
+    }
+  }
+}
+
+TEST_CASE("exchange_stale") {
+  typedef float Q1;
+  const Dim3 sz(20, 20, 20);
+
+  dim3 dimGrid(10, 10, 10);
+  dim3 dimBlock(8, 8, 8);
+
+  DistributedDomain dd(sz.x, sz.y, sz.z);
+  dd.set_radius(1);
+  auto dh0 = dd.add_data<Q1>("d0");
+  dd.set_methods(MethodFlags::CudaMpi | MethodFlags::CudaMemcpyPeer | MethodFlags::CudaKernel);
+  dd.realize();
+
+  for (auto &d : dd.domains()) {
+    CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+    init_kernel<<<dimGrid, dimBlock>>>(d.get_curr(dh0), d.origin(), d.raw_size());
+    CUDA_RUNTIME(cudaDeviceSynchronize());
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  SECTION("staleness 0 is exchange()") {
+    REQUIRE(dd.exchange_stale(1, 0) == 1);
+    for (auto &d : dd.domains()) {
+      require_coords<Q1>(d, 0, sz);
+    }
+    dd.finish_stale(2);
+  }
+
+  SECTION("halos are within the bound") {
+    const uint64_t s = 2;
+    for (uint64_t step = 1; step <= 5; ++step) {
+      const uint64_t oldest = dd.exchange_stale(step, s);
+      REQUIRE(oldest <= step);
+      REQUIRE(oldest + s >= step);
+    }
+    dd.finish_stale(6);
+    // the interiors never changed, so every halo is right whichever step it came from
+    for (auto &d : dd.domains()) {
+      require_coords<Q1>(d, 0, sz);
+    }
+  }
+}
+
+TEST_CASE("exchange_stale with swap") {
+  const Dim3 sz(20, 20, 20);
+  const uint64_t s = 2;
+
+  dim3 dimGrid(10, 10, 10);
+  dim3 dimBlock(8, 8, 8);
+
+  DistributedDomain dd(sz.x, sz.y, sz.z);
+  dd.set_radius(1);
+  auto dh0 = dd.add_data<int64_t>("d0");
+  dd.set_methods(MethodFlags::CudaMpi | MethodFlags::CudaMemcpyPeer | MethodFlags::CudaKernel);
+  dd.realize();
+
+  for (auto &d : dd.domains()) {
+    CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+    stamp_kernel<<<dimGrid, dimBlock>>>(d.get_curr(dh0), d.origin(), d.raw_size(), 0);
+    CUDA_RUNTIME(cudaDeviceSynchronize());
+  }
+  dd.exchange();
+
+  INFO("each step swaps, writes the step into the new interior, and exchanges");
+  for (uint64_t step = 1; step <= 6; ++step) {
+    dd.swap();
+    for (auto &d : dd.domains()) {
+      CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+      stamp_kernel<<<dimGrid, dimBlock>>>(d.get_curr(dh0), d.origin(), d.raw_size(), int64_t(step));
+      CUDA_RUNTIME(cudaDeviceSynchronize());
+    }
+    const uint64_t oldest = dd.exchange_stale(step, s);
+    REQUIRE(oldest <= step);
+    REQUIRE(oldest + s >= step);
+
+    INFO("every halo of the current buffers is from a step in [oldest, step], at the right coordinate");
+    for (auto &d : dd.domains()) {
+      const Dim3 ext = d.raw_size(0);
+      auto vec = d.quantity_to_host(0);
+      std::vector<int64_t> quantity(ext.flatten());
+      REQUIRE(vec.size() == quantity.size() * sizeof(int64_t));
+      std::memcpy(quantity.data(), vec.data(), vec.size());
+      for (int64_t z = 0; z < ext.z; ++z) {
+        for (int64_t y = 0; y < ext.y; ++y) {
+          for (int64_t x = 0; x < ext.x; ++x) {
+            const Dim3 coord = (Dim3(x, y, z) - Dim3(1, 1, 1) + d.origin()).wrap(sz);
+            const int64_t val = quantity[z * (ext.y * ext.x) + y * (ext.x) + x];
+            const uint64_t valStep = uint64_t(val) >> 32;
+            REQUIRE(unpack_x(int(val & 0xFFFFFFFF)) == coord.x);
+            REQUIRE(unpack_y(int(val & 0xFFFFFFFF)) == coord.y);
+            REQUIRE(unpack_z(int(val & 0xFFFFFFFF)) == coord.z);
+            REQUIRE(valStep >= oldest);
+            REQUIRE(valStep <= step);
+          }
+        }
+      }
+    }
+  }
+  dd.finish_stale(7);
+}
+
+TEST_CASE("staggered") {
+  typedef int32_t Q1;
+  const Dim3 sz(12, 12, 12);
+
+  DistributedDomain dd(sz.x, sz.y, sz.z);
+  dd.set_radius(1);
+  auto dhc = dd.add_data<Q1>("cell");
+  auto dhu = dd.add_data<Q1>("u", Dim3(1, 0, 0));
+  dd.set_methods(MethodFlags::All);
+  dd.realize();
+
+  for (auto &d : dd.domains()) {
+    INFO("u has one more point along x, including in the +x halo, and nowhere else");
+    REQUIRE(d.raw_size(1) == d.raw_size() + Dim3(1, 0, 0));
+    REQUIRE(d.halo_bytes(Dim3(1, 0, 0), 1) == 2 * d.halo_bytes(Dim3(1, 0, 0), 0));
+    REQUIRE(d.halo_bytes(Dim3(-1, 0, 0), 1) == d.halo_bytes(Dim3(-1, 0, 0), 0));
+    REQUIRE(d.halo_bytes(Dim3(0, 1, 0), 1) == d.halo_bytes(Dim3(0, 1, 0), 0));
+
+    // owned points hold their coordinate, the halo and u's shared face are -1
+    for (size_t qi = 0; qi < 2; ++qi) {
+      fill_owned<Q1>(d, qi, [](const Dim3 &p) { return pack_xyz(p.x, p.y, p.z); });
+    }
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  dd.exchange();
+
+  for (auto &d : dd.domains()) {
+    require_coords<Q1>(d, 0, sz);
+    INFO("u's shared face comes from the +x neighbor");
+    require_coords<Q1>(d, 1, sz);
+  }
+}
+
+TEST_CASE("boundary") {
+  typedef float Q1;
+  const Dim3 sz(12, 12, 12);
+  const Q1 wall = 7;
+
+  DistributedDomain dd(sz.x, sz.y, sz.z);
+  dd.set_radius(1);
+  dd.add_data<Q1>("x");
+  dd.set_boundary(Dim3(-1, 0, 0), BoundaryCondition::dirichlet(wall));
+  dd.set_boundary(Dim3(1, 0, 0), BoundaryCondition::neumann());
+  dd.set_methods(MethodFlags::All);
+  dd.realize();
+
+  // owned points hold their global x, the halo is -1
+  for (auto &d : dd.domains()) {
+    fill_owned<Q1>(d, 0, [](const Dim3 &p) { return Q1(p.x); });
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  dd.exchange();
+
+  INFO("the -x wall is fixed, the +x wall mirrors the interior, y and z are periodic");
+  for (auto &d : dd.domains()) {
+    const Dim3 raw = d.raw_size();
+    const std::vector<Q1> host = host_quantity<Q1>(d, 0);
+    for (int64_t z = 0; z < raw.z; ++z) {
+      for (int64_t y = 0; y < raw.y; ++y) {
+        for (int64_t x = 0; x < raw.x; ++x) {
+          const int64_t gx = d.origin().x + x - 1;
+          Q1 expected = gx;
+          if (gx < 0) {
+            expected = wall;
+          } else if (gx >= sz.x) {
+            expected = 2 * sz.x - 1 - gx;
+          }
+          INFO(d.origin() << " + " << Dim3(x, y, z));
+          REQUIRE(host[z * raw.y * raw.x + y * raw.x + x] == expected);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("set_active") {
+  typedef float Q1;
+  const Dim3 sz(16, 8, 8);
+
+  DistributedDomain dd(sz.x, sz.y, sz.z);
+  dd.set_radius(1);
+  dd.add_data<Q1>("x");
+  INFO("only the two blocks with x < 8 are active");
+  dd.set_active(Dim3(4, 1, 1), [](const Rect3 &region) { return region.lo.x < 8; });
+  dd.set_methods(MethodFlags::All);
+  dd.realize();
+
+  int64_t count = dd.domains().size();
+  MPI_Allreduce(MPI_IN_PLACE, &count, 1, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+  REQUIRE(count == 2);
+
+  // owned points hold their global x, the halo is -1
+  for (auto &d : dd.domains()) {
+    REQUIRE(d.origin().x < 8);
+    REQUIRE(d.size() == Dim3(4, 8, 8));
+    fill_owned<Q1>(d, 0, [](const Dim3 &p) { return Q1(p.x); });
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  dd.exchange();
+
+  INFO("the halo between the active blocks is exchanged, the halos facing inactive blocks are untouched");
+  for (auto &d : dd.domains()) {
+    const Dim3 raw = d.raw_size();
+    const std::vector<Q1> host = host_quantity<Q1>(d, 0);
+    const int64_t y = 1, z = 1;
+    if (0 == d.origin().x) {
+      REQUIRE(host[z * raw.y * raw.x + y * raw.x + 0] == -1);
+      REQUIRE(host[z * raw.y * raw.x + y * raw.x + raw.x - 1] == 4);
+    } else {
+      REQUIRE(host[z * raw.y * raw.x + y * raw.x + 0] == 3);
+      REQUIRE(host[z * raw.y * raw.x + y * raw.x + raw.x - 1] == -1);
+    }
+  }
+}
+
+TEST_CASE("refined patch") {
+  typedef float Q1;
+  const Dim3 sz(8, 8, 8);
+
+  DistributedDomain dd(sz.x, sz.y, sz.z);
+  dd.set_radius(1);
+  dd.add_data<Q1>("x");
+  dd.set_methods(MethodFlags::All);
+  dd.realize();
+
+  // each point holds `f` of its global coordinate, the halo is -1
+  auto fill = [](DistributedDomain &d, std::function<Q1(const Dim3 &)> f) {
+    for (auto &ld : d.domains()) {
+      fill_owned<Q1>(ld, 0, f);
+    }
+  };
+  fill(dd, [](const Dim3 &p) { return Q1(p.x); });
+
+  const Rect3 region(Dim3(2, 2, 2), Dim3(6, 6, 6));
+  RefinedPatch patch(dd, region);
+  patch.realize();
+  REQUIRE(patch.fine().size() == Dim3(8, 8, 8));
+
+  // fine point f is at parent point region.lo + (f + 0.5) / 2 - 0.5, so a field linear in x is 1.75 + f.x / 2
+  fill(patch.fine(), [](const Dim3 &f) { return Q1(1.75 + f.x / 2.0); });
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  dd.exchange();
+  patch.exchange();
+
+  INFO("every fine halo point, exchanged or interpolated from the parent, continues the linear field");
+  for (auto &ld : patch.fine().domains()) {
+    const Dim3 raw = ld.raw_size();
+    const std::vector<Q1> host = host_quantity<Q1>(ld, 0);
+    for (int64_t z = 0; z < raw.z; ++z) {
+      for (int64_t y = 0; y < raw.y; ++y) {
+        for (int64_t x = 0; x < raw.x; ++x) {
+          const int64_t fx = ld.origin().x + x - 1;
+          REQUIRE(host[z * raw.y * raw.x + y * raw.x + x] == Q1(1.75 + fx / 2.0));
+        }
+      }
+    }
+  }
+
+  fill(patch.fine(), [](const Dim3 &) { return Q1(100); });
+  MPI_Barrier(MPI_COMM_WORLD);
+  patch.coarsen();
+
+  INFO("the parent under the patch is the fine average, the rest is unchanged");
+  for (auto &ld : dd.domains()) {
+    const Dim3 raw = ld.raw_size();
+    const std::vector<Q1> host = host_quantity<Q1>(ld, 0);
+    for (int64_t z = 1; z < 1 + ld.size().z; ++z) {
+      for (int64_t y = 1; y < 1 + ld.size().y; ++y) {
+        for (int64_t x = 1; x < 1 + ld.size().x; ++x) {
+          const Dim3 p = ld.origin() + Dim3(x, y, z) - 1;
+          const bool under = p.x >= 2 && p.x < 6 && p.y >= 2 && p.y < 6 && p.z >= 2 && p.z < 6;
+          REQUIRE(host[z * raw.y * raw.x + y * raw.x + x] == (under ? Q1(100) : Q1(p.x)));
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("exchange group") {
+  typedef float Q1;
+  const Dim3 sz(20, 20, 20);
+
+  dim3 dimGrid(10, 10, 10);
+  dim3 dimBlock(8, 8, 8);
+
+  DistributedDomain dd1(sz.x, sz.y, sz.z);
+  DistributedDomain dd2(sz.x, sz.y, sz.z);
+  auto dh1 = dd1.add_data<Q1>("d1");
+  auto dh2a = dd2.add_data<Q1>("d2a");
+  auto dh2b = dd2.add_data<Q1>("d2b");
+  for (DistributedDomain *dd : {&dd1, &dd2}) {
+    dd->set_radius(1);
+    dd->set_methods(MethodFlags::All);
+  }
+
+  ExchangeGroup group;
+  group.add(dd1);
+  group.add(dd2);
+  group.realize();
+  REQUIRE(dd1.domains().size() == dd2.domains().size());
+
+  for (size_t di = 0; di < dd1.domains().size(); ++di) {
+    LocalDomain &d1 = dd1.domains()[di];
+    LocalDomain &d2 = dd2.domains()[di];
+    CUDA_RUNTIME(cudaSetDevice(d1.gpu()));
+    init_kernel<<<dimGrid, dimBlock>>>(d1.get_curr(dh1), d1.origin(), d1.raw_size());
+    init_kernel<<<dimGrid, dimBlock>>>(d2.get_curr(dh2a), d2.origin(), d2.raw_size());
+    init_kernel<<<dimGrid, dimBlock>>>(d2.get_curr(dh2b), d2.origin(), d2.raw_size());
+    CUDA_RUNTIME(cudaDeviceSynchronize());
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  group.exchange();
+
+  for (auto &d : dd1.domains()) {
+    require_coords<Q1>(d, 0, sz);
+  }
+  for (auto &d : dd2.domains()) {
+    require_coords<Q1>(d, 0, sz);
+    require_coords<Q1>(d, 1, sz);
+  }
+}
+
+TEST_CASE("neighbor_exchange") {
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  typedef int64_t Q1;
+  const Dim3 sz(20, 20, 20);
+  const int64_t steps = 5;
+
+  dim3 dimGrid(10, 10, 10);
+  dim3 dimBlock(8, 8, 8);
+
+  // every neighbor must be on this rank
+  MPI_Comm self;
+  MPI_Comm_split(MPI_COMM_WORLD, rank, 0, &self);
+  {
+    DistributedDomain dd(sz.x, sz.y, sz.z, self);
+    dd.set_radius(1);
+    auto dh = dd.add_data<Q1>("d0");
+    dd.set_subdomains_per_gpu(4);
+    dd.set_methods(MethodFlags::CudaMemcpyPeer | MethodFlags::CudaKernel);
+    dd.realize();
+
+    for (auto &d : dd.domains()) {
+      CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+      stamp_kernel<<<dimGrid, dimBlock>>>(d.get_curr(dh), d.origin(), d.raw_size(), 0);
+      CUDA_RUNTIME(cudaDeviceSynchronize());
+    }
+    dd.exchange();
+
+    // points of each domain that did not hold the step just exchanged, counted by its thread since REQUIRE is not
+    // thread-safe
+    std::vector<int64_t> wrong(dd.domains().size(), 0);
+
+    INFO("one thread per domain writes each step into next and exchanges with only its neighbors");
+    std::vector<std::thread> threads;
+    for (size_t di = 0; di < dd.domains().size(); ++di) {
+      threads.push_back(std::thread([&, di]() {
+        LocalDomain &d = dd.domains()[di];
+        cudaStream_t stream;
+        CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+        CUDA_RUNTIME(cudaStreamCreate(&stream));
+        for (int64_t step = 1; step <= steps; ++step) {
+          CUDA_RUNTIME(cudaSetDevice(d.gpu()));
+          stamp_kernel<<<dimGrid, dimBlock, 0, stream>>>(d.get_next(dh), d.origin(), d.raw_size(), step);
+          CUDA_RUNTIME(cudaStreamSynchronize(stream));
+          dd.neighbor_exchange(di);
+
+          // only this thread fills this domain's halo, so it holds this step until the next neighbor_exchange()
+          const Dim3 ext = d.raw_size(0);
+          auto vec = d.quantity_to_host(0);
+          std::vector<Q1> quantity(ext.flatten());
+          if (vec.size() != quantity.size() * sizeof(Q1)) {
+            wrong[di] += quantity.size();
+            continue;
+          }
+          std::memcpy(quantity.data(), vec.data(), vec.size());
+          for (int64_t z = 0; z < ext.z; ++z) {
+            for (int64_t y = 0; y < ext.y; ++y) {
+              for (int64_t x = 0; x < ext.x; ++x) {
+                const Dim3 coord = (Dim3(x, y, z) - Dim3(1, 1, 1) + d.origin()).wrap(sz);
+                const Q1 val = quantity[z * (ext.y * ext.x) + y * (ext.x) + x];
+                if ((val >> 32) != step || int(val & 0xFFFFFFFF) != pack_xyz(coord.x, coord.y, coord.z)) {
+                  ++wrong[di];
+                }
+              }
+            }
+          }
+        }
+        CUDA_RUNTIME(cudaStreamDestroy(stream));
+      }));
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    CUDA_RUNTIME(cudaDeviceSynchronize());
+
+    INFO("after every step, each domain's interior and halo hold that step's values");
+    for (size_t di = 0; di < wrong.size(); ++di) {
+      INFO("domain " << di);
+      REQUIRE(0 == wrong[di]);
+    }
+  }
+  MPI_Comm_free(&self);
+}
@@ -38,8 +38,10 @@ init_kernel(Accessor<T> dst, //<! [out] region to fill
 }
 
 /* check an exchange that supports the given kernel radius
+   linkCap limits the bytes in flight to each rank, 0 for no limit
+   chunkBytes is the remote message chunk size
 */
-static void check_exchange(const Radius &radius) {
+static void check_exchange(const Radius &radius, size_t linkCap = 0, size_t chunkBytes = REMOTE_CHUNK_BYTES) {
 
   int rank;
   int size;
@@ -56,6 +58,8 @@ static void check_exchange(const Radius &radius) {
   dd.set_radius(radius);
   auto dh1 = dd.add_data<Q1>("d0");
   dd.set_methods(MethodFlags::CudaMpi);
+  dd.set_link_cap(linkCap);
+  dd.set_remote_chunk_bytes(chunkBytes);
 
   INFO("realize");
   dd.realize();
@@ -232,4 +236,16 @@ TEST_CASE("exchange2") {
     check_exchange(r);
   }
 
+  SECTION("r=2, link cap") { // every send waits for the previous send to its rank
+    check_exchange(Radius::constant(2), 1);
+  }
+
+  SECTION("r=2, small chunks") { // most messages are several chunks, the last one partial
+    check_exchange(Radius::constant(2), 0, 100);
+  }
+
+  SECTION("r=2, small chunks, link cap") {
+    check_exchange(Radius::constant(2), 1, 100);
+  }
+
 }
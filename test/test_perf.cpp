@@ -0,0 +1,227 @@
+/* CPU-only performance regression tests, run by ctest with the "perf" label.
+
+   test_perf <suite> <baseline file> <tolerance>
+
+   The "cpu" suite times the QAP solvers and the partitioners on one rank. The "mpi" suite times building the
+   Trivial and Masked placements on every rank of the job (ctest runs it on 4). Without a GPU, these are the parts of
+   the library a CPU-only machine can guard; packing and exchanging halos need a GPU and are measured by
+   bin/bench_pack and bin/bench_exchange. Each metric is the median of several repetitions, in seconds, and the
+   slowest rank's for the "mpi" suite. Logging is muted while timing, so the background writer is not measured.
+
+   Metrics are compared to the baseline file, one "<metric> <seconds>" per line, which is specific to the machine.
+   A metric slower than (1 + tolerance) * baseline fails the test, naming the metric and how much slower it was.
+   A metric missing from the baseline skips the test (exit code SKIPPED), since there is nothing to compare against.
+   With STENCIL_PERF_UPDATE=1 in the environment, all of this suite's metrics are recorded as the baseline instead of
+   being checked. A metric faster than (1 - tolerance) * baseline is reported, so the baseline can be updated to guard
+   the gain.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#include "stencil/logging.hpp"
+#include "stencil/mat2d.hpp"
+#include "stencil/mpi.hpp"
+#include "stencil/mpi_topology.hpp"
+#include "stencil/partition.hpp"
+#include "stencil/qap.hpp"
+#include "stencil/radius.hpp"
+
+typedef std::map<std::string, double> Metrics;
+
+// exit code for ctest's SKIP_RETURN_CODE
+constexpr int SKIPPED = 77;
+
+/* median seconds of `reps` calls to f after one warmup, the slowest rank's if `collective`
+ */
+double time_median(int reps, bool collective, const std::function<void()> &f) {
+  logging::Mute mute;
+  f();
+  std::vector<double> times;
+  for (int i = 0; i < reps; ++i) {
+    if (collective) {
+      MPI_Barrier(MPI_COMM_WORLD);
+    }
+    const double start = MPI_Wtime();
+    f();
+    double elapsed = MPI_Wtime() - start;
+    if (collective) {
+      MPI_Allreduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    }
+    times.push_back(elapsed);
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+Mat2D<double> random_matrix(size_t n, std::mt19937 &g) {
+  std::uniform_real_distribution<double> dist(1, 10);
+  Mat2D<double> ret(n, n, 0);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      ret.at(i, j) = i == j ? 0 : dist(g);
+    }
+  }
+  return ret;
+}
+
+Metrics run_cpu() {
+  Metrics ret;
+
+  std::mt19937 g(0);
+  const Mat2D<double> w8 = random_matrix(8, g);
+  Mat2D<double> d8 = random_matrix(8, g);
+  ret["qap.solve.8"] = time_median(9, false, [&]() { qap::solve(w8, d8); });
+  const Mat2D<double> w64 = random_matrix(64, g);
+  Mat2D<double> d64 = random_matrix(64, g);
+  ret["qap.solve_catch.64"] = time_median(9, false, [&]() { qap::solve_catch(w64, d64); });
+
+  ret["partition.rank"] = time_median(9, false, [&]() {
+    for (int i = 0; i < 20; ++i) {
+      for (int64_t n = 1; n <= 1024; ++n) {
+        RankPartition part(Dim3(1000, 750, 500), n);
+        (void)part.dim();
+      }
+    }
+  });
+  ret["partition.node"] = time_median(9, false, [&]() {
+    for (int i = 0; i < 100; ++i) {
+      for (int64_t nodes = 1; nodes <= 256; ++nodes) {
+        NodePartition part(Dim3(1000, 750, 500), Radius::constant(3), nodes, 6);
+        (void)part.dim();
+      }
+    }
+  });
+  ret["partition.efficient_split"] = time_median(9, false, [&]() {
+    (void)efficient_split(Dim3(512, 512, 512), 4096, Radius::constant(3), 0.7);
+  });
+  return ret;
+}
+
+Metrics run_mpi() {
+  Metrics ret;
+  const Dim3 ext(1024, 1024, 1024);
+  MpiTopology topo(MPI_COMM_WORLD);
+  const std::vector<int> cudaIds(64, 0); // 64 subdomains per rank
+
+  ret["placement.trivial"] = time_median(11, true, [&]() {
+    for (int i = 0; i < 100; ++i) {
+      Trivial placement(ext, topo, cudaIds);
+    }
+  });
+
+  // every other block of a grid with more blocks than subdomains is active
+  const Dim3 blocks(32, 32, 16);
+  std::vector<bool> mask(blocks.flatten());
+  for (size_t i = 0; i < mask.size(); ++i) {
+    mask[i] = i % 2;
+  }
+  ret["placement.masked"] = time_median(11, true, [&]() {
+    for (int i = 0; i < 5; ++i) {
+      Masked placement(ext, blocks, mask, topo, cudaIds);
+    }
+  });
+  return ret;
+}
+
+Metrics read_baseline(const std::string &path) {
+  Metrics ret;
+  std::ifstream is(path);
+  std::string line;
+  while (std::getline(is, line)) {
+    std::stringstream ss(line);
+    std::string name;
+    double secs;
+    if ('#' != line[0] && ss >> name >> secs) {
+      ret[name] = secs;
+    }
+  }
+  return ret;
+}
+
+void write_baseline(const std::string &path, const Metrics &metrics) {
+  std::ofstream os(path);
+  os << "# seconds per metric on this machine, written by test_perf\n";
+  for (auto &kv : metrics) {
+    os << kv.first << " " << kv.second << "\n";
+  }
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  const int rank = mpi::world_rank();
+
+  if (argc != 4) {
+    LOG_FATAL("usage: test_perf <cpu|mpi> <baseline file> <tolerance>");
+  }
+  const std::string suite = argv[1];
+  const std::string path = argv[2];
+  const double tolerance = std::atof(argv[3]);
+  const char *update = std::getenv("STENCIL_PERF_UPDATE");
+  const bool updating = update && 0 == std::strcmp(update, "1");
+
+  Metrics metrics;
+  if ("cpu" == suite) {
+    if (0 == rank) {
+      metrics = run_cpu();
+    }
+  } else if ("mpi" == suite) {
+    metrics = run_mpi();
+  } else {
+    LOG_FATAL("unknown suite " << suite);
+  }
+
+  int failed = 0;
+  int missing = 0;
+  if (0 == rank) {
+    Metrics baseline = read_baseline(path);
+    bool changed = false;
+    for (auto &kv : metrics) {
+      auto it = baseline.find(kv.first);
+      if (updating) {
+        std::cout << kv.first << ": " << kv.second << "s, recorded as the baseline\n";
+        baseline[kv.first] = kv.second;
+        changed = true;
+        continue;
+      }
+      if (baseline.end() == it) {
+        std::cout << "NO BASELINE: " << kv.first << " (" << kv.second << "s) is not in " << path
+                  << "; rerun with STENCIL_PERF_UPDATE=1 to record it\n";
+        missing = 1;
+        continue;
+      }
+      const double ratio = kv.second / it->second;
+      std::cout << kv.first << ": " << kv.second << "s, baseline " << it->second << "s (" << ratio << "x)\n";
+      if (ratio > 1 + tolerance) {
+        std::cout << "REGRESSION: " << kv.first << " is " << (ratio - 1) * 100 << "% slower than the baseline ("
+                  << kv.second << "s vs " << it->second << "s, tolerance " << tolerance * 100 << "%)\n";
+        ++failed;
+      } else if (ratio < 1 - tolerance) {
+        std::cout << "IMPROVED: " << kv.first << " is " << (1 - ratio) * 100
+                  << "% faster than the baseline; rerun with STENCIL_PERF_UPDATE=1 so the gain is guarded\n";
+      }
+    }
+    if (changed) {
+      write_baseline(path, baseline);
+      std::cout << "wrote " << path << "\n";
+    }
+  }
+  MPI_Bcast(&failed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&missing, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  MPI_Finalize();
+  if (failed) {
+    return EXIT_FAILURE;
+  }
+  return missing ? SKIPPED : EXIT_SUCCESS;
+}